@@ -135,12 +135,29 @@ CREATE INDEX bttest_a_expr_idx ON bttest_a ((ifun(id) + ifun(0)))
 
 SELECT bt_index_check('bttest_a_expr_idx', true);
 
+--
+-- Test high keys truncated within a bytea or text value, built both by page
+-- splits and by CREATE INDEX
+--
+CREATE TABLE bttest_prefix (t text COLLATE "C", b bytea);
+CREATE INDEX bttest_prefix_idx ON bttest_prefix (t);
+CREATE INDEX bttest_prefix_pattern_idx ON bttest_prefix (t text_pattern_ops);
+INSERT INTO bttest_prefix
+  SELECT s, s::bytea FROM
+    (SELECT 'https://www.example.com/some/rather/long/path/' || i AS s
+     FROM generate_series(1, 20000) i) ss;
+CREATE INDEX bttest_prefix_bytea_idx ON bttest_prefix (b, t);
+SELECT bt_index_parent_check('bttest_prefix_idx', true, true);
+SELECT bt_index_parent_check('bttest_prefix_pattern_idx', true, true);
+SELECT bt_index_parent_check('bttest_prefix_bytea_idx', true, true);
+
 -- cleanup
 DROP TABLE bttest_a;
 DROP TABLE bttest_b;
 DROP TABLE bttest_multi;
 DROP TABLE delete_test_table;
 DROP TABLE toast_bug;
+DROP TABLE bttest_prefix;
 DROP FUNCTION ifun(int8);
 DROP OWNED BY regress_bttest_role; -- permissions
 DROP ROLE regress_bttest_role;
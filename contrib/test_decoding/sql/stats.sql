@@ -43,6 +43,14 @@ SELECT count(*) FROM pg_logical_slot_peek_changes('regression_slot_stats1', NULL
 SELECT pg_stat_force_next_flush();
 SELECT slot_name, spill_txns > 0 AS spill_txns, spill_count > 0 AS spill_count FROM pg_stat_replication_slots;
 
+-- spilling the xact with compression; fewer bytes reach the disk
+SELECT pg_stat_reset_replication_slot('regression_slot_stats2');
+SET logical_decoding_spill_compression = pglz;
+SELECT count(*) FROM pg_logical_slot_peek_changes('regression_slot_stats2', NULL, NULL, 'skip-empty-xacts', '1');
+RESET logical_decoding_spill_compression;
+SELECT pg_stat_force_next_flush();
+SELECT slot_name, spill_txns > 0 AS spill_txns, spill_disk_bytes > 0 AS spill_disk_bytes, spill_disk_bytes <= spill_bytes AS compressed FROM pg_stat_replication_slots WHERE slot_name = 'regression_slot_stats2';
+
 -- Ensure stats can be repeatedly accessed using the same stats snapshot. See
 -- https://postgr.es/m/20210317230447.c7uc4g3vbs4wi32i%40alap3.anarazel.de
 BEGIN;
@@ -186,79 +186,116 @@ GetVisibilityMapPins(Relation relation, Buffer buffer1, Buffer buffer2,
 }
 
 /*
- * Extend a relation by multiple blocks to avoid future contention on the
- * relation extension lock.  Our goal is to pre-extend the relation by an
+ * Upper limit on the number of blocks RelationAddBlocks() adds at once.  We
+ * pin all of them for a short while, so this can't be very large.
+ */
+#define MAX_BUFFERS_TO_EXTEND_BY	64
+
+/*
+ * Extend the relation, and return an exclusive-locked, initialized buffer of
+ * the first new page.
+ *
+ * We add more than one page at a time when that's likely to be useful, so
+ * that we don't have to come back for the relation extension lock so soon,
+ * and so that other backends waiting for the lock can use the extra pages
+ * instead of extending further themselves.  num_pages is the number of pages
+ * the caller expects to fill.  Our goal is to pre-extend the relation by an
  * amount which ramps up as the degree of contention ramps up, but limiting
  * the result to some sane overall value.
+ *
+ * If needLock, the caller holds the relation extension lock; we release it
+ * as soon as the relation has been extended.
  */
-static void
-RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
+static Buffer
+RelationAddBlocks(Relation relation, BulkInsertState bistate,
+				  int num_pages, bool use_fsm, bool needLock)
 {
-	BlockNumber blockNum,
-				firstBlock = InvalidBlockNumber;
-	int			extraBlocks;
-	int			lockWaiters;
-
-	/* Use the length of the lock wait queue to judge how much to extend. */
-	lockWaiters = RelationExtensionLockWaiterCount(relation);
-	if (lockWaiters <= 0)
-		return;
-
-	/*
-	 * It might seem like multiplying the number of lock waiters by as much as
-	 * 20 is too aggressive, but benchmarking revealed that smaller numbers
-	 * were insufficient.  512 is just an arbitrary cap to prevent
-	 * pathological results.
-	 */
-	extraBlocks = Min(512, lockWaiters * 20);
+	Buffer		victim_buffers[MAX_BUFFERS_TO_EXTEND_BY];
+	BlockNumber first_block;
+	BlockNumber last_block;
+	uint32		extend_by;
+	uint32		not_in_fsm;
+	Buffer		buffer;
+	Page		page;
 
-	do
+	if (bistate == NULL && !use_fsm)
+	{
+		/* Nobody could find any extra pages, so don't bother */
+		extend_by = 1;
+	}
+	else
 	{
-		Buffer		buffer;
-		Page		page;
-		Size		freespace;
+		extend_by = Max(num_pages, 1);
 
 		/*
-		 * Extend by one page.  This should generally match the main-line
-		 * extension code in RelationGetBufferForTuple, except that we hold
-		 * the relation extension lock throughout, and we don't immediately
-		 * initialize the page (see below).
+		 * Use the length of the lock wait queue to judge how much to extend.
+		 * It might seem like adding as many as 20 pages per waiter is too
+		 * aggressive, but benchmarking revealed that smaller numbers were
+		 * insufficient.
 		 */
-		buffer = ReadBufferBI(relation, P_NEW, RBM_ZERO_AND_LOCK, bistate);
-		page = BufferGetPage(buffer);
-
-		if (!PageIsNew(page))
-			elog(ERROR, "page %u of relation \"%s\" should be empty but is not",
-				 BufferGetBlockNumber(buffer),
-				 RelationGetRelationName(relation));
+		if (needLock)
+			extend_by += RelationExtensionLockWaiterCount(relation) * 20;
 
 		/*
-		 * Add the page to the FSM without initializing. If we were to
-		 * initialize here, the page would potentially get flushed out to disk
-		 * before we add any useful content. There's no guarantee that that'd
-		 * happen before a potential crash, so we need to deal with
-		 * uninitialized pages anyway, thus avoid the potential for
-		 * unnecessary writes.
+		 * If we extended using this bistate before, we're likely to need a
+		 * lot more space; extend by at least as much as we have so far, so
+		 * that the amount grows geometrically up to the limit.
 		 */
+		if (bistate)
+			extend_by = Max(extend_by, bistate->already_extended_by);
+
+		extend_by = Min(extend_by, MAX_BUFFERS_TO_EXTEND_BY);
+	}
+
+	first_block = ExtendBufferedRelBy(relation, MAIN_FORKNUM,
+									  bistate ? bistate->strategy : NULL,
+									  EB_SKIP_EXTENSION_LOCK | EB_LOCK_FIRST,
+									  extend_by, victim_buffers, &extend_by);
+	last_block = first_block + (extend_by - 1);
+
+	/*
+	 * Release the file-extension lock; it's now OK for someone else to extend
+	 * the relation some more.
+	 */
+	if (needLock)
+		UnlockRelationForExtension(relation, ExclusiveLock);
 
-		/* we'll need this info below */
-		blockNum = BufferGetBlockNumber(buffer);
-		freespace = BufferGetPageSize(buffer) - SizeOfPageHeaderData;
+	/*
+	 * We need to initialize the empty new page.  ExtendBufferedRelBy() has
+	 * made sure that it really is empty.
+	 */
+	buffer = victim_buffers[0];
+	page = BufferGetPage(buffer);
+	Assert(PageIsNew(page));
+	PageInit(page, BufferGetPageSize(buffer), 0);
+	MarkBufferDirty(buffer);
 
-		UnlockReleaseBuffer(buffer);
+	/*
+	 * Decide which of the extra pages to advertise in the FSM.  With a
+	 * bistate, we're going to use the pages we asked for ourselves, and only
+	 * the rest is for other backends.  We never enter the page we're about to
+	 * return.
+	 *
+	 * The extra pages are entered into the FSM without initializing them.  If
+	 * we were to initialize them here, they would potentially get flushed out
+	 * to disk before we add any useful content.  There's no guarantee that
+	 * that'd happen before a potential crash, so we need to deal with
+	 * uninitialized pages anyway, thus avoid the potential for unnecessary
+	 * writes.
+	 */
+	if (bistate)
+		not_in_fsm = Min(Max(num_pages, 1), extend_by);
+	else
+		not_in_fsm = 1;
 
-		/* Remember first block number thus added. */
-		if (firstBlock == InvalidBlockNumber)
-			firstBlock = blockNum;
+	for (uint32 i = 1; i < extend_by; i++)
+	{
+		ReleaseBuffer(victim_buffers[i]);
 
-		/*
-		 * Immediately update the bottom level of the FSM.  This has a good
-		 * chance of making this page visible to other concurrently inserting
-		 * backends, and we want that to happen without delay.
-		 */
-		RecordPageWithFreeSpace(relation, blockNum, freespace);
+		if (use_fsm && i >= not_in_fsm)
+			RecordPageWithFreeSpace(relation, first_block + i,
+									BLCKSZ - SizeOfPageHeaderData);
 	}
-	while (--extraBlocks > 0);
 
 	/*
 	 * Updating the upper levels of the free space map is too expensive to do
@@ -266,7 +303,33 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
 	 * subsequent insertion activity sees all of those nifty free pages we
 	 * just inserted.
 	 */
-	FreeSpaceMapVacuumRange(relation, firstBlock, blockNum + 1);
+	if (use_fsm && not_in_fsm < extend_by)
+		FreeSpaceMapVacuumRange(relation, first_block + not_in_fsm,
+								last_block + 1);
+
+	if (bistate)
+	{
+		/* Remember the extra pages, so we can use them without the FSM */
+		if (extend_by > 1)
+		{
+			bistate->next_free = first_block + 1;
+			bistate->last_free = last_block;
+		}
+		else
+		{
+			bistate->next_free = InvalidBlockNumber;
+			bistate->last_free = InvalidBlockNumber;
+		}
+		bistate->already_extended_by += extend_by;
+
+		/* Save the new page as target for future inserts */
+		if (bistate->current_buf != InvalidBuffer)
+			ReleaseBuffer(bistate->current_buf);
+		IncrBufferRefCount(buffer);
+		bistate->current_buf = buffer;
+	}
+
+	return buffer;
 }
 
 /*
@@ -321,6 +384,10 @@ RelationAddExtraBlocks(Relation relation, BulkInsertState bistate)
  *	BULKWRITE buffer selection strategy object to the buffer manager.
  *	Passing NULL for bistate selects the default behavior.
  *
+ *	num_pages is the number of pages the caller expects to fill, including
+ *	the one returned; if we have to extend the relation, we try to add at
+ *	least that many pages at once.
+ *
  *	We don't fill existing pages further than the fillfactor, except for large
  *	tuples in nearly-empty pages.  This is OK since this routine is not
  *	consulted when updating a tuple and keeping it on the same page, which is
@@ -333,7 +400,8 @@ Buffer
 RelationGetBufferForTuple(Relation relation, Size len,
 						  Buffer otherBuffer, int options,
 						  BulkInsertState bistate,
-						  Buffer *vmbuffer, Buffer *vmbuffer_other)
+						  Buffer *vmbuffer, Buffer *vmbuffer_other,
+						  int num_pages)
 {
 	bool		use_fsm = !(options & HEAP_INSERT_SKIP_FSM);
 	Buffer		buffer = InvalidBuffer;
@@ -552,18 +620,44 @@ loop:
 			ReleaseBuffer(buffer);
 		}
 
-		/* Without FSM, always fall out of the loop and extend */
-		if (!use_fsm)
-			break;
+		if (bistate && bistate->next_free != InvalidBlockNumber)
+		{
+			Assert(bistate->next_free <= bistate->last_free);
 
-		/*
-		 * Update FSM as to condition of this page, and ask for another page
-		 * to try.
-		 */
-		targetBlock = RecordAndGetPageWithFreeSpace(relation,
-													targetBlock,
-													pageFreeSpace,
-													targetFreeSpace);
+			/*
+			 * We bulk-extended the relation earlier and haven't used up all
+			 * of the pages yet, so try the next one without consulting the
+			 * FSM.  Do record this page's free space, though; somebody might
+			 * be able to use it for narrower tuples.
+			 */
+			if (use_fsm)
+				RecordPageWithFreeSpace(relation, targetBlock, pageFreeSpace);
+
+			targetBlock = bistate->next_free;
+			if (bistate->next_free >= bistate->last_free)
+			{
+				bistate->next_free = InvalidBlockNumber;
+				bistate->last_free = InvalidBlockNumber;
+			}
+			else
+				bistate->next_free++;
+		}
+		else if (!use_fsm)
+		{
+			/* Without FSM, always fall out of the loop and extend */
+			break;
+		}
+		else
+		{
+			/*
+			 * Update FSM as to condition of this page, and ask for another
+			 * page to try.
+			 */
+			targetBlock = RecordAndGetPageWithFreeSpace(relation,
+														targetBlock,
+														pageFreeSpace,
+														targetFreeSpace);
+		}
 	}
 
 	/*
@@ -577,10 +671,9 @@ loop:
 	needLock = !RELATION_IS_LOCAL(relation);
 
 	/*
-	 * If we need the lock but are not able to acquire it immediately, we'll
-	 * consider extending the relation by multiple blocks at a time to manage
-	 * contention on the relation extension lock.  However, this only makes
-	 * sense if we're using the FSM; otherwise, there's no point.
+	 * If we need the lock but are not able to acquire it immediately, some
+	 * other backend may extend the relation by enough for us while we wait.
+	 * That only helps if we're using the FSM, though.
 	 */
 	if (needLock)
 	{
@@ -606,38 +699,17 @@ loop:
 				UnlockRelationForExtension(relation, ExclusiveLock);
 				goto loop;
 			}
-
-			/* Time to bulk-extend. */
-			RelationAddExtraBlocks(relation, bistate);
 		}
 	}
 
 	/*
-	 * In addition to whatever extension we performed above, we always add at
-	 * least one block to satisfy our own request.
-	 *
-	 * XXX This does an lseek - rather expensive - but at the moment it is the
-	 * only way to accurately determine how many blocks are in a relation.  Is
-	 * it worth keeping an accurate file length in shared memory someplace,
-	 * rather than relying on the kernel to do it for us?
-	 */
-	buffer = ReadBufferBI(relation, P_NEW, RBM_ZERO_AND_LOCK, bistate);
-
-	/*
-	 * We need to initialize the empty new page.  Double-check that it really
-	 * is empty (this should never happen, but if it does we don't want to
-	 * risk wiping out valid data).
+	 * Add at least one block to satisfy our own request, and perhaps more.
+	 * This releases the extension lock.
 	 */
+	buffer = RelationAddBlocks(relation, bistate, num_pages, use_fsm,
+							   needLock);
 	page = BufferGetPage(buffer);
 
-	if (!PageIsNew(page))
-		elog(ERROR, "page %u of relation \"%s\" should be empty but is not",
-			 BufferGetBlockNumber(buffer),
-			 RelationGetRelationName(relation));
-
-	PageInit(page, BufferGetPageSize(buffer), 0);
-	MarkBufferDirty(buffer);
-
 	/*
 	 * The page is empty, pin vmbuffer to set all_frozen bit.
 	 */
@@ -647,13 +719,6 @@ loop:
 		visibilitymap_pin(relation, BufferGetBlockNumber(buffer), vmbuffer);
 	}
 
-	/*
-	 * Release the file-extension lock; it's now OK for someone else to extend
-	 * the relation some more.
-	 */
-	if (needLock)
-		UnlockRelationForExtension(relation, ExclusiveLock);
-
 	/*
 	 * Lock the other buffer. It's guaranteed to be of a lower page number
 	 * than the new page. To conform with the deadlock prevent rules, we ought
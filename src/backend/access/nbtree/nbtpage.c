@@ -29,6 +29,7 @@
 #include "access/xlog.h"
 #include "access/xloginsert.h"
 #include "miscadmin.h"
+#include "storage/freespace.h"
 #include "storage/indexfsm.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
@@ -846,6 +847,12 @@ _bt_log_reuse_page(Relation rel, BlockNumber blkno, FullTransactionId safexid)
 	XLogInsert(RM_BTREE_ID, XLOG_BTREE_REUSE_PAGE);
 }
 
+/*
+ * Upper limit on the number of pages _bt_getbuf() adds to the index at once
+ * when other backends are waiting to extend it, too.
+ */
+#define BT_MAX_EXTEND_BY	16
+
 /*
  *	_bt_getbuf() -- Get a buffer by block number for read or write.
  *
@@ -882,10 +889,16 @@ _bt_getbuf(Relation rel, BlockNumber blkno, int access)
 	else
 	{
 		bool		needLock;
+		bool		recheckedFSM = false;
+		Buffer		newbufs[BT_MAX_EXTEND_BY];
+		BlockNumber firstblkno;
+		uint32		extend_by = 1;
 		Page		page;
 
 		Assert(access == BT_WRITE);
 
+retry:
+
 		/*
 		 * First see if the FSM knows of any free pages.
 		 *
@@ -962,7 +975,7 @@ _bt_getbuf(Relation rel, BlockNumber blkno, int access)
 		}
 
 		/*
-		 * Extend the relation by one page.
+		 * Extend the relation.
 		 *
 		 * We have to use a lock to ensure no one else is extending the rel at
 		 * the same time, else we will both try to initialize the same new
@@ -971,14 +984,52 @@ _bt_getbuf(Relation rel, BlockNumber blkno, int access)
 		 */
 		needLock = !RELATION_IS_LOCAL(rel);
 
-		if (needLock)
+		if (needLock &&
+			!ConditionalLockRelationForExtension(rel, ExclusiveLock))
+		{
+			/* Couldn't get the lock immediately; wait for it. */
 			LockRelationForExtension(rel, ExclusiveLock);
 
-		buf = ReadBuffer(rel, P_NEW);
+			/*
+			 * Whoever held the lock may have left spare pages in the FSM for
+			 * us (see below), so look there once more before extending.
+			 */
+			if (!recheckedFSM)
+			{
+				UnlockRelationForExtension(rel, ExclusiveLock);
+				recheckedFSM = true;
+				goto retry;
+			}
+
+			/*
+			 * Other backends are queuing up behind us to extend the index
+			 * too.  Add a page for each of them while we're at it.
+			 */
+			extend_by = 1 + RelationExtensionLockWaiterCount(rel);
+			extend_by = Min(extend_by, BT_MAX_EXTEND_BY);
+		}
+
+		firstblkno = ExtendBufferedRelBy(rel, MAIN_FORKNUM, NULL,
+										 EB_SKIP_EXTENSION_LOCK,
+										 extend_by, newbufs, &extend_by);
+		buf = newbufs[0];
 
 		/* Acquire buffer lock on new page */
 		_bt_lockbuf(rel, buf, BT_WRITE);
 
+		/*
+		 * Hand any extra pages over to the FSM.  They are all-zeroes, which
+		 * the code above knows to reuse immediately.
+		 */
+		for (uint32 i = 1; i < extend_by; i++)
+		{
+			ReleaseBuffer(newbufs[i]);
+			RecordFreeIndexPage(rel, firstblkno + i);
+		}
+		if (extend_by > 1)
+			FreeSpaceMapVacuumRange(rel, firstblkno + 1,
+									firstblkno + extend_by);
+
 		/*
 		 * Release the file-extension lock; it's now OK for someone else to
 		 * extend the relation some more.  Note that we cannot release this
@@ -227,7 +227,9 @@ btgettuple(IndexScanDesc scan, ScanDirection dir)
 		if (so->numArrayKeys < 0)
 			return false;
 
-		_bt_start_array_keys(scan, dir);
+		/* punt if a skip array finds the index empty */
+		if (!_bt_start_array_keys(scan, dir))
+			return false;
 	}
 
 	/* This loop handles advancing to the next array elements, if any */
@@ -297,7 +299,8 @@ btgetbitmap(IndexScanDesc scan, TIDBitmap *tbm)
 		if (so->numArrayKeys < 0)
 			return ntids;
 
-		_bt_start_array_keys(scan, ForwardScanDirection);
+		if (!_bt_start_array_keys(scan, ForwardScanDirection))
+			return ntids;
 	}
 
 	/* This loop handles advancing to the next array elements, if any */
@@ -355,8 +358,9 @@ btbeginscan(Relation rel, int nkeys, int norderbys)
 	so = (BTScanOpaque) palloc(sizeof(BTScanOpaqueData));
 	BTScanPosInvalidate(so->currPos);
 	BTScanPosInvalidate(so->markPos);
+	/* leave room for the key of a skip array, see _bt_preprocess_skip_key */
 	if (scan->numberOfKeys > 0)
-		so->keyData = (ScanKey) palloc(scan->numberOfKeys * sizeof(ScanKeyData));
+		so->keyData = (ScanKey) palloc((scan->numberOfKeys + 1) * sizeof(ScanKeyData));
 	else
 		so->keyData = NULL;
 
@@ -364,6 +368,7 @@ btbeginscan(Relation rel, int nkeys, int norderbys)
 	so->numArrayKeys = 0;
 	so->arrayKeys = NULL;
 	so->arrayContext = NULL;
+	so->skipScan = false;
 
 	so->killedItems = NULL;		/* until needed */
 	so->numKilled = 0;
@@ -439,6 +444,9 @@ btrescan(IndexScanDesc scan, ScanKey scankey, int nscankeys,
 
 	/* If any keys are SK_SEARCHARRAY type, set up array-key info */
 	_bt_preprocess_array_keys(scan);
+
+	/* Skip over the first column if it has no keys, but the second does */
+	_bt_preprocess_skip_key(scan);
 }
 
 /*
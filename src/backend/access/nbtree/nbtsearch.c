@@ -20,12 +20,38 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/predicate.h"
+#include "utils/datum.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 
 
+/*
+ * Kinds of leading key attribute that _bt_binsrch() and _bt_binsrch_insert()
+ * can compare without calling the opclass comparison function.  See
+ * _bt_fastcmp_kind().
+ */
+typedef enum BTFastCmpKind
+{
+	BTFASTCMP_NONE,				/* use _bt_compare() for every probe */
+	BTFASTCMP_INT16,
+	BTFASTCMP_INT32,
+	BTFASTCMP_UINT32,
+	BTFASTCMP_INT64
+} BTFastCmpKind;
+
+
 static void _bt_drop_lock_and_maybe_pin(IndexScanDesc scan, BTScanPos sp);
+static BTFastCmpKind _bt_fastcmp_kind(Relation rel, BTScanInsert key);
+static inline int32 _bt_compare_fast(Relation rel, BTScanInsert key,
+									 Page page, OffsetNumber offnum,
+									 BTFastCmpKind kind);
 static OffsetNumber _bt_binsrch(Relation rel, BTScanInsert key, Buffer buf);
+static inline OffsetNumber _bt_binsrch_impl(Relation rel, BTScanInsert key,
+											Buffer buf, BTFastCmpKind kind);
+static inline OffsetNumber _bt_binsrch_insert_impl(Relation rel,
+												   BTInsertState insertstate,
+												   BTFastCmpKind kind);
 static int	_bt_binsrch_posting(BTScanInsert key, Page page,
 								OffsetNumber offnum);
 static bool _bt_readpage(IndexScanDesc scan, ScanDirection dir,
@@ -44,6 +70,10 @@ static bool _bt_parallel_readpage(IndexScanDesc scan, BlockNumber blkno,
 								  ScanDirection dir);
 static Buffer _bt_walk_left(Relation rel, Buffer buf, Snapshot snapshot);
 static bool _bt_endpoint(IndexScanDesc scan, ScanDirection dir);
+static Buffer _bt_skip_locate(IndexScanDesc scan, ScanDirection dir,
+							  bool first, Datum value, bool isnull,
+							  OffsetNumber *offnum);
+static bool _bt_skip_resume(IndexScanDesc scan, ScanDirection dir);
 static inline void _bt_initialize_more_data(BTScanOpaque so, ScanDirection dir);
 
 
@@ -338,6 +368,34 @@ static OffsetNumber
 _bt_binsrch(Relation rel,
 			BTScanInsert key,
 			Buffer buf)
+{
+	/*
+	 * Dispatch to a copy of the search loop specialized for the kind of the
+	 * leading key attribute, so that the comparisons get inlined.
+	 */
+	switch (_bt_fastcmp_kind(rel, key))
+	{
+		case BTFASTCMP_INT16:
+			return _bt_binsrch_impl(rel, key, buf, BTFASTCMP_INT16);
+		case BTFASTCMP_INT32:
+			return _bt_binsrch_impl(rel, key, buf, BTFASTCMP_INT32);
+		case BTFASTCMP_UINT32:
+			return _bt_binsrch_impl(rel, key, buf, BTFASTCMP_UINT32);
+		case BTFASTCMP_INT64:
+			return _bt_binsrch_impl(rel, key, buf, BTFASTCMP_INT64);
+		default:
+			return _bt_binsrch_impl(rel, key, buf, BTFASTCMP_NONE);
+	}
+}
+
+/*
+ * Workhorse for _bt_binsrch().  'kind' is always a compile-time constant.
+ */
+static pg_attribute_always_inline OffsetNumber
+_bt_binsrch_impl(Relation rel,
+				 BTScanInsert key,
+				 Buffer buf,
+				 BTFastCmpKind kind)
 {
 	Page		page;
 	BTPageOpaque opaque;
@@ -389,7 +447,7 @@ _bt_binsrch(Relation rel,
 
 		/* We have low <= mid < high, so mid points at a real slot */
 
-		result = _bt_compare(rel, key, page, mid);
+		result = _bt_compare_fast(rel, key, page, mid, kind);
 
 		if (result >= cmpval)
 			low = mid + 1;
@@ -440,6 +498,30 @@ _bt_binsrch(Relation rel,
  */
 OffsetNumber
 _bt_binsrch_insert(Relation rel, BTInsertState insertstate)
+{
+	/* See _bt_binsrch() */
+	switch (_bt_fastcmp_kind(rel, insertstate->itup_key))
+	{
+		case BTFASTCMP_INT16:
+			return _bt_binsrch_insert_impl(rel, insertstate, BTFASTCMP_INT16);
+		case BTFASTCMP_INT32:
+			return _bt_binsrch_insert_impl(rel, insertstate, BTFASTCMP_INT32);
+		case BTFASTCMP_UINT32:
+			return _bt_binsrch_insert_impl(rel, insertstate, BTFASTCMP_UINT32);
+		case BTFASTCMP_INT64:
+			return _bt_binsrch_insert_impl(rel, insertstate, BTFASTCMP_INT64);
+		default:
+			return _bt_binsrch_insert_impl(rel, insertstate, BTFASTCMP_NONE);
+	}
+}
+
+/*
+ * Workhorse for _bt_binsrch_insert().  'kind' is always a compile-time
+ * constant.
+ */
+static pg_attribute_always_inline OffsetNumber
+_bt_binsrch_insert_impl(Relation rel, BTInsertState insertstate,
+						BTFastCmpKind kind)
 {
 	BTScanInsert key = insertstate->itup_key;
 	Page		page;
@@ -502,7 +584,7 @@ _bt_binsrch_insert(Relation rel, BTInsertState insertstate)
 
 		/* We have low <= mid < high, so mid points at a real slot */
 
-		result = _bt_compare(rel, key, page, mid);
+		result = _bt_compare_fast(rel, key, page, mid, kind);
 
 		if (result >= cmpval)
 			low = mid + 1;
@@ -625,6 +707,146 @@ _bt_binsrch_posting(BTScanInsert key, Page page, OffsetNumber offnum)
 	return low;
 }
 
+/*
+ *	_bt_fastcmp_kind() -- Can the binary search compare keys inline?
+ *
+ * Most btree indexes lead with an integer-like column: int2, int4, int8,
+ * oid, date, timestamp or timestamptz.  When the search key's first
+ * attribute uses the default same-type comparison function of one of
+ * those, comparing it against an index tuple is just an integer comparison,
+ * and the binary search loops can do that inline instead of going through
+ * the fmgr call in _bt_compare().  We also insist that the index attribute
+ * has the matching by-value representation, so that we know how to fetch
+ * it from the tuple.
+ */
+static BTFastCmpKind
+_bt_fastcmp_kind(Relation rel, BTScanInsert key)
+{
+	ScanKey		scankey = key->scankeys;
+	Form_pg_attribute att = TupleDescAttr(RelationGetDescr(rel), 0);
+	BTFastCmpKind kind;
+	int			attlen;
+
+	if (key->keysz < 1 || (scankey->sk_flags & SK_ISNULL))
+		return BTFASTCMP_NONE;
+	Assert(scankey->sk_attno == 1);
+
+	switch (scankey->sk_func.fn_oid)
+	{
+		case F_BTINT2CMP:
+			kind = BTFASTCMP_INT16;
+			attlen = sizeof(int16);
+			break;
+		case F_BTINT4CMP:
+		case F_DATE_CMP:
+			kind = BTFASTCMP_INT32;
+			attlen = sizeof(int32);
+			break;
+		case F_BTOIDCMP:
+			kind = BTFASTCMP_UINT32;
+			attlen = sizeof(Oid);
+			break;
+		case F_BTINT8CMP:
+		case F_TIMESTAMP_CMP:
+		case F_TIMESTAMPTZ_CMP:
+			kind = BTFASTCMP_INT64;
+			attlen = sizeof(int64);
+			break;
+		default:
+			return BTFASTCMP_NONE;
+	}
+
+	if (!att->attbyval || att->attlen != attlen)
+		return BTFASTCMP_NONE;
+
+	return kind;
+}
+
+/*
+ *	_bt_compare_fast() -- _bt_compare(), with the leading attribute compared
+ *		inline when 'kind' allows it.
+ *
+ * The first key attribute of a tuple without NULLs is always at the start
+ * of its data area, so we can fetch it directly.  Only when it is equal to
+ * the scankey's do the remaining attributes, the heap TID and everything
+ * else _bt_compare() knows about come into play, so in that case, and for
+ * tuples we can't handle here, we just defer to _bt_compare().
+ */
+static pg_attribute_always_inline int32
+_bt_compare_fast(Relation rel,
+				 BTScanInsert key,
+				 Page page,
+				 OffsetNumber offnum,
+				 BTFastCmpKind kind)
+{
+	BTPageOpaque opaque;
+	IndexTuple	itup;
+	ScanKey		scankey = key->scankeys;
+	char	   *tp;
+	int32		result;
+
+	if (kind == BTFASTCMP_NONE)
+		return _bt_compare(rel, key, page, offnum);
+
+	/* Force result ">" for the "minus infinity" item, as _bt_compare does */
+	opaque = BTPageGetOpaque(page);
+	if (!P_ISLEAF(opaque) && offnum == P_FIRSTDATAKEY(opaque))
+		return 1;
+
+	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+	if (IndexTupleHasNulls(itup) ||
+		(!P_ISLEAF(opaque) && BTreeTupleGetNAtts(itup, rel) < 1))
+		return _bt_compare(rel, key, page, offnum);
+
+	tp = (char *) itup + IndexInfoFindDataOffset(itup->t_info);
+	switch (kind)
+	{
+		case BTFASTCMP_INT16:
+			{
+				int16		arg = DatumGetInt16(scankey->sk_argument);
+				int16		val = *(int16 *) tp;
+
+				result = (arg > val) - (arg < val);
+				break;
+			}
+		case BTFASTCMP_INT32:
+			{
+				int32		arg = DatumGetInt32(scankey->sk_argument);
+				int32		val = *(int32 *) tp;
+
+				result = (arg > val) - (arg < val);
+				break;
+			}
+		case BTFASTCMP_UINT32:
+			{
+				uint32		arg = DatumGetObjectId(scankey->sk_argument);
+				uint32		val = *(uint32 *) tp;
+
+				result = (arg > val) - (arg < val);
+				break;
+			}
+		case BTFASTCMP_INT64:
+			{
+				int64		arg = DatumGetInt64(scankey->sk_argument);
+				int64		val = *(int64 *) tp;
+
+				result = (arg > val) - (arg < val);
+				break;
+			}
+		default:
+			pg_unreachable();
+	}
+
+	/* see _bt_compare about the sign of the result for DESC columns */
+	if (scankey->sk_flags & SK_BT_DESC)
+		INVERT_COMPARE_RESULT(result);
+
+	if (result != 0)
+		return result;
+
+	return _bt_compare(rel, key, page, offnum);
+}
+
 /*----------
  *	_bt_compare() -- Compare insertion-type scankey to tuple on a page.
  *
@@ -898,6 +1120,13 @@ _bt_first(IndexScanDesc scan, ScanDirection dir)
 		return false;
 	}
 
+	/*
+	 * A skip scan that has given up on skipping carries on from the last
+	 * leading value it visited, rather than positioning using the keys.
+	 */
+	if (so->skipScan && so->skipFallback)
+		return _bt_skip_resume(scan, dir);
+
 	/*
 	 * For parallel scans, get the starting page from shared state. If the
 	 * scan has not started, proceed to find out first leaf page in the usual
@@ -1558,6 +1787,9 @@ _bt_readpage(IndexScanDesc scan, ScanDirection dir, OffsetNumber offnum)
 	 */
 	so->currPos.currPage = BufferGetBlockNumber(so->currPos.buf);
 
+	/* Skip scans want to know where each primitive scan ended */
+	so->skipLastPage = so->currPos.currPage;
+
 	/*
 	 * We save the LSN of the page as we read it, so that we know whether it
 	 * safe to apply LP_DEAD hints to the page later.  This allows us to drop
@@ -2378,6 +2610,245 @@ _bt_get_endpoint(Relation rel, uint32 level, bool rightmost,
 	return buf;
 }
 
+/*
+ *	_bt_skip_locate() -- Find the leaf item holding the next leading value
+ *
+ * Workhorse for _bt_skip_search() and _bt_skip_resume().  If first is true,
+ * we find the first item of the index in the given scan direction.
+ * Otherwise we find the nearest item whose first column sorts after value
+ * and isnull in the scan direction, using a fresh descent of the tree that
+ * only looks at the first column.  Returns the leaf page's buffer, pinned
+ * and read-locked, and sets *offnum to the item; or returns InvalidBuffer if
+ * there is no such item.
+ *
+ * We don't care whether the tuple we find is dead; at worst the primitive
+ * index scan for its value won't return anything.
+ */
+static Buffer
+_bt_skip_locate(IndexScanDesc scan, ScanDirection dir, bool first,
+				Datum value, bool isnull, OffsetNumber *offnum)
+{
+	Relation	rel = scan->indexRelation;
+	Buffer		buf;
+	Page		page;
+	BTPageOpaque opaque;
+	bool		atedge;
+
+	*offnum = InvalidOffsetNumber;
+
+	if (first)
+	{
+		buf = _bt_get_endpoint(rel, 0, ScanDirectionIsBackward(dir),
+							   scan->xs_snapshot);
+		atedge = true;
+	}
+	else
+	{
+		BTScanInsert key;
+		BTStack		stack;
+		int			flags;
+
+		/*
+		 * Build an insertion scankey on just the first column, the same way
+		 * _bt_mkscankey would.  A forward scan wants the first item > value.
+		 * A backward scan wants the last item < value, which is the one
+		 * just before the first item >= value.
+		 */
+		key = palloc(offsetof(BTScanInsertData, scankeys) +
+					 sizeof(ScanKeyData));
+		_bt_metaversion(rel, &key->heapkeyspace, &key->allequalimage);
+		key->anynullkeys = isnull;
+		key->nextkey = ScanDirectionIsForward(dir);
+		key->pivotsearch = false;
+		key->scantid = NULL;
+		key->keysz = 1;
+		flags = (isnull ? SK_ISNULL : 0) |
+			(rel->rd_indoption[0] << SK_BT_INDOPTION_SHIFT);
+		ScanKeyEntryInitializeWithInfo(&key->scankeys[0],
+									   flags,
+									   1,
+									   InvalidStrategy,
+									   InvalidOid,
+									   rel->rd_indcollation[0],
+									   index_getprocinfo(rel, 1, BTORDER_PROC),
+									   isnull ? (Datum) 0 : value);
+
+		stack = _bt_search(rel, key, &buf, BT_READ, scan->xs_snapshot);
+		_bt_freestack(stack);
+		if (BufferIsValid(buf))
+		{
+			*offnum = _bt_binsrch(rel, key, buf);
+			if (ScanDirectionIsBackward(dir))
+				*offnum = OffsetNumberPrev(*offnum);
+		}
+		atedge = false;
+		pfree(key);
+	}
+
+	if (!BufferIsValid(buf))
+	{
+		/* Empty index; lock the whole relation, as _bt_endpoint does */
+		PredicateLockRelation(rel, scan->xs_snapshot);
+		return InvalidBuffer;
+	}
+
+	/*
+	 * Step to the neighboring page until we're on an item.  The pages we look
+	 * at cover the gap between the last value and the new one, so they get
+	 * predicate locked just like the pages a scan reads.
+	 */
+	for (;;)
+	{
+		page = BufferGetPage(buf);
+		opaque = BTPageGetOpaque(page);
+		Assert(P_ISLEAF(opaque));
+
+		if (!P_IGNORE(opaque))
+		{
+			OffsetNumber minoff = P_FIRSTDATAKEY(opaque);
+			OffsetNumber maxoff = PageGetMaxOffsetNumber(page);
+
+			PredicateLockPage(rel, BufferGetBlockNumber(buf),
+							  scan->xs_snapshot);
+			if (atedge)
+				*offnum = ScanDirectionIsForward(dir) ? minoff : maxoff;
+			if (*offnum >= minoff && *offnum <= maxoff)
+				return buf;
+		}
+
+		if (ScanDirectionIsForward(dir))
+		{
+			if (P_RIGHTMOST(opaque))
+			{
+				_bt_relbuf(rel, buf);
+				return InvalidBuffer;
+			}
+			buf = _bt_relandgetbuf(rel, buf, opaque->btpo_next, BT_READ);
+		}
+		else
+		{
+			buf = _bt_walk_left(rel, buf, scan->xs_snapshot);
+			if (!BufferIsValid(buf))
+				return InvalidBuffer;
+		}
+		TestForOldSnapshot(scan->xs_snapshot, rel, BufferGetPage(buf));
+		atedge = true;
+	}
+}
+
+/*
+ *	_bt_skip_search() -- Find the next value of the leading column
+ *
+ * This is how a skip scan advances its skip array (see
+ * _bt_preprocess_skip_key).  If first is true, we find the first value of
+ * the index's first column in the given scan direction.  Otherwise *value
+ * and *isnull hold the current value on entry, and we find the nearest
+ * value after it in the scan direction.  On success, the value found is
+ * copied into the caller's memory context and returned in *value and
+ * *isnull.  Returns false if there are no more values.
+ *
+ * *nearby is set to true if the value is on the leaf page that the last
+ * primitive index scan ended on, or on the page right after it: in that
+ * case skipping to the value saved no leaf page reads compared to just
+ * carrying on with the scan.
+ */
+bool
+_bt_skip_search(IndexScanDesc scan, ScanDirection dir, bool first,
+				Datum *value, bool *isnull, bool *nearby)
+{
+	Relation	rel = scan->indexRelation;
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	TupleDesc	itupdesc = RelationGetDescr(rel);
+	Form_pg_attribute att = TupleDescAttr(itupdesc, 0);
+	Buffer		buf;
+	Page		page;
+	BTPageOpaque opaque;
+	OffsetNumber offnum;
+	BlockNumber blkno;
+	IndexTuple	itup;
+	Datum		datum;
+
+	buf = _bt_skip_locate(scan, dir, first, *value, *isnull, &offnum);
+	if (!BufferIsValid(buf))
+		return false;
+
+	page = BufferGetPage(buf);
+	opaque = BTPageGetOpaque(page);
+	blkno = BufferGetBlockNumber(buf);
+
+	if (first)
+		*nearby = false;
+	else if (ScanDirectionIsForward(dir))
+		*nearby = (blkno == so->skipLastPage ||
+				   opaque->btpo_prev == so->skipLastPage);
+	else
+		*nearby = (blkno == so->skipLastPage ||
+				   opaque->btpo_next == so->skipLastPage);
+
+	itup = (IndexTuple) PageGetItem(page, PageGetItemId(page, offnum));
+	datum = index_getattr(itup, 1, itupdesc, isnull);
+	*value = *isnull ? (Datum) 0 : datumCopy(datum, att->attbyval, att->attlen);
+
+	_bt_relbuf(rel, buf);
+
+	return true;
+}
+
+/*
+ *	_bt_skip_resume() -- Start the final primitive scan of a skip scan that
+ *		has stopped skipping
+ *
+ * Once skipping to each leading value stops paying off, _bt_skip_advance
+ * drops the skip array's key, and we get here from _bt_first instead of
+ * positioning the scan using the keys.  The scan resumes just past the last
+ * leading value that was visited and reads the rest of the index in the
+ * scan direction.  Exit conditions are the same as for _bt_first().
+ */
+static bool
+_bt_skip_resume(IndexScanDesc scan, ScanDirection dir)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Buffer		buf;
+	OffsetNumber offnum;
+	BTScanPosItem *currItem;
+
+	buf = _bt_skip_locate(scan, dir, false, so->skipValue, so->skipIsNull,
+						  &offnum);
+	if (!BufferIsValid(buf))
+	{
+		BTScanPosInvalidate(so->currPos);
+		return false;
+	}
+
+	/* remember which buffer we have pinned */
+	so->currPos.buf = buf;
+
+	_bt_initialize_more_data(so, dir);
+
+	/*
+	 * Now load data from the first page of the scan, as _bt_endpoint does.
+	 */
+	if (!_bt_readpage(scan, dir, offnum))
+	{
+		_bt_unlockbuf(scan->indexRelation, so->currPos.buf);
+		if (!_bt_steppage(scan, dir))
+			return false;
+	}
+	else
+	{
+		/* Drop the lock, and maybe the pin, on the current page */
+		_bt_drop_lock_and_maybe_pin(scan, &so->currPos);
+	}
+
+	/* OK, itemIndex says what to return */
+	currItem = &so->currPos.items[so->currPos.itemIndex];
+	scan->xs_heaptid = currItem->heapTid;
+	if (scan->xs_want_itup)
+		scan->xs_itup = (IndexTuple) (so->currTuples + currItem->tupleOffset);
+
+	return true;
+}
+
 /*
  *	_bt_endpoint() -- Find the first or last page in the index, and scan
  * from there to the first key satisfying all the quals.
@@ -255,7 +255,6 @@ typedef struct BTWriteState
 	bool		btws_use_wal;	/* dump pages to WAL? */
 	BlockNumber btws_pages_alloced; /* # pages allocated */
 	BlockNumber btws_pages_written; /* # pages written out */
-	Page		btws_zeropage;	/* workspace for filling zeroes */
 } BTWriteState;
 
 
@@ -574,7 +573,6 @@ _bt_leafbuild(BTSpool *btspool, BTSpool *btspool2)
 	/* reserve the metapage */
 	wstate.btws_pages_alloced = BTREE_METAPAGE + 1;
 	wstate.btws_pages_written = 0;
-	wstate.btws_zeropage = NULL;	/* until needed */
 
 	pgstat_progress_update_param(PROGRESS_CREATEIDX_SUBPHASE,
 								 PROGRESS_BTREE_PHASE_LEAF_LOAD);
@@ -657,15 +655,13 @@ _bt_blwritepage(BTWriteState *wstate, Page page, BlockNumber blkno)
 	 * zeroes anyway), but it should help to avoid fragmentation. The dummy
 	 * pages aren't WAL-logged though.
 	 */
-	while (blkno > wstate->btws_pages_written)
+	if (blkno > wstate->btws_pages_written)
 	{
-		if (!wstate->btws_zeropage)
-			wstate->btws_zeropage = (Page) palloc0(BLCKSZ);
-		/* don't set checksum for all-zero page */
-		smgrextend(RelationGetSmgr(wstate->index), MAIN_FORKNUM,
-				   wstate->btws_pages_written++,
-				   (char *) wstate->btws_zeropage,
-				   true);
+		smgrzeroextend(RelationGetSmgr(wstate->index), MAIN_FORKNUM,
+					   wstate->btws_pages_written,
+					   blkno - wstate->btws_pages_written,
+					   true);
+		wstate->btws_pages_written = blkno;
 	}
 
 	PageSetChecksumInplace(page, blkno);
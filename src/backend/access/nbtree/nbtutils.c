@@ -21,6 +21,7 @@
 #include "access/reloptions.h"
 #include "access/relscan.h"
 #include "catalog/catalog.h"
+#include "catalog/pg_opfamily.h"
 #include "commands/progress.h"
 #include "lib/qunique.h"
 #include "miscadmin.h"
@@ -28,9 +29,16 @@
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/pg_locale.h"
 #include "utils/rel.h"
 
 
+/*
+ * Number of consecutive skips that save no leaf page reads after which a
+ * skip scan stops skipping; see _bt_skip_advance()
+ */
+#define BT_SKIP_MAX_WASTED	8
+
 typedef struct BTSortArrayContext
 {
 	FmgrInfo	flinfo;
@@ -45,6 +53,11 @@ static int	_bt_sort_array_elements(IndexScanDesc scan, ScanKey skey,
 									bool reverse,
 									Datum *elems, int nelems);
 static int	_bt_compare_array_elements(const void *a, const void *b, void *arg);
+static bool _bt_skip_advance(IndexScanDesc scan, ScanDirection dir,
+							 bool first);
+static void _bt_skip_set_key(BTScanOpaque so);
+static Datum _bt_skip_copy_value(IndexScanDesc scan, Datum value, bool isnull);
+static void _bt_skip_free_value(IndexScanDesc scan, Datum value, bool isnull);
 static bool _bt_compare_scankey_args(IndexScanDesc scan, ScanKey op,
 									 ScanKey leftarg, ScanKey rightarg,
 									 bool *result);
@@ -55,6 +68,9 @@ static bool _bt_check_rowcompare(ScanKey skey,
 								 ScanDirection dir, bool *continuescan);
 static int	_bt_keep_natts(Relation rel, IndexTuple lastleft,
 						   IndexTuple firstright, BTScanInsert itup_key);
+static IndexTuple _bt_truncate_datum(Relation rel, IndexTuple pivot,
+									 IndexTuple lastleft, IndexTuple firstright,
+									 int attnum);
 
 
 /*
@@ -371,6 +387,110 @@ _bt_preprocess_array_keys(IndexScanDesc scan)
 	MemoryContextSwitchTo(oldContext);
 }
 
+/*
+ *	_bt_preprocess_skip_key() -- Set up a skip array for the leading column
+ *
+ * A scan with keys on the second index column but none on the first can't
+ * use them to position itself or to end early, so it would have to read the
+ * entire index.  Instead we pretend there's an equality array key on the
+ * first column holding each of its distinct values, which turns the scan
+ * into a series of primitive index scans, one per leading value, that can
+ * each use the second column's keys as though the query had constrained
+ * the first column.  The "array" is never materialized: _bt_skip_search()
+ * looks up the next distinct value in the index each time we advance it.
+ * That's a win when the leading column has few distinct values, which is
+ * what the planner checks for before choosing such a scan.  In case its
+ * estimate is off, _bt_skip_advance() stops skipping once it sees that
+ * the descents aren't saving any leaf page reads.
+ *
+ * The skip array becomes arrayKeys[0], and its scan key is placed ahead of
+ * the caller's keys in so->arrayKeyData, so it's always the most significant
+ * array and primitive scans still return tuples in index order.
+ *
+ * Must be called just after _bt_preprocess_array_keys().
+ */
+void
+_bt_preprocess_skip_key(IndexScanDesc scan)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Relation	rel = scan->indexRelation;
+	int			numberOfKeys = scan->numberOfKeys;
+	Oid			opcintype = rel->rd_opcintype[0];
+	Oid			eq_op;
+	RegProcedure eq_proc;
+	ScanKey		keys;
+	BTArrayKeyInfo *arrayKeys;
+	MemoryContext oldContext;
+	int			i;
+
+	so->skipScan = false;
+	so->skipValue = so->skipMarkValue = (Datum) 0;
+	so->skipIsNull = so->skipMarkIsNull = false;
+	so->skipFallback = so->skipMarkFallback = false;
+	so->skipWasted = 0;
+	so->skipLastPage = InvalidBlockNumber;
+
+	/*
+	 * Input keys are ordered by attribute, so the first one tells us if the
+	 * first column is unconstrained while the second one isn't.  Parallel
+	 * scans coordinate through the array keys in shared memory, which can't
+	 * describe a skip array, so they'll just have to scan the whole index.
+	 */
+	if (numberOfKeys < 1 || so->numArrayKeys < 0 ||
+		scan->keyData[0].sk_attno != 2 ||
+		scan->parallel_scan != NULL)
+		return;
+
+	eq_op = get_opfamily_member(rel->rd_opfamily[0], opcintype, opcintype,
+								BTEqualStrategyNumber);
+	if (!OidIsValid(eq_op))
+		return;
+	eq_proc = get_opcode(eq_op);
+	if (!RegProcedureIsValid(eq_proc))
+		elog(ERROR, "missing oprcode for operator %u", eq_op);
+
+	/* _bt_preprocess_array_keys only resets the context if it had arrays */
+	if (so->arrayContext == NULL)
+		so->arrayContext = AllocSetContextCreate(CurrentMemoryContext,
+												 "BTree array context",
+												 ALLOCSET_SMALL_SIZES);
+	else if (so->numArrayKeys == 0)
+		MemoryContextReset(so->arrayContext);
+
+	oldContext = MemoryContextSwitchTo(so->arrayContext);
+
+	ScanKeyEntryInitialize(&so->skipKey,
+						   0,
+						   1,
+						   BTEqualStrategyNumber,
+						   InvalidOid,
+						   rel->rd_indcollation[0],
+						   eq_proc,
+						   (Datum) 0);
+
+	/* Prepend the skip array's key to the (possibly modified) input keys */
+	keys = (ScanKey) palloc((numberOfKeys + 1) * sizeof(ScanKeyData));
+	memcpy(&keys[0], &so->skipKey, sizeof(ScanKeyData));
+	memcpy(&keys[1],
+		   so->arrayKeyData ? so->arrayKeyData : scan->keyData,
+		   numberOfKeys * sizeof(ScanKeyData));
+
+	arrayKeys = (BTArrayKeyInfo *)
+		palloc0((so->numArrayKeys + 1) * sizeof(BTArrayKeyInfo));
+	for (i = 0; i < so->numArrayKeys; i++)
+	{
+		arrayKeys[i + 1] = so->arrayKeys[i];
+		arrayKeys[i + 1].scan_key++;
+	}
+
+	so->arrayKeyData = keys;
+	so->arrayKeys = arrayKeys;
+	so->numArrayKeys++;
+	so->skipScan = true;
+
+	MemoryContextSwitchTo(oldContext);
+}
+
 /*
  * _bt_find_extreme_element() -- get least or greatest array element
  *
@@ -520,8 +640,11 @@ _bt_compare_array_elements(const void *a, const void *b, void *arg)
  *
  * Set up the cur_elem counters and fill in the first sk_argument value for
  * each array scankey.  We can't do this until we know the scan direction.
+ *
+ * Returns false if there's a skip array and the index turns out to be
+ * empty, in which case the scan needn't be run at all.
  */
-void
+bool
 _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir)
 {
 	BTScanOpaque so = (BTScanOpaque) scan->opaque;
@@ -532,6 +655,13 @@ _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir)
 		BTArrayKeyInfo *curArrayKey = &so->arrayKeys[i];
 		ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
 
+		if (so->skipScan && i == 0)
+		{
+			if (!_bt_skip_advance(scan, dir, true))
+				return false;
+			continue;
+		}
+
 		Assert(curArrayKey->num_elems > 0);
 		if (ScanDirectionIsBackward(dir))
 			curArrayKey->cur_elem = curArrayKey->num_elems - 1;
@@ -539,6 +669,8 @@ _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir)
 			curArrayKey->cur_elem = 0;
 		skey->sk_argument = curArrayKey->elem_values[curArrayKey->cur_elem];
 	}
+
+	return true;
 }
 
 /*
@@ -567,6 +699,16 @@ _bt_advance_array_keys(IndexScanDesc scan, ScanDirection dir)
 		int			cur_elem = curArrayKey->cur_elem;
 		int			num_elems = curArrayKey->num_elems;
 
+		/*
+		 * The skip array is always the first, so there's nothing to wrap
+		 * around into once it runs out of values.
+		 */
+		if (so->skipScan && i == 0)
+		{
+			found = _bt_skip_advance(scan, dir, false);
+			break;
+		}
+
 		if (ScanDirectionIsBackward(dir))
 		{
 			if (--cur_elem < 0)
@@ -616,6 +758,19 @@ _bt_mark_array_keys(IndexScanDesc scan)
 	{
 		BTArrayKeyInfo *curArrayKey = &so->arrayKeys[i];
 
+		/* Copy the skip array's value, unless the mark already has it */
+		if (so->skipScan && i == 0 &&
+			curArrayKey->mark_elem != curArrayKey->cur_elem)
+		{
+			if (curArrayKey->mark_elem > 0)
+				_bt_skip_free_value(scan, so->skipMarkValue,
+									so->skipMarkIsNull);
+			so->skipMarkValue = _bt_skip_copy_value(scan, so->skipValue,
+													so->skipIsNull);
+			so->skipMarkIsNull = so->skipIsNull;
+			so->skipMarkFallback = so->skipFallback;
+		}
+
 		curArrayKey->mark_elem = curArrayKey->cur_elem;
 	}
 }
@@ -639,6 +794,24 @@ _bt_restore_array_keys(IndexScanDesc scan)
 		ScanKey		skey = &so->arrayKeyData[curArrayKey->scan_key];
 		int			mark_elem = curArrayKey->mark_elem;
 
+		if (so->skipScan && i == 0)
+		{
+			/* Nothing to restore if the mark was set before the first value */
+			if (curArrayKey->cur_elem != mark_elem && mark_elem > 0)
+			{
+				if (curArrayKey->cur_elem > 0)
+					_bt_skip_free_value(scan, so->skipValue, so->skipIsNull);
+				so->skipValue = _bt_skip_copy_value(scan, so->skipMarkValue,
+													so->skipMarkIsNull);
+				so->skipIsNull = so->skipMarkIsNull;
+				so->skipFallback = so->skipMarkFallback;
+				curArrayKey->cur_elem = mark_elem;
+				_bt_skip_set_key(so);
+				changed = true;
+			}
+			continue;
+		}
+
 		if (curArrayKey->cur_elem != mark_elem)
 		{
 			curArrayKey->cur_elem = mark_elem;
@@ -660,14 +833,138 @@ _bt_restore_array_keys(IndexScanDesc scan)
 	}
 }
 
+/*
+ * _bt_skip_advance() -- Move the skip array to the next leading value
+ *
+ * If first is true, we move to the first value in the scan direction
+ * instead.  Returns false if there are no more values.
+ *
+ * When the leading column turns out to have many more distinct values than
+ * the planner thought, most skips land on the leaf page the last primitive
+ * scan ended on, or the one after it, and each descent is pure overhead.
+ * After BT_SKIP_MAX_WASTED such skips in a row we give up skipping: the
+ * skip array's key is dropped, and the next primitive scan reads the rest
+ * of the index from just past the current value (see _bt_skip_resume).
+ * That's only possible when there are no other arrays to cycle through.
+ */
+static bool
+_bt_skip_advance(IndexScanDesc scan, ScanDirection dir, bool first)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	BTArrayKeyInfo *skipArrayKey = &so->arrayKeys[0];
+	Datum		value = so->skipValue;
+	bool		isnull = so->skipIsNull;
+	MemoryContext oldContext;
+	bool		found;
+	bool		nearby;
+
+	Assert(so->skipScan);
+
+	if (first)
+	{
+		so->skipFallback = false;
+		so->skipWasted = 0;
+	}
+	else if (so->skipFallback)
+	{
+		/* The last primitive scan read everything that was left */
+		return false;
+	}
+	else if (so->skipWasted >= BT_SKIP_MAX_WASTED && so->numArrayKeys == 1)
+	{
+		so->skipFallback = true;
+		/* the mark must notice this, as though the value had changed */
+		skipArrayKey->cur_elem++;
+		return true;
+	}
+
+	/* _bt_skip_search copies the value it finds into the array context */
+	oldContext = MemoryContextSwitchTo(so->arrayContext);
+	found = _bt_skip_search(scan, dir, first, &value, &isnull, &nearby);
+	MemoryContextSwitchTo(oldContext);
+
+	if (!found)
+		return false;
+
+	if (nearby)
+		so->skipWasted++;
+	else
+		so->skipWasted = 0;
+
+	if (skipArrayKey->cur_elem > 0)
+		_bt_skip_free_value(scan, so->skipValue, so->skipIsNull);
+	so->skipValue = value;
+	so->skipIsNull = isnull;
+
+	/*
+	 * cur_elem just counts the values we've moved to, so that marking and
+	 * restoring can tell cheaply whether the value has changed since the
+	 * mark was set.
+	 */
+	skipArrayKey->cur_elem++;
+	_bt_skip_set_key(so);
+
+	return true;
+}
+
+/*
+ * _bt_skip_set_key() -- Set the skip array's scan key to its current value
+ */
+static void
+_bt_skip_set_key(BTScanOpaque so)
+{
+	ScanKey		skey = &so->arrayKeyData[so->arrayKeys[0].scan_key];
+
+	memcpy(skey, &so->skipKey, sizeof(ScanKeyData));
+	if (so->skipIsNull)
+	{
+		/* Search for NULLs, just like "col IS NULL" would */
+		skey->sk_flags |= (SK_ISNULL | SK_SEARCHNULL);
+		skey->sk_strategy = InvalidStrategy;
+	}
+	else
+		skey->sk_argument = so->skipValue;
+}
+
+/*
+ * Copy a leading column value into the array context, or free such a copy.
+ */
+static Datum
+_bt_skip_copy_value(IndexScanDesc scan, Datum value, bool isnull)
+{
+	BTScanOpaque so = (BTScanOpaque) scan->opaque;
+	Form_pg_attribute att = TupleDescAttr(RelationGetDescr(scan->indexRelation), 0);
+	MemoryContext oldContext;
+	Datum		result;
+
+	if (isnull || att->attbyval)
+		return value;
+
+	oldContext = MemoryContextSwitchTo(so->arrayContext);
+	result = datumCopy(value, att->attbyval, att->attlen);
+	MemoryContextSwitchTo(oldContext);
+
+	return result;
+}
+
+static void
+_bt_skip_free_value(IndexScanDesc scan, Datum value, bool isnull)
+{
+	Form_pg_attribute att = TupleDescAttr(RelationGetDescr(scan->indexRelation), 0);
+
+	if (!isnull && !att->attbyval)
+		pfree(DatumGetPointer(value));
+}
+
 
 /*
  *	_bt_preprocess_keys() -- Preprocess scan keys
  *
  * The given search-type keys (in scan->keyData[] or so->arrayKeyData[])
  * are copied to so->keyData[] with possible transformation.
- * scan->numberOfKeys is the number of input keys, so->numberOfKeys gets
- * the number of output keys (possibly less, never greater).
+ * scan->numberOfKeys is the number of input keys (plus one for the key of
+ * a skip array, if any), so->numberOfKeys gets the number of output keys
+ * (possibly less, never greater).
  *
  * The output keys are marked with additional sk_flags bits beyond the
  * system-standard bits supplied by the caller.  The DESC and NULLS_FIRST
@@ -770,12 +1067,18 @@ _bt_preprocess_keys(IndexScanDesc scan)
 		return;					/* done if qual-less scan */
 
 	/*
-	 * Read so->arrayKeyData if array keys are present, else scan->keyData
+	 * Read so->arrayKeyData if array keys are present, else scan->keyData.
+	 * A skip array adds a key of its own ahead of the caller's keys, unless
+	 * the scan has stopped skipping.
 	 */
 	if (so->arrayKeyData != NULL)
 		inkeys = so->arrayKeyData;
 	else
 		inkeys = scan->keyData;
+	if (so->skipScan && !so->skipFallback)
+		numberOfKeys++;
+	else if (so->skipScan)
+		inkeys++;
 
 	outkeys = so->keyData;
 	cur = &inkeys[0];
@@ -2192,14 +2495,15 @@ btbuildphasename(int64 phasenum)
  * key attributes are treated as containing "minus infinity" values by
  * _bt_compare().
  *
+ * The distinguishing attribute's value itself may also be shortened, for
+ * the byte-ordered types handled by _bt_truncate_datum().
+ *
  * In the worst case (when a heap TID must be appended to distinguish lastleft
  * from firstright), the size of the returned tuple is the size of firstright
  * plus the size of an additional MAXALIGN()'d item pointer.  This guarantee
  * is important, since callers need to stay under the 1/3 of a page
- * restriction on tuple size.  If this routine is ever taught to truncate
- * within an attribute/datum, it will need to avoid returning an enlarged
- * tuple to caller when truncation + TOAST compression ends up enlarging the
- * final datum.
+ * restriction on tuple size.  Truncation within an attribute/datum never
+ * returns a tuple larger than whole-attribute truncation would have.
  */
 IndexTuple
 _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
@@ -2245,10 +2549,15 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 
 	/*
 	 * If there is a distinguishing key attribute within pivot tuple, we're
-	 * done
+	 * done, though we may still be able to shorten that attribute's value
 	 */
 	if (keepnatts <= nkeyatts)
 	{
+#ifndef DEBUG_NO_TRUNCATE
+		if (itup_key->heapkeyspace)
+			pivot = _bt_truncate_datum(rel, pivot, lastleft, firstright,
+									   keepnatts);
+#endif
 		BTreeTupleSetNAtts(pivot, keepnatts, false);
 		return pivot;
 	}
@@ -2335,6 +2644,124 @@ _bt_truncate(Relation rel, IndexTuple lastleft, IndexTuple firstright,
 	return tidpivot;
 }
 
+/*
+ * _bt_truncate_datum - truncate within the distinguishing attribute.
+ *
+ * Caller's pivot has firstright's first attnum key attributes, the last of
+ * which is the first one whose lastleft and firstright values differ.  When
+ * that attribute sorts its values bytewise, with a shorter value sorting
+ * before any longer value it is a prefix of, the shortest prefix of
+ * firstright's value that is still greater than lastleft's value works just
+ * as well as the whole value: it is greater than everything on the left page
+ * and no greater than anything on the right page.  That prefix is one byte
+ * longer than the common prefix of the two values.  This is what the Prefix
+ * B-Trees paper calls a shortest separator.
+ *
+ * Types and opclasses that compare that way are bytea, text_pattern_ops, and
+ * text under the "C" collation.  A DESC column would need a separator built
+ * the other way around, which we don't bother with.
+ *
+ * Returns a new pivot, or caller's pivot when nothing can be saved.  Caller's
+ * pivot is freed in the former case.
+ */
+static IndexTuple
+_bt_truncate_datum(Relation rel, IndexTuple pivot, IndexTuple lastleft,
+				   IndexTuple firstright, int attnum)
+{
+	TupleDesc	itupdesc = RelationGetDescr(rel);
+	Form_pg_attribute att = TupleDescAttr(itupdesc, attnum - 1);
+	Datum		leftdatum,
+				rightdatum;
+	bool		leftnull,
+				rightnull;
+	struct varlena *left;
+	struct varlena *right;
+	int			leftlen,
+				rightlen,
+				prefixlen;
+	struct varlena *prefix;
+	TupleDesc	truncdesc;
+	Datum		values[INDEX_MAX_KEYS];
+	bool		isnull[INDEX_MAX_KEYS];
+	IndexTuple	newpivot;
+
+	if (att->attlen != -1 ||
+		(rel->rd_indoption[attnum - 1] & INDOPTION_DESC) != 0)
+		return pivot;
+
+	switch (rel->rd_opfamily[attnum - 1])
+	{
+		case TEXT_BTREE_FAM_OID:
+			if (!lc_collate_is_c(rel->rd_indcollation[attnum - 1]))
+				return pivot;
+			break;
+		case TEXT_PATTERN_BTREE_FAM_OID:
+		case BYTEA_BTREE_FAM_OID:
+			break;
+		default:
+			return pivot;
+	}
+
+	leftdatum = index_getattr(lastleft, attnum, itupdesc, &leftnull);
+	rightdatum = index_getattr(firstright, attnum, itupdesc, &rightnull);
+	if (leftnull || rightnull)
+		return pivot;
+
+	/* Index tuple values may be compressed, but they're never external */
+	left = PG_DETOAST_DATUM_PACKED(leftdatum);
+	right = PG_DETOAST_DATUM_PACKED(rightdatum);
+	leftlen = VARSIZE_ANY_EXHDR(left);
+	rightlen = VARSIZE_ANY_EXHDR(right);
+
+	prefixlen = 0;
+	while (prefixlen < leftlen && prefixlen < rightlen &&
+		   VARDATA_ANY(left)[prefixlen] == VARDATA_ANY(right)[prefixlen])
+		prefixlen++;
+
+	/*
+	 * The values differ, and lastleft's sorts first, so firstright's value
+	 * can't be a prefix of lastleft's.
+	 */
+	Assert(prefixlen < rightlen);
+	prefixlen++;
+	if (prefixlen >= rightlen)
+		return pivot;
+
+	prefix = (struct varlena *) palloc(VARHDRSZ + prefixlen);
+	SET_VARSIZE(prefix, VARHDRSZ + prefixlen);
+	memcpy(VARDATA(prefix), VARDATA_ANY(right), prefixlen);
+
+	/* Form the new pivot from the old one, with the value replaced */
+	truncdesc = palloc(TupleDescSize(itupdesc));
+	TupleDescCopy(truncdesc, itupdesc);
+	truncdesc->natts = attnum;
+	index_deform_tuple(pivot, truncdesc, values, isnull);
+	values[attnum - 1] = PointerGetDatum(prefix);
+	newpivot = index_form_tuple(truncdesc, values, isnull);
+	newpivot->t_tid = pivot->t_tid;
+
+	pfree(truncdesc);
+	pfree(prefix);
+	if ((Pointer) left != DatumGetPointer(leftdatum))
+		pfree(left);
+	if ((Pointer) right != DatumGetPointer(rightdatum))
+		pfree(right);
+
+	/*
+	 * The prefix can still end up larger than the original value if that was
+	 * compressed.  Don't make the pivot any bigger than whole-attribute
+	 * truncation would have.
+	 */
+	if (IndexTupleSize(newpivot) >= IndexTupleSize(pivot))
+	{
+		pfree(newpivot);
+		return pivot;
+	}
+
+	pfree(pivot);
+	return newpivot;
+}
+
 /*
  * _bt_keep_natts - how many key attributes to keep when truncating.
  *
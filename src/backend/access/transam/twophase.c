@@ -492,8 +492,12 @@ MarkAsPreparingGuts(GlobalTransaction gxact, TransactionId xid, const char *gid,
 	pg_atomic_init_u64(&proc->waitStart, 0);
 	for (i = 0; i < NUM_LOCK_PARTITIONS; i++)
 		SHMQueueInit(&(proc->myProcLocks[i]));
-	/* subxid data must be filled later by GXactLoadSubxactData */
+	/*
+	 * subxid data must be filled later by GXactLoadSubxactData.  The dummy
+	 * PGPROC never claims its subxids are in the SubXidMap.
+	 */
 	proc->subxidStatus.overflowed = false;
+	proc->subxidStatus.mapped = false;
 	proc->subxidStatus.count = 0;
 
 	gxact->prepared_at = prepared_at;
@@ -2625,3 +2629,32 @@ LookupGXact(const char *gid, XLogRecPtr prepare_end_lsn,
 	LWLockRelease(TwoPhaseStateLock);
 	return found;
 }
+
+/*
+ * GetPreparedTransactionGids
+ *		Return a list of the GIDs of all prepared transactions whose GID
+ *		starts with the given prefix.
+ *
+ * This is used by logical replication to find the prepared transactions left
+ * behind by the workers that copy parts of a table in parallel.
+ */
+List *
+GetPreparedTransactionGids(const char *prefix)
+{
+	List	   *result = NIL;
+	size_t		prefixlen = strlen(prefix);
+	int			i;
+
+	LWLockAcquire(TwoPhaseStateLock, LW_SHARED);
+	for (i = 0; i < TwoPhaseState->numPrepXacts; i++)
+	{
+		GlobalTransaction gxact = TwoPhaseState->prepXacts[i];
+
+		/* Ignore not-yet-valid GIDs. */
+		if (gxact->valid && strncmp(gxact->gid, prefix, prefixlen) == 0)
+			result = lappend(result, pstrdup(gxact->gid));
+	}
+	LWLockRelease(TwoPhaseStateLock);
+
+	return result;
+}
@@ -24,6 +24,7 @@
 #include "postmaster/autovacuum.h"
 #include "storage/pmsignal.h"
 #include "storage/proc.h"
+#include "storage/subxidmap.h"
 #include "utils/syscache.h"
 
 
@@ -75,6 +76,15 @@ GetNewTransactionId(bool isSubXact)
 	if (RecoveryInProgress())
 		elog(ERROR, "cannot assign TransactionIds during recovery");
 
+	/*
+	 * If this subxid won't fit in our PGPROC cache, it will go into the
+	 * SubXidMap.  Give that a chance to prune itself first; it can't do so
+	 * while we hold XidGenLock.
+	 */
+	if (isSubXact &&
+		MyProc->subxidStatus.count >= PGPROC_MAX_CACHED_SUBXIDS)
+		SubXidMapMaintain(GetTopFullTransactionIdIfAny());
+
 	LWLockAcquire(XidGenLock, LW_EXCLUSIVE);
 
 	full_xid = ShmemVariableCache->nextXid;
@@ -219,6 +229,14 @@ GetNewTransactionId(bool isSubXact)
 	 * the status of the XID, so it seems OK.  (Snapshots taken during this
 	 * window *will* include the parent XID, so they will deliver the correct
 	 * answer later on when someone does have a reason to inquire.)
+	 *
+	 * An overflowed subxid is also entered into the SubXidMap, and as long as
+	 * all of our overflowed subxids made it in, we advertise that with the
+	 * mapped flag; snapshots can then consult the map rather than
+	 * pg_subtrans.  The entry must be made before we release XidGenLock, so
+	 * that it's present before any snapshot could need it.  A stale mapped
+	 * flag seen by a concurrent snapshot is harmless, because it can only
+	 * concern this new XID, which will be >= that snapshot's xmax.
 	 */
 	if (!isSubXact)
 	{
@@ -238,6 +256,7 @@ GetNewTransactionId(bool isSubXact)
 
 		Assert(substat->count == MyProc->subxidStatus.count);
 		Assert(substat->overflowed == MyProc->subxidStatus.overflowed);
+		Assert(substat->mapped == MyProc->subxidStatus.mapped);
 
 		if (nxids < PGPROC_MAX_CACHED_SUBXIDS)
 		{
@@ -246,7 +265,15 @@ GetNewTransactionId(bool isSubXact)
 			MyProc->subxidStatus.count = substat->count = nxids + 1;
 		}
 		else
+		{
+			bool		mapped;
+
+			mapped = (!substat->overflowed || substat->mapped) &&
+				SubXidMapInsert(xid, GetTopFullTransactionIdIfAny());
+
+			MyProc->subxidStatus.mapped = substat->mapped = mapped;
 			MyProc->subxidStatus.overflowed = substat->overflowed = true;
+		}
 	}
 
 	LWLockRelease(XidGenLock);
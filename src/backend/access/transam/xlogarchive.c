@@ -514,7 +514,10 @@ XLogArchiveNotify(const char *xlog)
 
 	/* Notify archiver that it's got something to do */
 	if (IsUnderPostmaster)
+	{
+		PgArchNotifyReady(xlog);
 		PgArchWakeup();
+	}
 }
 
 /*
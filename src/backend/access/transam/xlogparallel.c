@@ -0,0 +1,1106 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.c
+ *		Parallel WAL redo.
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *		src/backend/access/transam/xlogparallel.c
+ *
+ * When recovery_parallel_workers is set, the startup process launches that
+ * many background workers when redo begins, and hands WAL records over to
+ * them instead of replaying them itself.  Each record goes to a worker chosen
+ * by hashing the relation it modifies, so all changes to a given relation
+ * (including its FSM and visibility map forks) are replayed by the same
+ * worker, in WAL order.  Since workers never touch the same relation, they
+ * don't need to coordinate with each other, and relation extension is safe.
+ *
+ * That's not good enough while hot standby is active, though: the record
+ * inserting an index entry must not be replayed before the heap record it
+ * points to, or an index scan could follow the entry to a tuple that isn't
+ * there yet, and an index-only scan could see the page still marked
+ * all-visible and return an uncommitted row.  So with hot standby, a record
+ * for anything but a heap is sent along with the number of records each
+ * other worker must have applied first, namely up to the last heap record
+ * dispatched to it, and the worker waits for them before applying it.  That
+ * keeps index records behind the heap records that precede them in WAL
+ * without holding up the startup process.
+ *
+ * The workers don't run with InHotStandby set, so records that must resolve
+ * recovery conflicts with queries have their conflicts resolved by the
+ * startup process before it dispatches them.  Records that need a cleanup
+ * lock are still replayed by the startup process with hot standby, since
+ * only it can resolve conflicts with queries holding buffer pins.
+ *
+ * Only record types whose redo routine looks at nothing but the blocks of a
+ * single relation are dispatched; see ParallelRedoChooseWorker().  Every
+ * other record (transaction status, DDL, checkpoints, records that need to
+ * resolve recovery conflicts, multi-relation records, ...) acts as a barrier:
+ * the startup process waits for the workers to apply everything dispatched
+ * so far, and then replays the record itself.  As a consequence, nothing
+ * becomes visible to hot standby queries out of order, and the replay
+ * position advertised to the rest of the system (lastReplayedEndRecPtr) only
+ * advances once the workers have caught up.
+ *
+ * Records are passed to the workers in their decoded form, through one
+ * shm_mq per worker in the main shared memory segment.  A worker that runs
+ * into a reference to a missing page passes it back to the startup process,
+ * which owns the invalid-page table.  After a barrier record that may have
+ * dropped or resized relations, the workers are told to close their files or
+ * forget their cached relation sizes before applying their next record;
+ * similarly, the startup process forgets its cached sizes after waiting for
+ * the workers.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/heapam_xlog.h"
+#include "access/nbtxlog.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
+#include "access/xlogrecovery.h"
+#include "access/xlogutils.h"
+#include "catalog/pg_control.h"
+#include "catalog/storage_xlog.h"
+#include "common/hashfn.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "port/atomics.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/startup.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shmem.h"
+#include "storage/smgr.h"
+#include "storage/spin.h"
+#include "storage/standby.h"
+#include "utils/memutils.h"
+
+/* Size of the queue used to pass records to each worker */
+#define PARALLEL_REDO_QUEUE_SIZE	(1024 * 1024)
+
+/* Number of invalid-page references a worker can queue up */
+#define PARALLEL_REDO_MAX_INVALID_PAGES	64
+
+/* Flags passed along with a record */
+#define PARALLEL_REDO_FORGET_NBLOCKS	0x01	/* forget cached sizes first */
+#define PARALLEL_REDO_CLOSE_FILES		0x02	/* close all files first */
+#define PARALLEL_REDO_CONSISTENT		0x04	/* reachedConsistency is set */
+
+/* GUCs */
+int			recovery_parallel_workers = 0;
+
+typedef struct ParallelRedoInvalidPage
+{
+	RelFileLocator locator;
+	ForkNumber	forkno;
+	BlockNumber blkno;
+	bool		present;
+} ParallelRedoInvalidPage;
+
+typedef struct ParallelRedoWorkerSlot
+{
+	/* Number of records applied by the worker; written only by the worker */
+	pg_atomic_uint64 nprocessed;
+
+	/* Fields below are protected by mutex */
+	slock_t		mutex;
+	Latch	   *latch;			/* worker's latch, once it has started */
+	bool		exited;			/* worker has exited */
+	int			ninvalid;		/* number of entries in invalid[] */
+	ParallelRedoInvalidPage invalid[PARALLEL_REDO_MAX_INVALID_PAGES];
+} ParallelRedoWorkerSlot;
+
+typedef struct ParallelRedoCtlData
+{
+	Latch	   *startupLatch;	/* latch of the startup process */
+	pg_atomic_uint32 startupWaiting;	/* is the startup process waiting for
+										 * the workers? */
+	pg_atomic_uint32 workersWaiting;	/* number of workers waiting for
+										 * other workers */
+	ParallelRedoWorkerSlot workers[FLEXIBLE_ARRAY_MEMBER];
+	/* the queues follow, each PARALLEL_REDO_QUEUE_SIZE bytes */
+} ParallelRedoCtlData;
+
+/* Header of each message sent to a worker, followed by the decoded record */
+typedef struct ParallelRedoMsgHeader
+{
+	XLogRecPtr	ReadRecPtr;
+	XLogRecPtr	EndRecPtr;
+	char	   *origin;			/* address of the record in the startup
+								 * process, to relocate internal pointers */
+	uint8		flags;
+	int			nwaits;			/* number of uint64 progress targets, one
+								 * per worker, between header and record */
+} ParallelRedoMsgHeader;
+
+#define PARALLEL_REDO_MSG_HEADER_SIZE	MAXALIGN(sizeof(ParallelRedoMsgHeader))
+
+static ParallelRedoCtlData *ParallelRedoCtl = NULL;
+
+/* Startup process state */
+static int	nRedoWorkers = 0;
+static shm_mq_handle **redoQueues;
+static BackgroundWorkerHandle **redoHandles;
+static uint64 *redoDispatched;
+static uint64 *redoLastHeap;	/* redoDispatched as of the last heap record */
+static uint64 *redoWaits;
+static uint8 *redoPendingFlags;
+static bool redoDispatchedSinceWait = false;
+
+/* Worker state */
+static ParallelRedoWorkerSlot *MyRedoSlot = NULL;
+static shm_mq_handle *MyRedoQueue = NULL;
+
+static int	ParallelRedoChooseWorker(XLogReaderState *record);
+static bool ParallelRedoSafe(RmgrId rmid, uint8 info);
+static void ParallelRedoResolveConflicts(XLogReaderState *record);
+static void ParallelRedoWaitForOthers(const uint64 *waits, int nwaits);
+static void ParallelRedoWakeWorkers(void);
+static void ParallelRedoAbsorbInvalidPages(void);
+static void ParallelRedoCheckWorker(int workerno);
+static void ParallelRedoShutdown(int code, Datum arg);
+static void ParallelRedoWorkerShutdown(int code, Datum arg);
+static void ParallelRedoErrorCallback(void *arg);
+
+static inline char *
+ParallelRedoQueue(int workerno)
+{
+	return (char *) ParallelRedoCtl +
+		MAXALIGN(offsetof(ParallelRedoCtlData, workers) +
+				 sizeof(ParallelRedoWorkerSlot) * recovery_parallel_workers) +
+		(Size) workerno * PARALLEL_REDO_QUEUE_SIZE;
+}
+
+/*
+ * Report shared-memory space needed by ParallelRedoShmemInit.
+ */
+Size
+ParallelRedoShmemSize(void)
+{
+	Size		size;
+
+	if (recovery_parallel_workers == 0)
+		return 0;
+
+	size = offsetof(ParallelRedoCtlData, workers);
+	size = add_size(size, mul_size(sizeof(ParallelRedoWorkerSlot),
+								   recovery_parallel_workers));
+	size = MAXALIGN(size);
+	size = add_size(size, mul_size(PARALLEL_REDO_QUEUE_SIZE,
+								   recovery_parallel_workers));
+
+	return size;
+}
+
+/*
+ * Allocate and initialize parallel redo related shared memory.
+ */
+void
+ParallelRedoShmemInit(void)
+{
+	bool		found;
+
+	if (recovery_parallel_workers == 0)
+		return;
+
+	ParallelRedoCtl = (ParallelRedoCtlData *)
+		ShmemInitStruct("Parallel Redo", ParallelRedoShmemSize(), &found);
+
+	if (!found)
+	{
+		ParallelRedoCtl->startupLatch = NULL;
+		pg_atomic_init_u32(&ParallelRedoCtl->startupWaiting, 0);
+		pg_atomic_init_u32(&ParallelRedoCtl->workersWaiting, 0);
+		for (int i = 0; i < recovery_parallel_workers; i++)
+		{
+			ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->workers[i];
+
+			pg_atomic_init_u64(&slot->nprocessed, 0);
+			SpinLockInit(&slot->mutex);
+			slot->latch = NULL;
+			slot->exited = false;
+			slot->ninvalid = 0;
+		}
+	}
+}
+
+/*
+ * Launch the parallel redo workers, if configured.  Called by the startup
+ * process when redo begins.
+ *
+ * If we can't launch as many workers as requested, we carry on with the
+ * ones we got, or replay everything ourselves if we got none.
+ */
+void
+ParallelRedoStartWorkers(void)
+{
+	MemoryContext oldcontext;
+
+	Assert(nRedoWorkers == 0);
+
+	if (recovery_parallel_workers == 0 || !IsUnderPostmaster)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(TopMemoryContext);
+	redoQueues = palloc0_array(shm_mq_handle *, recovery_parallel_workers);
+	redoHandles = palloc0_array(BackgroundWorkerHandle *,
+								recovery_parallel_workers);
+	redoDispatched = palloc0_array(uint64, recovery_parallel_workers);
+	redoLastHeap = palloc0_array(uint64, recovery_parallel_workers);
+	redoWaits = palloc0_array(uint64, recovery_parallel_workers);
+	redoPendingFlags = palloc0_array(uint8, recovery_parallel_workers);
+	MemoryContextSwitchTo(oldcontext);
+
+	ParallelRedoCtl->startupLatch = MyLatch;
+	pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 0);
+	pg_atomic_write_u32(&ParallelRedoCtl->workersWaiting, 0);
+
+	for (int i = 0; i < recovery_parallel_workers; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->workers[i];
+		BackgroundWorker worker;
+		BackgroundWorkerHandle *handle;
+		shm_mq	   *mq;
+
+		pg_atomic_write_u64(&slot->nprocessed, 0);
+		SpinLockAcquire(&slot->mutex);
+		slot->latch = NULL;
+		slot->exited = false;
+		slot->ninvalid = 0;
+		SpinLockRelease(&slot->mutex);
+
+		mq = shm_mq_create(ParallelRedoQueue(i), PARALLEL_REDO_QUEUE_SIZE);
+		shm_mq_set_sender(mq, MyProc);
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_PostmasterStart;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		snprintf(worker.bgw_library_name, BGW_MAXLEN, "postgres");
+		snprintf(worker.bgw_function_name, BGW_MAXLEN,
+				 "ParallelRedoWorkerMain");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "parallel redo worker %d", i);
+		snprintf(worker.bgw_type, BGW_MAXLEN, "parallel redo worker");
+		worker.bgw_main_arg = Int32GetDatum(i);
+		worker.bgw_notify_pid = MyProcPid;
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+		{
+			ereport(LOG,
+					(errmsg("could not register parallel redo worker"),
+					 errhint("You might need to increase max_worker_processes.")));
+			break;
+		}
+
+		redoHandles[i] = handle;
+		redoQueues[i] = shm_mq_attach(mq, NULL, handle);
+		redoDispatched[i] = 0;
+		redoLastHeap[i] = 0;
+		redoPendingFlags[i] = 0;
+		nRedoWorkers++;
+	}
+
+	if (nRedoWorkers > 0)
+	{
+		before_shmem_exit(ParallelRedoShutdown, 0);
+		ereport(LOG,
+				(errmsg_plural("using %d parallel redo worker",
+							   "using %d parallel redo workers",
+							   nRedoWorkers, nRedoWorkers)));
+	}
+}
+
+/*
+ * Hand a record over to a parallel redo worker, if possible.
+ *
+ * Returns true if the record was dispatched.  Otherwise, the caller must
+ * wait for the workers with ParallelRedoWaitForWorkers(), replay the record
+ * itself, and then call ParallelRedoBarrierApplied().
+ */
+bool
+ParallelRedoDispatch(XLogReaderState *record)
+{
+	DecodedXLogRecord *decoded = record->record;
+	union
+	{
+		ParallelRedoMsgHeader hdr;
+		char		data[PARALLEL_REDO_MSG_HEADER_SIZE];
+	}			msg;
+	shm_mq_iovec iov[3];
+	RmgrId		rmid = XLogRecGetRmid(record);
+	bool		isheap;
+	int			workerno;
+	int			nwaits = 0;
+
+	if (nRedoWorkers == 0)
+		return false;
+
+	workerno = ParallelRedoChooseWorker(record);
+	if (workerno < 0)
+		return false;
+
+	/* Full-page images count as heap records, since they may be either */
+	isheap = (rmid == RM_HEAP_ID || rmid == RM_HEAP2_ID || rmid == RM_XLOG_ID);
+
+	if (InHotStandby)
+	{
+		ParallelRedoResolveConflicts(record);
+
+		/*
+		 * Make the worker wait for the heap records dispatched to the other
+		 * workers so far, unless they have already been applied.
+		 */
+		if (rmid != RM_HEAP_ID && rmid != RM_HEAP2_ID)
+		{
+			for (int i = 0; i < nRedoWorkers; i++)
+			{
+				redoWaits[i] = 0;
+				if (i != workerno &&
+					redoLastHeap[i] >
+					pg_atomic_read_u64(&ParallelRedoCtl->workers[i].nprocessed))
+				{
+					redoWaits[i] = redoLastHeap[i];
+					nwaits = nRedoWorkers;
+				}
+			}
+		}
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.hdr.ReadRecPtr = record->ReadRecPtr;
+	msg.hdr.EndRecPtr = record->EndRecPtr;
+	msg.hdr.origin = (char *) decoded;
+	msg.hdr.flags = redoPendingFlags[workerno];
+	if (reachedConsistency)
+		msg.hdr.flags |= PARALLEL_REDO_CONSISTENT;
+	msg.hdr.nwaits = nwaits;
+
+	iov[0].data = msg.data;
+	iov[0].len = PARALLEL_REDO_MSG_HEADER_SIZE;
+	iov[1].data = (const char *) redoWaits;
+	iov[1].len = sizeof(uint64) * nwaits;
+	iov[2].data = (const char *) decoded;
+	iov[2].len = decoded->size;
+
+	/*
+	 * Send without blocking, so that we can service invalid-page reports and
+	 * notice a dead worker while the queue is full.
+	 */
+	for (;;)
+	{
+		shm_mq_result res;
+
+		res = shm_mq_sendv(redoQueues[workerno], iov, 3, true, true);
+		if (res == SHM_MQ_SUCCESS)
+			break;
+		if (res == SHM_MQ_DETACHED)
+			ereport(FATAL,
+					(errmsg("parallel redo worker %d exited unexpectedly",
+							workerno)));
+
+		ParallelRedoAbsorbInvalidPages();
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+						 WAIT_EVENT_RECOVERY_PARALLEL_REDO_DISPATCH);
+		ResetLatch(MyLatch);
+		HandleStartupProcInterrupts();
+	}
+
+	redoPendingFlags[workerno] = 0;
+	redoDispatched[workerno]++;
+	if (isheap)
+		redoLastHeap[workerno] = redoDispatched[workerno];
+	redoDispatchedSinceWait = true;
+
+	return true;
+}
+
+/*
+ * Wait until the workers have applied all records dispatched so far.
+ *
+ * Returns false if there was nothing to wait for.
+ */
+bool
+ParallelRedoWaitForWorkers(void)
+{
+	if (!redoDispatchedSinceWait)
+		return false;
+
+	pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 1);
+
+	for (;;)
+	{
+		bool		done = true;
+
+		pg_memory_barrier();
+
+		ParallelRedoAbsorbInvalidPages();
+
+		for (int i = 0; i < nRedoWorkers; i++)
+		{
+			if (pg_atomic_read_u64(&ParallelRedoCtl->workers[i].nprocessed) <
+				redoDispatched[i])
+			{
+				ParallelRedoCheckWorker(i);
+				done = false;
+			}
+		}
+
+		if (done)
+			break;
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+						 WAIT_EVENT_RECOVERY_PARALLEL_REDO_SYNC);
+		ResetLatch(MyLatch);
+		HandleStartupProcInterrupts();
+	}
+
+	pg_atomic_write_u32(&ParallelRedoCtl->startupWaiting, 0);
+
+	/* A worker reports invalid pages before counting the record as done */
+	ParallelRedoAbsorbInvalidPages();
+
+	/* The workers may have extended relations behind our back */
+	smgrforgetallnblocks();
+
+	redoDispatchedSinceWait = false;
+
+	return true;
+}
+
+/*
+ * Called by the startup process after replaying a record itself, to tell the
+ * workers about any changes to relation files they need to know about.
+ */
+void
+ParallelRedoBarrierApplied(XLogReaderState *record)
+{
+	RmgrId		rmid = XLogRecGetRmid(record);
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+	uint8		flags = 0;
+
+	if (nRedoWorkers == 0)
+		return;
+
+	switch (rmid)
+	{
+		case RM_XACT_ID:
+			{
+				uint8		xact_info = info & XLOG_XACT_OPMASK;
+
+				/* Relation files dropped at commit or abort? */
+				if (xact_info == XLOG_XACT_COMMIT ||
+					xact_info == XLOG_XACT_COMMIT_PREPARED)
+				{
+					xl_xact_parsed_commit parsed;
+
+					ParseCommitRecord(XLogRecGetInfo(record),
+									  (xl_xact_commit *) XLogRecGetData(record),
+									  &parsed);
+					if (parsed.nrels > 0)
+						flags = PARALLEL_REDO_CLOSE_FILES;
+				}
+				else if (xact_info == XLOG_XACT_ABORT ||
+						 xact_info == XLOG_XACT_ABORT_PREPARED)
+				{
+					xl_xact_parsed_abort parsed;
+
+					ParseAbortRecord(XLogRecGetInfo(record),
+									 (xl_xact_abort *) XLogRecGetData(record),
+									 &parsed);
+					if (parsed.nrels > 0)
+						flags = PARALLEL_REDO_CLOSE_FILES;
+				}
+			}
+			break;
+
+		case RM_SMGR_ID:
+			if (info == XLOG_SMGR_TRUNCATE)
+				flags = PARALLEL_REDO_FORGET_NBLOCKS;
+			break;
+
+		case RM_DBASE_ID:
+		case RM_TBLSPC_ID:
+			flags = PARALLEL_REDO_CLOSE_FILES;
+			break;
+
+		default:
+			/* We may have extended a relation that a worker also handles */
+			if (XLogRecMaxBlockId(record) >= 0)
+				flags = PARALLEL_REDO_FORGET_NBLOCKS;
+			break;
+	}
+
+	if (flags != 0)
+	{
+		for (int i = 0; i < nRedoWorkers; i++)
+			redoPendingFlags[i] |= flags;
+	}
+}
+
+/*
+ * Wait for all outstanding records to be applied, then shut the workers
+ * down.  Called by the startup process at the end of redo.
+ */
+void
+ParallelRedoStopWorkers(void)
+{
+	int			nworkers = nRedoWorkers;
+
+	if (nworkers == 0)
+		return;
+
+	(void) ParallelRedoWaitForWorkers();
+
+	/* Detaching from the queues tells the workers to exit */
+	nRedoWorkers = 0;
+	for (int i = 0; i < nworkers; i++)
+	{
+		shm_mq_detach(redoQueues[i]);
+		redoQueues[i] = NULL;
+	}
+
+	/* Don't let them linger into the end-of-recovery checkpoint */
+	for (int i = 0; i < nworkers; i++)
+	{
+		(void) WaitForBackgroundWorkerShutdown(redoHandles[i]);
+		pfree(redoHandles[i]);
+		redoHandles[i] = NULL;
+	}
+}
+
+/*
+ * Choose the worker to replay a record, or return -1 if the startup process
+ * needs to replay it itself.
+ */
+static int
+ParallelRedoChooseWorker(XLogReaderState *record)
+{
+	RelFileLocator *rlocator = NULL;
+
+	/* Consistency checking of backup blocks is done by the startup process */
+	if ((XLogRecGetInfo(record) & XLR_CHECK_CONSISTENCY) != 0)
+		return -1;
+
+	if (!ParallelRedoSafe(XLogRecGetRmid(record),
+						  XLogRecGetInfo(record) & ~XLR_INFO_MASK))
+		return -1;
+
+	/* All the blocks must belong to the same relation */
+	for (int block_id = 0; block_id <= XLogRecMaxBlockId(record); block_id++)
+	{
+		DecodedBkpBlock *blk;
+
+		if (!XLogRecHasBlockRef(record, block_id))
+			continue;
+
+		blk = XLogRecGetBlock(record, block_id);
+		if (rlocator == NULL)
+			rlocator = &blk->rlocator;
+		else if (!RelFileLocatorEquals(*rlocator, blk->rlocator))
+			return -1;
+	}
+
+	if (rlocator == NULL)
+		return -1;
+
+	return hash_bytes((const unsigned char *) rlocator,
+					  sizeof(RelFileLocator)) % nRedoWorkers;
+}
+
+/*
+ * Can records of this type be replayed by a parallel redo worker?
+ *
+ * That's the case if the redo routine only touches the blocks referenced by
+ * the record and doesn't depend on any state kept by the startup process.
+ * Records that need to resolve recovery conflicts on snapshots qualify, as
+ * ParallelRedoResolveConflicts() takes care of that, but records that take
+ * a cleanup lock qualify only when hot standby is not active.
+ */
+static bool
+ParallelRedoSafe(RmgrId rmid, uint8 info)
+{
+	bool		no_conflicts = (standbyState == STANDBY_DISABLED);
+
+	switch (rmid)
+	{
+		case RM_XLOG_ID:
+			return info == XLOG_FPI || info == XLOG_FPI_FOR_HINT;
+
+		case RM_HEAP_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP_INSERT:
+				case XLOG_HEAP_DELETE:
+				case XLOG_HEAP_UPDATE:
+				case XLOG_HEAP_HOT_UPDATE:
+				case XLOG_HEAP_CONFIRM:
+				case XLOG_HEAP_LOCK:
+				case XLOG_HEAP_INPLACE:
+					return true;
+			}
+			return false;
+
+		case RM_HEAP2_ID:
+			switch (info & XLOG_HEAP_OPMASK)
+			{
+				case XLOG_HEAP2_MULTI_INSERT:
+				case XLOG_HEAP2_LOCK_UPDATED:
+				case XLOG_HEAP2_FREEZE_PAGE:
+				case XLOG_HEAP2_VISIBLE:
+					return true;
+				case XLOG_HEAP2_PRUNE:
+				case XLOG_HEAP2_VACUUM:
+					return no_conflicts;
+			}
+			return false;
+
+		case RM_BTREE_ID:
+			switch (info)
+			{
+				case XLOG_BTREE_INSERT_LEAF:
+				case XLOG_BTREE_INSERT_UPPER:
+				case XLOG_BTREE_INSERT_META:
+				case XLOG_BTREE_SPLIT_L:
+				case XLOG_BTREE_SPLIT_R:
+				case XLOG_BTREE_INSERT_POST:
+				case XLOG_BTREE_DEDUP:
+				case XLOG_BTREE_NEWROOT:
+				case XLOG_BTREE_META_CLEANUP:
+				case XLOG_BTREE_DELETE:
+					return true;
+				case XLOG_BTREE_VACUUM:
+					return no_conflicts;
+			}
+			return false;
+
+		default:
+			return false;
+	}
+}
+
+/*
+ * Resolve recovery conflicts with hot standby queries for a record about to
+ * be dispatched, like its redo routine would do if replayed by the startup
+ * process.  Keep this in sync with the redo routines of the record types
+ * accepted by ParallelRedoSafe().
+ */
+static void
+ParallelRedoResolveConflicts(XLogReaderState *record)
+{
+	RmgrId		rmid = XLogRecGetRmid(record);
+	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
+	RelFileLocator rlocator;
+	TransactionId latestRemovedXid;
+
+	if (rmid == RM_HEAP2_ID &&
+		(info & XLOG_HEAP_OPMASK) == XLOG_HEAP2_FREEZE_PAGE)
+	{
+		xl_heap_freeze_page *xlrec;
+
+		xlrec = (xl_heap_freeze_page *) XLogRecGetData(record);
+		latestRemovedXid = xlrec->cutoff_xid;
+		TransactionIdRetreat(latestRemovedXid);
+		XLogRecGetBlockTag(record, 0, &rlocator, NULL, NULL);
+	}
+	else if (rmid == RM_HEAP2_ID &&
+			 (info & XLOG_HEAP_OPMASK) == XLOG_HEAP2_VISIBLE)
+	{
+		xl_heap_visible *xlrec = (xl_heap_visible *) XLogRecGetData(record);
+
+		latestRemovedXid = xlrec->cutoff_xid;
+		XLogRecGetBlockTag(record, 1, &rlocator, NULL, NULL);
+	}
+	else if (rmid == RM_BTREE_ID && info == XLOG_BTREE_DELETE)
+	{
+		xl_btree_delete *xlrec = (xl_btree_delete *) XLogRecGetData(record);
+
+		latestRemovedXid = xlrec->latestRemovedXid;
+		XLogRecGetBlockTag(record, 0, &rlocator, NULL, NULL);
+	}
+	else
+		return;
+
+	ResolveRecoveryConflictWithSnapshot(latestRemovedXid, rlocator);
+}
+
+/*
+ * Wait until other workers have applied the records that must be applied
+ * before our next one.  waits[i] is the number of records worker i must
+ * have applied, or 0.  Those records precede ours in WAL, so the other
+ * workers can never be waiting for us in turn.
+ */
+static void
+ParallelRedoWaitForOthers(const uint64 *waits, int nwaits)
+{
+	pg_atomic_fetch_add_u32(&ParallelRedoCtl->workersWaiting, 1);
+
+	for (;;)
+	{
+		bool		done = true;
+
+		pg_memory_barrier();
+
+		for (int i = 0; i < nwaits; i++)
+		{
+			ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->workers[i];
+			bool		exited;
+
+			if (waits[i] == 0 ||
+				pg_atomic_read_u64(&slot->nprocessed) >= waits[i])
+				continue;
+
+			SpinLockAcquire(&slot->mutex);
+			exited = slot->exited;
+			SpinLockRelease(&slot->mutex);
+			if (exited)
+				ereport(FATAL,
+						(errmsg("parallel redo worker %d exited unexpectedly",
+								i)));
+
+			done = false;
+		}
+
+		if (done)
+			break;
+
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+						 WAIT_EVENT_RECOVERY_PARALLEL_REDO_ORDER);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	pg_atomic_fetch_sub_u32(&ParallelRedoCtl->workersWaiting, 1);
+}
+
+/*
+ * Wake up the other workers, some of which may be waiting for us.
+ */
+static void
+ParallelRedoWakeWorkers(void)
+{
+	for (int i = 0; i < recovery_parallel_workers; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->workers[i];
+		Latch	   *latch;
+
+		if (slot == MyRedoSlot)
+			continue;
+
+		SpinLockAcquire(&slot->mutex);
+		latch = slot->latch;
+		SpinLockRelease(&slot->mutex);
+
+		if (latch)
+			SetLatch(latch);
+	}
+}
+
+/*
+ * Move invalid-page references reported by the workers into our own table.
+ */
+static void
+ParallelRedoAbsorbInvalidPages(void)
+{
+	ParallelRedoInvalidPage pages[PARALLEL_REDO_MAX_INVALID_PAGES];
+
+	for (int i = 0; i < nRedoWorkers; i++)
+	{
+		ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->workers[i];
+		Latch	   *latch;
+		int			n;
+
+		SpinLockAcquire(&slot->mutex);
+		n = slot->ninvalid;
+		memcpy(pages, slot->invalid, sizeof(ParallelRedoInvalidPage) * n);
+		slot->ninvalid = 0;
+		latch = slot->latch;
+		SpinLockRelease(&slot->mutex);
+
+		if (n == 0)
+			continue;
+
+		for (int j = 0; j < n; j++)
+			XLogRememberInvalidPage(pages[j].locator, pages[j].forkno,
+									pages[j].blkno, pages[j].present);
+
+		/* The worker might be waiting for room */
+		if (latch)
+			SetLatch(latch);
+	}
+}
+
+/*
+ * Error out if a worker has exited.
+ */
+static void
+ParallelRedoCheckWorker(int workerno)
+{
+	ParallelRedoWorkerSlot *slot = &ParallelRedoCtl->workers[workerno];
+	bool		exited;
+
+	SpinLockAcquire(&slot->mutex);
+	exited = slot->exited;
+	SpinLockRelease(&slot->mutex);
+
+	if (exited)
+		ereport(FATAL,
+				(errmsg("parallel redo worker %d exited unexpectedly",
+						workerno)));
+}
+
+/*
+ * Detach from the queues when the startup process exits, so that the workers
+ * go away too.
+ */
+static void
+ParallelRedoShutdown(int code, Datum arg)
+{
+	for (int i = 0; i < nRedoWorkers; i++)
+	{
+		if (redoQueues[i] != NULL)
+			shm_mq_detach(redoQueues[i]);
+	}
+	nRedoWorkers = 0;
+}
+
+/*
+ * Called by a parallel redo worker instead of adding an entry to its own
+ * invalid-page table.  Returns false if we are not a parallel redo worker.
+ */
+bool
+ParallelRedoReportInvalidPage(RelFileLocator locator, ForkNumber forkno,
+							  BlockNumber blkno, bool present)
+{
+	if (MyRedoSlot == NULL)
+		return false;
+
+	for (;;)
+	{
+		SpinLockAcquire(&MyRedoSlot->mutex);
+		if (MyRedoSlot->ninvalid < PARALLEL_REDO_MAX_INVALID_PAGES)
+		{
+			ParallelRedoInvalidPage *page;
+
+			page = &MyRedoSlot->invalid[MyRedoSlot->ninvalid++];
+			page->locator = locator;
+			page->forkno = forkno;
+			page->blkno = blkno;
+			page->present = present;
+			SpinLockRelease(&MyRedoSlot->mutex);
+			break;
+		}
+		SpinLockRelease(&MyRedoSlot->mutex);
+
+		/* Full; wait for the startup process to absorb the entries */
+		SetLatch(ParallelRedoCtl->startupLatch);
+		(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, -1,
+						 WAIT_EVENT_RECOVERY_PARALLEL_REDO_REPORT);
+		ResetLatch(MyLatch);
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	return true;
+}
+
+/*
+ * Main entry point for a parallel redo worker.
+ */
+void
+ParallelRedoWorkerMain(Datum main_arg)
+{
+	int			workerno = DatumGetInt32(main_arg);
+	shm_mq	   *mq;
+	XLogReaderState *reader;
+	char	   *buffer = NULL;
+	Size		buffer_size = 0;
+	uint64	   *waits;
+	uint64		nprocessed = 0;
+	MemoryContext redo_context;
+	ErrorContextCallback errcallback;
+
+	BackgroundWorkerUnblockSignals();
+
+	Assert(ParallelRedoCtl != NULL);
+	Assert(workerno >= 0 && workerno < recovery_parallel_workers);
+
+	MyRedoSlot = &ParallelRedoCtl->workers[workerno];
+	SpinLockAcquire(&MyRedoSlot->mutex);
+	MyRedoSlot->latch = MyLatch;
+	SpinLockRelease(&MyRedoSlot->mutex);
+
+	mq = (shm_mq *) ParallelRedoQueue(workerno);
+	shm_mq_set_receiver(mq, MyProc);
+	MyRedoQueue = shm_mq_attach(mq, NULL, NULL);
+
+	before_shmem_exit(ParallelRedoWorkerShutdown, 0);
+
+	/* We replay WAL records, like the startup process */
+	InRecovery = true;
+	RmgrStartup();
+
+	/* Only used to pass records to the redo routines, so no page_read */
+	reader = XLogReaderAllocate(wal_segment_size, NULL, XL_ROUTINE(), NULL);
+	if (!reader)
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("out of memory"),
+				 errdetail("Failed while allocating a WAL reading processor.")));
+	waits = MemoryContextAlloc(TopMemoryContext,
+							   sizeof(uint64) * recovery_parallel_workers);
+	redo_context = AllocSetContextCreate(TopMemoryContext,
+										 "parallel redo",
+										 ALLOCSET_DEFAULT_SIZES);
+
+	errcallback.callback = ParallelRedoErrorCallback;
+	errcallback.arg = (void *) reader;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	for (;;)
+	{
+		ParallelRedoMsgHeader hdr;
+		DecodedXLogRecord *decoded;
+		shm_mq_result res;
+		Size		nbytes;
+		void	   *data;
+		Size		offset;
+		Size		size;
+		ptrdiff_t	delta;
+		MemoryContext oldcontext;
+
+		res = shm_mq_receive(MyRedoQueue, &nbytes, &data, false);
+		if (res != SHM_MQ_SUCCESS)
+			break;				/* startup process detached; we're done */
+
+		if (nbytes < PARALLEL_REDO_MSG_HEADER_SIZE)
+			elog(ERROR, "invalid parallel redo message length %zu", nbytes);
+
+		memcpy(&hdr, data, sizeof(hdr));
+		if (hdr.nwaits < 0 || hdr.nwaits > recovery_parallel_workers)
+			elog(ERROR, "invalid parallel redo message");
+		offset = PARALLEL_REDO_MSG_HEADER_SIZE + sizeof(uint64) * hdr.nwaits;
+		if (nbytes < offset + sizeof(DecodedXLogRecord))
+			elog(ERROR, "invalid parallel redo message length %zu", nbytes);
+		memcpy(waits, (char *) data + PARALLEL_REDO_MSG_HEADER_SIZE,
+			   sizeof(uint64) * hdr.nwaits);
+		size = nbytes - offset;
+
+		/* Copy the record to suitably aligned local memory */
+		if (size > buffer_size)
+		{
+			if (buffer)
+				pfree(buffer);
+			buffer_size = Max(size, 2 * buffer_size);
+			buffer = MemoryContextAlloc(TopMemoryContext, buffer_size);
+		}
+		memcpy(buffer, (char *) data + offset, size);
+
+		/* The record lies in one chunk of memory; fix up its pointers */
+		decoded = (DecodedXLogRecord *) buffer;
+		delta = buffer - hdr.origin;
+		decoded->next = NULL;
+		if (decoded->main_data_len > 0)
+			decoded->main_data += delta;
+		for (int block_id = 0; block_id <= decoded->max_block_id; block_id++)
+		{
+			DecodedBkpBlock *blk = &decoded->blocks[block_id];
+
+			if (!blk->in_use)
+				continue;
+			if (blk->has_image)
+				blk->bkp_image += delta;
+			if (blk->has_data)
+				blk->data += delta;
+		}
+
+		if (hdr.flags & PARALLEL_REDO_CLOSE_FILES)
+			smgrcloseall();
+		else if (hdr.flags & PARALLEL_REDO_FORGET_NBLOCKS)
+			smgrforgetallnblocks();
+		reachedConsistency = (hdr.flags & PARALLEL_REDO_CONSISTENT) != 0;
+
+		if (hdr.nwaits > 0)
+			ParallelRedoWaitForOthers(waits, hdr.nwaits);
+
+		reader->ReadRecPtr = hdr.ReadRecPtr;
+		reader->EndRecPtr = hdr.EndRecPtr;
+		reader->record = decoded;
+
+		oldcontext = MemoryContextSwitchTo(redo_context);
+		GetRmgr(decoded->header.xl_rmid).rm_redo(reader);
+		MemoryContextSwitchTo(oldcontext);
+		MemoryContextReset(redo_context);
+
+		reader->record = NULL;
+
+		/* Let the startup process and other workers know if they wait */
+		pg_atomic_write_u64(&MyRedoSlot->nprocessed, ++nprocessed);
+		pg_memory_barrier();
+		if (pg_atomic_read_u32(&ParallelRedoCtl->startupWaiting) != 0)
+			SetLatch(ParallelRedoCtl->startupLatch);
+		if (pg_atomic_read_u32(&ParallelRedoCtl->workersWaiting) != 0)
+			ParallelRedoWakeWorkers();
+	}
+
+	error_context_stack = errcallback.previous;
+
+	RmgrCleanup();
+
+	proc_exit(0);
+}
+
+/*
+ * Tell the startup process that we're gone.
+ */
+static void
+ParallelRedoWorkerShutdown(int code, Datum arg)
+{
+	SpinLockAcquire(&MyRedoSlot->mutex);
+	MyRedoSlot->exited = true;
+	MyRedoSlot->latch = NULL;
+	SpinLockRelease(&MyRedoSlot->mutex);
+
+	if (MyRedoQueue != NULL)
+	{
+		shm_mq_detach(MyRedoQueue);
+		MyRedoQueue = NULL;
+	}
+
+	if (ParallelRedoCtl->startupLatch)
+		SetLatch(ParallelRedoCtl->startupLatch);
+	ParallelRedoWakeWorkers();
+}
+
+/*
+ * Error context callback for errors occurring during rm_redo() in a worker.
+ */
+static void
+ParallelRedoErrorCallback(void *arg)
+{
+	XLogReaderState *record = (XLogReaderState *) arg;
+	StringInfoData buf;
+
+	if (record->record == NULL)
+		return;
+
+	initStringInfo(&buf);
+	xlog_outdesc(&buf, record);
+
+	/* translator: %s is a WAL record description */
+	errcontext("WAL redo at %X/%X for %s",
+			   LSN_FORMAT_ARGS(record->ReadRecPtr),
+			   buf.data);
+
+	pfree(buf.data);
+}
@@ -36,6 +36,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/xlogarchive.h"
+#include "access/xlogparallel.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogreader.h"
 #include "access/xlogrecovery.h"
@@ -185,6 +186,15 @@ static bool LocalPromoteIsTriggered = false;
 /* Has the recovery code requested a walreceiver wakeup? */
 static bool doRequestWalReceiverReply;
 
+/*
+ * Position of the last record handed to a parallel redo worker.  It isn't
+ * published as lastReplayedEndRecPtr until the workers have caught up, see
+ * SyncParallelRedo().
+ */
+static XLogRecPtr pendingReplayedReadRecPtr = InvalidXLogRecPtr;
+static XLogRecPtr pendingReplayedEndRecPtr = InvalidXLogRecPtr;
+static TimeLineID pendingReplayedTLI = 0;
+
 /* XLogReader object used to parse the WAL records */
 static XLogReaderState *xlogreader = NULL;
 
@@ -395,6 +405,7 @@ static bool read_tablespace_map(List **tablespaces);
 
 static void xlogrecovery_redo(XLogReaderState *record, TimeLineID replayTLI);
 static void CheckRecoveryConsistency(void);
+static void SyncParallelRedo(void);
 static void rm_redo_error_callback(void *arg);
 #ifdef WAL_DEBUG
 static void xlog_outrec(StringInfo buf, XLogReaderState *record);
@@ -1639,6 +1650,7 @@ PerformWalRecovery(void)
 		InRedo = true;
 
 		RmgrStartup();
+		ParallelRedoStartWorkers();
 
 		ereport(LOG,
 				(errmsg("redo starts at %X/%X",
@@ -1742,6 +1754,10 @@ PerformWalRecovery(void)
 		 * end of main redo apply loop
 		 */
 
+		/* Let parallel redo workers finish before anything else happens */
+		SyncParallelRedo();
+		ParallelRedoStopWorkers();
+
 		if (reachedRecoveryTarget)
 		{
 			if (!reachedConsistency)
@@ -1893,6 +1909,23 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 	if (record->xl_rmid == RM_XLOG_ID)
 		xlogrecovery_redo(xlogreader, *replayTLI);
 
+	/*
+	 * If the record can be replayed by a parallel redo worker, hand it over.
+	 * The replay position is advanced later, once the workers have caught up.
+	 */
+	if (ParallelRedoDispatch(xlogreader))
+	{
+		Assert(!switchedTLI);
+		error_context_stack = errcallback.previous;
+		pendingReplayedReadRecPtr = xlogreader->ReadRecPtr;
+		pendingReplayedEndRecPtr = xlogreader->EndRecPtr;
+		pendingReplayedTLI = *replayTLI;
+		return;
+	}
+
+	/* Everything dispatched before this record must be applied first */
+	SyncParallelRedo();
+
 	/* Now apply the WAL record itself */
 	GetRmgr(record->xl_rmid).rm_redo(xlogreader);
 
@@ -1904,6 +1937,8 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 	if ((record->xl_info & XLR_CHECK_CONSISTENCY) != 0)
 		verifyBackupPageConsistency(xlogreader);
 
+	ParallelRedoBarrierApplied(xlogreader);
+
 	/* Pop the error context stack */
 	error_context_stack = errcallback.previous;
 
@@ -1951,6 +1986,35 @@ ApplyWalRecord(XLogReaderState *xlogreader, XLogRecord *record, TimeLineID *repl
 	}
 }
 
+/*
+ * Wait for the parallel redo workers to apply everything dispatched so far,
+ * and then advance lastReplayedEndRecPtr past the records they applied.
+ *
+ * This must be done before replaying any record locally, and before waiting
+ * for more WAL to arrive, so that standbys report an accurate replay position.
+ */
+static void
+SyncParallelRedo(void)
+{
+	if (!ParallelRedoWaitForWorkers())
+		return;
+
+	if (XLogRecPtrIsInvalid(pendingReplayedEndRecPtr))
+		return;
+
+	SpinLockAcquire(&XLogRecoveryCtl->info_lck);
+	XLogRecoveryCtl->lastReplayedReadRecPtr = pendingReplayedReadRecPtr;
+	XLogRecoveryCtl->lastReplayedEndRecPtr = pendingReplayedEndRecPtr;
+	XLogRecoveryCtl->lastReplayedTLI = pendingReplayedTLI;
+	SpinLockRelease(&XLogRecoveryCtl->info_lck);
+
+	pendingReplayedReadRecPtr = InvalidXLogRecPtr;
+	pendingReplayedEndRecPtr = InvalidXLogRecPtr;
+
+	/* Allow read-only connections if we're consistent now */
+	CheckRecoveryConsistency();
+}
+
 /*
  * Some XLOG RM record types that are directly related to WAL recovery are
  * handled here rather than in the xlog_redo()
@@ -2798,6 +2862,9 @@ getRecoveryStopReason(void)
 static void
 recoveryPausesHere(bool endOfRecovery)
 {
+	/* Make sure the paused-at position is accurate */
+	SyncParallelRedo();
+
 	/* Don't pause unless users can connect! */
 	if (!LocalHotStandbyActive)
 		return;
@@ -2902,6 +2969,9 @@ recoveryApplyDelay(XLogReaderState *record)
 	if (msecs <= 0)
 		return false;
 
+	/* Apply what has been dispatched so far while we wait */
+	SyncParallelRedo();
+
 	while (true)
 	{
 		ResetLatch(&XLogRecoveryCtl->recoveryWakeupLatch);
@@ -3571,6 +3641,8 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 						elog(LOG, "waiting for WAL to become available at %X/%X",
 							 LSN_FORMAT_ARGS(RecPtr));
 
+						SyncParallelRedo();
+
 						(void) WaitLatch(&XLogRecoveryCtl->recoveryWakeupLatch,
 										 WL_LATCH_SET | WL_TIMEOUT |
 										 WL_EXIT_ON_PM_DEATH,
@@ -3829,8 +3901,10 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 					 * far and are about to start waiting for more WAL, let's
 					 * tell the upstream server our replay location now so
 					 * that pg_stat_replication doesn't show stale
-					 * information.
+					 * information.  Parallel redo workers must catch up
+					 * first for the location to be accurate.
 					 */
+					SyncParallelRedo();
 					if (!streaming_reply_sent)
 					{
 						WalRcvForceReply();
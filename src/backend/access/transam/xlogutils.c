@@ -22,6 +22,7 @@
 #include "access/timeline.h"
 #include "access/xlogrecovery.h"
 #include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogutils.h"
 #include "miscadmin.h"
@@ -39,16 +40,16 @@ bool		ignore_invalid_pages = false;
 /*
  * Are we doing recovery from XLOG?
  *
- * This is only ever true in the startup process; it should be read as meaning
- * "this process is replaying WAL records", rather than "the system is in
- * recovery mode".  It should be examined primarily by functions that need
- * to act differently when called from a WAL redo function (e.g., to skip WAL
- * logging).  To check whether the system is in recovery regardless of which
- * process you're running in, use RecoveryInProgress() but only after shared
- * memory startup and lock initialization.
+ * This is only ever true in the startup process and in parallel redo workers;
+ * it should be read as meaning "this process is replaying WAL records", rather
+ * than "the system is in recovery mode".  It should be examined primarily by
+ * functions that need to act differently when called from a WAL redo function
+ * (e.g., to skip WAL logging).  To check whether the system is in recovery
+ * regardless of which process you're running in, use RecoveryInProgress() but
+ * only after shared memory startup and lock initialization.
  *
- * This is updated from xlog.c and xlogrecovery.c, but lives here because
- * it's mostly read by WAL redo functions.
+ * This is updated from xlog.c, xlogrecovery.c and xlogparallel.c, but lives
+ * here because it's mostly read by WAL redo functions.
  */
 bool		InRecovery = false;
 
@@ -132,6 +133,13 @@ log_invalid_page(RelFileLocator locator, ForkNumber forkno, BlockNumber blkno,
 	if (message_level_is_interesting(DEBUG1))
 		report_invalid_page(DEBUG1, locator, forkno, blkno, present);
 
+	/*
+	 * A parallel redo worker hands the reference over to the startup
+	 * process, which owns the invalid-page table.
+	 */
+	if (ParallelRedoReportInvalidPage(locator, forkno, blkno, present))
+		return;
+
 	if (invalid_page_tab == NULL)
 	{
 		/* create hash table when first needed */
@@ -164,6 +172,17 @@ log_invalid_page(RelFileLocator locator, ForkNumber forkno, BlockNumber blkno,
 	}
 }
 
+/*
+ * Remember a reference to an invalid page reported by a parallel redo worker,
+ * as if we had come across it ourselves.
+ */
+void
+XLogRememberInvalidPage(RelFileLocator locator, ForkNumber forkno,
+						BlockNumber blkno, bool present)
+{
+	log_invalid_page(locator, forkno, blkno, present);
+}
+
 /* Forget any invalid pages >= minblkno, because they've been dropped */
 static void
 forget_invalid_pages(RelFileLocator locator, ForkNumber forkno,
@@ -907,6 +926,7 @@ read_local_xlog_page_guts(XLogReaderState *state, XLogRecPtr targetPagePtr,
 				loc;
 	TimeLineID	tli;
 	int			count;
+	Size		rbytes;
 	WALReadError errinfo;
 	TimeLineID	currTLI;
 
@@ -1025,9 +1045,15 @@ read_local_xlog_page_guts(XLogReaderState *state, XLogRecPtr targetPagePtr,
 	 * Even though we just determined how much of the page can be validly read
 	 * as 'count', read the whole page anyway. It's guaranteed to be
 	 * zero-padded up to the page boundary if it's incomplete.
+	 *
+	 * Take what we can from the WAL buffers first, see WALReadFromBuffers(),
+	 * and zero-pad the page ourselves if that's all we need.
 	 */
-	if (!WALRead(state, cur_page, targetPagePtr, XLOG_BLCKSZ, tli,
-				 &errinfo))
+	rbytes = WALReadFromBuffers(cur_page, targetPagePtr, count, tli);
+	if (rbytes == count)
+		memset(cur_page + count, 0, XLOG_BLCKSZ - count);
+	else if (!WALRead(state, cur_page + rbytes, targetPagePtr + rbytes,
+					  XLOG_BLCKSZ - rbytes, tli, &errinfo))
 		WALReadRaiseError(&errinfo);
 
 	/* number of valid bytes in the buffer */
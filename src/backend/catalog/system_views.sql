@@ -1004,6 +1004,7 @@ CREATE VIEW pg_stat_replication_slots AS
             s.spill_txns,
             s.spill_count,
             s.spill_bytes,
+            s.spill_disk_bytes,
             s.stream_txns,
             s.stream_count,
             s.stream_bytes,
@@ -1120,6 +1121,7 @@ CREATE VIEW pg_stat_wal AS
         w.wal_fpi,
         w.wal_bytes,
         w.wal_buffers_full,
+        w.wal_buffers_hit,
         w.wal_write,
         w.wal_sync,
         w.wal_write_time,
@@ -411,7 +411,8 @@ CopyMultiInsertBufferCleanup(CopyMultiInsertInfo *miinfo,
  * Write out all stored tuples in all buffers out to the tables.
  *
  * Once flushed we also trim the tracked buffers list down to size by removing
- * the buffers created earliest first.
+ * the buffers that received no tuples since the previous flush first, and
+ * then the buffers created earliest.
  *
  * Callers should pass 'curr_rri' as the ResultRelInfo that's currently being
  * used.  When cleaning up old buffers we'll never remove the one for
@@ -420,24 +421,44 @@ CopyMultiInsertBufferCleanup(CopyMultiInsertInfo *miinfo,
 static inline void
 CopyMultiInsertInfoFlush(CopyMultiInsertInfo *miinfo, ResultRelInfo *curr_rri)
 {
+	List	   *idle = NIL;
+	List	   *busy = NIL;
 	ListCell   *lc;
 
 	foreach(lc, miinfo->multiInsertBuffers)
 	{
 		CopyMultiInsertBuffer *buffer = (CopyMultiInsertBuffer *) lfirst(lc);
 
-		CopyMultiInsertBufferFlush(miinfo, buffer);
+		if (buffer->nused > 0)
+		{
+			CopyMultiInsertBufferFlush(miinfo, buffer);
+			busy = lappend(busy, buffer);
+		}
+		else
+			idle = lappend(idle, buffer);
 	}
 
 	miinfo->bufferedTuples = 0;
 	miinfo->bufferedBytes = 0;
 
 	/*
-	 * Trim the list of tracked buffers down if it exceeds the limit.  Here we
-	 * remove buffers starting with the ones we created first.  It seems less
-	 * likely that these older ones will be needed than the ones that were
-	 * just created.
+	 * Trim the list of tracked buffers down if it exceeds the limit.  The
+	 * partitions that just received tuples are the most likely to receive
+	 * more in the next batch, so move their buffers to the end of the list,
+	 * keeping them alive across batches, and remove buffers from the front:
+	 * first those that sat idle during this batch, then the ones we created
+	 * first.  It seems less likely that these older ones will be needed than
+	 * the ones that were just created.
 	 */
+	if (list_length(miinfo->multiInsertBuffers) > MAX_PARTITION_BUFFERS)
+	{
+		list_free(miinfo->multiInsertBuffers);
+		miinfo->multiInsertBuffers = list_concat(idle, busy);
+	}
+	else
+		list_free(idle);
+	list_free(busy);
+
 	while (list_length(miinfo->multiInsertBuffers) > MAX_PARTITION_BUFFERS)
 	{
 		CopyMultiInsertBuffer *buffer;
@@ -34,6 +34,7 @@
 #include "catalog/namespace.h"
 #include "catalog/toasting.h"
 #include "commands/createas.h"
+#include "commands/defrem.h"
 #include "commands/matview.h"
 #include "commands/prepare.h"
 #include "commands/tablecmds.h"
@@ -66,6 +67,7 @@ typedef struct
 /* utility functions for CTAS definition creation */
 static ObjectAddress create_ctas_internal(List *attrList, IntoClause *into);
 static ObjectAddress create_ctas_nodata(List *tlist, IntoClause *into);
+static bool is_incremental_matview(IntoClause *into);
 
 /* DestReceiver routines for collecting data */
 static void intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo);
@@ -142,6 +144,11 @@ create_ctas_internal(List *attrList, IntoClause *into)
 
 		StoreViewQuery(intoRelationAddr.objectId, query, false);
 		CommandCounterIncrement();
+
+		/* Start logging changes if it is to be maintained incrementally. */
+		if (is_incremental_matview(into))
+			CreateMatViewChangeLogs(intoRelationAddr.objectId,
+									(Query *) into->viewQuery);
 	}
 
 	return intoRelationAddr;
@@ -218,6 +225,33 @@ create_ctas_nodata(List *tlist, IntoClause *into)
 	return create_ctas_internal(attrList, into);
 }
 
+/*
+ * is_incremental_matview
+ *
+ * Does the IntoClause describe a materialized view to be maintained
+ * incrementally?
+ */
+static bool
+is_incremental_matview(IntoClause *into)
+{
+	ListCell   *lc;
+	bool		result = false;
+
+	if (into->viewQuery == NULL)
+		return false;
+
+	foreach(lc, into->options)
+	{
+		DefElem    *def = lfirst_node(DefElem, lc);
+
+		if (def->defnamespace == NULL &&
+			strcmp(def->defname, "incremental") == 0)
+			result = defGetBoolean(def);
+	}
+
+	return result;
+}
+
 
 /*
  * ExecCreateTableAs -- execute a CREATE TABLE AS command
@@ -292,6 +326,40 @@ ExecCreateTableAs(ParseState *pstate, CreateTableAsStmt *stmt,
 		 */
 		address = create_ctas_nodata(query->targetList, into);
 	}
+	else if (is_incremental_matview(into))
+	{
+		RefreshMatViewStmt *refresh;
+		QueryCompletion refreshqc;
+
+		/*
+		 * An incrementally maintained materialized view must be populated
+		 * using a snapshot taken after its change logging triggers were
+		 * installed, or changes committed in between would be missed.  So
+		 * define it without data, then refresh it with a new snapshot, which
+		 * is only possible in READ COMMITTED mode.
+		 */
+		if (IsolationUsesXactSnapshot())
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot populate an incrementally maintained materialized view in a REPEATABLE READ or SERIALIZABLE transaction"),
+					 errhint("Use WITH NO DATA, and refresh the materialized view afterwards.")));
+
+		address = create_ctas_nodata(query->targetList, into);
+
+		refresh = makeNode(RefreshMatViewStmt);
+		refresh->concurrent = false;
+		refresh->skipData = false;
+		refresh->relation =
+			makeRangeVar(get_namespace_name(get_rel_namespace(address.objectId)),
+						 get_rel_name(address.objectId), -1);
+
+		PushActiveSnapshot(GetTransactionSnapshot());
+		ExecRefreshMatView(refresh, pstate->p_sourcetext, params, &refreshqc);
+		PopActiveSnapshot();
+
+		if (qc)
+			SetQueryCompletion(qc, CMDTAG_SELECT, refreshqc.nprocessed);
+	}
 	else
 	{
 		/*
@@ -472,6 +540,15 @@ intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
 	/* This code supports both CREATE TABLE AS and CREATE MATERIALIZED VIEW */
 	is_matview = (into->viewQuery != NULL);
 
+	/*
+	 * ExecCreateTableAs() populates incrementally maintained materialized
+	 * views by other means, so we can only get here from EXPLAIN ANALYZE.
+	 */
+	if (is_incremental_matview(into))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("EXPLAIN ANALYZE is not supported for incrementally maintained materialized views")));
+
 	/*
 	 * Build column definitions using "pre-cooked" type and collation info. If
 	 * a column name list was specified in CREATE TABLE AS, override the
@@ -22,29 +22,47 @@
 #include "access/xact.h"
 #include "access/xlog.h"
 #include "catalog/catalog.h"
+#include "catalog/dependency.h"
+#include "catalog/heap.h"
 #include "catalog/indexing.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_aggregate.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_depend.h"
+#include "catalog/pg_inherits.h"
 #include "catalog/pg_opclass.h"
 #include "catalog/pg_operator.h"
+#include "catalog/pg_trigger.h"
+#include "catalog/toasting.h"
 #include "commands/cluster.h"
 #include "commands/matview.h"
 #include "commands/tablecmds.h"
 #include "commands/tablespace.h"
+#include "commands/trigger.h"
 #include "executor/executor.h"
 #include "executor/spi.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
+#include "parser/analyze.h"
 #include "parser/parse_relation.h"
+#include "parser/parser.h"
+#include "parser/parsetree.h"
 #include "pgstat.h"
 #include "rewrite/rewriteHandler.h"
 #include "storage/lmgr.h"
 #include "storage/smgr.h"
 #include "tcop/tcopprot.h"
+#include "utils/acl.h"
 #include "utils/builtins.h"
+#include "utils/fmgroids.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/ruleutils.h"
 #include "utils/snapmgr.h"
 #include "utils/syscache.h"
+#include "utils/typcache.h"
 
 
 typedef struct
@@ -58,6 +76,52 @@ typedef struct
 	BulkInsertState bistate;	/* bulk insert state */
 } DR_transientrel;
 
+/* Name of the sign column of a change log */
+#define IVM_SIGN_COLUMN		"__ivm_sign__"
+
+/*
+ * The number of delta terms grows exponentially with the number of changed
+ * relations, so beyond this many REFRESH recomputes the view instead.
+ */
+#define IVM_MAX_CHANGED_RELS	6
+
+/* A base relation reference in the query of an incremental matview */
+typedef struct IvmBaseRel
+{
+	Index		rtindex;		/* range table index in the view's query */
+	Oid			relid;			/* OID of the table */
+	Oid			logoid;			/* OID of its change log */
+	bool		changed;		/* does the log contain changes? */
+} IvmBaseRel;
+
+/* What the query of a delta term returns, see ivm_delta_term() */
+typedef enum IvmTermKind
+{
+	IVM_TERM_ROWS,				/* the view's rows, and signs */
+	IVM_TERM_KEYS,				/* the grouping keys */
+	IVM_TERM_AGGARGS			/* grouping keys, aggregate arguments, signs */
+} IvmTermKind;
+
+/* Kinds of aggregates whose changes can be applied to the stored result */
+typedef enum IvmAggKind
+{
+	IVM_AGG_COUNT_STAR,
+	IVM_AGG_COUNT,
+	IVM_AGG_SUM,
+	IVM_AGG_AVG
+} IvmAggKind;
+
+/* An aggregate column of a matview maintained by ivm_apply_aggs() */
+typedef struct IvmAggColumn
+{
+	AttrNumber	attnum;			/* column of the matview */
+	IvmAggKind	kind;
+	Expr	   *arg;			/* argument of the aggregate, or NULL */
+	int			countidx;		/* for sum and avg, the position of the
+								 * count of the non-null values of arg */
+	int			sumidx;			/* for avg, the position of the sum of arg */
+} IvmAggColumn;
+
 static int	matview_maintenance_depth = 0;
 
 static void transientrel_startup(DestReceiver *self, int operation, TupleDesc typeinfo);
@@ -74,6 +138,34 @@ static bool is_usable_unique_index(Relation indexRel);
 static void OpenMatViewIncrementalMaintenance(void);
 static void CloseMatViewIncrementalMaintenance(void);
 
+static void check_ivm_query(Query *query);
+static void create_ivm_logs(Relation matviewRel, Query *query);
+static Oid	create_ivm_log(Relation matviewRel, Oid relid, Bitmapset *attnums);
+static void create_ivm_triggers(Oid matviewOid, Oid relid, Oid logoid);
+static void ivm_log_tuplestore(Relation logRel, Relation baseRel,
+							   Tuplestorestate *tuplestore, int16 sign);
+static Oid	ivm_find_log(Oid relid, Oid matviewOid);
+static char *ivm_log_name(Oid logoid);
+static void ivm_clear_log(Oid logoid, Snapshot snapshot);
+static bool refresh_by_ivm(Relation matviewRel, Query *query,
+						   uint64 *processed);
+static Query *ivm_delta_term(Query *query, List *changed, uint32 mask,
+							 IvmTermKind kind, List *aggs);
+static void ivm_replace_with_log(RangeTblEntry *rte, IvmBaseRel *baserel);
+static SPIPlanPtr ivm_prepare(const char *sql, int nargs, Oid *argtypes);
+static Portal ivm_cursor_open(SPIPlanPtr plan, Snapshot snapshot);
+static void ivm_append_term_sign(StringInfo buf, List *changed, uint32 mask);
+static uint64 ivm_apply_delta(Relation matviewRel, Query *query,
+							  List *changed, Snapshot snapshot);
+static List *ivm_direct_aggs(Query *query);
+static bool ivm_expr_is_not_null(Query *query, Expr *expr);
+static uint64 ivm_apply_aggs(Relation matviewRel, Query *query,
+							 List *changed, List *aggs, Snapshot snapshot);
+static uint64 ivm_apply_grouped(Relation matviewRel, Query *query,
+								List *changed, Snapshot snapshot);
+static void ivm_append_match_conds(StringInfo buf, Relation matviewRel,
+								   List *attnums, List *eqops);
+
 /*
  * SetMatViewPopulatedState
  *		Mark a materialized view as populated, or not.
@@ -154,6 +246,7 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 	Oid			save_userid;
 	int			save_sec_context;
 	int			save_nestlevel;
+	bool		pushed_snapshot = false;
 	ObjectAddress address;
 
 	/* Determine strength of lock needed. */
@@ -226,6 +319,56 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 			 "the rule for materialized view \"%s\" is not a single action",
 			 RelationGetRelationName(matviewRel));
 
+	/*
+	 * The stored query was rewritten at the time of the MV definition, but
+	 * has not been scribbled on by the planner.
+	 */
+	dataQuery = linitial_node(Query, actions);
+
+	/*
+	 * A populated incrementally maintained matview is brought up to date by
+	 * applying the changes logged since the last refresh, unless a table was
+	 * truncated or too many of them changed.  This doesn't block readers
+	 * beyond what the requested lock level does, so CONCURRENTLY needs no
+	 * unique index here.
+	 */
+	if (!stmt->skipData && RelationIsPopulated(matviewRel) &&
+		RelationIsIncrementallyMaintained(matviewRel) &&
+		GetMatViewChangeLogs(matviewOid) != NIL)
+	{
+		int			old_depth = matview_maintenance_depth;
+		bool		done;
+
+		PG_TRY();
+		{
+			done = refresh_by_ivm(matviewRel, dataQuery, &processed);
+		}
+		PG_CATCH();
+		{
+			matview_maintenance_depth = old_depth;
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+		Assert(matview_maintenance_depth == old_depth);
+
+		if (done)
+		{
+			table_close(matviewRel, NoLock);
+
+			/* Roll back any GUC changes */
+			AtEOXact_GUC(false, save_nestlevel);
+
+			/* Restore userid and security context */
+			SetUserIdAndSecContext(save_userid, save_sec_context);
+
+			ObjectAddressSet(address, RelationRelationId, matviewOid);
+			if (qc)
+				SetQueryCompletion(qc, CMDTAG_REFRESH_MATERIALIZED_VIEW,
+								   processed);
+			return address;
+		}
+	}
+
 	/*
 	 * Check that there is a unique index with no WHERE clause on one or more
 	 * columns of the materialized view if CONCURRENTLY is specified.
@@ -259,12 +402,6 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 					 errhint("Create a unique index with no WHERE clause on one or more columns of the materialized view.")));
 	}
 
-	/*
-	 * The stored query was rewritten at the time of the MV definition, but
-	 * has not been scribbled on by the planner.
-	 */
-	dataQuery = linitial_node(Query, actions);
-
 	/*
 	 * Check for active uses of the relation in the current transaction, such
 	 * as open scans.
@@ -303,10 +440,60 @@ ExecRefreshMatView(RefreshMatViewStmt *stmt, const char *queryString,
 	LockRelationOid(OIDNewHeap, AccessExclusiveLock);
 	dest = CreateTransientRelDestReceiver(OIDNewHeap);
 
+	/*
+	 * An incrementally maintained matview has no change logs after
+	 * pg_upgrade, so create them now.  As in CREATE MATERIALIZED VIEW, the
+	 * data must then be generated with a snapshot taken after the logging
+	 * triggers are in place.
+	 *
+	 * Even if the logs exist, the data must be generated with a snapshot
+	 * taken after we locked the matview, and the logs cleared with the same
+	 * snapshot.  The caller's snapshot may predate a concurrent incremental
+	 * refresh that consumed log entries our snapshot can't see, and those
+	 * changes would be lost.  That can't be done if the transaction snapshot
+	 * can't be refreshed.
+	 */
+	if (RelationIsIncrementallyMaintained(matviewRel) && !stmt->skipData)
+	{
+		bool		create_logs = (GetMatViewChangeLogs(matviewOid) == NIL);
+
+		if (IsolationUsesXactSnapshot())
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot refresh materialized view \"%s\" in a REPEATABLE READ or SERIALIZABLE transaction",
+							RelationGetRelationName(matviewRel)),
+					 create_logs ?
+					 errdetail("Its change logs have to be created first.") :
+					 errdetail("It has to be recomputed with a snapshot taken after it is locked.")));
+
+		if (create_logs)
+			create_ivm_logs(matviewRel, dataQuery);
+		PushActiveSnapshot(GetTransactionSnapshot());
+		pushed_snapshot = true;
+	}
+	else if (RelationIsIncrementallyMaintained(matviewRel) &&
+			 GetMatViewChangeLogs(matviewOid) == NIL)
+		create_ivm_logs(matviewRel, dataQuery);
+
 	/* Generate the data, if wanted. */
 	if (!stmt->skipData)
 		processed = refresh_matview_datafill(dest, dataQuery, queryString);
 
+	/*
+	 * The new contents reflect all changes visible to our snapshot, so drop
+	 * those from the change logs.
+	 */
+	if (RelationIsIncrementallyMaintained(matviewRel))
+	{
+		ListCell   *lc;
+
+		foreach(lc, GetMatViewChangeLogs(matviewOid))
+			ivm_clear_log(lfirst_oid(lc), GetActiveSnapshot());
+	}
+
+	if (pushed_snapshot)
+		PopActiveSnapshot();
+
 	/* Make the matview match the newly generated data. */
 	if (concurrent)
 	{
@@ -934,3 +1121,1881 @@ CloseMatViewIncrementalMaintenance(void)
 	matview_maintenance_depth--;
 	Assert(matview_maintenance_depth >= 0);
 }
+
+
+/*
+ * Incremental maintenance
+ *
+ * A materialized view created WITH (incremental = true) gets a change log
+ * for each table it references: a heap owned by the view, named
+ * pg_ivmlog_<view OID>_<table OID>, that holds a copy of the referenced
+ * columns of every row inserted into (sign +1) or deleted from (sign -1) the
+ * table.  Column "aN" of the log holds the table's attribute number N.  The
+ * logs are filled by statement-level AFTER triggers reading the statement's
+ * transition tables, so the cost to writers is one insertion per changed row.
+ * TRUNCATE just logs a row of sign 0, which forces the next refresh to
+ * recompute the view.
+ *
+ * REFRESH then computes the change in the view's result from the logs and
+ * applies it to the stored contents.  For a join of relations R1..Rn, with
+ * post-change contents Ri' and logged changes dRi, the view's delta is the
+ * sum over all nonempty subsets T of the changed relations of
+ * (-1)^(|T|+1) * V(dRi for i in T, Ri' for the rest), where the sign of each
+ * result row is the product of the signs of the log rows it was formed from.
+ * Each term is the view's own query with some of its base relations replaced
+ * by their logs, so the planner can use the base tables' indexes and the
+ * cost is proportional to the size of the changes.  For views without
+ * aggregation, the summed delta is applied by inserting or deleting rows.
+ * For aggregate views made of count, and of sum and avg of integers, the
+ * terms are aggregated per group into the changes of the aggregates, which
+ * are added to the stored values.  That needs count(*) to find out when a
+ * group becomes empty, and a count of the non-null values of each sum or avg
+ * argument, to find out when its result becomes null.  For other aggregate
+ * views, the terms only yield the grouping keys that may have changed, and
+ * each such group is recomputed from the base tables.
+ *
+ * All the queries of a refresh, and the removal of the consumed log entries,
+ * use the same snapshot.  A writer's log entries become visible along with
+ * its changes, so whatever is committed after that snapshot is left in the
+ * logs for the next refresh, and writers needn't be blocked.
+ */
+
+/*
+ * Report an unsupported construct in the query of an incremental matview.
+ */
+#define ivm_unsupported(what) \
+	ereport(ERROR, \
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED), \
+			 errmsg("%s is not supported in incrementally maintained materialized views", \
+					(what))))
+
+/*
+ * Check that a query is one REFRESH knows how to maintain incrementally:
+ * inner joins of plain tables, with projections, restrictions and optionally
+ * aggregation.
+ */
+static void
+check_ivm_query(Query *query)
+{
+	ListCell   *lc;
+	int			nbaserels = 0;
+	int			ncolumns = 0;
+
+	if (query->cteList != NIL)
+		ivm_unsupported("WITH");
+	if (query->hasSubLinks)
+		ivm_unsupported("subquery");
+	if (query->hasWindowFuncs)
+		ivm_unsupported("window function");
+	if (query->hasTargetSRFs)
+		ivm_unsupported("set-returning function");
+	if (query->setOperations != NULL)
+		ivm_unsupported("UNION/INTERSECT/EXCEPT");
+	if (query->distinctClause != NIL)
+		ivm_unsupported("DISTINCT");
+	if (query->limitCount != NULL || query->limitOffset != NULL)
+		ivm_unsupported("LIMIT/OFFSET");
+	if (query->groupingSets != NIL)
+		ivm_unsupported("GROUPING SETS");
+
+	/*
+	 * The delta of the view is computed from the current contents of the
+	 * tables, so expressions must give the same results when reevaluated.
+	 */
+	if (contain_mutable_functions((Node *) query))
+		ivm_unsupported("mutable function");
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+		int			col;
+
+		switch (rte->rtekind)
+		{
+			case RTE_RELATION:
+				if (rte->relkind != RELKIND_RELATION)
+					ereport(ERROR,
+							(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+							 errmsg("incrementally maintained materialized views can only reference plain tables"),
+							 errdetail("\"%s\" is not a plain table.",
+									   get_rel_name(rte->relid))));
+				if (rte->tablesample != NULL)
+					ivm_unsupported("TABLESAMPLE");
+				if (rte->inh && has_subclass(rte->relid))
+					ivm_unsupported("table with inheritance children");
+
+				col = -1;
+				while ((col = bms_next_member(rte->selectedCols, col)) >= 0)
+				{
+					if (col + FirstLowInvalidHeapAttributeNumber <= 0)
+						ivm_unsupported("system column or whole-row reference");
+				}
+				nbaserels++;
+				break;
+			case RTE_JOIN:
+				if (rte->jointype != JOIN_INNER)
+					ivm_unsupported("outer join");
+				break;
+			case RTE_SUBQUERY:
+				ivm_unsupported("subquery in FROM");
+				break;
+			case RTE_FUNCTION:
+			case RTE_TABLEFUNC:
+				ivm_unsupported("function in FROM");
+				break;
+			case RTE_VALUES:
+				ivm_unsupported("VALUES");
+				break;
+			default:
+				elog(ERROR, "unexpected rtekind: %d", (int) rte->rtekind);
+				break;
+		}
+	}
+
+	if (nbaserels == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("incrementally maintained materialized views must reference at least one table")));
+
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		Oid			typid = exprType((Node *) tle->expr);
+
+		if (tle->resjunk)
+			continue;
+		ncolumns++;
+
+		/*
+		 * Rows of non-aggregate views are matched on all their columns, and
+		 * the delta is summed by grouping on them.
+		 */
+		if (!query->hasAggs && query->groupClause == NIL)
+		{
+			TypeCacheEntry *typentry;
+
+			typentry = lookup_type_cache(typid,
+										 TYPECACHE_EQ_OPR | TYPECACHE_LT_OPR |
+										 TYPECACHE_HASH_PROC);
+			if (!OidIsValid(typentry->eq_opr) ||
+				(!OidIsValid(typentry->lt_opr) &&
+				 !OidIsValid(typentry->hash_proc)))
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("column \"%s\" of type %s cannot be used in an incrementally maintained materialized view",
+								tle->resname, format_type_be(typid)),
+						 errdetail("The type has no equality and ordering or hashing operators.")));
+		}
+	}
+
+	if (ncolumns == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("incrementally maintained materialized views must have at least one column")));
+
+	/* Groups are located by their keys, so the keys must be stored */
+	foreach(lc, query->groupClause)
+	{
+		SortGroupClause *sgc = lfirst_node(SortGroupClause, lc);
+		TargetEntry *tle = get_sortgroupclause_tle(sgc, query->targetList);
+
+		if (tle->resjunk)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("GROUP BY expressions of an incrementally maintained materialized view must appear in its select list")));
+	}
+}
+
+/*
+ * CreateMatViewChangeLogs
+ *
+ * Set up incremental maintenance of a newly created materialized view: check
+ * that its query is supported, and create the change log and triggers for
+ * each table it references.
+ */
+void
+CreateMatViewChangeLogs(Oid matviewOid, Query *query)
+{
+	Relation	matviewRel;
+
+	check_ivm_query(query);
+
+	/*
+	 * pg_upgrade doesn't carry the logs over, and couldn't assign their OIDs
+	 * anyway; the first REFRESH after the upgrade creates them.
+	 */
+	if (IsBinaryUpgrade)
+		return;
+
+	matviewRel = table_open(matviewOid, NoLock);
+	create_ivm_logs(matviewRel, query);
+	table_close(matviewRel, NoLock);
+}
+
+/*
+ * Create the change logs and triggers of a matview for all its tables.
+ */
+static void
+create_ivm_logs(Relation matviewRel, Query *query)
+{
+	Oid			matviewOid = RelationGetRelid(matviewRel);
+	List	   *relids = NIL;
+	ListCell   *lc;
+
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+
+		if (rte->rtekind == RTE_RELATION && rte->relid != matviewOid)
+			relids = list_append_unique_oid(relids, rte->relid);
+	}
+
+	foreach(lc, relids)
+	{
+		Oid			relid = lfirst_oid(lc);
+		Bitmapset  *attnums = NULL;
+		AclResult	aclresult;
+		ListCell   *lc2;
+		Oid			logoid;
+
+		/* Installing the triggers is up to those allowed to create them */
+		aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_TRIGGER);
+		if (aclresult != ACLCHECK_OK)
+			aclcheck_error(aclresult, OBJECT_TABLE, get_rel_name(relid));
+
+		/* Log the columns referenced by any use of the table */
+		foreach(lc2, query->rtable)
+		{
+			RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc2);
+			int			col = -1;
+
+			if (rte->rtekind != RTE_RELATION || rte->relid != relid)
+				continue;
+			while ((col = bms_next_member(rte->selectedCols, col)) >= 0)
+				attnums = bms_add_member(attnums,
+										 col + FirstLowInvalidHeapAttributeNumber);
+		}
+
+		logoid = create_ivm_log(matviewRel, relid, attnums);
+		create_ivm_triggers(matviewOid, relid, logoid);
+	}
+}
+
+/*
+ * Create the change log of a matview for one of its tables.
+ */
+static Oid
+create_ivm_log(Relation matviewRel, Oid relid, Bitmapset *attnums)
+{
+	Relation	baseRel;
+	TupleDesc	basedesc;
+	TupleDesc	tupdesc;
+	char		relname[NAMEDATALEN];
+	Oid			logoid;
+	ObjectAddress myself;
+	ObjectAddress referenced;
+	AttrNumber	logattno = 1;
+	int			attnum = -1;
+
+	baseRel = table_open(relid, AccessShareLock);
+	basedesc = RelationGetDescr(baseRel);
+
+	tupdesc = CreateTemplateTupleDesc(1 + bms_num_members(attnums));
+	TupleDescInitEntry(tupdesc, logattno++, IVM_SIGN_COLUMN, INT2OID, -1, 0);
+	while ((attnum = bms_next_member(attnums, attnum)) >= 0)
+	{
+		Form_pg_attribute attr = TupleDescAttr(basedesc, attnum - 1);
+		char		colname[NAMEDATALEN];
+
+		snprintf(colname, sizeof(colname), "a%d", attnum);
+		TupleDescInitEntry(tupdesc, logattno, colname,
+						   attr->atttypid, attr->atttypmod, attr->attndims);
+		TupleDescInitEntryCollation(tupdesc, logattno, attr->attcollation);
+		logattno++;
+	}
+
+	snprintf(relname, sizeof(relname), "pg_ivmlog_%u_%u",
+			 RelationGetRelid(matviewRel), relid);
+
+	logoid = heap_create_with_catalog(relname,
+									  RelationGetNamespace(matviewRel),
+									  matviewRel->rd_rel->reltablespace,
+									  InvalidOid,
+									  InvalidOid,
+									  InvalidOid,
+									  matviewRel->rd_rel->relowner,
+									  HEAP_TABLE_AM_OID,
+									  tupdesc,
+									  NIL,
+									  RELKIND_RELATION,
+									  matviewRel->rd_rel->relpersistence,
+									  false,
+									  false,
+									  ONCOMMIT_NOOP,
+									  (Datum) 0,
+									  false,
+									  true,
+									  true,
+									  InvalidOid,
+									  NULL);
+
+	/* The log is part of the matview, and goes away with it */
+	ObjectAddressSet(myself, RelationRelationId, logoid);
+	ObjectAddressSet(referenced, RelationRelationId,
+					 RelationGetRelid(matviewRel));
+	recordDependencyOn(&myself, &referenced, DEPENDENCY_INTERNAL);
+
+	/* NewRelationCreateToastTable ends with CommandCounterIncrement() */
+	CommandCounterIncrement();
+	NewRelationCreateToastTable(logoid, (Datum) 0);
+
+	table_close(baseRel, AccessShareLock);
+
+	return logoid;
+}
+
+/*
+ * Create the triggers filling the change log of a matview for one table.
+ *
+ * A trigger with transition tables can only handle one event, so there is
+ * one for each kind of change.  They fire even in replica mode, since the
+ * log must see every change made to the table.
+ */
+static void
+create_ivm_triggers(Oid matviewOid, Oid relid, Oid logoid)
+{
+	static const int16 events[] = {
+		TRIGGER_TYPE_INSERT, TRIGGER_TYPE_DELETE,
+		TRIGGER_TYPE_UPDATE, TRIGGER_TYPE_TRUNCATE
+	};
+	ObjectAddress mvaddr;
+	int			i;
+
+	ObjectAddressSet(mvaddr, RelationRelationId, matviewOid);
+
+	for (i = 0; i < lengthof(events); i++)
+	{
+		CreateTrigStmt *trigger = makeNode(CreateTrigStmt);
+		ObjectAddress trigaddr;
+
+		trigger->replace = false;
+		trigger->isconstraint = false;
+		trigger->trigname = "pg_ivm_log";
+		trigger->relation = NULL;
+		trigger->funcname = SystemFuncName("ivm_log_changes");
+		trigger->args = list_make2(makeString(psprintf("%u", matviewOid)),
+								   makeString(psprintf("%u", logoid)));
+		trigger->row = false;
+		trigger->timing = TRIGGER_TYPE_AFTER;
+		trigger->events = events[i];
+		trigger->columns = NIL;
+		trigger->whenClause = NULL;
+		trigger->transitionRels = NIL;
+		if (events[i] == TRIGGER_TYPE_DELETE || events[i] == TRIGGER_TYPE_UPDATE)
+		{
+			TriggerTransition *tt = makeNode(TriggerTransition);
+
+			tt->name = "pg_ivm_old";
+			tt->isNew = false;
+			tt->isTable = true;
+			trigger->transitionRels = lappend(trigger->transitionRels, tt);
+		}
+		if (events[i] == TRIGGER_TYPE_INSERT || events[i] == TRIGGER_TYPE_UPDATE)
+		{
+			TriggerTransition *tt = makeNode(TriggerTransition);
+
+			tt->name = "pg_ivm_new";
+			tt->isNew = true;
+			tt->isTable = true;
+			trigger->transitionRels = lappend(trigger->transitionRels, tt);
+		}
+		trigger->deferrable = false;
+		trigger->initdeferred = false;
+		trigger->constrrel = NULL;
+
+		trigaddr = CreateTriggerFiringOn(trigger, NULL, relid, InvalidOid,
+										 InvalidOid, InvalidOid,
+										 F_IVM_LOG_CHANGES, InvalidOid, NULL,
+										 true, false, TRIGGER_FIRES_ALWAYS);
+
+		/* Don't let the trigger be dropped on its own */
+		recordDependencyOn(&trigaddr, &mvaddr, DEPENDENCY_INTERNAL);
+	}
+
+	CommandCounterIncrement();
+}
+
+/*
+ * ivm_log_changes
+ *
+ * Trigger function copying the rows changed by a statement into the change
+ * log of an incrementally maintained materialized view.  The arguments are
+ * the OIDs of the matview and of the log.
+ */
+Datum
+ivm_log_changes(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	Trigger    *trigger;
+	Relation	logRel;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "ivm_log_changes: not fired by trigger manager");
+	if (!TRIGGER_FIRED_AFTER(trigdata->tg_event) ||
+		!TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event))
+		elog(ERROR, "ivm_log_changes: must be fired after statement");
+
+	trigger = trigdata->tg_trigger;
+	if (trigger->tgnargs != 2)
+		elog(ERROR, "ivm_log_changes: wrong number of arguments");
+
+	logRel = table_open(atooid(trigger->tgargs[1]), RowExclusiveLock);
+
+	if (TRIGGER_FIRED_BY_TRUNCATE(trigdata->tg_event))
+	{
+		TupleDesc	logdesc = RelationGetDescr(logRel);
+		Datum	   *values = (Datum *) palloc0(logdesc->natts * sizeof(Datum));
+		bool	   *nulls = (bool *) palloc(logdesc->natts * sizeof(bool));
+		HeapTuple	tuple;
+
+		/* A row of sign 0 tells REFRESH to recompute the view */
+		memset(nulls, true, logdesc->natts * sizeof(bool));
+		values[0] = Int16GetDatum(0);
+		nulls[0] = false;
+		tuple = heap_form_tuple(logdesc, values, nulls);
+		simple_heap_insert(logRel, tuple);
+		heap_freetuple(tuple);
+	}
+	else
+	{
+		if (trigdata->tg_oldtable)
+			ivm_log_tuplestore(logRel, trigdata->tg_relation,
+							   trigdata->tg_oldtable, -1);
+		if (trigdata->tg_newtable)
+			ivm_log_tuplestore(logRel, trigdata->tg_relation,
+							   trigdata->tg_newtable, 1);
+	}
+
+	table_close(logRel, NoLock);
+
+	return PointerGetDatum(NULL);
+}
+
+/*
+ * Append the rows of a transition table to a change log, with the given
+ * sign.
+ */
+static void
+ivm_log_tuplestore(Relation logRel, Relation baseRel,
+				   Tuplestorestate *tuplestore, int16 sign)
+{
+	TupleDesc	logdesc = RelationGetDescr(logRel);
+	AttrNumber *attmap;
+	Datum	   *values;
+	bool	   *nulls;
+	TupleTableSlot *slot;
+	BulkInsertState bistate;
+	CommandId	cid = GetCurrentCommandId(true);
+	int			readptr;
+	int			i;
+
+	/* Map the log's columns "aN" to the table's attribute numbers */
+	attmap = (AttrNumber *) palloc0(logdesc->natts * sizeof(AttrNumber));
+	for (i = 1; i < logdesc->natts; i++)
+		attmap[i] = atoi(NameStr(TupleDescAttr(logdesc, i)->attname) + 1);
+
+	values = (Datum *) palloc(logdesc->natts * sizeof(Datum));
+	nulls = (bool *) palloc(logdesc->natts * sizeof(bool));
+	values[0] = Int16GetDatum(sign);
+	nulls[0] = false;
+
+	slot = MakeSingleTupleTableSlot(RelationGetDescr(baseRel),
+									&TTSOpsMinimalTuple);
+	bistate = GetBulkInsertState();
+
+	/* Other triggers may read the same tuplestore, so use our own pointer */
+	readptr = tuplestore_alloc_read_pointer(tuplestore, EXEC_FLAG_REWIND);
+	tuplestore_select_read_pointer(tuplestore, readptr);
+	tuplestore_rescan(tuplestore);
+
+	while (tuplestore_gettupleslot(tuplestore, true, false, slot))
+	{
+		HeapTuple	tuple;
+
+		slot_getallattrs(slot);
+		for (i = 1; i < logdesc->natts; i++)
+		{
+			values[i] = slot->tts_values[attmap[i] - 1];
+			nulls[i] = slot->tts_isnull[attmap[i] - 1];
+		}
+
+		/* heap_insert() copies out-of-line values into the log's TOAST */
+		tuple = heap_form_tuple(logdesc, values, nulls);
+		heap_insert(logRel, tuple, cid, 0, bistate);
+		heap_freetuple(tuple);
+	}
+
+	FreeBulkInsertState(bistate);
+	ExecDropSingleTupleTableSlot(slot);
+}
+
+/*
+ * GetMatViewChangeLogs
+ *
+ * Return the OIDs of the change logs of an incrementally maintained
+ * materialized view.
+ */
+List *
+GetMatViewChangeLogs(Oid matviewOid)
+{
+	Relation	depRel;
+	ScanKeyData key[2];
+	SysScanDesc scan;
+	HeapTuple	tup;
+	List	   *result = NIL;
+
+	depRel = table_open(DependRelationId, AccessShareLock);
+
+	ScanKeyInit(&key[0],
+				Anum_pg_depend_refclassid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(RelationRelationId));
+	ScanKeyInit(&key[1],
+				Anum_pg_depend_refobjid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(matviewOid));
+
+	scan = systable_beginscan(depRel, DependReferenceIndexId, true,
+							  NULL, 2, key);
+
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_depend depForm = (Form_pg_depend) GETSTRUCT(tup);
+
+		/* The TOAST table is internally dependent, too, so check relkind */
+		if (depForm->classid == RelationRelationId &&
+			depForm->objsubid == 0 &&
+			depForm->refobjsubid == 0 &&
+			depForm->deptype == DEPENDENCY_INTERNAL &&
+			get_rel_relkind(depForm->objid) == RELKIND_RELATION)
+			result = lappend_oid(result, depForm->objid);
+	}
+
+	systable_endscan(scan);
+	table_close(depRel, AccessShareLock);
+
+	return result;
+}
+
+/*
+ * Find the change log of a matview for one of its tables, by way of the
+ * arguments of the table's logging triggers.
+ */
+static Oid
+ivm_find_log(Oid relid, Oid matviewOid)
+{
+	Relation	rel = table_open(relid, NoLock);
+	TriggerDesc *trigdesc = rel->trigdesc;
+	Oid			logoid = InvalidOid;
+	int			i;
+
+	for (i = 0; trigdesc != NULL && i < trigdesc->numtriggers; i++)
+	{
+		Trigger    *trigger = &trigdesc->triggers[i];
+
+		if (trigger->tgfoid == F_IVM_LOG_CHANGES &&
+			trigger->tgnargs == 2 &&
+			atooid(trigger->tgargs[0]) == matviewOid)
+		{
+			logoid = atooid(trigger->tgargs[1]);
+			break;
+		}
+	}
+
+	if (!OidIsValid(logoid))
+		elog(ERROR, "could not find change log of table \"%s\" for materialized view %u",
+			 RelationGetRelationName(rel), matviewOid);
+
+	table_close(rel, NoLock);
+
+	return logoid;
+}
+
+static char *
+ivm_log_name(Oid logoid)
+{
+	return quote_qualified_identifier(get_namespace_name(get_rel_namespace(logoid)),
+									  get_rel_name(logoid));
+}
+
+/*
+ * Remove the changes visible to the given snapshot from a change log.
+ *
+ * Changes committed later are kept for the next refresh.
+ */
+static void
+ivm_clear_log(Oid logoid, Snapshot snapshot)
+{
+	Relation	logRel;
+	TableScanDesc scan;
+	TupleTableSlot *slot;
+
+	logRel = table_open(logoid, RowExclusiveLock);
+	slot = table_slot_create(logRel, NULL);
+	scan = table_beginscan(logRel, snapshot, 0, NULL);
+
+	while (table_scan_getnextslot(scan, ForwardScanDirection, slot))
+		simple_table_tuple_delete(logRel, &slot->tts_tid, snapshot);
+
+	table_endscan(scan);
+	ExecDropSingleTupleTableSlot(slot);
+	table_close(logRel, NoLock);
+}
+
+/*
+ * refresh_by_ivm
+ *
+ * Bring an incrementally maintained matview up to date by applying the
+ * changes logged for its tables.  Returns false, without having changed
+ * anything, if the view has to be recomputed instead.  *processed is set to
+ * the number of rows inserted into the matview.
+ */
+static bool
+refresh_by_ivm(Relation matviewRel, Query *query, uint64 *processed)
+{
+	Oid			matviewOid = RelationGetRelid(matviewRel);
+	List	   *baserels = NIL;
+	List	   *changed = NIL;
+	List	   *changedlogs = NIL;
+	ListCell   *lc;
+	int			rtindex = 0;
+	StringInfoData querybuf;
+	Snapshot	snapshot;
+
+	*processed = 0;
+
+	/*
+	 * Writers aren't blocked, see the notes above; the lock only keeps the
+	 * definitions and logging triggers of the tables in place.
+	 */
+	foreach(lc, query->rtable)
+	{
+		RangeTblEntry *rte = lfirst_node(RangeTblEntry, lc);
+		IvmBaseRel *baserel;
+
+		rtindex++;
+		if (rte->rtekind != RTE_RELATION || rte->relid == matviewOid)
+			continue;
+
+		LockRelationOid(rte->relid, AccessShareLock);
+
+		/* The logs don't cover children added since the view was created */
+		if (rte->inh && has_subclass(rte->relid))
+			return false;
+
+		baserel = (IvmBaseRel *) palloc0(sizeof(IvmBaseRel));
+		baserel->rtindex = rtindex;
+		baserel->relid = rte->relid;
+		baserel->logoid = ivm_find_log(rte->relid, matviewOid);
+		baserels = lappend(baserels, baserel);
+	}
+
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+
+	/* Taken after the caller has locked the matview against other refreshes */
+	snapshot = RegisterSnapshot(GetTransactionSnapshot());
+
+	/*
+	 * Find out which logs contain changes, and whether any of the tables was
+	 * truncated.
+	 */
+	initStringInfo(&querybuf);
+	foreach(lc, baserels)
+	{
+		IvmBaseRel *baserel = (IvmBaseRel *) lfirst(lc);
+		bool		isnull;
+		Datum		truncated;
+
+		resetStringInfo(&querybuf);
+		appendStringInfo(&querybuf,
+						 "SELECT pg_catalog.bool_or(%s OPERATOR(pg_catalog.=) 0) FROM %s",
+						 IVM_SIGN_COLUMN, ivm_log_name(baserel->logoid));
+		if (SPI_execute_snapshot(ivm_prepare(querybuf.data, 0, NULL),
+								 NULL, NULL, snapshot, InvalidSnapshot,
+								 true, false, 0) != SPI_OK_SELECT ||
+			SPI_processed != 1)
+			elog(ERROR, "SPI_exec failed: %s", querybuf.data);
+
+		truncated = SPI_getbinval(SPI_tuptable->vals[0],
+								  SPI_tuptable->tupdesc, 1, &isnull);
+		if (!isnull && DatumGetBool(truncated))
+		{
+			UnregisterSnapshot(snapshot);
+			SPI_finish();
+			return false;
+		}
+
+		if (!isnull)
+		{
+			baserel->changed = true;
+			changed = lappend(changed, baserel);
+			changedlogs = list_append_unique_oid(changedlogs, baserel->logoid);
+		}
+	}
+
+	if (list_length(changed) > IVM_MAX_CHANGED_RELS)
+	{
+		UnregisterSnapshot(snapshot);
+		SPI_finish();
+		return false;
+	}
+
+	if (changed != NIL)
+	{
+		OpenMatViewIncrementalMaintenance();
+		if (query->hasAggs || query->groupClause != NIL)
+		{
+			List	   *aggs = ivm_direct_aggs(query);
+
+			if (aggs != NIL)
+				*processed = ivm_apply_aggs(matviewRel, query, changed,
+											aggs, snapshot);
+			else
+				*processed = ivm_apply_grouped(matviewRel, query, changed,
+											   snapshot);
+		}
+		else
+			*processed = ivm_apply_delta(matviewRel, query, changed,
+										 snapshot);
+		CloseMatViewIncrementalMaintenance();
+	}
+
+	if (SPI_finish() != SPI_OK_FINISH)
+		elog(ERROR, "SPI_finish failed");
+
+	/* The changes have been applied, so consume them */
+	foreach(lc, changedlogs)
+		ivm_clear_log(lfirst_oid(lc), snapshot);
+	UnregisterSnapshot(snapshot);
+
+	return true;
+}
+
+/*
+ * Build the query computing one term of the view's delta.
+ *
+ * The members of "changed" selected by the bits of "mask" are replaced by
+ * their logs.  Depending on "kind", the result returns:
+ *
+ * IVM_TERM_ROWS: the view's columns followed by the sign columns of those
+ * logs, named __ivm_c<n> and __ivm_s<n>.
+ *
+ * IVM_TERM_KEYS: the distinct grouping keys of the view, named __ivm_k<n>,
+ * without aggregation.
+ *
+ * IVM_TERM_AGGARGS: the grouping keys, the arguments of the members of
+ * "aggs" that have one, named __ivm_a<n> after their position in "aggs", and
+ * the sign columns, for each row that the view would aggregate.
+ */
+static Query *
+ivm_delta_term(Query *query, List *changed, uint32 mask, IvmTermKind kind,
+			   List *aggs)
+{
+	Query	   *term = copyObject(query);
+	List	   *tlist = NIL;
+	AttrNumber	resno = 1;
+	ListCell   *lc;
+	int			i = 0;
+
+	term->sortClause = NIL;
+	if (kind != IVM_TERM_ROWS)
+	{
+		term->hasAggs = false;
+		term->havingQual = NULL;
+	}
+
+	foreach(lc, term->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+
+		if (tle->resjunk)
+			continue;
+		if (kind != IVM_TERM_ROWS)
+		{
+			if (tle->ressortgroupref == 0 ||
+				get_sortgroupref_clause_noerr(tle->ressortgroupref,
+											  term->groupClause) == NULL)
+				continue;
+			tle->resname = psprintf("__ivm_k%d", resno);
+		}
+		else
+			tle->resname = psprintf("__ivm_c%d", resno);
+		tle->resno = resno++;
+		tlist = lappend(tlist, tle);
+	}
+
+	if (kind == IVM_TERM_AGGARGS)
+	{
+		/* The rows are aggregated by the caller */
+		foreach(lc, tlist)
+			lfirst_node(TargetEntry, lc)->ressortgroupref = 0;
+		term->groupClause = NIL;
+
+		foreach(lc, aggs)
+		{
+			IvmAggColumn *agg = (IvmAggColumn *) lfirst(lc);
+
+			if (agg->kind != IVM_AGG_COUNT && agg->kind != IVM_AGG_SUM)
+				continue;
+			tlist = lappend(tlist,
+							makeTargetEntry(copyObject(agg->arg), resno++,
+											psprintf("__ivm_a%d",
+													 foreach_current_index(lc) + 1),
+											false));
+		}
+	}
+
+	foreach(lc, changed)
+	{
+		IvmBaseRel *baserel = (IvmBaseRel *) lfirst(lc);
+		RangeTblEntry *rte;
+
+		if ((mask & (1 << i++)) == 0)
+			continue;
+
+		rte = rt_fetch(baserel->rtindex, term->rtable);
+		ivm_replace_with_log(rte, baserel);
+
+		if (kind != IVM_TERM_KEYS)
+		{
+			Var		   *signvar;
+
+			/* The sign column is the last column of the log subquery */
+			signvar = makeVar(baserel->rtindex,
+							  list_length(rte->eref->colnames),
+							  INT2OID, -1, InvalidOid, 0);
+			tlist = lappend(tlist,
+							makeTargetEntry((Expr *) signvar, resno,
+											psprintf("__ivm_s%d", i),
+											false));
+			resno++;
+		}
+	}
+
+	term->targetList = tlist;
+
+	return term;
+}
+
+/*
+ * Turn a base relation reference into a subquery reading the table's change
+ * log.  The subquery has the same columns as the table, in the same order,
+ * followed by the sign; columns that aren't logged are returned as nulls,
+ * since the view's query doesn't use them.
+ */
+static void
+ivm_replace_with_log(RangeTblEntry *rte, IvmBaseRel *baserel)
+{
+	Relation	baseRel;
+	TupleDesc	basedesc;
+	StringInfoData sql;
+	List	   *colnames = NIL;
+	RawStmt    *rawstmt;
+	int			i;
+
+	baseRel = table_open(baserel->relid, NoLock);
+	basedesc = RelationGetDescr(baseRel);
+
+	initStringInfo(&sql);
+	appendStringInfoString(&sql, "SELECT ");
+	for (i = 0; i < basedesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(basedesc, i);
+		char		logcol[NAMEDATALEN];
+
+		snprintf(logcol, sizeof(logcol), "a%d", attr->attnum);
+		if (attr->attisdropped)
+		{
+			/* ruleutils.c treats an empty column name as a dropped column */
+			appendStringInfo(&sql, "NULL AS \"?dropped?%d\", ", attr->attnum);
+			colnames = lappend(colnames, makeString(pstrdup("")));
+			continue;
+		}
+
+		if (get_attnum(baserel->logoid, logcol) != InvalidAttrNumber)
+			appendStringInfo(&sql, "%s AS %s, ", logcol,
+							 quote_identifier(NameStr(attr->attname)));
+		else
+			appendStringInfo(&sql, "NULL AS %s, ",
+							 quote_identifier(NameStr(attr->attname)));
+		colnames = lappend(colnames,
+						   makeString(pstrdup(NameStr(attr->attname))));
+	}
+	appendStringInfo(&sql, "%s FROM %s",
+					 IVM_SIGN_COLUMN, ivm_log_name(baserel->logoid));
+	colnames = lappend(colnames, makeString(IVM_SIGN_COLUMN));
+
+	table_close(baseRel, NoLock);
+
+	rawstmt = linitial_node(RawStmt, pg_parse_query(sql.data));
+
+	rte->rtekind = RTE_SUBQUERY;
+	rte->subquery = parse_analyze_fixedparams(rawstmt, sql.data,
+											  NULL, 0, NULL);
+	rte->security_barrier = false;
+	rte->relid = InvalidOid;
+	rte->relkind = 0;
+	rte->rellockmode = 0;
+	rte->tablesample = NULL;
+	rte->inh = false;
+	rte->requiredPerms = 0;
+	rte->checkAsUser = InvalidOid;
+	rte->selectedCols = NULL;
+	rte->insertedCols = NULL;
+	rte->updatedCols = NULL;
+	rte->extraUpdatedCols = NULL;
+	if (rte->alias == NULL)
+		rte->alias = makeAlias(rte->eref->aliasname, NIL);
+	rte->eref = makeAlias(rte->eref->aliasname, colnames);
+}
+
+/*
+ * Prepare a query of incremental maintenance.
+ */
+static SPIPlanPtr
+ivm_prepare(const char *sql, int nargs, Oid *argtypes)
+{
+	SPIPlanPtr	plan = SPI_prepare(sql, nargs, argtypes);
+
+	if (plan == NULL)
+		elog(ERROR, "SPI_prepare returned %s for %s",
+			 SPI_result_code_string(SPI_result), sql);
+
+	return plan;
+}
+
+/*
+ * Open a cursor reading the tables and logs as of the given snapshot.
+ */
+static Portal
+ivm_cursor_open(SPIPlanPtr plan, Snapshot snapshot)
+{
+	Portal		portal;
+
+	/* A read-only cursor uses the active snapshot */
+	PushActiveSnapshot(snapshot);
+	portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+	PopActiveSnapshot();
+
+	return portal;
+}
+
+/*
+ * Append the sign of the rows of a delta term, named __ivm_s: a term over k
+ * logs has sign (-1)^(k+1), times the signs of the log rows each of its rows
+ * was formed from.
+ */
+static void
+ivm_append_term_sign(StringInfo buf, List *changed, uint32 mask)
+{
+	int			nterm = 0;
+	int			j;
+
+	for (j = 0; j < list_length(changed); j++)
+		if (mask & (1 << j))
+			nterm++;
+	appendStringInfo(buf, "(%d::pg_catalog.int8",
+					 (nterm % 2 == 1) ? 1 : -1);
+	for (j = 0; j < list_length(changed); j++)
+		if (mask & (1 << j))
+			appendStringInfo(buf, " OPERATOR(pg_catalog.*) __ivm_s%d", j + 1);
+	appendStringInfoString(buf, ") AS __ivm_s");
+}
+
+/*
+ * Apply the delta of a view without aggregation.
+ *
+ * The terms of the delta are summed per distinct row, and each row with a
+ * nonzero count is inserted into, or deleted from, the matview that many
+ * times.
+ */
+static uint64
+ivm_apply_delta(Relation matviewRel, Query *query, List *changed,
+				Snapshot snapshot)
+{
+	TupleDesc	tupdesc = RelationGetDescr(matviewRel);
+	int			natts = tupdesc->natts;
+	char	   *matviewname;
+	StringInfoData querybuf;
+	Oid		   *argtypes;
+	Datum	   *values;
+	char	   *nulls;
+	List	   *attnums = NIL;
+	List	   *eqops = NIL;
+	SPIPlanPtr	deltaplan;
+	SPIPlanPtr	insplan;
+	SPIPlanPtr	delplan;
+	Portal		portal;
+	uint32		mask;
+	uint64		processed = 0;
+	int			i;
+
+	matviewname = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(matviewRel)),
+											 RelationGetRelationName(matviewRel));
+
+	initStringInfo(&querybuf);
+	appendStringInfoString(&querybuf, "SELECT ");
+	for (i = 1; i <= natts; i++)
+		appendStringInfo(&querybuf, "__ivm_c%d, ", i);
+	appendStringInfoString(&querybuf,
+						   "pg_catalog.sum(__ivm_s)::pg_catalog.int8 FROM (");
+
+	for (mask = 1; mask < (1 << list_length(changed)); mask++)
+	{
+		Query	   *term = ivm_delta_term(query, changed, mask,
+										  IVM_TERM_ROWS, NIL);
+
+		if (mask > 1)
+			appendStringInfoString(&querybuf, " UNION ALL ");
+		appendStringInfoString(&querybuf, "SELECT ");
+		for (i = 1; i <= natts; i++)
+			appendStringInfo(&querybuf, "__ivm_c%d, ", i);
+		ivm_append_term_sign(&querybuf, changed, mask);
+		appendStringInfo(&querybuf, " FROM (%s) t",
+						 pg_get_querydef(term, false));
+	}
+
+	appendStringInfoString(&querybuf, ") d GROUP BY ");
+	for (i = 1; i <= natts; i++)
+		appendStringInfo(&querybuf, "%s%d", i > 1 ? ", " : "", i);
+	appendStringInfoString(&querybuf,
+						   " HAVING pg_catalog.sum(__ivm_s) OPERATOR(pg_catalog.<>) 0");
+
+	deltaplan = ivm_prepare(querybuf.data, 0, NULL);
+
+	/* Statements inserting and deleting $n+1 copies of a row */
+	argtypes = (Oid *) palloc((natts + 1) * sizeof(Oid));
+	for (i = 0; i < natts; i++)
+	{
+		Oid			typid = TupleDescAttr(tupdesc, i)->atttypid;
+
+		argtypes[i] = typid;
+		attnums = lappend_int(attnums, i + 1);
+		eqops = lappend_oid(eqops,
+							lookup_type_cache(typid, TYPECACHE_EQ_OPR)->eq_opr);
+	}
+	argtypes[natts] = INT8OID;
+
+	resetStringInfo(&querybuf);
+	appendStringInfo(&querybuf, "INSERT INTO %s SELECT ", matviewname);
+	for (i = 1; i <= natts; i++)
+		appendStringInfo(&querybuf, "%s$%d", i > 1 ? ", " : "", i);
+	appendStringInfo(&querybuf,
+					 " FROM pg_catalog.generate_series(1, $%d)", natts + 1);
+	insplan = ivm_prepare(querybuf.data, natts + 1, argtypes);
+
+	resetStringInfo(&querybuf);
+	appendStringInfo(&querybuf,
+					 "DELETE FROM %s WHERE ctid OPERATOR(pg_catalog.=) ANY "
+					 "(ARRAY(SELECT mv.ctid FROM %s mv WHERE ",
+					 matviewname, matviewname);
+	ivm_append_match_conds(&querybuf, matviewRel, attnums, eqops);
+	appendStringInfo(&querybuf, " LIMIT $%d))", natts + 1);
+	delplan = ivm_prepare(querybuf.data, natts + 1, argtypes);
+
+	values = (Datum *) palloc((natts + 1) * sizeof(Datum));
+	nulls = (char *) palloc((natts + 1) * sizeof(char));
+	nulls[natts] = ' ';
+
+	portal = ivm_cursor_open(deltaplan, snapshot);
+	for (;;)
+	{
+		SPITupleTable *tuptable;
+		uint64		ntuples;
+		uint64		j;
+
+		SPI_cursor_fetch(portal, true, 1000);
+		if (SPI_processed == 0)
+			break;
+		tuptable = SPI_tuptable;
+		ntuples = SPI_processed;
+
+		for (j = 0; j < ntuples; j++)
+		{
+			HeapTuple	tuple = tuptable->vals[j];
+			int64		count;
+			bool		isnull;
+
+			for (i = 0; i < natts; i++)
+			{
+				values[i] = SPI_getbinval(tuple, tuptable->tupdesc, i + 1,
+										  &isnull);
+				nulls[i] = isnull ? 'n' : ' ';
+			}
+			count = DatumGetInt64(SPI_getbinval(tuple, tuptable->tupdesc,
+												natts + 1, &isnull));
+
+			if (count > 0)
+			{
+				values[natts] = Int64GetDatum(count);
+				if (SPI_execute_snapshot(insplan, values, nulls, snapshot,
+										 InvalidSnapshot, false, false,
+										 0) != SPI_OK_INSERT)
+					elog(ERROR, "SPI_execute_plan failed inserting into \"%s\"",
+						 RelationGetRelationName(matviewRel));
+				processed += SPI_processed;
+			}
+			else
+			{
+				values[natts] = Int64GetDatum(-count);
+				if (SPI_execute_snapshot(delplan, values, nulls, snapshot,
+										 InvalidSnapshot, false, false,
+										 0) != SPI_OK_DELETE)
+					elog(ERROR, "SPI_execute_plan failed deleting from \"%s\"",
+						 RelationGetRelationName(matviewRel));
+				if (SPI_processed != (uint64) -count)
+					elog(ERROR, "materialized view \"%s\" does not match its change logs",
+						 RelationGetRelationName(matviewRel));
+			}
+		}
+
+		SPI_freetuptable(tuptable);
+	}
+	SPI_cursor_close(portal);
+
+	return processed;
+}
+
+/*
+ * Check whether the changes of an aggregate view can be applied directly to
+ * its stored aggregates, see the notes above.  If so, return the list of
+ * IvmAggColumns describing its aggregates, else NIL.
+ */
+static List *
+ivm_direct_aggs(Query *query)
+{
+	List	   *aggs = NIL;
+	int			countstar = -1;
+	ListCell   *lc;
+
+	/* A group could then be hidden or shown without any change to it */
+	if (query->havingQual != NULL)
+		return NIL;
+
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		Aggref	   *aggref;
+		IvmAggColumn *agg;
+
+		if (tle->resjunk)
+			continue;
+		if (tle->ressortgroupref != 0 &&
+			get_sortgroupref_clause_noerr(tle->ressortgroupref,
+										  query->groupClause) != NULL)
+			continue;
+
+		/* Anything else must be a plain aggregate */
+		if (!IsA(tle->expr, Aggref))
+			return NIL;
+		aggref = (Aggref *) tle->expr;
+		if (aggref->aggdistinct != NIL || aggref->aggorder != NIL ||
+			aggref->aggfilter != NULL || aggref->aggkind != AGGKIND_NORMAL ||
+			aggref->agglevelsup != 0)
+			return NIL;
+
+		agg = (IvmAggColumn *) palloc0(sizeof(IvmAggColumn));
+		agg->attnum = tle->resno;
+		if (aggref->args != NIL)
+			agg->arg = linitial_node(TargetEntry, aggref->args)->expr;
+		agg->countidx = -1;
+		agg->sumidx = -1;
+
+		/*
+		 * Sums and averages of integers are computed exactly, so adding up
+		 * their changes gives the same result as recomputing them.
+		 */
+		switch (aggref->aggfnoid)
+		{
+			case F_COUNT_:
+				agg->kind = IVM_AGG_COUNT_STAR;
+				countstar = list_length(aggs);
+				break;
+			case F_COUNT_ANY:
+				agg->kind = IVM_AGG_COUNT;
+				break;
+			case F_SUM_INT2:
+			case F_SUM_INT4:
+			case F_SUM_INT8:
+				agg->kind = IVM_AGG_SUM;
+				break;
+			case F_AVG_INT2:
+			case F_AVG_INT4:
+			case F_AVG_INT8:
+				agg->kind = IVM_AGG_AVG;
+				break;
+			default:
+				return NIL;
+		}
+
+		aggs = lappend(aggs, agg);
+	}
+
+	/* count(*) tells when a group is gone */
+	if (query->groupClause != NIL && countstar < 0)
+		return NIL;
+
+	foreach(lc, aggs)
+	{
+		IvmAggColumn *agg = (IvmAggColumn *) lfirst(lc);
+		ListCell   *lc2;
+
+		if (agg->kind != IVM_AGG_SUM && agg->kind != IVM_AGG_AVG)
+			continue;
+
+		/* Find the count of the non-null values of the argument... */
+		foreach(lc2, aggs)
+		{
+			IvmAggColumn *other = (IvmAggColumn *) lfirst(lc2);
+
+			if (other->kind == IVM_AGG_COUNT && equal(other->arg, agg->arg))
+			{
+				agg->countidx = foreach_current_index(lc2);
+				break;
+			}
+		}
+		if (agg->countidx < 0 && countstar >= 0 &&
+			ivm_expr_is_not_null(query, agg->arg))
+			agg->countidx = countstar;
+		if (agg->countidx < 0)
+			return NIL;
+
+		/* ... and for avg, their sum */
+		if (agg->kind == IVM_AGG_AVG)
+		{
+			foreach(lc2, aggs)
+			{
+				IvmAggColumn *other = (IvmAggColumn *) lfirst(lc2);
+
+				if (other->kind == IVM_AGG_SUM && equal(other->arg, agg->arg))
+				{
+					agg->sumidx = foreach_current_index(lc2);
+					break;
+				}
+			}
+			if (agg->sumidx < 0)
+				return NIL;
+		}
+	}
+
+	return aggs;
+}
+
+/*
+ * Is the expression a column of one of the view's tables declared NOT NULL?
+ * The view's joins are inner joins, so the column can't go to null.
+ *
+ * This is checked at each refresh, and dropping the constraint conflicts
+ * with our lock on the table, so it holds for all the changes we apply.
+ */
+static bool
+ivm_expr_is_not_null(Query *query, Expr *expr)
+{
+	Var		   *var;
+	RangeTblEntry *rte;
+	HeapTuple	tp;
+	bool		result;
+
+	if (!IsA(expr, Var))
+		return false;
+	var = (Var *) expr;
+	if (var->varlevelsup != 0 || var->varattno <= 0)
+		return false;
+	rte = rt_fetch(var->varno, query->rtable);
+	if (rte->rtekind != RTE_RELATION)
+		return false;
+
+	tp = SearchSysCache2(ATTNUM,
+						 ObjectIdGetDatum(rte->relid),
+						 Int16GetDatum(var->varattno));
+	if (!HeapTupleIsValid(tp))
+		elog(ERROR, "cache lookup failed for attribute %d of relation %u",
+			 var->varattno, rte->relid);
+	result = ((Form_pg_attribute) GETSTRUCT(tp))->attnotnull;
+	ReleaseSysCache(tp);
+
+	return result;
+}
+
+/*
+ * Apply the changes to an aggregate view whose aggregates are all described
+ * by "aggs", see ivm_direct_aggs().
+ *
+ * The rows of the delta terms are aggregated per group into the changes of
+ * count(*), of the counts and of the sums, which are added to the stored
+ * values of the group.  Averages are then computed from the new sums and
+ * counts.  A group that appears is inserted, and one whose count(*) drops to
+ * zero is deleted.  Without GROUP BY, the view's single row is updated.
+ */
+static uint64
+ivm_apply_aggs(Relation matviewRel, Query *query, List *changed, List *aggs,
+			   Snapshot snapshot)
+{
+	TupleDesc	tupdesc = RelationGetDescr(matviewRel);
+	int			natts = tupdesc->natts;
+	char	   *matviewname;
+	StringInfoData querybuf;
+	char	  **colexprs;
+	int		   *paramnos;
+	List	   *attnums = NIL;
+	List	   *eqops = NIL;
+	Oid		   *argtypes;
+	Datum	   *values;
+	char	   *nulls;
+	SPIPlanPtr	deltaplan;
+	SPIPlanPtr	updplan;
+	SPIPlanPtr	insplan = NULL;
+	SPIPlanPtr	delplan = NULL;
+	Portal		portal;
+	ListCell   *lc;
+	uint32		mask;
+	uint64		processed = 0;
+	bool		grouped = (query->groupClause != NIL);
+	int			countstar = -1;
+	int			nkeys = 0;
+	int			nparams;
+	int			i;
+
+	matviewname = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(matviewRel)),
+											 RelationGetRelationName(matviewRel));
+
+	/*
+	 * The parameters of the statements below are the keys of a group, in the
+	 * order of the matview's columns, followed by the changes of its counts
+	 * and sums, in the order of "aggs".  colexprs collects the value of each
+	 * column of a newly inserted group.
+	 */
+	argtypes = (Oid *) palloc((natts + list_length(aggs)) * sizeof(Oid));
+	colexprs = (char **) palloc0(natts * sizeof(char *));
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		SortGroupClause *sgc;
+
+		if (tle->resjunk || tle->ressortgroupref == 0)
+			continue;
+		sgc = get_sortgroupref_clause_noerr(tle->ressortgroupref,
+											query->groupClause);
+		if (sgc == NULL)
+			continue;
+
+		argtypes[nkeys++] = exprType((Node *) tle->expr);
+		colexprs[tle->resno - 1] = psprintf("$%d", nkeys);
+		attnums = lappend_int(attnums, tle->resno);
+		eqops = lappend_oid(eqops, sgc->eqop);
+	}
+
+	nparams = nkeys;
+	paramnos = (int *) palloc0(list_length(aggs) * sizeof(int));
+	foreach(lc, aggs)
+	{
+		IvmAggColumn *agg = (IvmAggColumn *) lfirst(lc);
+
+		if (agg->kind == IVM_AGG_AVG)
+			continue;
+		if (agg->kind == IVM_AGG_COUNT_STAR)
+			countstar = foreach_current_index(lc);
+		argtypes[nparams] = (agg->kind == IVM_AGG_SUM) ? NUMERICOID : INT8OID;
+		paramnos[foreach_current_index(lc)] = ++nparams;
+	}
+
+	/* The changes of the counts and sums of each group */
+	initStringInfo(&querybuf);
+	appendStringInfoString(&querybuf, "SELECT ");
+	for (i = 1; i <= nkeys; i++)
+		appendStringInfo(&querybuf, "__ivm_k%d, ", i);
+	foreach(lc, aggs)
+	{
+		IvmAggColumn *agg = (IvmAggColumn *) lfirst(lc);
+		int			aggno = foreach_current_index(lc) + 1;
+
+		switch (agg->kind)
+		{
+			case IVM_AGG_COUNT_STAR:
+				appendStringInfoString(&querybuf,
+									   "COALESCE(pg_catalog.sum(__ivm_s), 0)::pg_catalog.int8");
+				break;
+			case IVM_AGG_COUNT:
+				appendStringInfo(&querybuf,
+								 "COALESCE(pg_catalog.sum(CASE WHEN __ivm_a%d IS NULL THEN 0 ELSE __ivm_s END), 0)::pg_catalog.int8",
+								 aggno);
+				break;
+			case IVM_AGG_SUM:
+				appendStringInfo(&querybuf,
+								 "COALESCE(pg_catalog.sum(__ivm_a%d::pg_catalog.numeric OPERATOR(pg_catalog.*) __ivm_s), 0)",
+								 aggno);
+				break;
+			case IVM_AGG_AVG:
+				continue;
+		}
+		if (paramnos[aggno - 1] < nparams)
+			appendStringInfoString(&querybuf, ", ");
+	}
+	appendStringInfoString(&querybuf, " FROM (");
+
+	for (mask = 1; mask < (1 << list_length(changed)); mask++)
+	{
+		Query	   *term = ivm_delta_term(query, changed, mask,
+										  IVM_TERM_AGGARGS, aggs);
+
+		if (mask > 1)
+			appendStringInfoString(&querybuf, " UNION ALL ");
+		appendStringInfoString(&querybuf, "SELECT ");
+		for (i = 1; i <= nkeys; i++)
+			appendStringInfo(&querybuf, "__ivm_k%d, ", i);
+		foreach(lc, aggs)
+		{
+			IvmAggColumn *agg = (IvmAggColumn *) lfirst(lc);
+
+			if (agg->kind == IVM_AGG_COUNT || agg->kind == IVM_AGG_SUM)
+				appendStringInfo(&querybuf, "__ivm_a%d, ",
+								 foreach_current_index(lc) + 1);
+		}
+		ivm_append_term_sign(&querybuf, changed, mask);
+		appendStringInfo(&querybuf, " FROM (%s) t",
+						 pg_get_querydef(term, false));
+	}
+	appendStringInfoString(&querybuf, ") d");
+	if (grouped)
+	{
+		appendStringInfoString(&querybuf, " GROUP BY ");
+		for (i = 1; i <= nkeys; i++)
+			appendStringInfo(&querybuf, "%s%d", i > 1 ? ", " : "", i);
+	}
+	deltaplan = ivm_prepare(querybuf.data, 0, NULL);
+
+	/* Add the changes to the stored group, and report its new count(*) */
+	resetStringInfo(&querybuf);
+	appendStringInfo(&querybuf, "UPDATE %s mv SET ", matviewname);
+	foreach(lc, aggs)
+	{
+		IvmAggColumn *agg = (IvmAggColumn *) lfirst(lc);
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, agg->attnum - 1);
+		const char *colname = quote_identifier(NameStr(attr->attname));
+		int			paramno = paramnos[foreach_current_index(lc)];
+		char	   *newcount = NULL;
+		char	   *newsum = NULL;
+
+		if (agg->kind == IVM_AGG_SUM || agg->kind == IVM_AGG_AVG)
+		{
+			IvmAggColumn *count = list_nth(aggs, agg->countidx);
+			Form_pg_attribute countattr = TupleDescAttr(tupdesc, count->attnum - 1);
+
+			newcount = psprintf("(mv.%s OPERATOR(pg_catalog.+) $%d)",
+								quote_identifier(NameStr(countattr->attname)),
+								paramnos[agg->countidx]);
+		}
+		if (agg->kind == IVM_AGG_SUM)
+			newsum = psprintf("(COALESCE(mv.%s, 0)::pg_catalog.numeric OPERATOR(pg_catalog.+) $%d)",
+							  colname, paramno);
+		else if (agg->kind == IVM_AGG_AVG)
+		{
+			IvmAggColumn *sum = list_nth(aggs, agg->sumidx);
+			Form_pg_attribute sumattr = TupleDescAttr(tupdesc, sum->attnum - 1);
+
+			newsum = psprintf("(COALESCE(mv.%s, 0)::pg_catalog.numeric OPERATOR(pg_catalog.+) $%d)",
+							  quote_identifier(NameStr(sumattr->attname)),
+							  paramnos[agg->sumidx]);
+		}
+
+		if (foreach_current_index(lc) > 0)
+			appendStringInfoString(&querybuf, ", ");
+		switch (agg->kind)
+		{
+			case IVM_AGG_COUNT_STAR:
+			case IVM_AGG_COUNT:
+				appendStringInfo(&querybuf,
+								 "%s = mv.%s OPERATOR(pg_catalog.+) $%d",
+								 colname, colname, paramno);
+				colexprs[agg->attnum - 1] = psprintf("$%d", paramno);
+				break;
+			case IVM_AGG_SUM:
+				appendStringInfo(&querybuf,
+								 "%s = CASE WHEN %s OPERATOR(pg_catalog.=) 0 THEN NULL ELSE %s::%s END",
+								 colname, newcount, newsum,
+								 format_type_be_qualified(attr->atttypid));
+				colexprs[agg->attnum - 1] =
+					psprintf("CASE WHEN $%d OPERATOR(pg_catalog.=) 0 THEN NULL ELSE $%d::%s END",
+							 paramnos[agg->countidx], paramno,
+							 format_type_be_qualified(attr->atttypid));
+				break;
+			case IVM_AGG_AVG:
+				appendStringInfo(&querybuf,
+								 "%s = CASE WHEN %s OPERATOR(pg_catalog.=) 0 THEN NULL ELSE %s OPERATOR(pg_catalog./) %s::pg_catalog.numeric END",
+								 colname, newcount, newsum, newcount);
+				colexprs[agg->attnum - 1] =
+					psprintf("CASE WHEN $%d OPERATOR(pg_catalog.=) 0 THEN NULL ELSE $%d OPERATOR(pg_catalog./) $%d::pg_catalog.numeric END",
+							 paramnos[agg->countidx], paramnos[agg->sumidx],
+							 paramnos[agg->countidx]);
+				break;
+		}
+	}
+	if (grouped)
+	{
+		Form_pg_attribute attr;
+
+		appendStringInfoString(&querybuf, " WHERE ");
+		ivm_append_match_conds(&querybuf, matviewRel, attnums, eqops);
+		attr = TupleDescAttr(tupdesc,
+							 ((IvmAggColumn *) list_nth(aggs, countstar))->attnum - 1);
+		appendStringInfo(&querybuf, " RETURNING mv.%s",
+						 quote_identifier(NameStr(attr->attname)));
+	}
+	updplan = ivm_prepare(querybuf.data, nparams, argtypes);
+
+	if (grouped)
+	{
+		/* Insert a new group */
+		resetStringInfo(&querybuf);
+		appendStringInfo(&querybuf, "INSERT INTO %s VALUES (", matviewname);
+		for (i = 0; i < natts; i++)
+		{
+			Assert(colexprs[i] != NULL);
+			appendStringInfo(&querybuf, "%s%s", i > 0 ? ", " : "",
+							 colexprs[i]);
+		}
+		appendStringInfoString(&querybuf, ")");
+		insplan = ivm_prepare(querybuf.data, nparams, argtypes);
+
+		/* Delete a group that is gone */
+		resetStringInfo(&querybuf);
+		appendStringInfo(&querybuf, "DELETE FROM %s mv WHERE ", matviewname);
+		ivm_append_match_conds(&querybuf, matviewRel, attnums, eqops);
+		delplan = ivm_prepare(querybuf.data, nkeys, argtypes);
+	}
+
+	values = (Datum *) palloc(nparams * sizeof(Datum));
+	nulls = (char *) palloc(nparams * sizeof(char));
+
+	portal = ivm_cursor_open(deltaplan, snapshot);
+	for (;;)
+	{
+		SPITupleTable *tuptable;
+		uint64		ntuples;
+		uint64		j;
+
+		SPI_cursor_fetch(portal, true, 1000);
+		if (SPI_processed == 0)
+			break;
+		tuptable = SPI_tuptable;
+		ntuples = SPI_processed;
+
+		for (j = 0; j < ntuples; j++)
+		{
+			HeapTuple	tuple = tuptable->vals[j];
+			bool		isnull;
+
+			for (i = 0; i < nparams; i++)
+			{
+				values[i] = SPI_getbinval(tuple, tuptable->tupdesc, i + 1,
+										  &isnull);
+				nulls[i] = isnull ? 'n' : ' ';
+			}
+
+			if (SPI_execute_snapshot(updplan, values, nulls, snapshot,
+									 InvalidSnapshot, false, false,
+									 0) != (grouped ? SPI_OK_UPDATE_RETURNING : SPI_OK_UPDATE))
+				elog(ERROR, "SPI_execute_plan failed updating \"%s\"",
+					 RelationGetRelationName(matviewRel));
+
+			if (!grouped)
+			{
+				if (SPI_processed != 1)
+					elog(ERROR, "materialized view \"%s\" does not match its change logs",
+						 RelationGetRelationName(matviewRel));
+				processed++;
+			}
+			else if (SPI_processed == 0)
+			{
+				int64		newcount;
+
+				/* A new group, or changes that cancel out */
+				newcount = DatumGetInt64(values[paramnos[countstar] - 1]);
+				if (newcount < 0)
+					elog(ERROR, "materialized view \"%s\" does not match its change logs",
+						 RelationGetRelationName(matviewRel));
+				if (newcount > 0)
+				{
+					if (SPI_execute_snapshot(insplan, values, nulls, snapshot,
+											 InvalidSnapshot, false, false,
+											 0) != SPI_OK_INSERT)
+						elog(ERROR, "SPI_execute_plan failed inserting into \"%s\"",
+							 RelationGetRelationName(matviewRel));
+					processed++;
+				}
+			}
+			else
+			{
+				int64		newcount;
+
+				if (SPI_processed != 1)
+					elog(ERROR, "materialized view \"%s\" does not match its change logs",
+						 RelationGetRelationName(matviewRel));
+				newcount = DatumGetInt64(SPI_getbinval(SPI_tuptable->vals[0],
+													   SPI_tuptable->tupdesc,
+													   1, &isnull));
+				SPI_freetuptable(SPI_tuptable);
+
+				if (newcount < 0)
+					elog(ERROR, "materialized view \"%s\" does not match its change logs",
+						 RelationGetRelationName(matviewRel));
+				if (newcount == 0)
+				{
+					if (SPI_execute_snapshot(delplan, values, nulls, snapshot,
+											 InvalidSnapshot, false, false,
+											 0) != SPI_OK_DELETE)
+						elog(ERROR, "SPI_execute_plan failed deleting from \"%s\"",
+							 RelationGetRelationName(matviewRel));
+				}
+				else
+					processed++;
+			}
+		}
+
+		SPI_freetuptable(tuptable);
+	}
+	SPI_cursor_close(portal);
+
+	return processed;
+}
+
+/*
+ * Apply the changes to an aggregate view that ivm_apply_aggs() can't handle.
+ *
+ * The delta terms give the keys of the groups that may have changed.  Each
+ * of these groups is deleted from the matview and recomputed, with the
+ * view's query restricted to the group.  Without GROUP BY, the view's single
+ * row is recomputed.
+ */
+static uint64
+ivm_apply_grouped(Relation matviewRel, Query *query, List *changed,
+				  Snapshot snapshot)
+{
+	char	   *matviewname;
+	StringInfoData querybuf;
+	List	   *attnums = NIL;
+	List	   *eqops = NIL;
+	Oid		   *argtypes;
+	Datum	   *values;
+	char	   *nulls;
+	Query	   *groupquery;
+	Node	   *groupquals = NULL;
+	SPIPlanPtr	keyplan;
+	SPIPlanPtr	insplan;
+	SPIPlanPtr	delplan;
+	Portal		portal;
+	ListCell   *lc;
+	uint32		mask;
+	uint64		processed = 0;
+	int			nkeys;
+	int			i;
+
+	matviewname = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(matviewRel)),
+											 RelationGetRelationName(matviewRel));
+	initStringInfo(&querybuf);
+
+	if (query->groupClause == NIL)
+	{
+		resetStringInfo(&querybuf);
+		appendStringInfo(&querybuf, "DELETE FROM %s", matviewname);
+		if (SPI_execute_snapshot(ivm_prepare(querybuf.data, 0, NULL),
+								 NULL, NULL, snapshot, InvalidSnapshot,
+								 false, false, 0) != SPI_OK_DELETE)
+			elog(ERROR, "SPI_exec failed: %s", querybuf.data);
+
+		resetStringInfo(&querybuf);
+		appendStringInfo(&querybuf, "INSERT INTO %s %s",
+						 matviewname, pg_get_querydef(query, false));
+		if (SPI_execute_snapshot(ivm_prepare(querybuf.data, 0, NULL),
+								 NULL, NULL, snapshot, InvalidSnapshot,
+								 false, false, 0) != SPI_OK_INSERT)
+			elog(ERROR, "SPI_exec failed: %s", querybuf.data);
+
+		return SPI_processed;
+	}
+
+	/*
+	 * Build the query restricting the view to one group, and collect the
+	 * matview columns and equality operators of the keys.
+	 */
+	nkeys = 0;
+	argtypes = (Oid *) palloc(list_length(query->targetList) * sizeof(Oid));
+	foreach(lc, query->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		SortGroupClause *sgc;
+		Expr	   *expr;
+		Param	   *param;
+		NullTest   *exprnull;
+		NullTest   *paramnull;
+		Node	   *qual;
+
+		if (tle->resjunk || tle->ressortgroupref == 0)
+			continue;
+		sgc = get_sortgroupref_clause_noerr(tle->ressortgroupref,
+											query->groupClause);
+		if (sgc == NULL)
+			continue;
+
+		expr = (Expr *) copyObject(tle->expr);
+		argtypes[nkeys] = exprType((Node *) expr);
+
+		param = makeNode(Param);
+		param->paramkind = PARAM_EXTERN;
+		param->paramid = ++nkeys;
+		param->paramtype = exprType((Node *) expr);
+		param->paramtypmod = exprTypmod((Node *) expr);
+		param->paramcollid = exprCollation((Node *) expr);
+		param->location = -1;
+
+		exprnull = makeNode(NullTest);
+		exprnull->arg = (Expr *) copyObject(expr);
+		exprnull->nulltesttype = IS_NULL;
+		exprnull->argisrow = false;
+		exprnull->location = -1;
+
+		paramnull = makeNode(NullTest);
+		paramnull->arg = (Expr *) copyObject(param);
+		paramnull->nulltesttype = IS_NULL;
+		paramnull->argisrow = false;
+		paramnull->location = -1;
+
+		/* (expr = $n OR (expr IS NULL AND $n IS NULL)) */
+		qual = (Node *)
+			makeBoolExpr(OR_EXPR,
+						 list_make2(make_opclause(sgc->eqop, BOOLOID, false,
+												  expr, (Expr *) param,
+												  InvalidOid,
+												  exprCollation((Node *) expr)),
+									makeBoolExpr(AND_EXPR,
+												 list_make2(exprnull, paramnull),
+												 -1)),
+						 -1);
+		groupquals = make_and_qual(groupquals, qual);
+
+		attnums = lappend_int(attnums, tle->resno);
+		eqops = lappend_oid(eqops, sgc->eqop);
+	}
+
+	groupquery = copyObject(query);
+	groupquery->jointree->quals = make_and_qual(groupquery->jointree->quals,
+												groupquals);
+
+	resetStringInfo(&querybuf);
+	appendStringInfo(&querybuf, "INSERT INTO %s %s",
+					 matviewname, pg_get_querydef(groupquery, false));
+	insplan = ivm_prepare(querybuf.data, nkeys, argtypes);
+
+	resetStringInfo(&querybuf);
+	appendStringInfo(&querybuf, "DELETE FROM %s mv WHERE ", matviewname);
+	ivm_append_match_conds(&querybuf, matviewRel, attnums, eqops);
+	delplan = ivm_prepare(querybuf.data, nkeys, argtypes);
+
+	/* The keys of the groups touched by any of the delta terms */
+	resetStringInfo(&querybuf);
+	appendStringInfoString(&querybuf, "SELECT DISTINCT * FROM (");
+	for (mask = 1; mask < (1 << list_length(changed)); mask++)
+	{
+		Query	   *term = ivm_delta_term(query, changed, mask,
+										  IVM_TERM_KEYS, NIL);
+
+		appendStringInfo(&querybuf, "%s(%s)",
+						 mask > 1 ? " UNION ALL " : "",
+						 pg_get_querydef(term, false));
+	}
+	appendStringInfoString(&querybuf, ") d");
+	keyplan = ivm_prepare(querybuf.data, 0, NULL);
+
+	values = (Datum *) palloc(nkeys * sizeof(Datum));
+	nulls = (char *) palloc(nkeys * sizeof(char));
+
+	portal = ivm_cursor_open(keyplan, snapshot);
+	for (;;)
+	{
+		SPITupleTable *tuptable;
+		uint64		ntuples;
+		uint64		j;
+
+		SPI_cursor_fetch(portal, true, 1000);
+		if (SPI_processed == 0)
+			break;
+		tuptable = SPI_tuptable;
+		ntuples = SPI_processed;
+
+		for (j = 0; j < ntuples; j++)
+		{
+			HeapTuple	tuple = tuptable->vals[j];
+			bool		isnull;
+
+			for (i = 0; i < nkeys; i++)
+			{
+				values[i] = SPI_getbinval(tuple, tuptable->tupdesc, i + 1,
+										  &isnull);
+				nulls[i] = isnull ? 'n' : ' ';
+			}
+
+			if (SPI_execute_snapshot(delplan, values, nulls, snapshot,
+									 InvalidSnapshot, false, false,
+									 0) != SPI_OK_DELETE)
+				elog(ERROR, "SPI_execute_plan failed deleting from \"%s\"",
+					 RelationGetRelationName(matviewRel));
+			if (SPI_execute_snapshot(insplan, values, nulls, snapshot,
+									 InvalidSnapshot, false, false,
+									 0) != SPI_OK_INSERT)
+				elog(ERROR, "SPI_execute_plan failed inserting into \"%s\"",
+					 RelationGetRelationName(matviewRel));
+			processed += SPI_processed;
+		}
+
+		SPI_freetuptable(tuptable);
+	}
+	SPI_cursor_close(portal);
+
+	return processed;
+}
+
+/*
+ * Append conditions matching the given columns of matview alias "mv" to
+ * parameters $1, $2, ..., treating nulls as equal.
+ */
+static void
+ivm_append_match_conds(StringInfo buf, Relation matviewRel,
+					   List *attnums, List *eqops)
+{
+	TupleDesc	tupdesc = RelationGetDescr(matviewRel);
+	ListCell   *lc1;
+	ListCell   *lc2;
+	int			paramno = 0;
+
+	forboth(lc1, attnums, lc2, eqops)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc1) - 1);
+		const char *colname = quote_identifier(NameStr(attr->attname));
+		char	   *leftop;
+		char		rightop[16];
+
+		paramno++;
+		leftop = psprintf("mv.%s", colname);
+		snprintf(rightop, sizeof(rightop), "$%d", paramno);
+
+		if (paramno > 1)
+			appendStringInfoString(buf, " AND ");
+		appendStringInfoString(buf, "(");
+		generate_operator_clause(buf, leftop, attr->atttypid,
+								 lfirst_oid(lc2),
+								 rightop, attr->atttypid);
+		appendStringInfo(buf, " OR (%s IS NULL AND %s IS NULL))",
+						 leftop, rightop);
+	}
+}
@@ -54,6 +54,7 @@
 #include "commands/comment.h"
 #include "commands/defrem.h"
 #include "commands/event_trigger.h"
+#include "commands/matview.h"
 #include "commands/policy.h"
 #include "commands/sequence.h"
 #include "commands/tablecmds.h"
@@ -13895,6 +13896,18 @@ ATExecChangeOwner(Oid relationOid, Oid newOwnerId, bool recursing, LOCKMODE lock
 
 		/* If it has dependent sequences, recurse to change them too */
 		change_owner_recurse_to_sequences(relationOid, newOwnerId, lockmode);
+
+		/*
+		 * REFRESH reads the change logs of a materialized view as its owner,
+		 * so they must stay owned by the same role.
+		 */
+		if (tuple_class->relkind == RELKIND_MATVIEW)
+		{
+			ListCell   *lc;
+
+			foreach(lc, GetMatViewChangeLogs(relationOid))
+				ATExecChangeOwner(lfirst_oid(lc), newOwnerId, true, lockmode);
+		}
 	}
 
 	InvokeObjectPostAlterHook(RelationRelationId, relationOid, 0);
@@ -14188,9 +14201,26 @@ ATExecSetRelOptions(Relation rel, List *defList, AlterTableType operation,
 	/* Validate */
 	switch (rel->rd_rel->relkind)
 	{
+		case RELKIND_MATVIEW:
+			{
+				ListCell   *cell;
+
+				/* Incremental maintenance is set up by CREATE only */
+				foreach(cell, defList)
+				{
+					DefElem    *def = (DefElem *) lfirst(cell);
+
+					if (def->defnamespace == NULL &&
+						strcmp(def->defname, "incremental") == 0)
+						ereport(ERROR,
+								(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+								 errmsg("cannot change parameter \"%s\" of an existing materialized view",
+										"incremental")));
+				}
+			}
+			/* FALLTHROUGH */
 		case RELKIND_RELATION:
 		case RELKIND_TOASTVALUE:
-		case RELKIND_MATVIEW:
 			(void) heap_reloptions(rel->rd_rel->relkind, newOptions, true);
 			break;
 		case RELKIND_PARTITIONED_TABLE:
@@ -48,6 +48,7 @@
 #include "partitioning/partdesc.h"
 #include "pgstat.h"
 #include "rewrite/rewriteManip.h"
+#include "storage/buffile.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "tcop/utility.h"
@@ -3740,6 +3741,15 @@ typedef struct AfterTriggerEventList
  * tables is a List of AfterTriggersTableData structs for target tables
  * of the current query (see below).
  *
+ * spill_file holds event chunks that were pushed out of memory because the
+ * query level's event list grew beyond work_mem (see afterTriggerSpillEvents).
+ * Spilled chunks always precede everything still in the in-memory list, so
+ * they are read back and fired first.  spill_nchunks counts the chunks not
+ * yet read back, and the read and write positions are tracked separately
+ * because firing spilled events can cause more chunks to be spilled.
+ * spill_relids lists the relations having spilled events, so that
+ * AfterTriggerPendingOnRel needn't read the file.
+ *
  * maxquerydepth is just the allocated length of query_stack.
  *
  * trans_stack holds per-subtransaction data, including these fields:
@@ -3802,6 +3812,13 @@ struct AfterTriggersQueryData
 	AfterTriggerEventList events;	/* events pending from this query */
 	Tuplestorestate *fdw_tuplestore;	/* foreign tuples for said events */
 	List	   *tables;			/* list of AfterTriggersTableData, see below */
+	BufFile    *spill_file;		/* spilled event chunks, or NULL */
+	int			spill_nchunks;	/* # of spilled chunks not yet read back */
+	int			spill_readfileno;	/* read position in spill_file */
+	off_t		spill_readoff;
+	int			spill_writefileno;	/* write position in spill_file */
+	off_t		spill_writeoff;
+	List	   *spill_relids;	/* OIDs of relations with spilled events */
 };
 
 struct AfterTriggersTransData
@@ -4172,6 +4189,417 @@ afterTriggerDeleteHeadEventChunk(AfterTriggersQueryData *qs)
 }
 
 
+/*
+ * Spilling of query-level event lists
+ *
+ * A single statement that modifies many rows of a table having row-level
+ * AFTER triggers (most commonly, foreign key enforcement triggers) queues one
+ * event per row and trigger, and until the end of the statement these would
+ * all have to be kept in memory.  To bound that, once a query level's event
+ * list exceeds work_mem, we write its leading chunks out to a temporary file
+ * and read them back one at a time in AfterTriggerEndQuery.
+ *
+ * Only chunks consisting entirely of not-yet-fired, non-deferrable row-level
+ * events on regular tables are spilled.  Such events are certain to be fired
+ * at the end of the query level, in queue order, without being looked at by
+ * afterTriggerMarkEvents, SET CONSTRAINTS, or cancel_prior_stmt_triggers, so
+ * nothing needs to find them while they are on disk.  Deferrable events must
+ * be available for moving to the transaction's deferred-event list, and
+ * foreign-table events are tied to the order of the FDW tuplestore, so a
+ * chunk containing any of those stays in memory, and so does every chunk
+ * after it, since spilled chunks must always precede the in-memory list.
+ *
+ * On disk, each chunk is stored as a header, the chunk's shared records, and
+ * a compact encoding of its events.  The events of one chunk mostly share a
+ * handful of shared records and refer to nearby (often identical) ctids, so
+ * each event is written as a header byte plus, as needed, the index of its
+ * shared record and its ctids as deltas from the previous event's first
+ * ctid.  The status bits need not be stored, since they are all clear.
+ * Pointers in the shared records remain valid because the file is only read
+ * by this backend while the query level is still active.
+ */
+typedef struct AfterTriggerSpillHeader
+{
+	uint32		nevents;		/* number of events */
+	uint32		nshared;		/* number of shared records */
+	Size		eventsize;		/* space the events take in a chunk */
+	Size		encodedsize;	/* space the events take on disk */
+} AfterTriggerSpillHeader;
+
+/* bits in the header byte of an encoded event */
+#define ATS_ENC_1CTID			0x01
+#define ATS_ENC_2CTID			0x02
+#define ATS_ENC_CP_UPDATE		0x03
+#define ATS_ENC_KIND_MASK		0x03
+#define ATS_ENC_SAME_SHARED		0x04	/* same shared record as previous */
+#define ATS_ENC_SAME_CTID1		0x08	/* same ctid1 as previous event */
+
+/* upper bound on the encoded size of one event */
+#define ATS_ENC_MAX_EVENT_SIZE	48
+
+static char *
+ats_encode_uint(char *ptr, uint64 val)
+{
+	while (val >= 0x80)
+	{
+		*ptr++ = (char) ((val & 0x7F) | 0x80);
+		val >>= 7;
+	}
+	*ptr++ = (char) val;
+	return ptr;
+}
+
+static char *
+ats_decode_uint(char *ptr, uint64 *val)
+{
+	uint64		result = 0;
+	int			shift = 0;
+	uint8		b;
+
+	do
+	{
+		b = (uint8) *ptr++;
+		result |= (uint64) (b & 0x7F) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	*val = result;
+	return ptr;
+}
+
+/* block number deltas can be negative, so zigzag-encode them */
+static char *
+ats_encode_int(char *ptr, int64 val)
+{
+	return ats_encode_uint(ptr, ((uint64) val << 1) ^ (uint64) (val >> 63));
+}
+
+static char *
+ats_decode_int(char *ptr, int64 *val)
+{
+	uint64		uval;
+
+	ptr = ats_decode_uint(ptr, &uval);
+	*val = (int64) (uval >> 1) ^ -(int64) (uval & 1);
+	return ptr;
+}
+
+/* ----------
+ * afterTriggerChunkSpillable()
+ *
+ *	Check whether an event chunk of the given query level may be spilled,
+ *	per the rules explained above.
+ * ----------
+ */
+static bool
+afterTriggerChunkSpillable(AfterTriggersQueryData *qs,
+						   AfterTriggerEventChunk *chunk)
+{
+	AfterTriggerEvent event;
+	ListCell   *lc;
+
+	/* cancel_prior_stmt_triggers might want to start scanning here */
+	foreach(lc, qs->tables)
+	{
+		AfterTriggersTableData *table = (AfterTriggersTableData *) lfirst(lc);
+
+		if (table->after_trig_done &&
+			table->after_trig_events.tail == chunk)
+			return false;
+	}
+
+	for_each_event(event, chunk)
+	{
+		AfterTriggerShared evtshared = GetTriggerSharedData(event);
+		TriggerFlags tupbits = event->ate_flags & AFTER_TRIGGER_TUP_BITS;
+
+		if (event->ate_flags & (AFTER_TRIGGER_DONE | AFTER_TRIGGER_IN_PROGRESS))
+			return false;
+		if (tupbits != AFTER_TRIGGER_1CTID &&
+			tupbits != AFTER_TRIGGER_2CTID &&
+			tupbits != AFTER_TRIGGER_CP_UPDATE)
+			return false;
+		if (!TRIGGER_FIRED_FOR_ROW(evtshared->ats_event) ||
+			(evtshared->ats_event & AFTER_TRIGGER_DEFERRABLE) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/* ----------
+ * afterTriggerWriteSpilledChunk()
+ *
+ *	Append an event chunk to the query level's spill file.  The caller
+ *	is responsible for removing it from the in-memory list.
+ * ----------
+ */
+static void
+afterTriggerWriteSpilledChunk(AfterTriggersQueryData *qs,
+							  AfterTriggerEventChunk *chunk)
+{
+	AfterTriggerSpillHeader hdr;
+	AfterTriggerShared firstshared = (AfterTriggerShared) chunk->endfree;
+	AfterTriggerEvent event;
+	char	   *buf;
+	char	   *ptr;
+	int64		prevshared = -1;
+	BlockNumber prevblk = 0;
+	OffsetNumber prevoff = InvalidOffsetNumber;
+	MemoryContext oldcxt;
+	int			i;
+
+	hdr.nevents = 0;
+	for_each_event(event, chunk)
+		hdr.nevents++;
+	hdr.nshared = (chunk->endptr - chunk->endfree) / sizeof(AfterTriggerSharedData);
+	hdr.eventsize = chunk->freeptr - CHUNK_DATA_START(chunk);
+
+	buf = ptr = palloc(hdr.nevents * ATS_ENC_MAX_EVENT_SIZE);
+	for_each_event(event, chunk)
+	{
+		int64		sharedidx = GetTriggerSharedData(event) - firstshared;
+		BlockNumber blk = ItemPointerGetBlockNumberNoCheck(&event->ate_ctid1);
+		OffsetNumber off = ItemPointerGetOffsetNumberNoCheck(&event->ate_ctid1);
+		char	   *hdrbyte = ptr++;
+
+		switch (event->ate_flags & AFTER_TRIGGER_TUP_BITS)
+		{
+			case AFTER_TRIGGER_1CTID:
+				*hdrbyte = ATS_ENC_1CTID;
+				break;
+			case AFTER_TRIGGER_2CTID:
+				*hdrbyte = ATS_ENC_2CTID;
+				break;
+			default:
+				Assert((event->ate_flags & AFTER_TRIGGER_TUP_BITS) ==
+					   AFTER_TRIGGER_CP_UPDATE);
+				*hdrbyte = ATS_ENC_CP_UPDATE;
+				break;
+		}
+
+		if (sharedidx == prevshared)
+			*hdrbyte |= ATS_ENC_SAME_SHARED;
+		else
+			ptr = ats_encode_uint(ptr, (uint64) sharedidx);
+		if (blk == prevblk && off == prevoff)
+			*hdrbyte |= ATS_ENC_SAME_CTID1;
+		else
+		{
+			ptr = ats_encode_int(ptr, (int64) blk - (int64) prevblk);
+			ptr = ats_encode_uint(ptr, off);
+		}
+		if ((*hdrbyte & ATS_ENC_KIND_MASK) != ATS_ENC_1CTID)
+		{
+			/* the new tuple is usually on or near the old one's page */
+			ptr = ats_encode_int(ptr,
+								 (int64) ItemPointerGetBlockNumberNoCheck(&event->ate_ctid2) -
+								 (int64) blk);
+			ptr = ats_encode_uint(ptr,
+								  ItemPointerGetOffsetNumberNoCheck(&event->ate_ctid2));
+		}
+		if ((*hdrbyte & ATS_ENC_KIND_MASK) == ATS_ENC_CP_UPDATE)
+		{
+			ptr = ats_encode_uint(ptr, event->ate_src_part);
+			ptr = ats_encode_uint(ptr, event->ate_dst_part);
+		}
+
+		prevshared = sharedidx;
+		prevblk = blk;
+		prevoff = off;
+	}
+	hdr.encodedsize = ptr - buf;
+
+	/*
+	 * Make the file, and the list of relations, valid until end of
+	 * subtransaction, like the FDW tuplestore.  We really only need them
+	 * until AfterTriggerEndQuery().
+	 */
+	oldcxt = MemoryContextSwitchTo(CurTransactionContext);
+	if (qs->spill_file == NULL)
+	{
+		ResourceOwner saveResourceOwner;
+
+		saveResourceOwner = CurrentResourceOwner;
+		CurrentResourceOwner = CurTransactionResourceOwner;
+
+		qs->spill_file = BufFileCreateTemp(false);
+
+		CurrentResourceOwner = saveResourceOwner;
+
+		qs->spill_nchunks = 0;
+		qs->spill_readfileno = qs->spill_writefileno = 0;
+		qs->spill_readoff = qs->spill_writeoff = 0;
+	}
+	for (i = 0; i < hdr.nshared; i++)
+		qs->spill_relids = list_append_unique_oid(qs->spill_relids,
+												  firstshared[i].ats_relid);
+	MemoryContextSwitchTo(oldcxt);
+
+	if (BufFileSeek(qs->spill_file, qs->spill_writefileno,
+					qs->spill_writeoff, SEEK_SET) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek in trigger event temporary file")));
+	BufFileWrite(qs->spill_file, &hdr, sizeof(hdr));
+	BufFileWrite(qs->spill_file, firstshared,
+				 hdr.nshared * sizeof(AfterTriggerSharedData));
+	BufFileWrite(qs->spill_file, buf, hdr.encodedsize);
+	BufFileTell(qs->spill_file, &qs->spill_writefileno, &qs->spill_writeoff);
+	qs->spill_nchunks++;
+
+	pfree(buf);
+}
+
+/* ----------
+ * afterTriggerReadSpilledChunk()
+ *
+ *	Read back the next spilled chunk of the query level, as a new chunk in
+ *	the event context.
+ * ----------
+ */
+static AfterTriggerEventChunk *
+afterTriggerReadSpilledChunk(AfterTriggersQueryData *qs)
+{
+	AfterTriggerSpillHeader hdr;
+	AfterTriggerEventChunk *chunk;
+	AfterTriggerShared firstshared;
+	AfterTriggerEvent event;
+	Size		chunksize;
+	char	   *buf;
+	char	   *ptr;
+	AfterTriggerShared evtshared = NULL;
+	BlockNumber blk = 0;
+	OffsetNumber off = InvalidOffsetNumber;
+	int			i;
+
+	Assert(qs->spill_nchunks > 0);
+
+	if (BufFileSeek(qs->spill_file, qs->spill_readfileno,
+					qs->spill_readoff, SEEK_SET) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not seek in trigger event temporary file")));
+	if (BufFileRead(qs->spill_file, &hdr, sizeof(hdr)) != sizeof(hdr))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from trigger event temporary file")));
+
+	chunksize = MAXALIGN(MAXALIGN(sizeof(AfterTriggerEventChunk)) + hdr.eventsize) +
+		hdr.nshared * sizeof(AfterTriggerSharedData);
+	chunk = MemoryContextAlloc(afterTriggers.event_cxt, chunksize);
+	chunk->next = NULL;
+	chunk->freeptr = CHUNK_DATA_START(chunk) + hdr.eventsize;
+	chunk->endptr = (char *) chunk + chunksize;
+	chunk->endfree = chunk->endptr - hdr.nshared * sizeof(AfterTriggerSharedData);
+	firstshared = (AfterTriggerShared) chunk->endfree;
+
+	buf = palloc(hdr.encodedsize);
+	if (BufFileRead(qs->spill_file, firstshared,
+					hdr.nshared * sizeof(AfterTriggerSharedData)) !=
+		hdr.nshared * sizeof(AfterTriggerSharedData) ||
+		BufFileRead(qs->spill_file, buf, hdr.encodedsize) != hdr.encodedsize)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from trigger event temporary file")));
+	BufFileTell(qs->spill_file, &qs->spill_readfileno, &qs->spill_readoff);
+	qs->spill_nchunks--;
+
+	ptr = buf;
+	event = (AfterTriggerEvent) CHUNK_DATA_START(chunk);
+	for (i = 0; i < hdr.nevents; i++)
+	{
+		uint8		hdrbyte = (uint8) *ptr++;
+		uint64		uval;
+		int64		ival;
+
+		switch (hdrbyte & ATS_ENC_KIND_MASK)
+		{
+			case ATS_ENC_1CTID:
+				event->ate_flags = AFTER_TRIGGER_1CTID;
+				break;
+			case ATS_ENC_2CTID:
+				event->ate_flags = AFTER_TRIGGER_2CTID;
+				break;
+			case ATS_ENC_CP_UPDATE:
+				event->ate_flags = AFTER_TRIGGER_CP_UPDATE;
+				break;
+			default:
+				elog(ERROR, "unrecognized trigger event encoding: %d",
+					 (int) hdrbyte);
+		}
+
+		if (!(hdrbyte & ATS_ENC_SAME_SHARED))
+		{
+			ptr = ats_decode_uint(ptr, &uval);
+			Assert(uval < hdr.nshared);
+			evtshared = firstshared + uval;
+		}
+		if (!(hdrbyte & ATS_ENC_SAME_CTID1))
+		{
+			ptr = ats_decode_int(ptr, &ival);
+			blk = (BlockNumber) ((int64) blk + ival);
+			ptr = ats_decode_uint(ptr, &uval);
+			off = (OffsetNumber) uval;
+		}
+		ItemPointerSet(&event->ate_ctid1, blk, off);
+		if ((hdrbyte & ATS_ENC_KIND_MASK) != ATS_ENC_1CTID)
+		{
+			ptr = ats_decode_int(ptr, &ival);
+			ptr = ats_decode_uint(ptr, &uval);
+			ItemPointerSet(&event->ate_ctid2,
+						   (BlockNumber) ((int64) blk + ival),
+						   (OffsetNumber) uval);
+		}
+		if ((hdrbyte & ATS_ENC_KIND_MASK) == ATS_ENC_CP_UPDATE)
+		{
+			ptr = ats_decode_uint(ptr, &uval);
+			event->ate_src_part = (Oid) uval;
+			ptr = ats_decode_uint(ptr, &uval);
+			event->ate_dst_part = (Oid) uval;
+		}
+
+		/* link the event to its shared record */
+		event->ate_flags |= (char *) evtshared - (char *) event;
+
+		event = (AfterTriggerEvent) ((char *) event + SizeofTriggerEvent(event));
+	}
+	Assert((char *) event == chunk->freeptr);
+	Assert(ptr == buf + hdr.encodedsize);
+
+	pfree(buf);
+
+	return chunk;
+}
+
+/* ----------
+ * afterTriggerSpillEvents()
+ *
+ *	If the query level's in-memory event list has grown beyond work_mem,
+ *	move as many of its leading chunks as possible to the spill file.  The
+ *	tail chunk, which new events are added to, always stays in memory.
+ * ----------
+ */
+static void
+afterTriggerSpillEvents(AfterTriggersQueryData *qs)
+{
+	AfterTriggerEventChunk *chunk;
+	Size		used = 0;
+
+	for_each_chunk(chunk, qs->events)
+		used += chunk->endptr - (char *) chunk;
+	if (used <= (Size) work_mem * 1024)
+		return;
+
+	while ((chunk = qs->events.head) != qs->events.tail &&
+		   afterTriggerChunkSpillable(qs, chunk))
+	{
+		afterTriggerWriteSpilledChunk(qs, chunk);
+		qs->events.head = chunk->next;
+		pfree(chunk);
+	}
+}
+
+
 /* ----------
  * AfterTriggerExecute()
  *
@@ -4715,6 +5143,54 @@ afterTriggerInvokeEvents(AfterTriggerEventList *events,
 	return all_fired;
 }
 
+/* ----------
+ * afterTriggerInvokeSpilledEvents()
+ *
+ *	Read back and fire all the spilled events of the current query level.
+ *	All of them are immediate-mode and not yet fired, so every event of a
+ *	chunk is fired in one afterTriggerInvokeEvents pass.
+ * ----------
+ */
+static void
+afterTriggerInvokeSpilledEvents(EState *estate)
+{
+	AfterTriggersQueryData *qs;
+
+	qs = &afterTriggers.query_stack[afterTriggers.query_depth];
+	while (qs->spill_nchunks > 0)
+	{
+		AfterTriggerEventList events;
+		AfterTriggerEventChunk *chunk;
+		AfterTriggerEvent event;
+		AfterTriggerShared evtshared;
+		CommandId	firing_id = afterTriggers.firing_counter++;
+		bool		all_fired PG_USED_FOR_ASSERTS_ONLY;
+
+		chunk = afterTriggerReadSpilledChunk(qs);
+
+		for_each_event(event, chunk)
+			event->ate_flags |= AFTER_TRIGGER_IN_PROGRESS;
+		for (evtshared = (AfterTriggerShared) chunk->endfree;
+			 (char *) evtshared < chunk->endptr;
+			 evtshared++)
+			evtshared->ats_firing_id = firing_id;
+
+		events.head = events.tail = chunk;
+		events.tailfree = chunk->freeptr;
+		all_fired = afterTriggerInvokeEvents(&events, firing_id, estate, false);
+		Assert(all_fired);
+
+		pfree(chunk);
+
+		/* firing a trigger could result in query_stack being repalloc'd */
+		qs = &afterTriggers.query_stack[afterTriggers.query_depth];
+	}
+
+	/* nothing is left on disk, so stop reporting the spilled relations */
+	list_free(qs->spill_relids);
+	qs->spill_relids = NIL;
+}
+
 
 /*
  * GetAfterTriggersTableData
@@ -5010,12 +5486,25 @@ AfterTriggerEndQuery(EState *estate)
 
 	for (;;)
 	{
+		/*
+		 * Events that were spilled to disk precede everything still in
+		 * memory, so fire those first.  They are all immediate-mode, so
+		 * doing this before marking the rest is just as if they had been
+		 * marked along with them.
+		 */
+		if (qs->spill_nchunks > 0)
+		{
+			afterTriggerInvokeSpilledEvents(estate);
+			qs = &afterTriggers.query_stack[afterTriggers.query_depth];
+		}
+
 		if (afterTriggerMarkEvents(&qs->events, &afterTriggers.events, true))
 		{
 			CommandId	firing_id = afterTriggers.firing_counter++;
 			AfterTriggerEventChunk *oldtail = qs->events.tail;
 
-			if (afterTriggerInvokeEvents(&qs->events, firing_id, estate, false))
+			if (afterTriggerInvokeEvents(&qs->events, firing_id, estate, false) &&
+				afterTriggers.query_stack[afterTriggers.query_depth].spill_nchunks == 0)
 				break;			/* all fired */
 
 			/*
@@ -5063,12 +5552,22 @@ static void
 AfterTriggerFreeQuery(AfterTriggersQueryData *qs)
 {
 	Tuplestorestate *ts;
+	BufFile    *spill_file;
 	List	   *tables;
 	ListCell   *lc;
 
 	/* Drop the trigger events */
 	afterTriggerFreeEventList(&qs->events);
 
+	/* Drop spilled events if any */
+	spill_file = qs->spill_file;
+	qs->spill_file = NULL;
+	qs->spill_nchunks = 0;
+	if (spill_file)
+		BufFileClose(spill_file);
+	list_free(qs->spill_relids);
+	qs->spill_relids = NIL;
+
 	/* Drop FDW tuplestore if any */
 	ts = qs->fdw_tuplestore;
 	qs->fdw_tuplestore = NULL;
@@ -5501,6 +6000,9 @@ AfterTriggerEnlargeQueryState(void)
 		qs->events.tailfree = NULL;
 		qs->fdw_tuplestore = NULL;
 		qs->tables = NIL;
+		qs->spill_file = NULL;
+		qs->spill_nchunks = 0;
+		qs->spill_relids = NIL;
 
 		++init_depth;
 	}
@@ -5940,6 +6442,9 @@ AfterTriggerPendingOnRel(Oid relid)
 			if (evtshared->ats_relid == relid)
 				return true;
 		}
+
+		if (list_member_oid(afterTriggers.query_stack[depth].spill_relids, relid))
+			return true;
 	}
 
 	return false;
@@ -6000,6 +6505,8 @@ AfterTriggerSaveEvent(EState *estate, ResultRelInfo *relinfo,
 	TriggerDesc *trigdesc = relinfo->ri_TrigDesc;
 	AfterTriggerEventData new_event;
 	AfterTriggerSharedData new_shared;
+	AfterTriggersQueryData *qs;
+	AfterTriggerEventChunk *oldtail;
 	char		relkind = rel->rd_rel->relkind;
 	int			tgtype_event;
 	int			tgtype_level;
@@ -6361,8 +6868,13 @@ AfterTriggerSaveEvent(EState *estate, ResultRelInfo *relinfo,
 			new_shared.ats_table = NULL;
 		new_shared.ats_modifiedcols = modifiedCols;
 
-		afterTriggerAddEvent(&afterTriggers.query_stack[afterTriggers.query_depth].events,
-							 &new_event, &new_shared);
+		qs = &afterTriggers.query_stack[afterTriggers.query_depth];
+		oldtail = qs->events.tail;
+		afterTriggerAddEvent(&qs->events, &new_event, &new_shared);
+
+		/* Each time the list grows by a chunk, see if we must spill some */
+		if (qs->events.tail != oldtail)
+			afterTriggerSpillEvents(qs);
 	}
 
 	/*
@@ -1359,10 +1359,14 @@ FormPartitionKeyDatum(PartitionDispatch pd,
  * found partition, and if so, we'll return that partition index, thus
  * skipping the need for the binary search.  If we fail to match the last
  * partition when double checking, then we fall back on doing a binary search.
- * In this case, unless we find 'values' belong to the DEFAULT partition,
- * we'll reset the number of times we've hit the same partition so that we
- * don't attempt to use the cache again until we've found that partition at
- * least PARTITION_CACHED_FIND_THRESHOLD times in a row.
+ * A single stray value, such as a late-arriving row in a time-series load,
+ * shouldn't cost us the cache, so the first such miss only takes the count
+ * one below PARTITION_CACHED_FIND_THRESHOLD, and finding the cached
+ * partition once more re-enables the cache.  If instead we miss again, then
+ * unless we find 'values' belong to the DEFAULT partition, we'll reset the
+ * number of times we've hit the same partition so that we don't attempt to
+ * use the cache again until we've found the new partition at least
+ * PARTITION_CACHED_FIND_THRESHOLD times in a row.
  *
  * For cases where the partition changes on each lookup, the amount of
  * additional work required just amounts to recording the last found partition
@@ -1576,11 +1580,14 @@ get_partition_for_tuple(PartitionDispatch pd, Datum *values, bool *isnull)
 	 * cached bound offset then we've found the same partition as last time,
 	 * so bump the count by one.  If all goes well, we'll eventually reach
 	 * PARTITION_CACHED_FIND_THRESHOLD and try the cache path next time
-	 * around.  Otherwise, we'll reset the cache count back to 1 to mark that
-	 * we've found this partition for the first time.
+	 * around.  If the cache was in use, give the cached partition a second
+	 * chance, as explained above.  Otherwise, we'll reset the cache count
+	 * back to 1 to mark that we've found this partition for the first time.
 	 */
 	if (bound_offset == partdesc->last_found_datum_index)
 		partdesc->last_found_count++;
+	else if (partdesc->last_found_count >= PARTITION_CACHED_FIND_THRESHOLD)
+		partdesc->last_found_count = PARTITION_CACHED_FIND_THRESHOLD - 1;
 	else
 	{
 		partdesc->last_found_count = 1;
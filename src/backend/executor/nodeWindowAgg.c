@@ -99,6 +99,24 @@ typedef struct WindowStatePerFuncData
 	WindowObject winobj;		/* object used in window function API */
 }			WindowStatePerFuncData;
 
+/*
+ * One level of an aggregate's segment tree.  Node i of level k holds the
+ * partial aggregate state of tree blocks i * 2^k .. (i + 1) * 2^k - 1.
+ */
+typedef struct WindowSegTreeLevel
+{
+	Datum	   *values;			/* partial states */
+	bool	   *isnulls;
+	int64		nnodes;			/* number of nodes built so far */
+	int64		maxnodes;		/* allocated length of the arrays */
+} WindowSegTreeLevel;
+
+/* Number of partition rows aggregated into each leaf of a segment tree */
+#define WINDOW_SEGTREE_BLOCKSIZE	16
+
+/* Enough levels for any number of blocks an int64 row count allows */
+#define WINDOW_SEGTREE_MAXLEVELS	64
+
 /*
  * For plain aggregate window functions, we also have one of these.
  */
@@ -156,6 +174,23 @@ typedef struct WindowStatePerAggData
 
 	/* Data local to eval_windowaggregates() */
 	bool		restart;		/* need to restart this agg in this cycle? */
+
+	/*
+	 * Segment tree state, used instead of restarting when the frame head
+	 * moves and there's no inverse transition function; see
+	 * eval_windowaggregate_segtree().  The tree covers the complete blocks
+	 * of WINDOW_SEGTREE_BLOCKSIZE rows starting at row segbase, and lives in
+	 * segcontext, which is reset for each partition.
+	 */
+	bool		use_segtree;
+	FmgrInfo	combinefn;
+	MemoryContext segcontext;
+	int64		segbase;		/* first row covered by the tree */
+	int64		segnblocks;		/* number of blocks aggregated so far */
+	int			segnlevels;		/* number of levels in use */
+	WindowSegTreeLevel seglevels[WINDOW_SEGTREE_MAXLEVELS];
+	int64		segheadpos;		/* frame of resultValue, or -1 */
+	int64		segtailpos;
 } WindowStatePerAggData;
 
 static void initialize_windowaggregate(WindowAggState *winstate,
@@ -173,6 +208,22 @@ static void finalize_windowaggregate(WindowAggState *winstate,
 									 Datum *result, bool *isnull);
 
 static void eval_windowaggregates(WindowAggState *winstate);
+static void eval_windowaggregate_segtree(WindowAggState *winstate,
+										 WindowStatePerFunc perfuncstate,
+										 WindowStatePerAgg peraggstate,
+										 Datum *result, bool *isnull);
+static void combine_windowaggregate(WindowAggState *winstate,
+									WindowStatePerFunc perfuncstate,
+									WindowStatePerAgg peraggstate,
+									Datum value, bool isnull);
+static void segtree_advance_rows(WindowAggState *winstate,
+								 WindowStatePerFunc perfuncstate,
+								 WindowStatePerAgg peraggstate,
+								 int64 startpos, int64 endpos);
+static void segtree_add_block(WindowAggState *winstate,
+							  WindowStatePerFunc perfuncstate,
+							  WindowStatePerAgg peraggstate);
+static void segtree_reset(WindowStatePerAgg peraggstate);
 static void eval_windowfunction(WindowAggState *winstate,
 								WindowStatePerFunc perfuncstate,
 								Datum *result, bool *isnull);
@@ -665,6 +716,7 @@ eval_windowaggregates(WindowAggState *winstate)
 	int			wfuncno,
 				numaggs,
 				numaggs_restart,
+				numaggs_segtree,
 				i;
 	int64		aggregatedupto_nonrestarted;
 	MemoryContext oldContext;
@@ -707,7 +759,10 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * unable to remove the tuple from aggregation.  If this happens, or if
 	 * the aggregate doesn't have an inverse transition function at all, we
 	 * must perform the aggregation all over again for all tuples within the
-	 * new frame boundaries.
+	 * new frame boundaries.  Aggregates that lack an inverse transition
+	 * function but can combine partial transition states are evaluated from
+	 * a segment tree of such states instead; see
+	 * eval_windowaggregate_segtree().
 	 *
 	 * If there's any exclusion clause, then we may have to aggregate over a
 	 * non-contiguous set of rows, so we punt and recalculate for every row.
@@ -736,6 +791,34 @@ eval_windowaggregates(WindowAggState *winstate)
 	if (winstate->frameheadpos < winstate->aggregatedbase)
 		elog(ERROR, "window frame head moved backward");
 
+	/*
+	 * Evaluate the aggregates that use segment trees, which need none of the
+	 * bookkeeping below.  If that's all of them, we're done.
+	 */
+	numaggs_segtree = 0;
+	for (i = 0; i < numaggs; i++)
+	{
+		peraggstate = &winstate->peragg[i];
+		if (!peraggstate->use_segtree)
+			continue;
+
+		wfuncno = peraggstate->wfuncno;
+		eval_windowaggregate_segtree(winstate,
+									 &winstate->perfunc[wfuncno],
+									 peraggstate,
+									 &econtext->ecxt_aggvalues[wfuncno],
+									 &econtext->ecxt_aggnulls[wfuncno]);
+		numaggs_segtree++;
+	}
+
+	if (numaggs_segtree == numaggs)
+	{
+		/* Let the tuplestore discard rows before the frame head */
+		if (agg_winobj->markptr >= 0)
+			WinSetMarkPosition(agg_winobj, winstate->frameheadpos);
+		return;
+	}
+
 	/*
 	 * If the frame didn't change compared to the previous row, we can re-use
 	 * the result values that were previously saved at the bottom of this
@@ -757,6 +840,8 @@ eval_windowaggregates(WindowAggState *winstate)
 		for (i = 0; i < numaggs; i++)
 		{
 			peraggstate = &winstate->peragg[i];
+			if (peraggstate->use_segtree)
+				continue;
 			wfuncno = peraggstate->wfuncno;
 			econtext->ecxt_aggvalues[wfuncno] = peraggstate->resultValue;
 			econtext->ecxt_aggnulls[wfuncno] = peraggstate->resultValueIsNull;
@@ -783,7 +868,9 @@ eval_windowaggregates(WindowAggState *winstate)
 	for (i = 0; i < numaggs; i++)
 	{
 		peraggstate = &winstate->peragg[i];
-		if (winstate->currentpos == 0 ||
+		if (peraggstate->use_segtree)
+			peraggstate->restart = false;
+		else if (winstate->currentpos == 0 ||
 			(winstate->aggregatedbase != winstate->frameheadpos &&
 			 !OidIsValid(peraggstate->invtransfn_oid)) ||
 			(winstate->frameOptions & FRAMEOPTION_EXCLUSION) ||
@@ -803,7 +890,7 @@ eval_windowaggregates(WindowAggState *winstate)
 	 * i.e. advance_windowaggregate_base() can return false, in which case
 	 * we'll restart that aggregate below.
 	 */
-	while (numaggs_restart < numaggs &&
+	while (numaggs_restart < numaggs - numaggs_segtree &&
 		   winstate->aggregatedbase < winstate->frameheadpos)
 	{
 		/*
@@ -826,7 +913,7 @@ eval_windowaggregates(WindowAggState *winstate)
 			bool		ok;
 
 			peraggstate = &winstate->peragg[i];
-			if (peraggstate->restart)
+			if (peraggstate->restart || peraggstate->use_segtree)
 				continue;
 
 			wfuncno = peraggstate->wfuncno;
@@ -878,6 +965,8 @@ eval_windowaggregates(WindowAggState *winstate)
 	for (i = 0; i < numaggs; i++)
 	{
 		peraggstate = &winstate->peragg[i];
+		if (peraggstate->use_segtree)
+			continue;
 
 		/* Aggregates using the shared ctx must restart if *any* agg does */
 		Assert(peraggstate->aggcontext != winstate->aggcontext ||
@@ -954,6 +1043,8 @@ eval_windowaggregates(WindowAggState *winstate)
 		for (i = 0; i < numaggs; i++)
 		{
 			peraggstate = &winstate->peragg[i];
+			if (peraggstate->use_segtree)
+				continue;
 
 			/* Non-restarted aggs skip until aggregatedupto_nonrestarted */
 			if (!peraggstate->restart &&
@@ -987,6 +1078,8 @@ next_tuple:
 		bool	   *isnull;
 
 		peraggstate = &winstate->peragg[i];
+		if (peraggstate->use_segtree)
+			continue;
 		wfuncno = peraggstate->wfuncno;
 		result = &econtext->ecxt_aggvalues[wfuncno];
 		isnull = &econtext->ecxt_aggnulls[wfuncno];
@@ -1019,6 +1112,357 @@ next_tuple:
 	}
 }
 
+/*
+ * eval_windowaggregate_segtree
+ * evaluate a plain aggregate over the current frame using a segment tree
+ *
+ * Without an inverse transition function, eval_windowaggregates() has to
+ * aggregate the whole frame anew whenever the frame head moves, which costs
+ * O(frame size) per row.  If the aggregate has a combine function, we can do
+ * better: we split the partition into blocks of WINDOW_SEGTREE_BLOCKSIZE
+ * rows, aggregate each block into a partial transition state, and build a
+ * binary tree of partial states on top of them, each node combining its two
+ * children.  Any frame then consists of a partial block at either end, which
+ * we aggregate row by row, and the run of whole blocks in between, which is
+ * covered by O(log n) tree nodes that we merge with the combine function, in
+ * order.  This is the same arrangement of transition and combine function
+ * calls that a parallel aggregation produces, so any aggregate that can be
+ * parallelized gives the right answer.
+ *
+ * The tree is built lazily, as the frame tail moves past the end of each
+ * block, and only when a frame is long enough to make use of it.  Since the
+ * frame head never moves backwards, blocks before it are never needed again,
+ * so if the head has moved past all blocks built so far, we discard the tree
+ * and start a new one at the frame head; that way, the rows we still need to
+ * read are never before the frame head, which is as far as the tuplestore
+ * keeps them.
+ */
+static void
+eval_windowaggregate_segtree(WindowAggState *winstate,
+							 WindowStatePerFunc perfuncstate,
+							 WindowStatePerAgg peraggstate,
+							 Datum *result, bool *isnull)
+{
+	int64		headpos,
+				tailpos;
+	MemoryContext oldContext;
+
+	update_frameheadpos(winstate);
+	update_frametailpos(winstate);
+	headpos = winstate->frameheadpos;
+	tailpos = winstate->frametailpos;
+
+	/* If the frame didn't change, the previous result still stands */
+	if (peraggstate->segheadpos == headpos &&
+		peraggstate->segtailpos == tailpos)
+	{
+		*result = peraggstate->resultValue;
+		*isnull = peraggstate->resultValueIsNull;
+		return;
+	}
+
+	if (tailpos - headpos < 2 * WINDOW_SEGTREE_BLOCKSIZE)
+	{
+		/* Short frame, the tree wouldn't save anything */
+		initialize_windowaggregate(winstate, perfuncstate, peraggstate);
+		segtree_advance_rows(winstate, perfuncstate, peraggstate,
+							 headpos, tailpos);
+	}
+	else
+	{
+		int64		firstblock,
+					endblock,
+					blockno;
+
+		/* Discard the tree if the frame head has left it behind */
+		if (peraggstate->segbase +
+			peraggstate->segnblocks * WINDOW_SEGTREE_BLOCKSIZE < headpos)
+		{
+			segtree_reset(peraggstate);
+			peraggstate->segbase =
+				(headpos + WINDOW_SEGTREE_BLOCKSIZE - 1) /
+				WINDOW_SEGTREE_BLOCKSIZE * WINDOW_SEGTREE_BLOCKSIZE;
+		}
+
+		/* Build all blocks that end within the frame */
+		while (peraggstate->segbase +
+			   (peraggstate->segnblocks + 1) * WINDOW_SEGTREE_BLOCKSIZE <= tailpos)
+			segtree_add_block(winstate, perfuncstate, peraggstate);
+
+		/* Blocks entirely within the frame */
+		firstblock = (Max(headpos, peraggstate->segbase) -
+					  peraggstate->segbase + WINDOW_SEGTREE_BLOCKSIZE - 1) /
+			WINDOW_SEGTREE_BLOCKSIZE;
+		endblock = (tailpos - peraggstate->segbase) / WINDOW_SEGTREE_BLOCKSIZE;
+		Assert(firstblock < endblock && endblock <= peraggstate->segnblocks);
+
+		/* Building blocks clobbered the transition value, so start afresh */
+		initialize_windowaggregate(winstate, perfuncstate, peraggstate);
+
+		segtree_advance_rows(winstate, perfuncstate, peraggstate,
+							 headpos,
+							 peraggstate->segbase +
+							 firstblock * WINDOW_SEGTREE_BLOCKSIZE);
+
+		/*
+		 * Cover the blocks with the largest aligned tree nodes that fit,
+		 * going from left to right so that the states are combined in order.
+		 */
+		blockno = firstblock;
+		while (blockno < endblock)
+		{
+			int			level = 0;
+			WindowSegTreeLevel *seglevel;
+
+			while (level + 1 < peraggstate->segnlevels &&
+				   (blockno & ((INT64CONST(1) << (level + 1)) - 1)) == 0 &&
+				   blockno + (INT64CONST(1) << (level + 1)) <= endblock)
+				level++;
+
+			seglevel = &peraggstate->seglevels[level];
+			Assert((blockno >> level) < seglevel->nnodes);
+			combine_windowaggregate(winstate, perfuncstate, peraggstate,
+									seglevel->values[blockno >> level],
+									seglevel->isnulls[blockno >> level]);
+			ResetExprContext(winstate->tmpcontext);
+
+			blockno += INT64CONST(1) << level;
+		}
+
+		segtree_advance_rows(winstate, perfuncstate, peraggstate,
+							 peraggstate->segbase +
+							 endblock * WINDOW_SEGTREE_BLOCKSIZE,
+							 tailpos);
+	}
+
+	finalize_windowaggregate(winstate, perfuncstate, peraggstate,
+							 result, isnull);
+
+	/* save the result in case the next row has the same frame */
+	if (!peraggstate->resulttypeByVal && !*isnull)
+	{
+		oldContext = MemoryContextSwitchTo(peraggstate->aggcontext);
+		peraggstate->resultValue = datumCopy(*result,
+											 peraggstate->resulttypeByVal,
+											 peraggstate->resulttypeLen);
+		MemoryContextSwitchTo(oldContext);
+	}
+	else
+		peraggstate->resultValue = *result;
+	peraggstate->resultValueIsNull = *isnull;
+	peraggstate->segheadpos = headpos;
+	peraggstate->segtailpos = tailpos;
+}
+
+/*
+ * combine_windowaggregate
+ * merge a partial transition state into an aggregate's transition value
+ *
+ * This is advance_windowaggregate for the combine function, with the same
+ * handling of strictness as nodeAgg.c applies to combine functions.
+ */
+static void
+combine_windowaggregate(WindowAggState *winstate,
+						WindowStatePerFunc perfuncstate,
+						WindowStatePerAgg peraggstate,
+						Datum value, bool isnull)
+{
+	LOCAL_FCINFO(fcinfo, 2);
+	Datum		newVal;
+	MemoryContext oldContext;
+
+	if (peraggstate->combinefn.fn_strict)
+	{
+		/* A NULL partial state contributes nothing */
+		if (isnull)
+			return;
+
+		/* The first non-NULL partial state becomes the transition value */
+		if (peraggstate->transValueIsNull)
+		{
+			oldContext = MemoryContextSwitchTo(peraggstate->aggcontext);
+			peraggstate->transValue = datumCopy(value,
+												peraggstate->transtypeByVal,
+												peraggstate->transtypeLen);
+			peraggstate->transValueIsNull = false;
+			peraggstate->transValueCount++;
+			MemoryContextSwitchTo(oldContext);
+			return;
+		}
+	}
+
+	oldContext = MemoryContextSwitchTo(winstate->tmpcontext->ecxt_per_tuple_memory);
+
+	InitFunctionCallInfoData(*fcinfo, &(peraggstate->combinefn), 2,
+							 perfuncstate->winCollation,
+							 (void *) winstate, NULL);
+	fcinfo->args[0].value = peraggstate->transValue;
+	fcinfo->args[0].isnull = peraggstate->transValueIsNull;
+	fcinfo->args[1].value = value;
+	fcinfo->args[1].isnull = isnull;
+	winstate->curaggcontext = peraggstate->aggcontext;
+	newVal = FunctionCallInvoke(fcinfo);
+	winstate->curaggcontext = NULL;
+
+	peraggstate->transValueCount++;
+
+	/* Keep the new value in aggcontext, as in advance_windowaggregate */
+	if (!peraggstate->transtypeByVal &&
+		DatumGetPointer(newVal) != DatumGetPointer(peraggstate->transValue))
+	{
+		if (!fcinfo->isnull)
+		{
+			MemoryContextSwitchTo(peraggstate->aggcontext);
+			if (DatumIsReadWriteExpandedObject(newVal,
+											   false,
+											   peraggstate->transtypeLen) &&
+				MemoryContextGetParent(DatumGetEOHP(newVal)->eoh_context) == CurrentMemoryContext)
+				 /* do nothing */ ;
+			else
+				newVal = datumCopy(newVal,
+								   peraggstate->transtypeByVal,
+								   peraggstate->transtypeLen);
+		}
+		if (!peraggstate->transValueIsNull)
+		{
+			if (DatumIsReadWriteExpandedObject(peraggstate->transValue,
+											   false,
+											   peraggstate->transtypeLen))
+				DeleteExpandedObject(peraggstate->transValue);
+			else
+				pfree(DatumGetPointer(peraggstate->transValue));
+		}
+	}
+
+	MemoryContextSwitchTo(oldContext);
+	peraggstate->transValue = newVal;
+	peraggstate->transValueIsNull = fcinfo->isnull;
+}
+
+/*
+ * segtree_advance_rows
+ * aggregate partition rows startpos .. endpos - 1 into the transition value
+ */
+static void
+segtree_advance_rows(WindowAggState *winstate,
+					 WindowStatePerFunc perfuncstate,
+					 WindowStatePerAgg peraggstate,
+					 int64 startpos, int64 endpos)
+{
+	TupleTableSlot *slot = winstate->temp_slot_1;
+	int64		pos;
+
+	for (pos = startpos; pos < endpos; pos++)
+	{
+		if (!window_gettupleslot(winstate->agg_winobj, pos, slot))
+			break;				/* end of partition */
+
+		/* Set tuple context for evaluation of aggregate arguments */
+		winstate->tmpcontext->ecxt_outertuple = slot;
+
+		advance_windowaggregate(winstate, perfuncstate, peraggstate);
+
+		/* Reset per-input-tuple context after each tuple */
+		ResetExprContext(winstate->tmpcontext);
+		ExecClearTuple(slot);
+	}
+}
+
+/*
+ * segtree_add_block
+ * aggregate the next block of rows and add it to the segment tree
+ *
+ * This clobbers the aggregate's transition value.
+ */
+static void
+segtree_add_block(WindowAggState *winstate,
+				  WindowStatePerFunc perfuncstate,
+				  WindowStatePerAgg peraggstate)
+{
+	int64		startpos;
+	int64		nodeno;
+	int			level;
+
+	startpos = peraggstate->segbase +
+		peraggstate->segnblocks * WINDOW_SEGTREE_BLOCKSIZE;
+	initialize_windowaggregate(winstate, perfuncstate, peraggstate);
+	segtree_advance_rows(winstate, perfuncstate, peraggstate,
+						 startpos, startpos + WINDOW_SEGTREE_BLOCKSIZE);
+
+	/*
+	 * Store the block's state as a leaf, then, for as long as the new node
+	 * completes a pair, store the combination of the pair one level up.
+	 */
+	nodeno = peraggstate->segnblocks++;
+	for (level = 0;; level++)
+	{
+		WindowSegTreeLevel *seglevel = &peraggstate->seglevels[level];
+		MemoryContext oldContext;
+
+		Assert(level < WINDOW_SEGTREE_MAXLEVELS);
+		Assert(seglevel->nnodes == nodeno);
+
+		oldContext = MemoryContextSwitchTo(peraggstate->segcontext);
+		if (level == peraggstate->segnlevels)
+		{
+			seglevel->maxnodes = 64;
+			seglevel->values = palloc(seglevel->maxnodes * sizeof(Datum));
+			seglevel->isnulls = palloc(seglevel->maxnodes * sizeof(bool));
+			peraggstate->segnlevels++;
+		}
+		else if (seglevel->nnodes >= seglevel->maxnodes)
+		{
+			seglevel->maxnodes *= 2;
+			seglevel->values = repalloc_huge(seglevel->values,
+											 seglevel->maxnodes * sizeof(Datum));
+			seglevel->isnulls = repalloc_huge(seglevel->isnulls,
+											  seglevel->maxnodes * sizeof(bool));
+		}
+
+		/* datumCopy also flattens any expanded object */
+		if (peraggstate->transValueIsNull)
+			seglevel->values[nodeno] = (Datum) 0;
+		else
+			seglevel->values[nodeno] = datumCopy(peraggstate->transValue,
+												 peraggstate->transtypeByVal,
+												 peraggstate->transtypeLen);
+		seglevel->isnulls[nodeno] = peraggstate->transValueIsNull;
+		seglevel->nnodes++;
+		MemoryContextSwitchTo(oldContext);
+
+		if ((nodeno & 1) == 0)
+			break;
+
+		initialize_windowaggregate(winstate, perfuncstate, peraggstate);
+		combine_windowaggregate(winstate, perfuncstate, peraggstate,
+								seglevel->values[nodeno - 1],
+								seglevel->isnulls[nodeno - 1]);
+		ResetExprContext(winstate->tmpcontext);
+		combine_windowaggregate(winstate, perfuncstate, peraggstate,
+								seglevel->values[nodeno],
+								seglevel->isnulls[nodeno]);
+		ResetExprContext(winstate->tmpcontext);
+		nodeno >>= 1;
+	}
+}
+
+/*
+ * segtree_reset
+ * discard an aggregate's segment tree
+ */
+static void
+segtree_reset(WindowStatePerAgg peraggstate)
+{
+	MemoryContextReset(peraggstate->segcontext);
+	memset(peraggstate->seglevels, 0,
+		   peraggstate->segnlevels * sizeof(WindowSegTreeLevel));
+	peraggstate->segnlevels = 0;
+	peraggstate->segbase = 0;
+	peraggstate->segnblocks = 0;
+	peraggstate->segheadpos = -1;
+	peraggstate->segtailpos = -1;
+}
+
 /*
  * eval_windowfunction
  *
@@ -1355,6 +1799,8 @@ release_partition(WindowAggState *winstate)
 	{
 		if (winstate->peragg[i].aggcontext != winstate->aggcontext)
 			MemoryContextResetAndDeleteChildren(winstate->peragg[i].aggcontext);
+		if (winstate->peragg[i].use_segtree)
+			segtree_reset(&winstate->peragg[i]);
 	}
 
 	if (winstate->buffer)
@@ -2685,6 +3131,8 @@ ExecEndWindowAgg(WindowAggState *node)
 	{
 		if (node->peragg[i].aggcontext != node->aggcontext)
 			MemoryContextDelete(node->peragg[i].aggcontext);
+		if (node->peragg[i].use_segtree)
+			MemoryContextDelete(node->peragg[i].segcontext);
 	}
 	MemoryContextDelete(node->partcontext);
 	MemoryContextDelete(node->aggcontext);
@@ -2754,7 +3202,8 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	bool		use_ma_code;
 	Oid			transfn_oid,
 				invtransfn_oid,
-				finalfn_oid;
+				finalfn_oid,
+				combinefn_oid;
 	bool		finalextra;
 	char		finalmodify;
 	Expr	   *transfnexpr,
@@ -2822,6 +3271,23 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 		initvalAttNo = Anum_pg_aggregate_agginitval;
 	}
 
+	/*
+	 * Without moving-aggregate support, a movable frame head means we'd have
+	 * to aggregate each frame from scratch.  If the aggregate can combine
+	 * partial transition states, use a segment tree of those instead, unless
+	 * the arguments contain volatile functions (for the same reason as
+	 * above).  Transition states of type internal are excluded, because the
+	 * tree must be able to copy the states.
+	 */
+	peraggstate->use_segtree =
+		!use_ma_code &&
+		OidIsValid(aggform->aggcombinefn) &&
+		!(winstate->frameOptions & (FRAMEOPTION_START_UNBOUNDED_PRECEDING |
+									FRAMEOPTION_EXCLUSION)) &&
+		aggtranstype != INTERNALOID &&
+		!contain_volatile_functions((Node *) wfunc);
+	combinefn_oid = peraggstate->use_segtree ? aggform->aggcombinefn : InvalidOid;
+
 	/*
 	 * ExecInitWindowAgg already checked permission to call aggregate function
 	 * ... but we still need to check the component functions
@@ -2866,6 +3332,16 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 							   get_func_name(finalfn_oid));
 			InvokeFunctionExecuteHook(finalfn_oid);
 		}
+
+		if (OidIsValid(combinefn_oid))
+		{
+			aclresult = pg_proc_aclcheck(combinefn_oid, aggOwner,
+										 ACL_EXECUTE);
+			if (aclresult != ACLCHECK_OK)
+				aclcheck_error(aclresult, OBJECT_FUNCTION,
+							   get_func_name(combinefn_oid));
+			InvokeFunctionExecuteHook(combinefn_oid);
+		}
 	}
 
 	/*
@@ -2926,6 +3402,25 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 		fmgr_info_set_expr((Node *) finalfnexpr, &peraggstate->finalfn);
 	}
 
+	if (OidIsValid(combinefn_oid))
+	{
+		Expr	   *combinefnexpr;
+
+		/* the combinefn takes and returns the transition type */
+		build_aggregate_transfn_expr(&aggtranstype,
+									 1,
+									 0,
+									 false,
+									 aggtranstype,
+									 wfunc->inputcollid,
+									 combinefn_oid,
+									 InvalidOid,
+									 &combinefnexpr,
+									 NULL);
+		fmgr_info(combinefn_oid, &peraggstate->combinefn);
+		fmgr_info_set_expr((Node *) combinefnexpr, &peraggstate->combinefn);
+	}
+
 	/* get info about relevant datatypes */
 	get_typlenbyval(wfunc->wintype,
 					&peraggstate->resulttypeLen,
@@ -2991,8 +3486,11 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	 * make the memory allocation rules for moving aggregates different than
 	 * they have historically been for plain aggregates, but that seems grotty
 	 * and likely to lead to memory leaks.
+	 *
+	 * Segment-tree aggregates start afresh for every frame, independently of
+	 * the others, so they need their own aggcontext as well.
 	 */
-	if (OidIsValid(invtransfn_oid))
+	if (OidIsValid(invtransfn_oid) || peraggstate->use_segtree)
 		peraggstate->aggcontext =
 			AllocSetContextCreate(CurrentMemoryContext,
 								  "WindowAgg Per Aggregate",
@@ -3000,6 +3498,15 @@ initialize_peragg(WindowAggState *winstate, WindowFunc *wfunc,
 	else
 		peraggstate->aggcontext = winstate->aggcontext;
 
+	if (peraggstate->use_segtree)
+	{
+		peraggstate->segcontext =
+			AllocSetContextCreate(CurrentMemoryContext,
+								  "WindowAgg Segment Tree",
+								  ALLOCSET_DEFAULT_SIZES);
+		segtree_reset(peraggstate);
+	}
+
 	ReleaseSysCache(aggTuple);
 
 	return peraggstate;
@@ -179,6 +179,24 @@ addHyperLogLog(hyperLogLogState *cState, uint32 hash)
 	cState->hashesArr[index] = Max(count, cState->hashesArr[index]);
 }
 
+/*
+ * Adds all elements added to another estimator to an estimator.
+ *
+ * Both must have the same register width.  The result is the same as if
+ * every hash added to oState had been added to cState as well.
+ */
+void
+mergeHyperLogLog(hyperLogLogState *cState, const hyperLogLogState *oState)
+{
+	Size		i;
+
+	if (cState->registerWidth != oState->registerWidth)
+		elog(ERROR, "cannot merge HyperLogLog states of different bit widths");
+
+	for (i = 0; i < cState->nRegisters; i++)
+		cState->hashesArr[i] = Max(cState->hashesArr[i], oState->hashesArr[i]);
+}
+
 /*
  * Estimates cardinality, based on elements added so far
  */
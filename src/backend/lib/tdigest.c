@@ -0,0 +1,231 @@
+/*-------------------------------------------------------------------------
+ *
+ * tdigest.c
+ *	  t-digest quantile estimator
+ *
+ * This is the "merging" variant of the t-digest: new values are appended to
+ * the list of centroids as centroids of their own, and whenever the list
+ * fills up, it is sorted and adjacent centroids are merged for as long as
+ * the result stays within the size limit the scale function allows at that
+ * quantile.  We use the k1 scale function,
+ *
+ *		k(q) = compression / (2 pi) * asin(2q - 1),
+ *
+ * which limits each centroid to one unit of k, so centroids grow roughly
+ * with sqrt(q(1 - q)), and at most about compression / 2 of them survive a
+ * merge pass.
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/lib/tdigest.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "lib/tdigest.h"
+
+/* Room for this many times the compression centroids between merge passes */
+#define TDIGEST_BUFFER_FACTOR	5
+
+static int	centroid_cmp(const void *a, const void *b);
+
+/*
+ * Create an empty t-digest, in the current memory context.
+ */
+TDigest *
+tdigest_create(int compression)
+{
+	TDigest    *td;
+
+	Assert(compression > 0);
+
+	td = palloc(sizeof(TDigest));
+	td->compression = compression;
+	td->ncentroids = 0;
+	td->maxcentroids = TDIGEST_BUFFER_FACTOR * compression + 1;
+	td->count = 0;
+	td->min = 0;
+	td->max = 0;
+	td->centroids = palloc(td->maxcentroids * sizeof(TDigestCentroid));
+
+	return td;
+}
+
+/*
+ * Add a value with the given weight (normally 1) to a t-digest.
+ *
+ * The value must be finite.
+ */
+void
+tdigest_add(TDigest *td, double value, double weight)
+{
+	Assert(!isnan(value) && !isinf(value));
+	Assert(weight > 0);
+
+	if (td->ncentroids >= td->maxcentroids)
+		tdigest_compress(td);
+
+	td->centroids[td->ncentroids].mean = value;
+	td->centroids[td->ncentroids].weight = weight;
+	td->ncentroids++;
+
+	if (td->count == 0 || value < td->min)
+		td->min = value;
+	if (td->count == 0 || value > td->max)
+		td->max = value;
+	td->count += weight;
+}
+
+/*
+ * Add all values summarized by another t-digest to a t-digest.
+ */
+void
+tdigest_merge(TDigest *td, const TDigest *other)
+{
+	double		min,
+				max;
+	int			i;
+
+	if (other->count == 0)
+		return;
+
+	min = (td->count == 0) ? other->min : Min(td->min, other->min);
+	max = (td->count == 0) ? other->max : Max(td->max, other->max);
+
+	for (i = 0; i < other->ncentroids; i++)
+		tdigest_add(td, other->centroids[i].mean, other->centroids[i].weight);
+
+	/* The other digest's extremes may lie outside all its centroids' means */
+	td->min = min;
+	td->max = max;
+}
+
+/*
+ * Sort the centroids of a t-digest and merge as many as the scale function
+ * allows.
+ */
+void
+tdigest_compress(TDigest *td)
+{
+	TDigestCentroid *c = td->centroids;
+	double		normalizer = td->compression / (2 * M_PI);
+	double		weight_so_far;
+	double		q_limit;
+	int			nmerged;
+	int			i;
+
+	if (td->ncentroids <= 1)
+		return;
+
+	qsort(c, td->ncentroids, sizeof(TDigestCentroid), centroid_cmp);
+
+	/*
+	 * Merge each centroid into the one being built, if the latter's upper
+	 * edge stays within one unit of k from its lower edge.
+	 */
+	weight_so_far = 0;
+	q_limit = (sin(Min(normalizer * asin(-1.0) + 1, normalizer * M_PI / 2) /
+				   normalizer) + 1) / 2;
+	nmerged = 0;
+	for (i = 1; i < td->ncentroids; i++)
+	{
+		double		proposed = c[nmerged].weight + c[i].weight;
+
+		if ((weight_so_far + proposed) / td->count <= q_limit)
+		{
+			c[nmerged].weight = proposed;
+			c[nmerged].mean += (c[i].mean - c[nmerged].mean) *
+				c[i].weight / proposed;
+		}
+		else
+		{
+			double		k;
+
+			weight_so_far += c[nmerged].weight;
+			k = normalizer * asin(2 * Min(weight_so_far / td->count, 1.0) - 1) + 1;
+			q_limit = (sin(Min(k, normalizer * M_PI / 2) / normalizer) + 1) / 2;
+			c[++nmerged] = c[i];
+		}
+	}
+	td->ncentroids = nmerged + 1;
+}
+
+/*
+ * Estimate the value at quantile q (between 0 and 1) of a t-digest.
+ *
+ * The result matches percentile_cont as long as no centroids have been
+ * merged: we place the i'th of n values at position i on a scale from 0 to
+ * n - 1, a centroid of weight w in the middle of the w positions it covers,
+ * and the minimum and maximum at the ends, and interpolate linearly between
+ * the two points on either side of position q * (n - 1).
+ */
+double
+tdigest_quantile(TDigest *td, double q)
+{
+	TDigestCentroid *c;
+	double		index;
+	double		lo_pos,
+				lo_val,
+				weight_so_far;
+	int			i;
+
+	Assert(td->count > 0);
+	Assert(q >= 0 && q <= 1);
+
+	tdigest_compress(td);
+	c = td->centroids;
+
+	index = q * (td->count - 1);
+	lo_pos = 0;
+	lo_val = td->min;
+	weight_so_far = 0;
+	for (i = 0; i < td->ncentroids; i++)
+	{
+		double		pos = weight_so_far + (c[i].weight - 1) / 2;
+
+		if (index <= pos)
+		{
+			if (pos <= lo_pos)
+				return c[i].mean;
+			return lo_val + (c[i].mean - lo_val) * (index - lo_pos) / (pos - lo_pos);
+		}
+		lo_pos = pos;
+		lo_val = c[i].mean;
+		weight_so_far += c[i].weight;
+	}
+
+	/* Between the last centroid and the maximum */
+	if (td->count - 1 <= lo_pos)
+		return td->max;
+	return lo_val + (td->max - lo_val) * (index - lo_pos) / (td->count - 1 - lo_pos);
+}
+
+/*
+ * Free a t-digest.
+ */
+void
+tdigest_free(TDigest *td)
+{
+	pfree(td->centroids);
+	pfree(td);
+}
+
+/*
+ * qsort comparator to sort centroids by mean
+ */
+static int
+centroid_cmp(const void *a, const void *b)
+{
+	double		ma = ((const TDigestCentroid *) a)->mean;
+	double		mb = ((const TDigestCentroid *) b)->mean;
+
+	if (ma < mb)
+		return -1;
+	if (ma > mb)
+		return 1;
+	return 0;
+}
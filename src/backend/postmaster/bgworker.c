@@ -13,6 +13,7 @@
 #include "postgres.h"
 
 #include "access/parallel.h"
+#include "access/xlogparallel.h"
 #include "libpq/pqsignal.h"
 #include "miscadmin.h"
 #include "pgstat.h"
@@ -128,6 +129,15 @@ static const struct
 	},
 	{
 		"ApplyWorkerMain", ApplyWorkerMain
+	},
+	{
+		"ParallelApplyWorkerMain", ParallelApplyWorkerMain
+	},
+	{
+		"TableCopyWorkerMain", TableCopyWorkerMain
+	},
+	{
+		"ParallelRedoWorkerMain", ParallelRedoWorkerMain
 	}
 };
 
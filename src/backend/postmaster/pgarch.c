@@ -75,6 +75,13 @@
  */
 #define NUM_FILES_PER_DIRECTORY_SCAN 64
 
+/*
+ * Number of newly-ready files that backends can queue for the archiver in
+ * shared memory.  If the queue fills up, the archiver falls back to scanning
+ * archive_status.
+ */
+#define NUM_READY_QUEUE_ENTRIES 64
+
 /* Shared memory area for archiver process */
 typedef struct PgArchData
 {
@@ -85,10 +92,18 @@ typedef struct PgArchData
 	 */
 	bool		force_dir_scan;
 
+	/*
+	 * Files marked .ready since the archiver last looked, in the order they
+	 * were reported.  Protected by arch_lck.
+	 */
+	int			ready_count;
+	char		ready_files[NUM_READY_QUEUE_ENTRIES][MAX_XFN_CHARS + 1];
+
 	slock_t		arch_lck;
 } PgArchData;
 
 char	   *XLogArchiveLibrary = "";
+int			archive_concurrency = 1;
 
 
 /* ----------
@@ -109,7 +124,15 @@ static ArchiveModuleCallbacks ArchiveContext;
  * the highest-priority files to archive.  After the directory scan
  * completes, the file names are stored in ascending order of priority in
  * arch_files.  pgarch_readyXlog() returns files from arch_files until it
- * is empty, at which point another directory scan must be performed.
+ * is empty.
+ *
+ * Files that backends report through the shared ready queue are merged into
+ * arch_files the same way, so while the archiver keeps up, it need not scan
+ * the directory at all.  need_dir_scan records whether there may be .ready
+ * files that we don't know about: at startup, if a scan or merge had to
+ * leave files out, after giving up on a file, or if the shared queue
+ * overflowed.  We also rescan every PGARCH_AUTOWAKE_INTERVAL seconds as a
+ * safety net.
  *
  * We only need this data in the archiver process, so make it a palloc'd
  * struct rather than a bunch of static arrays.
@@ -117,6 +140,8 @@ static ArchiveModuleCallbacks ArchiveContext;
 struct arch_files_state
 {
 	binaryheap *arch_heap;
+	bool		need_dir_scan;
+	pg_time_t	last_dir_scan;
 	int			arch_files_size;	/* number of live entries in arch_files[] */
 	char	   *arch_files[NUM_FILES_PER_DIRECTORY_SCAN];
 	/* buffers underlying heap, and later arch_files[], entries: */
@@ -137,8 +162,14 @@ static volatile sig_atomic_t ready_to_stop = false;
 static void pgarch_waken_stop(SIGNAL_ARGS);
 static void pgarch_MainLoop(void);
 static void pgarch_ArchiverCopyLoop(void);
+static bool pgarch_checkOrphan(char *xlog, bool *removed);
 static bool pgarch_archiveXlog(char *xlog);
+static void pgarch_archiveXlogs(int nxlogs, char (*xlogs)[MAX_XFN_CHARS + 1],
+								bool *succeeded);
 static bool pgarch_readyXlog(char *xlog);
+static void pgarch_scanStatusDir(void);
+static void pgarch_considerFile(const char *basename);
+static void pgarch_fillArchFiles(void);
 static void pgarch_archiveDone(char *xlog);
 static void pgarch_die(int code, Datum arg);
 static void HandlePgArchInterrupts(void);
@@ -244,6 +275,8 @@ PgArchiverMain(void)
 	/* Create workspace for pgarch_readyXlog() */
 	arch_files = palloc(sizeof(struct arch_files_state));
 	arch_files->arch_files_size = 0;
+	arch_files->need_dir_scan = true;
+	arch_files->last_dir_scan = 0;
 
 	/* Initialize our max-heap for prioritizing files to archive. */
 	arch_files->arch_heap = binaryheap_allocate(NUM_FILES_PER_DIRECTORY_SCAN,
@@ -379,14 +412,19 @@ pgarch_MainLoop(void)
  * pgarch_ArchiverCopyLoop
  *
  * Archives all outstanding xlogs then returns
+ *
+ * If the archive module can archive several files at once, we hand it up to
+ * archive_concurrency files per call; otherwise we archive one at a time.
+ * Files that fail are retried, together, up to NUM_ARCHIVE_RETRIES times
+ * before we give up for now.
  */
 static void
 pgarch_ArchiverCopyLoop(void)
 {
-	char		xlog[MAX_XFN_CHARS + 1];
-
-	/* force directory scan in the first call to pgarch_readyXlog() */
-	arch_files->arch_files_size = 0;
+	char		xlogs[MAX_ARCHIVE_CONCURRENCY][MAX_XFN_CHARS + 1];
+	bool		succeeded[MAX_ARCHIVE_CONCURRENCY];
+	int			nxlogs = 0;
+	int			failures = 0;
 
 	/*
 	 * loop through all xlogs with archive_status of .ready and archive
@@ -394,114 +432,160 @@ pgarch_ArchiverCopyLoop(void)
 	 * some backend will add files onto the list of those that need archiving
 	 * while we are still copying earlier archives
 	 */
-	while (pgarch_readyXlog(xlog))
+	for (;;)
 	{
-		int			failures = 0;
-		int			failures_orphan = 0;
+		int			batchsize;
+		int			nfailed;
 
-		for (;;)
+		/*
+		 * Do not initiate any more archive commands after receiving SIGTERM,
+		 * nor after the postmaster has died unexpectedly. The first condition
+		 * is to try to keep from having init SIGKILL the command, and the
+		 * second is to avoid conflicts with another archiver spawned by a
+		 * newer postmaster.
+		 */
+		if (ShutdownRequestPending || !PostmasterIsAlive())
+			return;
+
+		/*
+		 * Check for barrier events and config update.  This is so that we'll
+		 * adopt a new setting for archive_command as soon as possible, even
+		 * if there is a backlog of files to be archived.
+		 */
+		HandlePgArchInterrupts();
+
+		/* can't do anything if not configured ... */
+		if (ArchiveContext.check_configured_cb != NULL &&
+			!ArchiveContext.check_configured_cb())
 		{
-			struct stat stat_buf;
-			char		pathname[MAXPGPATH];
+			ereport(WARNING,
+					(errmsg("archive_mode enabled, yet archiving is not configured")));
+			/* files of an unfinished batch are forgotten; find them again */
+			arch_files->need_dir_scan = true;
+			return;
+		}
 
-			/*
-			 * Do not initiate any more archive commands after receiving
-			 * SIGTERM, nor after the postmaster has died unexpectedly. The
-			 * first condition is to try to keep from having init SIGKILL the
-			 * command, and the second is to avoid conflicts with another
-			 * archiver spawned by a newer postmaster.
-			 */
-			if (ShutdownRequestPending || !PostmasterIsAlive())
-				return;
+		/*
+		 * Fill up the batch with the next files to archive, unless we're
+		 * retrying failed ones.
+		 */
+		batchsize = ArchiveContext.archive_files_cb != NULL ?
+			archive_concurrency : 1;
+		while (failures == 0 && nxlogs < batchsize &&
+			   pgarch_readyXlog(xlogs[nxlogs]))
+		{
+			bool		removed;
+			bool		dup = false;
 
-			/*
-			 * Check for barrier events and config update.  This is so that
-			 * we'll adopt a new setting for archive_command as soon as
-			 * possible, even if there is a backlog of files to be archived.
-			 */
-			HandlePgArchInterrupts();
+			/* a directory scan may return a file we already collected */
+			for (int i = 0; i < nxlogs && !dup; i++)
+				dup = (strcmp(xlogs[i], xlogs[nxlogs]) == 0);
+			if (dup)
+				break;
 
-			/* can't do anything if not configured ... */
-			if (ArchiveContext.check_configured_cb != NULL &&
-				!ArchiveContext.check_configured_cb())
-			{
-				ereport(WARNING,
-						(errmsg("archive_mode enabled, yet archiving is not configured")));
-				return;
-			}
+			if (!pgarch_checkOrphan(xlogs[nxlogs], &removed))
+				return;			/* give up cleanup of orphan status files */
+			if (!removed)
+				nxlogs++;
+		}
+
+		if (nxlogs == 0)
+			return;				/* nothing left to do */
 
+		pgarch_archiveXlogs(nxlogs, xlogs, succeeded);
+
+		/*
+		 * Mark the successfully archived files done, and move the failed ones
+		 * to the front of the batch.
+		 */
+		nfailed = 0;
+		for (int i = 0; i < nxlogs; i++)
+		{
 			/*
-			 * Since archive status files are not removed in a durable manner,
-			 * a system crash could leave behind .ready files for WAL segments
-			 * that have already been recycled or removed.  In this case,
-			 * simply remove the orphan status file and move on.  unlink() is
-			 * used here as even on subsequent crashes the same orphan files
-			 * would get removed, so there is no need to worry about
-			 * durability.
+			 * Tell the cumulative stats system about the WAL file that we
+			 * archived, or failed to archive
 			 */
-			snprintf(pathname, MAXPGPATH, XLOGDIR "/%s", xlog);
-			if (stat(pathname, &stat_buf) != 0 && errno == ENOENT)
+			pgstat_report_archiver(xlogs[i], !succeeded[i]);
+
+			if (succeeded[i])
+				pgarch_archiveDone(xlogs[i]);
+			else
 			{
-				char		xlogready[MAXPGPATH];
-
-				StatusFilePath(xlogready, xlog, ".ready");
-				if (unlink(xlogready) == 0)
-				{
-					ereport(WARNING,
-							(errmsg("removed orphan archive status file \"%s\"",
-									xlogready)));
-
-					/* leave loop and move to the next status file */
-					break;
-				}
-
-				if (++failures_orphan >= NUM_ORPHAN_CLEANUP_RETRIES)
-				{
-					ereport(WARNING,
-							(errmsg("removal of orphan archive status file \"%s\" failed too many times, will try again later",
-									xlogready)));
-
-					/* give up cleanup of orphan status files */
-					return;
-				}
-
-				/* wait a bit before retrying */
-				pg_usleep(1000000L);
-				continue;
+				if (nfailed != i)
+					strcpy(xlogs[nfailed], xlogs[i]);
+				nfailed++;
 			}
+		}
+		nxlogs = nfailed;
 
-			if (pgarch_archiveXlog(xlog))
-			{
-				/* successful */
-				pgarch_archiveDone(xlog);
+		if (nfailed == 0)
+		{
+			failures = 0;
+			continue;
+		}
+
+		if (++failures >= NUM_ARCHIVE_RETRIES)
+		{
+			ereport(WARNING,
+					(errmsg("archiving write-ahead log file \"%s\" failed too many times, will try again later",
+							xlogs[0])));
 
-				/*
-				 * Tell the cumulative stats system about the WAL file that we
-				 * successfully archived
-				 */
-				pgstat_report_archiver(xlog, false);
+			/* make sure we find the failed files again */
+			arch_files->need_dir_scan = true;
+			return;				/* give up archiving for now */
+		}
+		pg_usleep(1000000L);	/* wait a bit before retrying */
+	}
+}
 
-				break;			/* out of inner retry loop */
-			}
-			else
-			{
-				/*
-				 * Tell the cumulative stats system about the WAL file that we
-				 * failed to archive
-				 */
-				pgstat_report_archiver(xlog, true);
-
-				if (++failures >= NUM_ARCHIVE_RETRIES)
-				{
-					ereport(WARNING,
-							(errmsg("archiving write-ahead log file \"%s\" failed too many times, will try again later",
-									xlog)));
-					return;		/* give up archiving for now */
-				}
-				pg_usleep(1000000L);	/* wait a bit before retrying */
-			}
+/*
+ * pgarch_checkOrphan
+ *
+ * Since archive status files are not removed in a durable manner, a system
+ * crash could leave behind .ready files for WAL segments that have already
+ * been recycled or removed.  In this case, simply remove the orphan status
+ * file and move on.  unlink() is used here as even on subsequent crashes the
+ * same orphan files would get removed, so there is no need to worry about
+ * durability.
+ *
+ * Sets *removed if xlog was an orphan whose status file we removed.  Returns
+ * false if we failed to remove an orphan status file too many times.
+ */
+static bool
+pgarch_checkOrphan(char *xlog, bool *removed)
+{
+	struct stat stat_buf;
+	char		pathname[MAXPGPATH];
+	char		xlogready[MAXPGPATH];
+	int			failures_orphan = 0;
+
+	*removed = false;
+
+	snprintf(pathname, MAXPGPATH, XLOGDIR "/%s", xlog);
+	if (stat(pathname, &stat_buf) == 0 || errno != ENOENT)
+		return true;
+
+	StatusFilePath(xlogready, xlog, ".ready");
+	while (unlink(xlogready) != 0)
+	{
+		if (++failures_orphan >= NUM_ORPHAN_CLEANUP_RETRIES)
+		{
+			ereport(WARNING,
+					(errmsg("removal of orphan archive status file \"%s\" failed too many times, will try again later",
+							xlogready)));
+			arch_files->need_dir_scan = true;
+			return false;
 		}
+
+		/* wait a bit before retrying */
+		pg_usleep(1000000L);
 	}
+
+	ereport(WARNING,
+			(errmsg("removed orphan archive status file \"%s\"",
+					xlogready)));
+	*removed = true;
+	return true;
 }
 
 /*
@@ -534,14 +618,71 @@ pgarch_archiveXlog(char *xlog)
 	return ret;
 }
 
+/*
+ * pgarch_archiveXlogs
+ *
+ * Archives a batch of files, using archive_files_cb if there's more than one.
+ * succeeded[i] is set to whether xlogs[i] was archived successfully.
+ */
+static void
+pgarch_archiveXlogs(int nxlogs, char (*xlogs)[MAX_XFN_CHARS + 1],
+					bool *succeeded)
+{
+	char		pathnames[MAX_ARCHIVE_CONCURRENCY][MAXPGPATH];
+	const char *files[MAX_ARCHIVE_CONCURRENCY];
+	const char *paths[MAX_ARCHIVE_CONCURRENCY];
+	char		activitymsg[MAXFNAMELEN + 32];
+	int			nfailed = 0;
+
+	Assert(nxlogs > 0 && nxlogs <= MAX_ARCHIVE_CONCURRENCY);
+
+	if (nxlogs == 1)
+	{
+		succeeded[0] = pgarch_archiveXlog(xlogs[0]);
+		return;
+	}
+
+	Assert(ArchiveContext.archive_files_cb != NULL);
+
+	for (int i = 0; i < nxlogs; i++)
+	{
+		snprintf(pathnames[i], MAXPGPATH, XLOGDIR "/%s", xlogs[i]);
+		files[i] = xlogs[i];
+		paths[i] = pathnames[i];
+		succeeded[i] = false;
+	}
+
+	/* Report archive activity in PS display */
+	snprintf(activitymsg, sizeof(activitymsg), "archiving %s and %d more",
+			 xlogs[0], nxlogs - 1);
+	set_ps_display(activitymsg);
+
+	ArchiveContext.archive_files_cb(nxlogs, files, paths, succeeded);
+
+	for (int i = 0; i < nxlogs; i++)
+	{
+		if (!succeeded[i])
+		{
+			if (nfailed++ == 0)
+				snprintf(activitymsg, sizeof(activitymsg), "failed on %s",
+						 xlogs[i]);
+		}
+	}
+	if (nfailed == 0)
+		snprintf(activitymsg, sizeof(activitymsg), "last was %s",
+				 xlogs[nxlogs - 1]);
+	set_ps_display(activitymsg);
+}
+
 /*
  * pgarch_readyXlog
  *
  * Return name of the oldest xlog file that has not yet been archived.
- * No notification is set that file archiving is now in progress, so
- * this would need to be extended if multiple concurrent archival
- * tasks were created. If a failure occurs, we will completely
- * re-copy the file at the next available opportunity.
+ * No notification is set that file archiving is now in progress, so a
+ * directory scan may return a file that the caller has already collected
+ * for the current batch; pgarch_ArchiverCopyLoop() must cope with that.
+ * If a failure occurs, we will completely re-copy the file at the next
+ * available opportunity.
  *
  * It is important that we return the oldest, so that we archive xlogs
  * in order that they were written, for two reasons:
@@ -559,52 +700,115 @@ pgarch_archiveXlog(char *xlog)
 static bool
 pgarch_readyXlog(char *xlog)
 {
-	char		XLogArchiveStatusDir[MAXPGPATH];
-	DIR		   *rldir;
-	struct dirent *rlde;
 	bool		force_dir_scan;
+	bool		scanned = false;
+	int			nready;
+	char		ready_files[NUM_READY_QUEUE_ENTRIES][MAX_XFN_CHARS + 1];
+	pg_time_t	now = (pg_time_t) time(NULL);
 
 	/*
-	 * If a directory scan was requested, clear the stored file names and
-	 * proceed.
+	 * Collect the files that backends have reported since we last looked,
+	 * and check whether a directory scan was requested.
 	 */
 	SpinLockAcquire(&PgArch->arch_lck);
 	force_dir_scan = PgArch->force_dir_scan;
 	PgArch->force_dir_scan = false;
+	nready = PgArch->ready_count;
+	if (nready > 0)
+		memcpy(ready_files, PgArch->ready_files, nready * sizeof(ready_files[0]));
+	PgArch->ready_count = 0;
 	SpinLockRelease(&PgArch->arch_lck);
 
-	if (force_dir_scan)
-		arch_files->arch_files_size = 0;
-
 	/*
-	 * If we still have stored file names from the previous directory scan,
-	 * try to return one of those.  We check to make sure the status file is
-	 * still present, as the archive_command for a previous file may have
-	 * already marked it done.
+	 * If a directory scan was requested, or it's been a while since the last
+	 * one, clear the stored file names and proceed to scan.  Otherwise merge
+	 * the newly reported files into the ones we know about.
 	 */
-	while (arch_files->arch_files_size > 0)
+	if (force_dir_scan ||
+		now - arch_files->last_dir_scan >= PGARCH_AUTOWAKE_INTERVAL)
 	{
-		struct stat st;
-		char		status_file[MAXPGPATH];
-		char	   *arch_file;
+		arch_files->arch_files_size = 0;
+		arch_files->need_dir_scan = true;
+	}
+	else if (nready > 0)
+	{
+		char		known_files[NUM_FILES_PER_DIRECTORY_SCAN][MAX_XFN_CHARS + 1];
+		int			nknown = arch_files->arch_files_size;
+
+		/* copy out the known names, since they live in the heap's buffers */
+		for (int i = 0; i < nknown; i++)
+			strcpy(known_files[i], arch_files->arch_files[i]);
 
-		arch_files->arch_files_size--;
-		arch_file = arch_files->arch_files[arch_files->arch_files_size];
-		StatusFilePath(status_file, arch_file, ".ready");
+		binaryheap_reset(arch_files->arch_heap);
+		for (int i = 0; i < nknown; i++)
+			pgarch_considerFile(known_files[i]);
+		for (int i = 0; i < nready; i++)
+		{
+			bool		known = false;
 
-		if (stat(status_file, &st) == 0)
+			for (int j = 0; j < nknown && !known; j++)
+				known = (strcmp(known_files[j], ready_files[i]) == 0);
+			if (!known)
+				pgarch_considerFile(ready_files[i]);
+		}
+		pgarch_fillArchFiles();
+	}
+
+	for (;;)
+	{
+		/*
+		 * If we have stored file names, try to return one of those.  We
+		 * check to make sure the status file is still present, as the
+		 * archive_command for a previous file may have already marked it
+		 * done.
+		 */
+		while (arch_files->arch_files_size > 0)
 		{
-			strcpy(xlog, arch_file);
-			return true;
+			struct stat st;
+			char		status_file[MAXPGPATH];
+			char	   *arch_file;
+
+			arch_files->arch_files_size--;
+			arch_file = arch_files->arch_files[arch_files->arch_files_size];
+			StatusFilePath(status_file, arch_file, ".ready");
+
+			if (stat(status_file, &st) == 0)
+			{
+				strcpy(xlog, arch_file);
+				return true;
+			}
+			else if (errno != ENOENT)
+				ereport(ERROR,
+						(errcode_for_file_access(),
+						 errmsg("could not stat file \"%s\": %m", status_file)));
 		}
-		else if (errno != ENOENT)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not stat file \"%s\": %m", status_file)));
+
+		/* Out of names; scan the directory if there may be more */
+		if (!arch_files->need_dir_scan || scanned)
+			return false;
+
+		pgarch_scanStatusDir();
+		scanned = true;
 	}
+}
+
+/*
+ * pgarch_scanStatusDir
+ *
+ * Read through the archive status directory, and store the names of the
+ * highest-priority files with the .ready suffix in arch_files.
+ */
+static void
+pgarch_scanStatusDir(void)
+{
+	char		XLogArchiveStatusDir[MAXPGPATH];
+	DIR		   *rldir;
+	struct dirent *rlde;
 
 	/* arch_heap is probably empty, but let's make sure */
 	binaryheap_reset(arch_files->arch_heap);
+	arch_files->need_dir_scan = false;
+	arch_files->last_dir_scan = (pg_time_t) time(NULL);
 
 	/*
 	 * Open the archive status directory and read through the list of files
@@ -617,7 +821,6 @@ pgarch_readyXlog(char *xlog)
 	{
 		int			basenamelen = (int) strlen(rlde->d_name) - 6;
 		char		basename[MAX_XFN_CHARS + 1];
-		char	   *arch_file;
 
 		/* Ignore entries with unexpected number of characters */
 		if (basenamelen < MIN_XFN_CHARS ||
@@ -636,58 +839,75 @@ pgarch_readyXlog(char *xlog)
 		memcpy(basename, rlde->d_name, basenamelen);
 		basename[basenamelen] = '\0';
 
-		/*
-		 * Store the file in our max-heap if it has a high enough priority.
-		 */
-		if (arch_files->arch_heap->bh_size < NUM_FILES_PER_DIRECTORY_SCAN)
-		{
-			/* If the heap isn't full yet, quickly add it. */
-			arch_file = arch_files->arch_filenames[arch_files->arch_heap->bh_size];
-			strcpy(arch_file, basename);
-			binaryheap_add_unordered(arch_files->arch_heap, CStringGetDatum(arch_file));
+		pgarch_considerFile(basename);
+	}
+	FreeDir(rldir);
 
-			/* If we just filled the heap, make it a valid one. */
-			if (arch_files->arch_heap->bh_size == NUM_FILES_PER_DIRECTORY_SCAN)
-				binaryheap_build(arch_files->arch_heap);
-		}
-		else if (ready_file_comparator(binaryheap_first(arch_files->arch_heap),
-									   CStringGetDatum(basename), NULL) > 0)
+	pgarch_fillArchFiles();
+}
+
+/*
+ * pgarch_considerFile
+ *
+ * Store the file in our max-heap if it has a high enough priority.  If a
+ * file has to be left out because the heap is full, remember that we need to
+ * scan the directory again once we run out of files.
+ */
+static void
+pgarch_considerFile(const char *basename)
+{
+	binaryheap *heap = arch_files->arch_heap;
+	char	   *arch_file;
+
+	if (heap->bh_size < NUM_FILES_PER_DIRECTORY_SCAN)
+	{
+		/* If the heap isn't full yet, quickly add it. */
+		arch_file = arch_files->arch_filenames[heap->bh_size];
+		strcpy(arch_file, basename);
+		binaryheap_add_unordered(heap, CStringGetDatum(arch_file));
+
+		/* If we just filled the heap, make it a valid one. */
+		if (heap->bh_size == NUM_FILES_PER_DIRECTORY_SCAN)
+			binaryheap_build(heap);
+	}
+	else
+	{
+		arch_files->need_dir_scan = true;
+
+		if (ready_file_comparator(binaryheap_first(heap),
+								  CStringGetDatum(basename), NULL) > 0)
 		{
 			/*
 			 * Remove the lowest priority file and add the current one to the
 			 * heap.
 			 */
-			arch_file = DatumGetCString(binaryheap_remove_first(arch_files->arch_heap));
+			arch_file = DatumGetCString(binaryheap_remove_first(heap));
 			strcpy(arch_file, basename);
-			binaryheap_add(arch_files->arch_heap, CStringGetDatum(arch_file));
+			binaryheap_add(heap, CStringGetDatum(arch_file));
 		}
 	}
-	FreeDir(rldir);
+}
 
-	/* If no files were found, simply return. */
-	if (arch_files->arch_heap->bh_size == 0)
-		return false;
+/*
+ * pgarch_fillArchFiles
+ *
+ * Empty the heap into arch_files, in ascending order of priority.
+ */
+static void
+pgarch_fillArchFiles(void)
+{
+	binaryheap *heap = arch_files->arch_heap;
 
 	/*
 	 * If we didn't fill the heap, we didn't make it a valid one.  Do that
 	 * now.
 	 */
-	if (arch_files->arch_heap->bh_size < NUM_FILES_PER_DIRECTORY_SCAN)
-		binaryheap_build(arch_files->arch_heap);
+	if (heap->bh_size < NUM_FILES_PER_DIRECTORY_SCAN)
+		binaryheap_build(heap);
 
-	/*
-	 * Fill arch_files array with the files to archive in ascending order of
-	 * priority.
-	 */
-	arch_files->arch_files_size = arch_files->arch_heap->bh_size;
+	arch_files->arch_files_size = heap->bh_size;
 	for (int i = 0; i < arch_files->arch_files_size; i++)
-		arch_files->arch_files[i] = DatumGetCString(binaryheap_remove_first(arch_files->arch_heap));
-
-	/* Return the highest priority file. */
-	arch_files->arch_files_size--;
-	strcpy(xlog, arch_files->arch_files[arch_files->arch_files_size]);
-
-	return true;
+		arch_files->arch_files[i] = DatumGetCString(binaryheap_remove_first(heap));
 }
 
 /*
@@ -729,6 +949,28 @@ PgArchForceDirScan(void)
 	SpinLockRelease(&PgArch->arch_lck);
 }
 
+/*
+ * PgArchNotifyReady
+ *
+ * Tell the archiver that the given file has just been marked .ready, so
+ * that it can be archived without scanning the archive_status directory.
+ * If the queue is full, a directory scan is forced instead.  The caller
+ * is responsible for waking up the archiver.
+ */
+void
+PgArchNotifyReady(const char *xlog)
+{
+	Assert(strlen(xlog) <= MAX_XFN_CHARS);
+
+	SpinLockAcquire(&PgArch->arch_lck);
+	if (PgArch->ready_count < NUM_READY_QUEUE_ENTRIES)
+		strlcpy(PgArch->ready_files[PgArch->ready_count++], xlog,
+				MAX_XFN_CHARS + 1);
+	else
+		PgArch->force_dir_scan = true;
+	SpinLockRelease(&PgArch->arch_lck);
+}
+
 /*
  * pgarch_archiveDone
  *
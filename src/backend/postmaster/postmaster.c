@@ -514,6 +514,7 @@ typedef struct
 	bool		query_id_enabled;
 	int			max_safe_fds;
 	int			MaxBackends;
+	int			FastPathLockGroupsPerBackend;
 #ifdef WIN32
 	HANDLE		PostmasterHandle;
 	HANDLE		initial_signal_pipe;
@@ -1033,9 +1034,10 @@ PostmasterMain(int argc, char *argv[])
 
 	/*
 	 * Now that loadable modules have had their chance to alter any GUCs,
-	 * calculate MaxBackends.
+	 * calculate MaxBackends and the number of fast-path lock groups.
 	 */
 	InitializeMaxBackends();
+	InitializeFastPathLocks();
 
 	/*
 	 * Give preloaded libraries a chance to request additional shared memory.
@@ -2254,12 +2256,24 @@ retry1:
 									valptr),
 							 errhint("Valid values are: \"false\", 0, \"true\", 1, \"database\".")));
 			}
+			else if (strcmp(nameptr, "_pq_.multirow_bind") == 0)
+			{
+				/*
+				 * Allow Bind messages to carry several parameter sets; see
+				 * exec_bind_message().
+				 */
+				if (!parse_bool(valptr, &port->multirow_bind))
+					ereport(FATAL,
+							(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							 errmsg("invalid value for parameter \"%s\": \"%s\"",
+									"_pq_.multirow_bind",
+									valptr)));
+			}
 			else if (strncmp(nameptr, "_pq_.", 5) == 0)
 			{
 				/*
-				 * Any option beginning with _pq_. is reserved for use as a
-				 * protocol-level option, but at present no such options are
-				 * defined.
+				 * Any other option beginning with _pq_. is reserved for use
+				 * as a protocol-level option that we don't know about.
 				 */
 				unrecognized_protocol_options =
 					lappend(unrecognized_protocol_options, pstrdup(nameptr));
@@ -6143,6 +6157,7 @@ save_backend_variables(BackendParameters *param, Port *port,
 	param->max_safe_fds = max_safe_fds;
 
 	param->MaxBackends = MaxBackends;
+	param->FastPathLockGroupsPerBackend = FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	param->PostmasterHandle = PostmasterHandle;
@@ -6376,6 +6391,7 @@ restore_backend_variables(BackendParameters *param, Port *port)
 	max_safe_fds = param->max_safe_fds;
 
 	MaxBackends = param->MaxBackends;
+	FastPathLockGroupsPerBackend = param->FastPathLockGroupsPerBackend;
 
 #ifdef WIN32
 	PostmasterHandle = param->PostmasterHandle;
@@ -20,9 +20,15 @@
 #include "access/xlog.h"
 #include "pgstat.h"
 #include "postmaster/pgarch.h"
+#include "storage/fd.h"
 
 static bool shell_archive_configured(void);
 static bool shell_archive_file(const char *file, const char *path);
+static void shell_archive_files(int nfiles, const char *const *files,
+								const char *const *paths, bool *succeeded);
+static void build_archive_command(char *xlogarchcmd, const char *file,
+								  const char *path);
+static bool check_archive_command_result(int rc, const char *xlogarchcmd);
 
 void
 shell_archive_init(ArchiveModuleCallbacks *cb)
@@ -31,6 +37,7 @@ shell_archive_init(ArchiveModuleCallbacks *cb)
 
 	cb->check_configured_cb = shell_archive_configured;
 	cb->archive_file_cb = shell_archive_file;
+	cb->archive_files_cb = shell_archive_files;
 }
 
 static bool
@@ -43,14 +50,104 @@ static bool
 shell_archive_file(const char *file, const char *path)
 {
 	char		xlogarchcmd[MAXPGPATH];
+	int			rc;
+
+	build_archive_command(xlogarchcmd, file, path);
+
+	ereport(DEBUG3,
+			(errmsg_internal("executing archive command \"%s\"",
+							 xlogarchcmd)));
+
+	fflush(NULL);
+	pgstat_report_wait_start(WAIT_EVENT_ARCHIVE_COMMAND);
+	rc = system(xlogarchcmd);
+	pgstat_report_wait_end();
+
+	if (!check_archive_command_result(rc, xlogarchcmd))
+		return false;
+
+	elog(DEBUG1, "archived write-ahead log file \"%s\"", file);
+	return true;
+}
+
+/*
+ * Archive several files by running one archive_command per file, all at the
+ * same time.  The commands are started with popen() so that we don't wait
+ * for one to finish before starting the next; their standard input is
+ * connected to a pipe that we close when collecting their exit status.
+ *
+ * We collect the exit status of every command before reporting any of them,
+ * since a command that died on a signal makes us exit with FATAL, and we
+ * must not leave the other commands running behind us.  For the same
+ * reason, such failures are reported after all the others.
+ */
+static void
+shell_archive_files(int nfiles, const char *const *files,
+					const char *const *paths, bool *succeeded)
+{
+	char		xlogarchcmds[MAX_ARCHIVE_CONCURRENCY][MAXPGPATH];
+	FILE	   *pipes[MAX_ARCHIVE_CONCURRENCY];
+	int			rcs[MAX_ARCHIVE_CONCURRENCY];
+	bool		started[MAX_ARCHIVE_CONCURRENCY];
+
+	Assert(nfiles <= MAX_ARCHIVE_CONCURRENCY);
+
+	fflush(NULL);
+	for (int i = 0; i < nfiles; i++)
+	{
+		build_archive_command(xlogarchcmds[i], files[i], paths[i]);
+
+		ereport(DEBUG3,
+				(errmsg_internal("executing archive command \"%s\"",
+								 xlogarchcmds[i])));
+
+		succeeded[i] = false;
+		pipes[i] = OpenPipeStream(xlogarchcmds[i], PG_BINARY_W);
+		started[i] = (pipes[i] != NULL);
+		if (!started[i])
+			ereport(LOG,
+					(errcode_for_file_access(),
+					 errmsg("could not execute command \"%s\": %m",
+							xlogarchcmds[i])));
+	}
+
+	pgstat_report_wait_start(WAIT_EVENT_ARCHIVE_COMMAND);
+	for (int i = 0; i < nfiles; i++)
+	{
+		if (started[i])
+			rcs[i] = ClosePipeStream(pipes[i]);
+	}
+	pgstat_report_wait_end();
+
+	/* Report ordinary results first, then commands that died on a signal */
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (int i = 0; i < nfiles; i++)
+		{
+			if (!started[i] ||
+				wait_result_is_any_signal(rcs[i], true) != (pass == 1))
+				continue;
+
+			if (check_archive_command_result(rcs[i], xlogarchcmds[i]))
+			{
+				elog(DEBUG1, "archived write-ahead log file \"%s\"", files[i]);
+				succeeded[i] = true;
+			}
+		}
+	}
+}
+
+/*
+ * Construct the command to be executed for archiving one file.
+ * xlogarchcmd must point to a buffer of MAXPGPATH bytes.
+ */
+static void
+build_archive_command(char *xlogarchcmd, const char *file, const char *path)
+{
 	char	   *dp;
 	char	   *endp;
 	const char *sp;
-	int			rc;
 
-	/*
-	 * construct the command to be executed
-	 */
 	dp = xlogarchcmd;
 	endp = xlogarchcmd + MAXPGPATH - 1;
 	*endp = '\0';
@@ -94,16 +191,15 @@ shell_archive_file(const char *file, const char *path)
 		}
 	}
 	*dp = '\0';
+}
 
-	ereport(DEBUG3,
-			(errmsg_internal("executing archive command \"%s\"",
-							 xlogarchcmd)));
-
-	fflush(NULL);
-	pgstat_report_wait_start(WAIT_EVENT_ARCHIVE_COMMAND);
-	rc = system(xlogarchcmd);
-	pgstat_report_wait_end();
-
+/*
+ * Check the exit status of an archive command, reporting any failure.
+ * Returns true if the command succeeded.
+ */
+static bool
+check_archive_command_result(int rc, const char *xlogarchcmd)
+{
 	if (rc != 0)
 	{
 		/*
@@ -153,6 +249,5 @@ shell_archive_file(const char *file, const char *path)
 		return false;
 	}
 
-	elog(DEBUG1, "archived write-ahead log file \"%s\"", file);
 	return true;
 }
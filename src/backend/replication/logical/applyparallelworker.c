@@ -0,0 +1,887 @@
+/*-------------------------------------------------------------------------
+ * applyparallelworker.c
+ *	   Support routines for applying xact by parallel apply worker
+ *
+ * Copyright (c) 2022, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  src/backend/replication/logical/applyparallelworker.c
+ *
+ * NOTES
+ *	  This file contains the code to launch, set up, and teardown a parallel
+ *	  apply worker which receives the changes from the leader worker and
+ *	  invokes routines to apply those on the subscriber database.
+ *
+ *	  Without parallel apply, a streamed transaction is spooled to a file by
+ *	  the leader apply worker and only applied once the commit arrives (see
+ *	  STREAMED TRANSACTIONS atop worker.c).  With the subscription option
+ *	  streaming = parallel, the leader instead hands the changes of a
+ *	  streamed transaction to a parallel apply worker as they arrive, which
+ *	  applies them right away, so that a large transaction is applied while
+ *	  it is still being received rather than all at once after its commit.
+ *
+ *	  The leader apply worker and the parallel apply worker share a dynamic
+ *	  shared memory segment holding a ParallelApplyWorkerShared struct and a
+ *	  shm_mq through which the leader sends each protocol message of the
+ *	  streamed transaction, unmodified.  The parallel apply worker feeds the
+ *	  messages through apply_dispatch() just like the leader does for the
+ *	  messages it receives from the publisher.  Subtransactions are mapped to
+ *	  savepoints, so that a STREAM ABORT of a subtransaction can be handled
+ *	  by rolling back to the savepoint.
+ *
+ *	  At most one streamed transaction is applied in parallel at any time;
+ *	  when a streamed transaction starts while the parallel apply worker is
+ *	  busy, or when one can't be started, the leader spools that transaction
+ *	  to a file as before.  A single parallel apply worker per leader is
+ *	  enough for that, so it is launched on first use and reused until the
+ *	  leader exits.  Allowing several transactions in flight would let the
+ *	  leader block on a full queue while the receiving worker waits for a
+ *	  lock held by another parallel apply worker, a wait cycle the deadlock
+ *	  detector can't see.
+ *
+ *	  We don't start a parallel apply worker unless all the tables of the
+ *	  subscription are in READY state, because we can't tell whether to apply
+ *	  a change to a table that is being synchronized before knowing the final
+ *	  LSN of the transaction.  Likewise, transactions are not applied in
+ *	  parallel while the subscription's skiplsn is set, as skipping depends
+ *	  on the finish LSN too, nor when two_phase is enabled, since a prepared
+ *	  streamed transaction has to be replayed from the spool file.
+ *
+ * LOCKING CONSIDERATIONS
+ * ----------------------
+ *	  Two heavyweight session locks on a LOCKTAG_APPLY_TRANSACTION tag
+ *	  identifying the remote transaction keep all waits between the leader
+ *	  and the parallel apply worker visible to the deadlock detector.
+ *
+ *	  The transaction lock is held in AccessExclusiveLock mode by the parallel
+ *	  apply worker from the first STREAM START of the transaction until it
+ *	  has committed or aborted it.  At STREAM COMMIT and toplevel STREAM
+ *	  ABORT, the leader waits for it in AccessShareLock mode before carrying
+ *	  on, which preserves the commit order of the publisher.  If the
+ *	  parallel apply worker waits for a lock held by a transaction being
+ *	  applied by the leader meanwhile, the deadlock detector sees the cycle.
+ *
+ *	  The stream lock is taken in AccessExclusiveLock mode by the leader
+ *	  before it sends a STREAM STOP and released when it sends the next
+ *	  STREAM START of the transaction (or the commit or abort).  When the
+ *	  parallel apply worker has run out of streaming blocks to apply, it
+ *	  waits for that lock in AccessShareLock mode, so that a leader waiting
+ *	  for a lock held by the parallel apply worker's open transaction is
+ *	  also detected as a deadlock.  The number of streaming blocks sent but
+ *	  not yet processed is tracked in pending_stream_count so that the
+ *	  parallel apply worker doesn't wait while there are still messages in
+ *	  the queue.
+ *
+ *	  Session locks are not released at transaction end, so both workers
+ *	  release them explicitly when they exit; see logicalrep_worker_onexit().
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "libpq/pqformat.h"
+#include "libpq/pqsignal.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "replication/logicalworker.h"
+#include "replication/origin.h"
+#include "replication/worker_internal.h"
+#include "storage/ipc.h"
+#include "storage/lmgr.h"
+#include "storage/shm_toc.h"
+#include "tcop/tcopprot.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+
+#define PG_LOGICAL_APPLY_SHM_MAGIC 0x787ca067
+
+/*
+ * DSM keys for parallel apply worker. Unlike other parallel execution code,
+ * since we don't need to worry about DSM keys conflicting with plan_node_id
+ * we can use small integers.
+ */
+#define PARALLEL_APPLY_KEY_SHARED		1
+#define PARALLEL_APPLY_KEY_MQ			2
+
+/* Queue size of DSM, 16 MB for now. */
+#define DSM_QUEUE_SIZE	(16 * 1024 * 1024)
+
+/*
+ * Wait time (ms) between attempts to send a message to the parallel apply
+ * worker while its queue is full.
+ */
+#define SHM_SEND_RETRY_INTERVAL_MS 1000
+
+/* Identifiers of the two locks taken on a remote transaction */
+#define PARALLEL_APPLY_LOCK_STREAM	0
+#define PARALLEL_APPLY_LOCK_XACT	1
+
+/*
+ * The parallel apply worker of this leader apply worker, if one has been
+ * launched.  It is reused for later streamed transactions until the leader
+ * exits.
+ */
+static ParallelApplyWorkerInfo *ParallelApplyWorker = NULL;
+
+/*
+ * Information shared between the leader and this parallel apply worker, set
+ * only in parallel apply workers.
+ */
+ParallelApplyWorkerShared *MyParallelShared = NULL;
+
+/*
+ * XIDs of the subtransactions of the transaction being applied for which a
+ * savepoint has been defined, in the order they were defined.
+ */
+static List *subxactlist = NIL;
+
+static bool pa_can_start(void);
+static ParallelApplyWorkerInfo *pa_launch_parallel_worker(void);
+static bool pa_setup_dsm(ParallelApplyWorkerInfo *winfo);
+static ParallelTransState pa_get_xact_state(ParallelApplyWorkerShared *wshared);
+static bool pa_has_exited(ParallelApplyWorkerShared *wshared);
+static void pa_wait_for_xact_state(ParallelApplyWorkerInfo *winfo,
+								   ParallelTransState xact_state);
+static void pa_savepoint_name(Oid suboid, TransactionId xid, char *spname,
+							  Size szsp);
+static void pa_shutdown(int code, Datum arg);
+static void LogicalParallelApplyLoop(shm_mq_handle *mqh);
+
+/*
+ * Returns true if it is OK to start a parallel apply worker for a new
+ * streamed transaction, false otherwise.
+ */
+static bool
+pa_can_start(void)
+{
+	/* Only leader apply workers can start parallel apply workers. */
+	if (!am_leader_apply_worker())
+		return false;
+
+	if (MySubscription->stream != LOGICALREP_STREAM_PARALLEL)
+		return false;
+
+	/*
+	 * Don't apply in parallel if the user has set skiplsn, as they might
+	 * want to skip this transaction and we won't know until its finish LSN
+	 * arrives.
+	 */
+	if (!XLogRecPtrIsInvalid(MySubscription->skiplsn))
+		return false;
+
+	/*
+	 * A streamed transaction may end with STREAM PREPARE when two_phase is
+	 * enabled, which is only supported for spooled transactions.
+	 */
+	if (MySubscription->twophasestate == LOGICALREP_TWOPHASE_STATE_ENABLED)
+		return false;
+
+	/*
+	 * We can't decide whether to apply a change for a relation that is not
+	 * in READY state without knowing the transaction's final LSN, see
+	 * should_apply_changes_for_rel().
+	 */
+	if (!AllTablesyncsReady())
+		return false;
+
+	return true;
+}
+
+/*
+ * Set up a dynamic shared memory segment for the parallel apply worker.
+ *
+ * We set up a control region that contains a fixed-size worker info
+ * (ParallelApplyWorkerShared) and a message queue from the leader to the
+ * parallel apply worker.
+ *
+ * Returns false if no segment could be created.
+ */
+static bool
+pa_setup_dsm(ParallelApplyWorkerInfo *winfo)
+{
+	shm_toc_estimator e;
+	Size		segsize;
+	dsm_segment *seg;
+	shm_toc    *toc;
+	ParallelApplyWorkerShared *shared;
+	shm_mq	   *mq;
+
+	shm_toc_initialize_estimator(&e);
+	shm_toc_estimate_chunk(&e, sizeof(ParallelApplyWorkerShared));
+	shm_toc_estimate_chunk(&e, (Size) DSM_QUEUE_SIZE);
+	shm_toc_estimate_keys(&e, 2);
+	segsize = shm_toc_estimate(&e);
+
+	seg = dsm_create(segsize, DSM_CREATE_NULL_IF_MAXSEGMENTS);
+	if (!seg)
+		return false;
+
+	toc = shm_toc_create(PG_LOGICAL_APPLY_SHM_MAGIC, dsm_segment_address(seg),
+						 segsize);
+
+	/* Set up the shared state. */
+	shared = shm_toc_allocate(toc, sizeof(ParallelApplyWorkerShared));
+	SpinLockInit(&shared->mutex);
+	shared->xid = InvalidTransactionId;
+	shared->xact_state = PARALLEL_TRANS_UNKNOWN;
+	pg_atomic_init_u32(&shared->pending_stream_count, 0);
+	shared->last_commit_end = InvalidXLogRecPtr;
+	shared->exited = false;
+	shm_toc_insert(toc, PARALLEL_APPLY_KEY_SHARED, shared);
+
+	/* Set up the message queue for the leader to send changes. */
+	mq = shm_mq_create(shm_toc_allocate(toc, (Size) DSM_QUEUE_SIZE),
+					   (Size) DSM_QUEUE_SIZE);
+	shm_toc_insert(toc, PARALLEL_APPLY_KEY_MQ, mq);
+	shm_mq_set_sender(mq, MyProc);
+
+	/* The segment must outlive any transaction of the leader. */
+	dsm_pin_mapping(seg);
+
+	winfo->mq_handle = shm_mq_attach(mq, seg, NULL);
+	winfo->dsm_seg = seg;
+	winfo->shared = shared;
+
+	return true;
+}
+
+/*
+ * Set up the shared memory and launch a parallel apply worker.
+ *
+ * Returns NULL if that failed.
+ */
+static ParallelApplyWorkerInfo *
+pa_launch_parallel_worker(void)
+{
+	MemoryContext oldcontext;
+	ParallelApplyWorkerInfo *winfo;
+	bool		launched;
+
+	oldcontext = MemoryContextSwitchTo(ApplyContext);
+
+	winfo = (ParallelApplyWorkerInfo *) palloc0(sizeof(ParallelApplyWorkerInfo));
+
+	if (!pa_setup_dsm(winfo))
+	{
+		MemoryContextSwitchTo(oldcontext);
+		pfree(winfo);
+		return NULL;
+	}
+
+	launched = logicalrep_worker_launch(MyLogicalRepWorker->dbid,
+										MySubscription->oid,
+										MySubscription->name,
+										MyLogicalRepWorker->userid,
+										InvalidOid,
+										dsm_segment_handle(winfo->dsm_seg));
+
+	if (!launched)
+	{
+		dsm_detach(winfo->dsm_seg);
+		pfree(winfo);
+		winfo = NULL;
+	}
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return winfo;
+}
+
+/*
+ * Try to get a parallel apply worker to apply the streamed transaction xid.
+ *
+ * Returns NULL if the transaction must be spooled to a file instead, either
+ * because parallel apply can't be used now or because the parallel apply
+ * worker is busy with another transaction.
+ */
+ParallelApplyWorkerInfo *
+pa_allocate_worker(TransactionId xid)
+{
+	ParallelApplyWorkerInfo *winfo;
+
+	/* Only one transaction is applied in parallel at a time. */
+	if (ParallelApplyWorker != NULL && ParallelApplyWorker->in_use)
+		return NULL;
+
+	if (!pa_can_start())
+		return NULL;
+
+	if (ParallelApplyWorker == NULL)
+	{
+		ParallelApplyWorker = pa_launch_parallel_worker();
+		if (ParallelApplyWorker == NULL)
+			return NULL;
+	}
+
+	winfo = ParallelApplyWorker;
+
+	SpinLockAcquire(&winfo->shared->mutex);
+	winfo->shared->xid = xid;
+	winfo->shared->xact_state = PARALLEL_TRANS_UNKNOWN;
+	winfo->shared->last_commit_end = InvalidXLogRecPtr;
+	SpinLockRelease(&winfo->shared->mutex);
+
+	Assert(pg_atomic_read_u32(&winfo->shared->pending_stream_count) == 0);
+
+	winfo->in_use = true;
+
+	return winfo;
+}
+
+/*
+ * Find the parallel apply worker applying the streamed transaction xid, if
+ * any.
+ */
+ParallelApplyWorkerInfo *
+pa_find_worker(TransactionId xid)
+{
+	ParallelApplyWorkerInfo *winfo = ParallelApplyWorker;
+
+	if (winfo != NULL && winfo->in_use && winfo->shared->xid == xid)
+		return winfo;
+
+	return NULL;
+}
+
+/*
+ * Send the data to the parallel apply worker via shared-memory queue.
+ *
+ * We don't wait indefinitely in shm_mq_send, so that we notice when the
+ * parallel apply worker has exited without detaching the queue.
+ */
+void
+pa_send_data(ParallelApplyWorkerInfo *winfo, Size nbytes, const void *data)
+{
+	shm_mq_result result;
+
+	Assert(am_leader_apply_worker());
+
+	for (;;)
+	{
+		int			rc;
+
+		result = shm_mq_send(winfo->mq_handle, nbytes, data, true, true);
+
+		if (result == SHM_MQ_SUCCESS)
+			return;
+
+		if (result == SHM_MQ_DETACHED || pa_has_exited(winfo->shared))
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("lost connection to the logical replication parallel apply worker")));
+
+		Assert(result == SHM_MQ_WOULD_BLOCK);
+
+		/* Wait for the parallel apply worker to consume some data. */
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+					   SHM_SEND_RETRY_INTERVAL_MS,
+					   WAIT_EVENT_LOGICAL_APPLY_SEND_DATA);
+
+		if (rc & WL_LATCH_SET)
+		{
+			ResetLatch(MyLatch);
+			CHECK_FOR_INTERRUPTS();
+		}
+	}
+}
+
+/*
+ * Wait for the parallel apply worker to finish the transaction it was
+ * assigned, record its commit for flush position reporting if remote_lsn is
+ * valid, and make the worker available for another transaction.
+ *
+ * This is called by the leader after sending STREAM COMMIT or a toplevel
+ * STREAM ABORT.  Waiting here keeps the commit order of the publisher.
+ */
+void
+pa_xact_finish(ParallelApplyWorkerInfo *winfo, XLogRecPtr remote_lsn)
+{
+	Assert(am_leader_apply_worker());
+
+	/* Let the parallel apply worker process the remaining messages. */
+	pa_unlock_stream(winfo->shared->xid, AccessExclusiveLock);
+
+	/*
+	 * Wait until the parallel apply worker has acquired the transaction
+	 * lock, so that we don't get it before the worker does.
+	 */
+	pa_wait_for_xact_state(winfo, PARALLEL_TRANS_STARTED);
+
+	/*
+	 * Wait for the transaction lock to be released. Waiting on the lock
+	 * rather than on the state lets the deadlock detector see this wait.
+	 */
+	pa_lock_transaction(winfo->shared->xid, AccessShareLock);
+	pa_unlock_transaction(winfo->shared->xid, AccessShareLock);
+
+	/*
+	 * The lock is also released if the parallel apply worker failed while
+	 * applying the transaction, so check that it actually finished.
+	 */
+	if (pa_get_xact_state(winfo->shared) != PARALLEL_TRANS_FINISHED)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("lost connection to the logical replication parallel apply worker")));
+
+	if (!XLogRecPtrIsInvalid(remote_lsn))
+		store_flush_position(remote_lsn, winfo->shared->last_commit_end);
+
+	winfo->in_use = false;
+}
+
+/*
+ * Wait until the parallel apply worker's transaction state has reached or
+ * exceeded the given state.
+ */
+static void
+pa_wait_for_xact_state(ParallelApplyWorkerInfo *winfo,
+					   ParallelTransState xact_state)
+{
+	for (;;)
+	{
+		if (pa_get_xact_state(winfo->shared) >= xact_state)
+			break;
+
+		if (pa_has_exited(winfo->shared))
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("lost connection to the logical replication parallel apply worker")));
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 10L,
+						 WAIT_EVENT_LOGICAL_PARALLEL_APPLY_STATE_CHANGE);
+
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * Set the transaction state for a given parallel apply worker.
+ */
+void
+pa_set_xact_state(ParallelApplyWorkerShared *wshared,
+				  ParallelTransState xact_state)
+{
+	SpinLockAcquire(&wshared->mutex);
+	wshared->xact_state = xact_state;
+	SpinLockRelease(&wshared->mutex);
+}
+
+/*
+ * Get the transaction state for a given parallel apply worker.
+ */
+static ParallelTransState
+pa_get_xact_state(ParallelApplyWorkerShared *wshared)
+{
+	ParallelTransState xact_state;
+
+	SpinLockAcquire(&wshared->mutex);
+	xact_state = wshared->xact_state;
+	SpinLockRelease(&wshared->mutex);
+
+	return xact_state;
+}
+
+/*
+ * Has the parallel apply worker exited?
+ */
+static bool
+pa_has_exited(ParallelApplyWorkerShared *wshared)
+{
+	bool		exited;
+
+	SpinLockAcquire(&wshared->mutex);
+	exited = wshared->exited;
+	SpinLockRelease(&wshared->mutex);
+
+	return exited;
+}
+
+/*
+ * Form the savepoint name for a subtransaction of a streamed transaction.
+ */
+static void
+pa_savepoint_name(Oid suboid, TransactionId xid, char *spname, Size szsp)
+{
+	snprintf(spname, szsp, "pg_sp_%u_%u", suboid, xid);
+}
+
+/*
+ * Define a savepoint for a subtransaction in the parallel apply worker if
+ * this is the first change we see for it, so that an abort of the
+ * subtransaction can be applied by rolling back to it.
+ */
+void
+pa_start_subtrans(TransactionId current_xid, TransactionId top_xid)
+{
+	if (current_xid != top_xid &&
+		!list_member_xid(subxactlist, current_xid))
+	{
+		MemoryContext oldctx;
+		char		spname[NAMEDATALEN];
+
+		pa_savepoint_name(MySubscription->oid, current_xid,
+						  spname, sizeof(spname));
+
+		elog(DEBUG1, "defining savepoint %s in logical replication parallel apply worker", spname);
+
+		/* We must be in transaction block to define the SAVEPOINT. */
+		if (!IsTransactionBlock())
+		{
+			if (!IsTransactionState())
+				StartTransactionCommand();
+
+			BeginTransactionBlock();
+			CommitTransactionCommand();
+		}
+
+		DefineSavepoint(spname);
+
+		/*
+		 * CommitTransactionCommand is needed to start a subtransaction after
+		 * issuing a SAVEPOINT inside a transaction block (see
+		 * StartSubTransaction()).
+		 */
+		CommitTransactionCommand();
+
+		oldctx = MemoryContextSwitchTo(TopTransactionContext);
+		subxactlist = lappend_xid(subxactlist, current_xid);
+		MemoryContextSwitchTo(oldctx);
+	}
+}
+
+/*
+ * Forget the subtransactions of the transaction just finished.  The list
+ * itself went away with TopTransactionContext.
+ */
+void
+pa_reset_subtrans(void)
+{
+	subxactlist = NIL;
+}
+
+/*
+ * Handle STREAM ABORT in the parallel apply worker.
+ */
+void
+pa_stream_abort(TransactionId xid, TransactionId subxid)
+{
+	if (subxid == xid)
+	{
+		/* Abort of the toplevel transaction. */
+		AbortCurrentTransaction();
+
+		if (IsTransactionBlock())
+		{
+			EndTransactionBlock(false);
+			CommitTransactionCommand();
+		}
+
+		pa_reset_subtrans();
+
+		/*
+		 * The state must be set before releasing the lock, see
+		 * pa_xact_finish().
+		 */
+		pa_set_xact_state(MyParallelShared, PARALLEL_TRANS_FINISHED);
+		pa_unlock_transaction(xid, AccessExclusiveLock);
+
+		pgstat_report_activity(STATE_IDLE, NULL);
+	}
+	else
+	{
+		/* OK, so it's a subxact. Rollback to the savepoint. */
+		int			i;
+		char		spname[NAMEDATALEN];
+
+		pa_savepoint_name(MySubscription->oid, subxid, spname, sizeof(spname));
+
+		elog(DEBUG1, "rolling back to savepoint %s in logical replication parallel apply worker", spname);
+
+		/*
+		 * Search the subxactlist, determine the offset tracked for the
+		 * subxact, and truncate the list.  If the subtransaction had no
+		 * changes, we have no savepoint for it and there is nothing to do.
+		 */
+		for (i = list_length(subxactlist) - 1; i >= 0; i--)
+		{
+			TransactionId xid_tmp = lfirst_xid(list_nth_cell(subxactlist, i));
+
+			if (xid_tmp == subxid)
+			{
+				RollbackToSavepoint(spname);
+				CommitTransactionCommand();
+				subxactlist = list_truncate(subxactlist, i);
+				break;
+			}
+		}
+	}
+}
+
+/*
+ * Called by the parallel apply worker after processing STREAM STOP or the
+ * STREAM ABORT of a subtransaction: if there are no more streaming blocks
+ * queued, wait for the leader to send the next one.  See the locking
+ * considerations atop this file.
+ *
+ * Note that the leader may send another block right after we have decided
+ * to wait, in which case we wait although there is work queued; that only
+ * delays us until the leader releases the stream lock.
+ */
+void
+pa_decr_and_wait_stream_block(void)
+{
+	Assert(am_parallel_apply_worker());
+
+	if (pg_atomic_read_u32(&MyParallelShared->pending_stream_count) == 0)
+		elog(ERROR, "invalid pending streaming chunk 0");
+
+	if (pg_atomic_sub_fetch_u32(&MyParallelShared->pending_stream_count, 1) == 0)
+	{
+		pa_lock_stream(MyParallelShared->xid, AccessShareLock);
+		pa_unlock_stream(MyParallelShared->xid, AccessShareLock);
+	}
+}
+
+/*
+ * Helper functions to acquire and release the locks used to coordinate the
+ * leader and the parallel apply worker; see the locking considerations atop
+ * this file.
+ */
+void
+pa_lock_stream(TransactionId xid, LOCKMODE lockmode)
+{
+	LockApplyTransactionForSession(MyLogicalRepWorker->subid, xid,
+								   PARALLEL_APPLY_LOCK_STREAM, lockmode);
+}
+
+void
+pa_unlock_stream(TransactionId xid, LOCKMODE lockmode)
+{
+	UnlockApplyTransactionForSession(MyLogicalRepWorker->subid, xid,
+									 PARALLEL_APPLY_LOCK_STREAM, lockmode);
+}
+
+void
+pa_lock_transaction(TransactionId xid, LOCKMODE lockmode)
+{
+	LockApplyTransactionForSession(MyLogicalRepWorker->subid, xid,
+								   PARALLEL_APPLY_LOCK_XACT, lockmode);
+}
+
+void
+pa_unlock_transaction(TransactionId xid, LOCKMODE lockmode)
+{
+	UnlockApplyTransactionForSession(MyLogicalRepWorker->subid, xid,
+									 PARALLEL_APPLY_LOCK_XACT, lockmode);
+}
+
+/*
+ * Tell the leader that we have exited, and detach from the shared memory
+ * segment, which also wakes up the leader via the message queue.
+ */
+static void
+pa_shutdown(int code, Datum arg)
+{
+	SpinLockAcquire(&MyParallelShared->mutex);
+	MyParallelShared->exited = true;
+	SpinLockRelease(&MyParallelShared->mutex);
+
+	dsm_detach((dsm_segment *) DatumGetPointer(arg));
+}
+
+/*
+ * Main loop of the parallel apply worker: receive the messages sent by the
+ * leader and apply them.
+ */
+static void
+LogicalParallelApplyLoop(shm_mq_handle *mqh)
+{
+	ErrorContextCallback errcallback;
+	MemoryContext oldcxt = CurrentMemoryContext;
+
+	/*
+	 * Init the ApplyMessageContext which we clean up after each replication
+	 * protocol message.
+	 */
+	ApplyMessageContext = AllocSetContextCreate(ApplyContext,
+												"ApplyMessageContext",
+												ALLOCSET_DEFAULT_SIZES);
+
+	/*
+	 * Push apply error context callback. Fields will be filled while applying
+	 * a change.
+	 */
+	errcallback.callback = apply_error_callback;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	for (;;)
+	{
+		void	   *data;
+		Size		len;
+		shm_mq_result shmq_res;
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Ensure we are reading the data into our memory context. */
+		MemoryContextSwitchTo(ApplyMessageContext);
+
+		shmq_res = shm_mq_receive(mqh, &len, &data, true);
+
+		if (shmq_res == SHM_MQ_SUCCESS)
+		{
+			StringInfoData s;
+			int			c;
+
+			if (len == 0)
+				elog(ERROR, "invalid message length");
+
+			s.data = data;
+			s.len = len;
+			s.cursor = 0;
+			s.maxlen = -1;
+
+			/*
+			 * The leader forwards the 'w' messages it received from the
+			 * publisher unchanged.
+			 */
+			c = pq_getmsgbyte(&s);
+			if (c != 'w')
+				elog(ERROR, "unexpected message \"%c\"", c);
+
+			/* Skip the start_lsn, end_lsn and send_time fields. */
+			(void) pq_getmsgint64(&s);
+			(void) pq_getmsgint64(&s);
+			(void) pq_getmsgint64(&s);
+
+			apply_dispatch(&s);
+		}
+		else if (shmq_res == SHM_MQ_WOULD_BLOCK)
+		{
+			int			rc;
+
+			/* Check for subscription changes while not in a transaction. */
+			if (!IsTransactionState())
+			{
+				AcceptInvalidationMessages();
+				maybe_reread_subscription();
+			}
+
+			rc = WaitLatch(MyLatch,
+						   WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						   1000L,
+						   WAIT_EVENT_LOGICAL_PARALLEL_APPLY_MAIN);
+
+			if (rc & WL_LATCH_SET)
+				ResetLatch(MyLatch);
+		}
+		else
+		{
+			Assert(shmq_res == SHM_MQ_DETACHED);
+
+			ereport(ERROR,
+					(errcode(ERRCODE_CONNECTION_FAILURE),
+					 errmsg("lost connection to the logical replication apply worker")));
+		}
+
+		MemoryContextReset(ApplyMessageContext);
+		MemoryContextSwitchTo(oldcxt);
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+	}
+}
+
+/*
+ * Parallel apply worker entry point.
+ */
+void
+ParallelApplyWorkerMain(Datum main_arg)
+{
+	int			worker_slot = DatumGetInt32(main_arg);
+	dsm_handle	handle;
+	dsm_segment *seg;
+	shm_toc    *toc;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	char		originname[NAMEDATALEN];
+	RepOriginId originid;
+
+	/* Setup signal handling. */
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/*
+	 * Attach to the dynamic shared memory segment set up by the leader, and
+	 * find its table of contents.
+	 */
+	memcpy(&handle, MyBgworkerEntry->bgw_extra, sizeof(dsm_handle));
+	seg = dsm_attach(handle);
+	if (!seg)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+
+	toc = shm_toc_attach(PG_LOGICAL_APPLY_SHM_MAGIC, dsm_segment_address(seg));
+	if (!toc)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("invalid magic number in dynamic shared memory segment")));
+
+	/* Look up the shared information. */
+	MyParallelShared = shm_toc_lookup(toc, PARALLEL_APPLY_KEY_SHARED, false);
+
+	/* Set up a message queue to receive data from the leader. */
+	mq = shm_toc_lookup(toc, PARALLEL_APPLY_KEY_MQ, false);
+	shm_mq_set_receiver(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	/* Attach to slot */
+	logicalrep_worker_attach(worker_slot);
+
+	/*
+	 * Registered after attaching to the slot so that the leader learns that
+	 * we're gone before the slot is released.
+	 */
+	before_shmem_exit(pa_shutdown, PointerGetDatum(seg));
+
+	InitializeApplyWorker();
+
+	/*
+	 * Setup replication origin tracking.  The parallel apply worker shares
+	 * the origin with its leader, which has it acquired already.
+	 */
+	StartTransactionCommand();
+	snprintf(originname, sizeof(originname), "pg_%u", MySubscription->oid);
+	originid = replorigin_by_name(originname, false);
+	replorigin_session_setup(originid, MyLogicalRepWorker->leader_pid);
+	replorigin_session_origin = originid;
+	CommitTransactionCommand();
+
+	/*
+	 * Setup callback for syscache so that we know when something changes in
+	 * the subscription relation state.
+	 */
+	CacheRegisterSyscacheCallback(SUBSCRIPTIONRELMAP,
+								  invalidate_syncing_table_states,
+								  (Datum) 0);
+
+	set_apply_error_context_origin(originname);
+
+	LogicalParallelApplyLoop(mqh);
+
+	/* Not reachable */
+}
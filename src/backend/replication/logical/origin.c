@@ -1078,9 +1078,15 @@ ReplicationOriginExitCleanup(int code, Datum arg)
  * Obviously only one such cached origin can exist per process and the current
  * cached value can only be set again after the previous value is torn down
  * with replorigin_session_reset().
+ *
+ * Normally the origin must not be in use by any other process, and we become
+ * its owner.  If acquired_by is not 0, we instead share the origin with the
+ * process having that PID, which must already own it; this is used by
+ * logical replication parallel apply workers, which advance the origin of
+ * their leader apply worker.
  */
 void
-replorigin_session_setup(RepOriginId node)
+replorigin_session_setup(RepOriginId node, int acquired_by)
 {
 	static bool registered_cleanup;
 	int			i;
@@ -1122,7 +1128,7 @@ replorigin_session_setup(RepOriginId node)
 		if (curstate->roident != node)
 			continue;
 
-		else if (curstate->acquired_by != 0)
+		else if (curstate->acquired_by != 0 && acquired_by == 0)
 		{
 			ereport(ERROR,
 					(errcode(ERRCODE_OBJECT_IN_USE),
@@ -1143,6 +1149,12 @@ replorigin_session_setup(RepOriginId node)
 				 errhint("Increase max_replication_slots and try again.")));
 	else if (session_replication_state == NULL)
 	{
+		if (acquired_by != 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("cannot use PID %d for inactive replication origin with ID %d",
+							acquired_by, node)));
+
 		/* initialize new slot */
 		session_replication_state = &replication_states[free_slot];
 		Assert(session_replication_state->remote_lsn == InvalidXLogRecPtr);
@@ -1153,7 +1165,21 @@ replorigin_session_setup(RepOriginId node)
 
 	Assert(session_replication_state->roident != InvalidRepOriginId);
 
-	session_replication_state->acquired_by = MyProcPid;
+	if (acquired_by == 0)
+		session_replication_state->acquired_by = MyProcPid;
+	else if (session_replication_state->acquired_by != acquired_by)
+	{
+		int			owner = session_replication_state->acquired_by;
+
+		session_replication_state = NULL;
+		LWLockRelease(ReplicationOriginLock);
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("replication origin with ID %d is not active for PID %d",
+						node, acquired_by),
+				 owner != 0 ?
+				 errdetail("It is active for PID %d.", owner) : 0));
+	}
 
 	LWLockRelease(ReplicationOriginLock);
 
@@ -1337,7 +1363,7 @@ pg_replication_origin_session_setup(PG_FUNCTION_ARGS)
 
 	name = text_to_cstring((text *) DatumGetPointer(PG_GETARG_DATUM(0)));
 	origin = replorigin_by_name(name, false);
-	replorigin_session_setup(origin);
+	replorigin_session_setup(origin, 0);
 
 	replorigin_session_origin = origin;
 
@@ -77,6 +77,15 @@
  *	  a bit more memory to the oldest subtransactions, because it's likely
  *	  they are the source for the next sequence of changes.
  *
+ *	  Spilled changes are not written to disk one at a time.  They are
+ *	  accumulated into blocks of about REORDER_BUFFER_SPILL_BLOCK_SIZE bytes,
+ *	  each of which is compressed as a unit according to
+ *	  logical_decoding_spill_compression and written out with a single
+ *	  write().  This keeps the number of system calls per spilled change low
+ *	  and, when compression is enabled, reduces the amount of I/O needed for
+ *	  large transactions considerably.  A block that doesn't compress is
+ *	  stored as is.
+ *
  * -------------------------------------------------------------------------
  */
 #include "postgres.h"
@@ -84,6 +93,14 @@
 #include <unistd.h>
 #include <sys/stat.h>
 
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "access/detoast.h"
 #include "access/heapam.h"
 #include "access/rewriteheap.h"
@@ -91,6 +108,7 @@
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "catalog/catalog.h"
+#include "common/pg_lzcompress.h"
 #include "lib/binaryheap.h"
 #include "miscadmin.h"
 #include "pgstat.h"
@@ -178,6 +196,24 @@ typedef struct ReorderBufferDiskChange
 	/* data follows */
 } ReorderBufferDiskChange;
 
+/*
+ * Header of a block of changes in a spill file.  The block's changes follow,
+ * each padded to MAXALIGN, compressed with the given method unless that is
+ * SPILL_COMPRESSION_NONE.
+ */
+typedef struct ReorderBufferDiskBlock
+{
+	Size		rawsize;		/* size of the changes, uncompressed */
+	Size		disksize;		/* size of the data following on disk */
+	int			method;			/* LogicalDecodingSpillCompression */
+} ReorderBufferDiskBlock;
+
+/*
+ * Target size of the uncompressed contents of a spill block.  A single change
+ * larger than this gets a block of its own.
+ */
+#define REORDER_BUFFER_SPILL_BLOCK_SIZE		(64 * 1024)
+
 #define IsSpecInsert(action) \
 ( \
 	((action) == REORDER_BUFFER_CHANGE_INTERNAL_SPEC_INSERT) \
@@ -207,6 +243,7 @@ typedef struct ReorderBufferDiskChange
  * like.
  */
 int			logical_decoding_work_mem;
+int			logical_decoding_spill_compression = SPILL_COMPRESSION_NONE;
 static const Size max_changes_in_memory = 4096; /* XXX for restore only */
 
 /* ---------------------------------------
@@ -247,6 +284,12 @@ static void ReorderBufferCheckMemoryLimit(ReorderBuffer *rb);
 static void ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn);
 static void ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 										 int fd, ReorderBufferChange *change);
+static void ReorderBufferSpillAppend(ReorderBuffer *rb, ReorderBufferTXN *txn,
+									 int fd, Size sz);
+static void ReorderBufferSpillFlush(ReorderBuffer *rb, ReorderBufferTXN *txn,
+									int fd);
+static bool ReorderBufferReadSpillBlock(ReorderBuffer *rb, TXNEntryFile *file,
+										Size *blocklen);
 static Size ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 										TXNEntryFile *file, XLogSegNo *segno);
 static void ReorderBufferRestoreChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
@@ -353,11 +396,19 @@ ReorderBufferAllocate(void)
 
 	buffer->outbuf = NULL;
 	buffer->outbufsize = 0;
+	buffer->spillbuf = NULL;
+	buffer->spillbufsize = 0;
+	buffer->spillbuflen = 0;
+	buffer->spillzbuf = NULL;
+	buffer->spillzbufsize = 0;
+	buffer->restorebuf = NULL;
+	buffer->restorebufsize = 0;
 	buffer->size = 0;
 
 	buffer->spillTxns = 0;
 	buffer->spillCount = 0;
 	buffer->spillBytes = 0;
+	buffer->spillDiskBytes = 0;
 	buffer->streamTxns = 0;
 	buffer->streamCount = 0;
 	buffer->streamBytes = 0;
@@ -3595,6 +3646,9 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 	elog(DEBUG2, "spill %u changes in XID %u to disk",
 		 (uint32) txn->nentries_mem, txn->xid);
 
+	/* discard anything left behind by an earlier failed attempt */
+	rb->spillbuflen = 0;
+
 	/* do the same to all child TXs */
 	dlist_foreach(subtxn_i, &txn->subtxns)
 	{
@@ -3621,7 +3675,10 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 			char		path[MAXPGPATH];
 
 			if (fd != -1)
+			{
+				ReorderBufferSpillFlush(rb, txn, fd);
 				CloseTransientFile(fd);
+			}
 
 			XLByteToSeg(change->lsn, curOpenSegNo, wal_segment_size);
 
@@ -3649,6 +3706,9 @@ ReorderBufferSerializeTXN(ReorderBuffer *rb, ReorderBufferTXN *txn)
 		spilled++;
 	}
 
+	if (fd != -1)
+		ReorderBufferSpillFlush(rb, txn, fd);
+
 	/* update the statistics iff we have spilled anything */
 	if (spilled)
 	{
@@ -3857,9 +3917,157 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	ondisk->size = sz;
 
+	ReorderBufferSpillAppend(rb, txn, fd, sz);
+
+	/*
+	 * Keep the transaction's final_lsn up to date with each change we send to
+	 * disk, so that ReorderBufferRestoreCleanup works correctly.  (We used to
+	 * only do this on commit and abort records, but that doesn't work if a
+	 * system crash leaves a transaction without its abort record).
+	 *
+	 * Make sure not to move it backwards.
+	 */
+	if (txn->final_lsn < change->lsn)
+		txn->final_lsn = change->lsn;
+
+	Assert(ondisk->change.action == change->action);
+}
+
+/*
+ * Add the serialized change of size sz in rb->outbuf to the current spill
+ * block, writing out the block first if the change doesn't fit into it.
+ *
+ * Each change is padded to MAXALIGN, so that it can be restored directly
+ * from the block buffer.
+ */
+static void
+ReorderBufferSpillAppend(ReorderBuffer *rb, ReorderBufferTXN *txn, int fd,
+						 Size sz)
+{
+	Size		needed;
+	char	   *data;
+
+	if (rb->spillbuflen > 0 &&
+		rb->spillbuflen + MAXALIGN(sz) > REORDER_BUFFER_SPILL_BLOCK_SIZE)
+		ReorderBufferSpillFlush(rb, txn, fd);
+
+	/* leave room for the block header in front of the changes */
+	needed = sizeof(ReorderBufferDiskBlock) +
+		Max(rb->spillbuflen + MAXALIGN(sz), REORDER_BUFFER_SPILL_BLOCK_SIZE);
+
+	if (rb->spillbufsize < needed)
+	{
+		if (rb->spillbuf == NULL)
+			rb->spillbuf = MemoryContextAlloc(rb->context, needed);
+		else
+			rb->spillbuf = repalloc(rb->spillbuf, needed);
+		rb->spillbufsize = needed;
+	}
+
+	data = rb->spillbuf + sizeof(ReorderBufferDiskBlock) + rb->spillbuflen;
+	memcpy(data, rb->outbuf, sz);
+	/* zero the padding rather than writing out random memory contents */
+	memset(data + sz, 0, MAXALIGN(sz) - sz);
+
+	rb->spillbuflen += MAXALIGN(sz);
+}
+
+/*
+ * Write out the current spill block, compressed with the method selected by
+ * logical_decoding_spill_compression if that makes it any smaller.
+ */
+static void
+ReorderBufferSpillFlush(ReorderBuffer *rb, ReorderBufferTXN *txn, int fd)
+{
+	ReorderBufferDiskBlock *hdr;
+	char	   *source;
+	char	   *dest;
+	char	   *towrite;
+	Size		rawsize = rb->spillbuflen;
+	Size		needed;
+	Size		writesize;
+	int			method = logical_decoding_spill_compression;
+	int32		len = -1;
+
+	if (rawsize == 0)
+		return;
+
+	source = rb->spillbuf + sizeof(ReorderBufferDiskBlock);
+
+	if (method != SPILL_COMPRESSION_NONE)
+	{
+		needed = sizeof(ReorderBufferDiskBlock) + PGLZ_MAX_OUTPUT(rawsize);
+		if (rb->spillzbufsize < needed)
+		{
+			if (rb->spillzbuf != NULL)
+				pfree(rb->spillzbuf);
+			rb->spillzbuf = MemoryContextAlloc(rb->context, needed);
+			rb->spillzbufsize = needed;
+		}
+		dest = rb->spillzbuf + sizeof(ReorderBufferDiskBlock);
+
+		/*
+		 * Only output smaller than the input is of any use to us, so we don't
+		 * need to leave room for incompressible data.
+		 */
+		switch (method)
+		{
+			case SPILL_COMPRESSION_PGLZ:
+				len = pglz_compress(source, rawsize, dest,
+									PGLZ_strategy_default);
+				break;
+
+			case SPILL_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+				len = LZ4_compress_default(source, dest, rawsize,
+										   rawsize - 1);
+				if (len <= 0)
+					len = -1;	/* failure */
+#else
+				elog(ERROR, "LZ4 is not supported by this build");
+#endif
+				break;
+
+			case SPILL_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+				{
+					size_t		zlen;
+
+					zlen = ZSTD_compress(dest, rawsize - 1, source, rawsize,
+										 ZSTD_CLEVEL_DEFAULT);
+					len = ZSTD_isError(zlen) ? -1 : (int32) zlen;
+				}
+#else
+				elog(ERROR, "zstd is not supported by this build");
+#endif
+				break;
+
+			default:
+				elog(ERROR, "unrecognized spill compression method %d",
+					 method);
+		}
+	}
+
+	if (len >= 0 && len < rawsize)
+	{
+		hdr = (ReorderBufferDiskBlock *) rb->spillzbuf;
+		hdr->disksize = len;
+		hdr->method = method;
+		towrite = rb->spillzbuf;
+	}
+	else
+	{
+		hdr = (ReorderBufferDiskBlock *) rb->spillbuf;
+		hdr->disksize = rawsize;
+		hdr->method = SPILL_COMPRESSION_NONE;
+		towrite = rb->spillbuf;
+	}
+	hdr->rawsize = rawsize;
+	writesize = sizeof(ReorderBufferDiskBlock) + hdr->disksize;
+
 	errno = 0;
 	pgstat_report_wait_start(WAIT_EVENT_REORDER_BUFFER_WRITE);
-	if (write(fd, rb->outbuf, ondisk->size) != ondisk->size)
+	if (write(fd, towrite, writesize) != writesize)
 	{
 		int			save_errno = errno;
 
@@ -3874,18 +4082,22 @@ ReorderBufferSerializeChange(ReorderBuffer *rb, ReorderBufferTXN *txn,
 	}
 	pgstat_report_wait_end();
 
-	/*
-	 * Keep the transaction's final_lsn up to date with each change we send to
-	 * disk, so that ReorderBufferRestoreCleanup works correctly.  (We used to
-	 * only do this on commit and abort records, but that doesn't work if a
-	 * system crash leaves a transaction without its abort record).
-	 *
-	 * Make sure not to move it backwards.
-	 */
-	if (txn->final_lsn < change->lsn)
-		txn->final_lsn = change->lsn;
+	rb->spillDiskBytes += writesize;
+	rb->spillbuflen = 0;
 
-	Assert(ondisk->change.action == change->action);
+	/* don't hang on to the memory needed for an unusually large change */
+	if (rb->spillbufsize > 2 * REORDER_BUFFER_SPILL_BLOCK_SIZE)
+	{
+		pfree(rb->spillbuf);
+		rb->spillbuf = NULL;
+		rb->spillbufsize = 0;
+	}
+	if (rb->spillzbufsize > 2 * REORDER_BUFFER_SPILL_BLOCK_SIZE)
+	{
+		pfree(rb->spillzbuf);
+		rb->spillzbuf = NULL;
+		rb->spillzbufsize = 0;
+	}
 }
 
 /* Returns true, if the output plugin supports streaming, false, otherwise. */
@@ -4154,8 +4366,8 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 
 	while (restored < max_changes_in_memory && *segno <= last_segno)
 	{
-		int			readBytes;
-		ReorderBufferDiskChange *ondisk;
+		Size		blocklen;
+		Size		blockpos;
 
 		if (*fd == -1)
 		{
@@ -4192,71 +4404,169 @@ ReorderBufferRestoreChanges(ReorderBuffer *rb, ReorderBufferTXN *txn,
 								path)));
 		}
 
-		/*
-		 * Read the statically sized part of a change which has information
-		 * about the total size. If we couldn't read a record, we're at the
-		 * end of this file.
-		 */
-		ReorderBufferSerializeReserve(rb, sizeof(ReorderBufferDiskChange));
-		readBytes = FileRead(file->vfd, rb->outbuf,
-							 sizeof(ReorderBufferDiskChange),
-							 file->curOffset, WAIT_EVENT_REORDER_BUFFER_READ);
-
-		/* eof */
-		if (readBytes == 0)
+		/* Read the next block of changes; if there is none, we're at EOF */
+		if (!ReorderBufferReadSpillBlock(rb, file, &blocklen))
 		{
 			FileClose(*fd);
 			*fd = -1;
 			(*segno)++;
 			continue;
 		}
-		else if (readBytes < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: %m")));
-		else if (readBytes != sizeof(ReorderBufferDiskChange))
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
-							readBytes,
-							(uint32) sizeof(ReorderBufferDiskChange))));
 
-		file->curOffset += readBytes;
+		/*
+		 * Restore all of the block's changes, even if that takes us somewhat
+		 * past max_changes_in_memory.  That way no file has to keep a block
+		 * of its own, and rb->restorebuf can be reused for the next block
+		 * read, from whichever file.
+		 */
+		blockpos = 0;
+		while (blockpos < blocklen)
+		{
+			ReorderBufferDiskChange *ondisk;
 
-		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
+			ondisk = (ReorderBufferDiskChange *) (rb->restorebuf + blockpos);
+			blockpos += MAXALIGN(ondisk->size);
 
-		ReorderBufferSerializeReserve(rb,
-									  sizeof(ReorderBufferDiskChange) + ondisk->size);
-		ondisk = (ReorderBufferDiskChange *) rb->outbuf;
+			if (blockpos > blocklen)
+				ereport(ERROR,
+						(errcode(ERRCODE_DATA_CORRUPTED),
+						 errmsg("invalid change size %zu in reorderbuffer spill file",
+								ondisk->size)));
 
-		readBytes = FileRead(file->vfd,
-							 rb->outbuf + sizeof(ReorderBufferDiskChange),
-							 ondisk->size - sizeof(ReorderBufferDiskChange),
-							 file->curOffset,
-							 WAIT_EVENT_REORDER_BUFFER_READ);
+			/*
+			 * ok, got a full change from disk, now restore it into proper
+			 * in-memory format
+			 */
+			ReorderBufferRestoreChange(rb, txn, (char *) ondisk);
+			restored++;
+		}
+	}
 
-		if (readBytes < 0)
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: %m")));
-		else if (readBytes != ondisk->size - sizeof(ReorderBufferDiskChange))
-			ereport(ERROR,
-					(errcode_for_file_access(),
-					 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
-							readBytes,
-							(uint32) (ondisk->size - sizeof(ReorderBufferDiskChange)))));
+	/* don't hang on to the memory needed for an unusually large change */
+	if (rb->restorebufsize > 2 * REORDER_BUFFER_SPILL_BLOCK_SIZE)
+	{
+		pfree(rb->restorebuf);
+		rb->restorebuf = NULL;
+		rb->restorebufsize = 0;
+	}
 
-		file->curOffset += readBytes;
+	return restored;
+}
 
-		/*
-		 * ok, read a full change from disk, now restore it into proper
-		 * in-memory format
-		 */
-		ReorderBufferRestoreChange(rb, txn, rb->outbuf);
-		restored++;
+/*
+ * Read the next block of changes from a spill file into rb->restorebuf,
+ * decompressing it if necessary, and set *blocklen to its length.  Returns
+ * false at the end of the file.
+ */
+static bool
+ReorderBufferReadSpillBlock(ReorderBuffer *rb, TXNEntryFile *file,
+							Size *blocklen)
+{
+	ReorderBufferDiskBlock hdr;
+	char	   *source;
+	bool		ok;
+	int			readBytes;
+
+	readBytes = FileRead(file->vfd, (char *) &hdr,
+						 sizeof(ReorderBufferDiskBlock),
+						 file->curOffset, WAIT_EVENT_REORDER_BUFFER_READ);
+
+	/* eof */
+	if (readBytes == 0)
+		return false;
+	else if (readBytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: %m")));
+	else if (readBytes != sizeof(ReorderBufferDiskBlock))
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
+						readBytes,
+						(uint32) sizeof(ReorderBufferDiskBlock))));
+
+	file->curOffset += readBytes;
+
+	if (rb->restorebufsize < hdr.rawsize)
+	{
+		if (rb->restorebuf != NULL)
+			pfree(rb->restorebuf);
+		rb->restorebufsize = Max(hdr.rawsize, REORDER_BUFFER_SPILL_BLOCK_SIZE);
+		rb->restorebuf = MemoryContextAlloc(rb->context, rb->restorebufsize);
 	}
 
-	return restored;
+	/* compressed data is read into the I/O buffer and decompressed from there */
+	if (hdr.method == SPILL_COMPRESSION_NONE)
+		source = rb->restorebuf;
+	else
+	{
+		ReorderBufferSerializeReserve(rb, hdr.disksize);
+		source = rb->outbuf;
+	}
+
+	readBytes = FileRead(file->vfd, source, hdr.disksize, file->curOffset,
+						 WAIT_EVENT_REORDER_BUFFER_READ);
+
+	if (readBytes < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: %m")));
+	else if (readBytes != hdr.disksize)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not read from reorderbuffer spill file: read %d instead of %u bytes",
+						readBytes,
+						(uint32) hdr.disksize)));
+
+	file->curOffset += readBytes;
+
+	switch (hdr.method)
+	{
+		case SPILL_COMPRESSION_NONE:
+			ok = (hdr.disksize == hdr.rawsize);
+			break;
+
+		case SPILL_COMPRESSION_PGLZ:
+			ok = (pglz_decompress(source, hdr.disksize, rb->restorebuf,
+								  hdr.rawsize, true) == hdr.rawsize);
+			break;
+
+		case SPILL_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			ok = (LZ4_decompress_safe(source, rb->restorebuf, hdr.disksize,
+									  hdr.rawsize) == hdr.rawsize);
+#else
+			elog(ERROR, "LZ4 is not supported by this build");
+#endif
+			break;
+
+		case SPILL_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			{
+				size_t		len;
+
+				len = ZSTD_decompress(rb->restorebuf, hdr.rawsize, source,
+									  hdr.disksize);
+				ok = (!ZSTD_isError(len) && len == hdr.rawsize);
+			}
+#else
+			elog(ERROR, "zstd is not supported by this build");
+#endif
+			break;
+
+		default:
+			ok = false;
+			break;
+	}
+
+	if (!ok)
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("could not decompress block of reorderbuffer spill file")));
+
+	*blocklen = hdr.rawsize;
+
+	return true;
 }
 
 /*
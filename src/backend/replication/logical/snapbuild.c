@@ -544,6 +544,7 @@ SnapBuildBuildSnapshot(SnapBuild *builder)
 	snapshot->subxip = NULL;
 
 	snapshot->suboverflowed = false;
+	snapshot->subxidmapped = false;
 	snapshot->takenDuringRecovery = false;
 	snapshot->copied = false;
 	snapshot->curcid = FirstCommandId;
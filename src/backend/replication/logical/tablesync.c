@@ -54,6 +54,29 @@
  *	  So the state progression is always: INIT -> DATASYNC -> FINISHEDCOPY
  *	  -> SYNCWAIT -> CATCHUP -> SYNCDONE -> READY.
  *
+ *	  Tables larger than min_parallel_table_sync_size are copied in parallel:
+ *	  the tablesync worker exports the snapshot of its remote transaction
+ *	  (which is the snapshot of its new replication slot) and launches table
+ *	  copy workers, which import it.  The table is split into chunks of
+ *	  table_sync_chunk_size consecutive blocks, fetched by TID range scans on
+ *	  the publisher, that the table copy workers grab one at a time until
+ *	  none are left.  Each table copy worker then prepares its transaction
+ *	  instead of committing it.  The tablesync worker commits these prepared
+ *	  transactions only after it has committed the FINISHEDCOPY state, and
+ *	  rolls them back if it has to redo the copy from DATASYNC state, so the
+ *	  copy is still all-or-nothing even though it's done by several
+ *	  transactions.  The catchup phase is the same as for a table copied by
+ *	  the tablesync worker alone.
+ *
+ *	  The tablesync worker doesn't copy any chunks itself while table copy
+ *	  workers are running, because a duplicate key in the data could then
+ *	  make it wait for the prepared transaction of a table copy worker, which
+ *	  would never end.  The table copy workers run with a lock_timeout
+ *	  instead, so that such a wait makes one of them fail.  If any table copy
+ *	  worker fails, the tablesync worker rolls back the prepared transactions
+ *	  and copies the whole table by itself, which then fails the same way as
+ *	  a non-parallel copy would if the data is really at fault.
+ *
  *	  The catalog pg_subscription_rel is used to keep information about
  *	  subscribed tables and their state.  The catalog holds all states
  *	  except SYNCWAIT and CATCHUP which are only in shared memory.
@@ -95,25 +118,34 @@
 #include "postgres.h"
 
 #include "access/table.h"
+#include "access/twophase.h"
 #include "access/xact.h"
 #include "catalog/indexing.h"
 #include "catalog/pg_subscription_rel.h"
 #include "catalog/pg_type.h"
 #include "commands/copy.h"
+#include "libpq/pqsignal.h"
 #include "miscadmin.h"
+#include "nodes/makefuncs.h"
 #include "parser/parse_relation.h"
 #include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
 #include "replication/logicallauncher.h"
 #include "replication/logicalrelation.h"
+#include "replication/logicalworker.h"
 #include "replication/walreceiver.h"
 #include "replication/worker_internal.h"
 #include "replication/slot.h"
 #include "replication/origin.h"
+#include "storage/dsm.h"
 #include "storage/ipc.h"
 #include "storage/lmgr.h"
+#include "tcop/tcopprot.h"
 #include "utils/acl.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
 #include "utils/rls.h"
@@ -126,6 +158,45 @@ static bool FetchTableStates(bool *started_tx);
 
 static StringInfo copybuf = NULL;
 
+/*
+ * Lock timeout of table copy workers.  Waiting for a lock held by another
+ * table copy worker means that both are inserting the same key; see the notes
+ * atop this file.
+ */
+#define TABLE_COPY_LOCK_TIMEOUT "5s"
+
+/*
+ * Information shared by a tablesync worker copying its table in parallel and
+ * its table copy workers.
+ */
+typedef struct TableCopyShared
+{
+	/* Snapshot exported from the tablesync worker's remote transaction. */
+	char		snapshot[NAMEDATALEN];
+
+	/* Replication origin of the tablesync worker. */
+	RepOriginId originid;
+
+	/* The table is copied in nchunks chunks of chunk_blocks blocks each. */
+	uint32		nchunks;
+	BlockNumber chunk_blocks;
+
+	/* Next chunk to be copied by whoever comes first. */
+	pg_atomic_uint32 next_chunk;
+
+	slock_t		mutex;
+
+	/* The fields below are protected by mutex. */
+	int			nworkers;		/* number of table copy workers launched */
+	int			nfinished;		/* number of them that have exited */
+	bool		failed;			/* did any exit without preparing? */
+} TableCopyShared;
+
+static TableCopyShared *MyTableCopyShared = NULL;
+
+/* Has this table copy worker prepared its part of the copy? */
+static bool table_copy_prepared = false;
+
 /*
  * Exit routine for synchronization worker.
  */
@@ -609,7 +680,8 @@ process_syncing_tables_for_apply(XLogRecPtr current_lsn)
 												 MySubscription->oid,
 												 MySubscription->name,
 												 MyLogicalRepWorker->userid,
-												 rstate->relid);
+												 rstate->relid,
+												 DSM_HANDLE_INVALID);
 						hentry->last_start_time = now;
 					}
 				}
@@ -630,6 +702,13 @@ process_syncing_tables_for_apply(XLogRecPtr current_lsn)
 void
 process_syncing_tables(XLogRecPtr current_lsn)
 {
+	/*
+	 * Skip for parallel apply workers because they only operate on tables
+	 * that are in a READY state. See should_apply_changes_for_rel().
+	 */
+	if (am_parallel_apply_worker())
+		return;
+
 	if (am_tablesync_worker())
 		process_syncing_tables_for_sync(current_lsn);
 	else
@@ -1051,52 +1130,35 @@ fetch_remote_table_info(char *nspname, char *relname,
 }
 
 /*
- * Copy existing data of a table from publisher.
- *
- * Caller is responsible for locking the local relation.
+ * Build the COPY command that fetches the data of the remote table, or only
+ * the rows stored in blocks [startblock, endblock) if startblock is valid.  An
+ * invalid endblock stands for the end of the table.
  */
-static void
-copy_table(Relation rel)
+static char *
+make_copy_command(LogicalRepRelation *lrel, List *qual,
+				  BlockNumber startblock, BlockNumber endblock, bool binary)
 {
-	LogicalRepRelMapEntry *relmapentry;
-	LogicalRepRelation lrel;
-	List	   *qual = NIL;
-	WalRcvExecResult *res;
 	StringInfoData cmd;
-	CopyFromState cstate;
-	List	   *attnamelist;
-	ParseState *pstate;
-
-	/* Get the publisher relation info. */
-	fetch_remote_table_info(get_namespace_name(RelationGetNamespace(rel)),
-							RelationGetRelationName(rel), &lrel, &qual);
-
-	/* Put the relation into relmap. */
-	logicalrep_relmap_update(&lrel);
 
-	/* Map the publisher relation to local one. */
-	relmapentry = logicalrep_rel_open(lrel.remoteid, NoLock);
-	Assert(rel == relmapentry->localrel);
-
-	/* Start copy on the publisher. */
 	initStringInfo(&cmd);
 
-	/* Regular table with no row filter */
-	if (lrel.relkind == RELKIND_RELATION && qual == NIL)
+	/* Regular table with no row filter, copied as a whole */
+	if (lrel->relkind == RELKIND_RELATION && qual == NIL &&
+		!BlockNumberIsValid(startblock))
 	{
 		appendStringInfo(&cmd, "COPY %s (",
-						 quote_qualified_identifier(lrel.nspname, lrel.relname));
+						 quote_qualified_identifier(lrel->nspname, lrel->relname));
 
 		/*
 		 * XXX Do we need to list the columns in all cases? Maybe we're
 		 * replicating all columns?
 		 */
-		for (int i = 0; i < lrel.natts; i++)
+		for (int i = 0; i < lrel->natts; i++)
 		{
 			if (i > 0)
 				appendStringInfoString(&cmd, ", ");
 
-			appendStringInfoString(&cmd, quote_identifier(lrel.attnames[i]));
+			appendStringInfoString(&cmd, quote_identifier(lrel->attnames[i]));
 		}
 
 		appendStringInfoString(&cmd, ") TO STDOUT");
@@ -1104,16 +1166,16 @@ copy_table(Relation rel)
 	else
 	{
 		/*
-		 * For non-tables and tables with row filters, we need to do COPY
-		 * (SELECT ...), but we can't just do SELECT * because we need to not
-		 * copy generated columns. For tables with any row filters, build a
-		 * SELECT query with OR'ed row filters for COPY.
+		 * For non-tables, tables with row filters and ranges of tables, we
+		 * need to do COPY (SELECT ...), but we can't just do SELECT * because
+		 * we need to not copy generated columns. For tables with any row
+		 * filters, build a SELECT query with OR'ed row filters for COPY.
 		 */
 		appendStringInfoString(&cmd, "COPY (SELECT ");
-		for (int i = 0; i < lrel.natts; i++)
+		for (int i = 0; i < lrel->natts; i++)
 		{
-			appendStringInfoString(&cmd, quote_identifier(lrel.attnames[i]));
-			if (i < lrel.natts - 1)
+			appendStringInfoString(&cmd, quote_identifier(lrel->attnames[i]));
+			if (i < lrel->natts - 1)
 				appendStringInfoString(&cmd, ", ");
 		}
 
@@ -1123,34 +1185,82 @@ copy_table(Relation rel)
 		 * For regular tables, make sure we don't copy data from a child that
 		 * inherits the named table as those will be copied separately.
 		 */
-		if (lrel.relkind == RELKIND_RELATION)
+		if (lrel->relkind == RELKIND_RELATION)
 			appendStringInfoString(&cmd, "ONLY ");
 
-		appendStringInfoString(&cmd, quote_qualified_identifier(lrel.nspname, lrel.relname));
+		appendStringInfoString(&cmd, quote_qualified_identifier(lrel->nspname, lrel->relname));
+
+		/* block range, which the publisher reads with a TID range scan */
+		if (BlockNumberIsValid(startblock))
+		{
+			appendStringInfo(&cmd, " WHERE ctid >= '(%u,0)'::pg_catalog.tid",
+							 startblock);
+			if (BlockNumberIsValid(endblock))
+				appendStringInfo(&cmd, " AND ctid < '(%u,0)'::pg_catalog.tid",
+								 endblock);
+		}
+
 		/* list of OR'ed filters */
 		if (qual != NIL)
 		{
 			ListCell   *lc;
 			char	   *q = strVal(linitial(qual));
 
-			appendStringInfo(&cmd, " WHERE %s", q);
+			if (BlockNumberIsValid(startblock))
+				appendStringInfo(&cmd, " AND (%s", q);
+			else
+				appendStringInfo(&cmd, " WHERE %s", q);
 			for_each_from(lc, qual, 1)
 			{
 				q = strVal(lfirst(lc));
 				appendStringInfo(&cmd, " OR %s", q);
 			}
-			list_free_deep(qual);
+			if (BlockNumberIsValid(startblock))
+				appendStringInfoChar(&cmd, ')');
 		}
 
 		appendStringInfoString(&cmd, ") TO STDOUT");
 	}
-	res = walrcv_exec(LogRepWorkerWalRcvConn, cmd.data, 0, NULL);
-	pfree(cmd.data);
+
+	if (binary)
+		appendStringInfoString(&cmd, " WITH (FORMAT binary)");
+
+	return cmd.data;
+}
+
+/*
+ * Copy the rows of the remote table stored in blocks [startblock, endblock),
+ * or all of them if startblock is invalid, into the local relation.
+ */
+static void
+copy_table_range(Relation rel, LogicalRepRelMapEntry *relmapentry,
+				 LogicalRepRelation *lrel, List *qual,
+				 BlockNumber startblock, BlockNumber endblock)
+{
+	WalRcvExecResult *res;
+	char	   *cmd;
+	CopyFromState cstate;
+	List	   *attnamelist;
+	List	   *options = NIL;
+	ParseState *pstate;
+	bool		binary;
+
+	/*
+	 * Copy in binary format if the subscription asks for it and the publisher
+	 * supports binary COPY TO from a replication connection.
+	 */
+	binary = (MySubscription->binary &&
+			  walrcv_server_version(LogRepWorkerWalRcvConn) >= 160000);
+
+	/* Start copy on the publisher. */
+	cmd = make_copy_command(lrel, qual, startblock, endblock, binary);
+	res = walrcv_exec(LogRepWorkerWalRcvConn, cmd, 0, NULL);
+	pfree(cmd);
 	if (res->status != WALRCV_OK_COPY_OUT)
 		ereport(ERROR,
 				(errcode(ERRCODE_CONNECTION_FAILURE),
 				 errmsg("could not start initial contents copy for table \"%s.%s\": %s",
-						lrel.nspname, lrel.relname, res->err)));
+						lrel->nspname, lrel->relname, res->err)));
 	walrcv_clear_result(res);
 
 	copybuf = makeStringInfo();
@@ -1160,14 +1270,517 @@ copy_table(Relation rel)
 										 NULL, false, false);
 
 	attnamelist = make_copy_attnamelist(relmapentry);
-	cstate = BeginCopyFrom(pstate, rel, NULL, NULL, false, copy_read_data, attnamelist, NIL);
+	if (binary)
+		options = list_make1(makeDefElem("format",
+										 (Node *) makeString("binary"), -1));
+	cstate = BeginCopyFrom(pstate, rel, NULL, NULL, false, copy_read_data,
+						   attnamelist, options);
 
 	/* Do the copy */
 	(void) CopyFrom(cstate);
 
+	EndCopyFrom(cstate);
+}
+
+/*
+ * Decide whether the remote table is to be copied in parallel.
+ *
+ * Returns the number of chunks to split the table into, with the size of a
+ * chunk in blocks in *chunk_blocks, or 1 if the table is to be copied by us
+ * alone.
+ */
+static uint32
+plan_parallel_copy(LogicalRepRelation *lrel, BlockNumber *chunk_blocks)
+{
+	WalRcvExecResult *res;
+	StringInfoData cmd;
+	TupleTableSlot *slot;
+	Oid			sizeRow[] = {INT8OID, INT4OID};
+	bool		isnull;
+	int64		relsize = 0;
+	int32		blcksz = 0;
+
+	/*
+	 * Only regular tables can be split into ranges of blocks, and only
+	 * publishers supporting TID range scans can read such a range without
+	 * scanning the whole table.  The table copy workers need sync worker
+	 * slots, and a prepared transaction each.
+	 */
+	if (lrel->relkind != RELKIND_RELATION ||
+		walrcv_server_version(LogRepWorkerWalRcvConn) < 140000 ||
+		max_sync_workers_per_subscription < 2 ||
+		max_prepared_xacts == 0)
+		return 1;
+
+	initStringInfo(&cmd);
+	appendStringInfo(&cmd,
+					 "SELECT pg_catalog.pg_relation_size(%u),"
+					 "       pg_catalog.current_setting('block_size')::pg_catalog.int4",
+					 lrel->remoteid);
+	res = walrcv_exec(LogRepWorkerWalRcvConn, cmd.data,
+					  lengthof(sizeRow), sizeRow);
+	pfree(cmd.data);
+
+	if (res->status != WALRCV_OK_TUPLES)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("could not fetch size of table \"%s.%s\" from publisher: %s",
+						lrel->nspname, lrel->relname, res->err)));
+
+	slot = MakeSingleTupleTableSlot(res->tupledesc, &TTSOpsMinimalTuple);
+	if (tuplestore_gettupleslot(res->tuplestore, true, false, slot))
+	{
+		Datum		d = slot_getattr(slot, 1, &isnull);
+
+		/* The size is NULL if the table was dropped concurrently. */
+		if (!isnull)
+			relsize = DatumGetInt64(d);
+		blcksz = DatumGetInt32(slot_getattr(slot, 2, &isnull));
+		Assert(!isnull);
+	}
+	ExecDropSingleTupleTableSlot(slot);
+	walrcv_clear_result(res);
+
+	/* Both settings are counted in blocks of the publisher. */
+	if (blcksz <= 0 || relsize < (int64) min_parallel_table_sync_size * blcksz)
+		return 1;
+
+	*chunk_blocks = table_sync_chunk_size;
+
+	return (uint32) ((relsize / blcksz + *chunk_blocks - 1) / *chunk_blocks);
+}
+
+/*
+ * Copy chunks of the remote table until there are none left, or until one of
+ * the table copy workers has failed, which makes the tablesync worker redo
+ * the whole copy anyway.
+ */
+static void
+copy_table_chunks(Relation rel, LogicalRepRelMapEntry *relmapentry,
+				  LogicalRepRelation *lrel, List *qual)
+{
+	TableCopyShared *shared = MyTableCopyShared;
+
+	for (;;)
+	{
+		uint32		chunk;
+		BlockNumber startblock;
+		BlockNumber endblock;
+		bool		failed;
+
+		SpinLockAcquire(&shared->mutex);
+		failed = shared->failed;
+		SpinLockRelease(&shared->mutex);
+
+		if (failed)
+			break;
+
+		chunk = pg_atomic_fetch_add_u32(&shared->next_chunk, 1);
+		if (chunk >= shared->nchunks)
+			break;
+
+		startblock = chunk * shared->chunk_blocks;
+
+		/*
+		 * The last chunk extends to the end of the table, so that the rows
+		 * are copied even if the table has grown since we looked at its size.
+		 */
+		if (chunk == shared->nchunks - 1)
+			endblock = InvalidBlockNumber;
+		else
+			endblock = startblock + shared->chunk_blocks;
+
+		copy_table_range(rel, relmapentry, lrel, qual, startblock, endblock);
+	}
+}
+
+/*
+ * Copy the remote table with the help of table copy workers.
+ *
+ * See the notes atop this file.  If no table copy worker can be launched, or
+ * if any of them fails, we copy the whole table ourselves.
+ */
+static void
+copy_table_parallel(Relation rel, LogicalRepRelMapEntry *relmapentry,
+					LogicalRepRelation *lrel, List *qual,
+					uint32 nchunks, BlockNumber chunk_blocks)
+{
+	WalRcvExecResult *res;
+	TupleTableSlot *slot;
+	Oid			snapRow[] = {TEXTOID};
+	char	   *snapshot;
+	bool		isnull;
+	dsm_segment *seg;
+	TableCopyShared *shared;
+	int			maxworkers;
+	int			nworkers;
+	bool		failed;
+
+	/*
+	 * Export the snapshot of our remote transaction for the table copy
+	 * workers.  It remains valid until our remote transaction ends, which
+	 * doesn't happen before all of them have finished.
+	 */
+	res = walrcv_exec(LogRepWorkerWalRcvConn,
+					  "SELECT pg_catalog.pg_export_snapshot()",
+					  lengthof(snapRow), snapRow);
+	if (res->status != WALRCV_OK_TUPLES)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("table copy could not export snapshot on publisher: %s",
+						res->err)));
+
+	slot = MakeSingleTupleTableSlot(res->tupledesc, &TTSOpsMinimalTuple);
+	if (!tuplestore_gettupleslot(res->tuplestore, true, false, slot))
+		elog(ERROR, "failed to fetch exported snapshot from publisher");
+	snapshot = TextDatumGetCString(slot_getattr(slot, 1, &isnull));
+	Assert(!isnull);
+	ExecDropSingleTupleTableSlot(slot);
+	walrcv_clear_result(res);
+
+	seg = dsm_create(sizeof(TableCopyShared), 0);
+	shared = dsm_segment_address(seg);
+	strlcpy(shared->snapshot, snapshot, sizeof(shared->snapshot));
+	shared->originid = replorigin_session_origin;
+	shared->nchunks = nchunks;
+	shared->chunk_blocks = chunk_blocks;
+	pg_atomic_init_u32(&shared->next_chunk, 0);
+	SpinLockInit(&shared->mutex);
+	shared->nworkers = 0;
+	shared->nfinished = 0;
+	shared->failed = false;
+	MyTableCopyShared = shared;
+
+	/*
+	 * Launch table copy workers.  They count against
+	 * max_sync_workers_per_subscription, so we stop as soon as one can't be
+	 * launched.
+	 */
+	maxworkers = Min(nchunks, max_prepared_xacts);
+	for (int i = 0; i < maxworkers; i++)
+	{
+		if (!logicalrep_worker_launch(MyLogicalRepWorker->dbid,
+									  MySubscription->oid,
+									  MySubscription->name,
+									  MyLogicalRepWorker->userid,
+									  MyLogicalRepWorker->relid,
+									  dsm_segment_handle(seg)))
+			break;
+
+		SpinLockAcquire(&shared->mutex);
+		shared->nworkers++;
+		SpinLockRelease(&shared->mutex);
+	}
+
+	elog(DEBUG1, "copying table \"%s.%s\" in %u chunks with %d table copy workers",
+		 lrel->nspname, lrel->relname, nchunks, shared->nworkers);
+
+	/*
+	 * Wait for the table copy workers to prepare their share, even if one of
+	 * them has failed already, so that none is left running when we roll
+	 * them back.
+	 */
+	for (;;)
+	{
+		bool		done;
+
+		CHECK_FOR_INTERRUPTS();
+
+		SpinLockAcquire(&shared->mutex);
+		nworkers = shared->nworkers;
+		done = (shared->nfinished == nworkers);
+		failed = shared->failed;
+		SpinLockRelease(&shared->mutex);
+
+		if (done)
+			break;
+
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 1000L, WAIT_EVENT_LOGICAL_SYNC_PARALLEL_COPY);
+		ResetLatch(MyLatch);
+	}
+
+	MyTableCopyShared = NULL;
+	dsm_detach(seg);
+
+	if (nworkers == 0)
+	{
+		/* Nobody to help us, so copy the table the usual way. */
+		copy_table_range(rel, relmapentry, lrel, qual,
+						 InvalidBlockNumber, InvalidBlockNumber);
+	}
+	else if (failed)
+	{
+		ereport(LOG,
+				(errmsg("logical replication table copy worker for subscription \"%s\", table \"%s\" exited before finishing its copy",
+						MySubscription->name, RelationGetRelationName(rel)),
+				 errdetail("The table will be copied by the table synchronization worker alone.")));
+
+		FinishTableCopyTransactions(MySubscription->oid,
+									MyLogicalRepWorker->relid,
+									false);
+		copy_table_range(rel, relmapentry, lrel, qual,
+						 InvalidBlockNumber, InvalidBlockNumber);
+	}
+}
+
+/*
+ * Copy existing data of a table from publisher.
+ *
+ * Caller is responsible for locking the local relation.
+ */
+static void
+copy_table(Relation rel)
+{
+	LogicalRepRelMapEntry *relmapentry;
+	LogicalRepRelation lrel;
+	List	   *qual = NIL;
+	uint32		nchunks;
+	BlockNumber chunk_blocks = InvalidBlockNumber;
+
+	/* Get the publisher relation info. */
+	fetch_remote_table_info(get_namespace_name(RelationGetNamespace(rel)),
+							RelationGetRelationName(rel), &lrel, &qual);
+
+	/* Put the relation into relmap. */
+	logicalrep_relmap_update(&lrel);
+
+	/* Map the publisher relation to local one. */
+	relmapentry = logicalrep_rel_open(lrel.remoteid, NoLock);
+	Assert(rel == relmapentry->localrel);
+
+	nchunks = plan_parallel_copy(&lrel, &chunk_blocks);
+	if (nchunks > 1)
+		copy_table_parallel(rel, relmapentry, &lrel, qual,
+							nchunks, chunk_blocks);
+	else
+		copy_table_range(rel, relmapentry, &lrel, qual,
+						 InvalidBlockNumber, InvalidBlockNumber);
+
+	list_free_deep(qual);
+
 	logicalrep_rel_close(relmapentry, NoLock);
 }
 
+/*
+ * Form the prefix of the GIDs of the transactions prepared by the table copy
+ * workers of a table.  The prepared transaction's XID completes the GID.
+ */
+static void
+TableCopyTransactionGidPrefix(Oid subid, Oid relid, char *gid, int szgid)
+{
+	snprintf(gid, szgid, "pg_sync_%u_%u_", subid, relid);
+}
+
+/*
+ * Commit or roll back the transactions prepared by the table copy workers of
+ * a table.
+ *
+ * The tablesync worker commits them once the copy is marked as finished, and
+ * rolls them back when it has to start the copy over.  They must also be
+ * cleaned up when the table is removed from the subscription, in which case
+ * isCommit should tell whether the copy was finished.
+ *
+ * Must be called in a transaction, but not in a transaction block.
+ */
+void
+FinishTableCopyTransactions(Oid subid, Oid relid, bool isCommit)
+{
+	char		prefix[GIDSIZE];
+	List	   *gids;
+	ListCell   *lc;
+
+	TableCopyTransactionGidPrefix(subid, relid, prefix, sizeof(prefix));
+
+	gids = GetPreparedTransactionGids(prefix);
+	foreach(lc, gids)
+		FinishPreparedTransaction((char *) lfirst(lc), isCommit);
+
+	list_free_deep(gids);
+}
+
+/*
+ * Are there transactions prepared by table copy workers of the subscription
+ * left to commit or roll back?
+ */
+bool
+TableCopyTransactionsExist(Oid subid)
+{
+	char		prefix[GIDSIZE];
+	List	   *gids;
+	bool		result;
+
+	snprintf(prefix, sizeof(prefix), "pg_sync_%u_", subid);
+
+	gids = GetPreparedTransactionGids(prefix);
+	result = (gids != NIL);
+	list_free_deep(gids);
+
+	return result;
+}
+
+/*
+ * Tell the tablesync worker that we're exiting, and whether we have prepared
+ * our share of the copy.
+ */
+static void
+table_copy_worker_shutdown(int code, Datum arg)
+{
+	SpinLockAcquire(&MyTableCopyShared->mutex);
+	MyTableCopyShared->nfinished++;
+	if (!table_copy_prepared)
+		MyTableCopyShared->failed = true;
+	SpinLockRelease(&MyTableCopyShared->mutex);
+
+	logicalrep_worker_wakeup(MyLogicalRepWorker->subid,
+							 MyLogicalRepWorker->relid);
+
+	dsm_detach((dsm_segment *) DatumGetPointer(arg));
+}
+
+/*
+ * Table copy worker entry point.
+ */
+void
+TableCopyWorkerMain(Datum main_arg)
+{
+	int			worker_slot = DatumGetInt32(main_arg);
+	dsm_handle	handle;
+	dsm_segment *seg;
+	char	   *slotname;
+	char	   *err;
+	WalRcvExecResult *res;
+	StringInfoData cmd;
+	Relation	rel;
+	LogicalRepRelMapEntry *relmapentry;
+	LogicalRepRelation lrel;
+	List	   *qual = NIL;
+	char		gid[GIDSIZE];
+
+	/* Setup signal handling. */
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* Attach to the dynamic shared memory segment set up by the leader. */
+	memcpy(&handle, MyBgworkerEntry->bgw_extra, sizeof(dsm_handle));
+	seg = dsm_attach(handle);
+	if (!seg)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+
+	MyTableCopyShared = dsm_segment_address(seg);
+
+	/* Attach to slot */
+	logicalrep_worker_attach(worker_slot);
+
+	/*
+	 * Registered after attaching to the slot so that the leader learns that
+	 * we're gone before the slot is released.
+	 */
+	before_shmem_exit(table_copy_worker_shutdown, PointerGetDatum(seg));
+
+	InitializeApplyWorker();
+
+	/* Don't wait forever for another table copy worker, see file header. */
+	SetConfigOption("lock_timeout", TABLE_COPY_LOCK_TIMEOUT,
+					PGC_SUSET, PGC_S_OVERRIDE);
+
+	/* Load the libpq-specific functions */
+	load_file("libpqwalreceiver", false);
+
+	/* Use the same application_name as the tablesync worker. */
+	slotname = (char *) palloc(NAMEDATALEN);
+	ReplicationSlotNameForTablesync(MySubscription->oid,
+									MyLogicalRepWorker->relid,
+									slotname,
+									NAMEDATALEN);
+
+	LogRepWorkerWalRcvConn =
+		walrcv_connect(MySubscription->conninfo, true, slotname, &err);
+	if (LogRepWorkerWalRcvConn == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("could not connect to the publisher: %s", err)));
+
+	/* Import the snapshot of the tablesync worker's remote transaction. */
+	res = walrcv_exec(LogRepWorkerWalRcvConn,
+					  "BEGIN READ ONLY ISOLATION LEVEL REPEATABLE READ",
+					  0, NULL);
+	if (res->status != WALRCV_OK_COMMAND)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("table copy could not start transaction on publisher: %s",
+						res->err)));
+	walrcv_clear_result(res);
+
+	initStringInfo(&cmd);
+	appendStringInfo(&cmd, "SET TRANSACTION SNAPSHOT %s",
+					 quote_literal_cstr(MyTableCopyShared->snapshot));
+	res = walrcv_exec(LogRepWorkerWalRcvConn, cmd.data, 0, NULL);
+	if (res->status != WALRCV_OK_COMMAND)
+		ereport(ERROR,
+				(errcode(ERRCODE_CONNECTION_FAILURE),
+				 errmsg("table copy could not import snapshot on publisher: %s",
+						res->err)));
+	walrcv_clear_result(res);
+	pfree(cmd.data);
+
+	/*
+	 * Share the replication origin of the tablesync worker, which has it
+	 * acquired already, so that our changes are marked as coming from it.
+	 */
+	replorigin_session_setup(MyTableCopyShared->originid,
+							 MyLogicalRepWorker->leader_pid);
+	replorigin_session_origin = MyTableCopyShared->originid;
+
+	StartTransactionCommand();
+
+	/*
+	 * The tablesync worker holds the same lock, and has checked our
+	 * permissions on the table already.
+	 */
+	rel = table_open(MyLogicalRepWorker->relid, RowExclusiveLock);
+
+	fetch_remote_table_info(get_namespace_name(RelationGetNamespace(rel)),
+							RelationGetRelationName(rel), &lrel, &qual);
+	logicalrep_relmap_update(&lrel);
+	relmapentry = logicalrep_rel_open(lrel.remoteid, NoLock);
+
+	PushActiveSnapshot(GetTransactionSnapshot());
+	copy_table_chunks(rel, relmapentry, &lrel, qual);
+	PopActiveSnapshot();
+
+	logicalrep_rel_close(relmapentry, NoLock);
+	table_close(rel, NoLock);
+
+	/*
+	 * Prepare our share of the copy, for the tablesync worker to commit along
+	 * with its own.
+	 */
+	TableCopyTransactionGidPrefix(MySubscription->oid,
+								  MyLogicalRepWorker->relid,
+								  gid, sizeof(gid));
+	snprintf(gid + strlen(gid), sizeof(gid) - strlen(gid), "%u",
+			 GetTopTransactionId());
+
+	/*
+	 * BeginTransactionBlock is necessary to balance the EndTransactionBlock
+	 * called within the PrepareTransactionBlock below.
+	 */
+	BeginTransactionBlock();
+	CommitTransactionCommand(); /* Completes the preceding Begin command. */
+
+	PrepareTransactionBlock(gid);
+	CommitTransactionCommand();
+
+	table_copy_prepared = true;
+
+	proc_exit(0);
+}
+
 /*
  * Determine the tablesync slot name.
  *
@@ -1293,6 +1906,16 @@ LogicalRepSyncTableStart(XLogRecPtr *origin_startpos)
 		 * seems like a better bet.
 		 */
 		ReplicationSlotDropAtPubNode(LogRepWorkerWalRcvConn, slotname, true);
+
+		/*
+		 * Likewise, the table copy workers might have prepared their share
+		 * of the copy already.  Roll it back, as we start over.
+		 */
+		StartTransactionCommand();
+		FinishTableCopyTransactions(MyLogicalRepWorker->subid,
+									MyLogicalRepWorker->relid,
+									false);
+		CommitTransactionCommand();
 	}
 	else if (MyLogicalRepWorker->relstate == SUBREL_STATE_FINISHEDCOPY)
 	{
@@ -1307,10 +1930,18 @@ LogicalRepSyncTableStart(XLogRecPtr *origin_startpos)
 		 * time this tablesync was launched.
 		 */
 		originid = replorigin_by_name(originname, false);
-		replorigin_session_setup(originid);
+		replorigin_session_setup(originid, 0);
 		replorigin_session_origin = originid;
 		*origin_startpos = replorigin_session_get_progress(false);
 
+		/*
+		 * If the table was copied in parallel, we might have crashed before
+		 * committing the share of the table copy workers.
+		 */
+		FinishTableCopyTransactions(MyLogicalRepWorker->subid,
+									MyLogicalRepWorker->relid,
+									true);
+
 		CommitTransactionCommand();
 
 		goto copy_table_done;
@@ -1418,7 +2049,7 @@ LogicalRepSyncTableStart(XLogRecPtr *origin_startpos)
 						   true /* go backward */ , true /* WAL log */ );
 		UnlockRelationOid(ReplicationOriginRelationId, RowExclusiveLock);
 
-		replorigin_session_setup(originid);
+		replorigin_session_setup(originid, 0);
 		replorigin_session_origin = originid;
 	}
 	else
@@ -1458,6 +2089,17 @@ LogicalRepSyncTableStart(XLogRecPtr *origin_startpos)
 
 	CommitTransactionCommand();
 
+	/*
+	 * Now that the copy is marked as finished, commit the share of the table
+	 * copy workers, if any.  This must be done before the catchup phase,
+	 * which may need to update the rows they have copied.
+	 */
+	StartTransactionCommand();
+	FinishTableCopyTransactions(MyLogicalRepWorker->subid,
+								MyLogicalRepWorker->relid,
+								true);
+	CommitTransactionCommand();
+
 copy_table_done:
 
 	elog(DEBUG1,
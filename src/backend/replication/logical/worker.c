@@ -50,6 +50,15 @@
  * the file we desired across multiple stream-open calls for the same
  * transaction.
  *
+ * If the subscription has streaming = parallel, the leader apply worker
+ * instead tries to hand a streamed transaction over to a parallel apply
+ * worker at its first STREAM START, and then forwards the messages of the
+ * transaction to it as they arrive, without spooling them.  The parallel
+ * apply worker applies the changes immediately and commits when it gets the
+ * STREAM COMMIT, which the leader waits for to preserve the commit order.
+ * Transactions that can't be applied in parallel are spooled as described
+ * above.  See applyparallelworker.c for details.
+ *
  * TWO_PHASE TRANSACTIONS
  * ----------------------
  * Two phase transactions are replayed at prepare and then committed or
@@ -242,7 +251,7 @@ static ApplyErrorCallbackArg apply_error_callback_arg =
 	.origin_name = NULL,
 };
 
-static MemoryContext ApplyMessageContext = NULL;
+MemoryContext ApplyMessageContext = NULL;
 MemoryContext ApplyContext = NULL;
 
 /* per stream context for streaming transactions */
@@ -261,6 +270,12 @@ static bool in_streamed_transaction = false;
 
 static TransactionId stream_xid = InvalidTransactionId;
 
+/*
+ * The parallel apply worker the current streaming block is being sent to, in
+ * the leader apply worker; NULL if the changes are spooled to a file.
+ */
+static ParallelApplyWorkerInfo *stream_apply_worker = NULL;
+
 /*
  * We enable skipping all data modification changes (INSERT, UPDATE, etc.) for
  * the subscription if the remote transaction's finish LSN matches the subskiplsn.
@@ -318,15 +333,8 @@ static void stream_close_file(void);
 
 static void send_feedback(XLogRecPtr recvpos, bool force, bool requestReply);
 
-static void store_flush_position(XLogRecPtr remote_lsn);
-
-static void maybe_reread_subscription(void);
-
 static void DisableSubscriptionAndExit(void);
 
-/* prototype needed because of stream_commit */
-static void apply_dispatch(StringInfo s);
-
 static void apply_handle_commit_internal(LogicalRepCommitData *commit_data);
 static void apply_handle_insert_internal(ApplyExecutionData *edata,
 										 ResultRelInfo *relinfo,
@@ -359,7 +367,6 @@ static void stop_skipping_changes(void);
 static void clear_subscription_skip_lsn(XLogRecPtr finish_lsn);
 
 /* Functions for apply error callback */
-static void apply_error_callback(void *arg);
 static inline void set_apply_error_context_xact(TransactionId xid, XLogRecPtr lsn);
 static inline void reset_apply_error_context_info(void);
 
@@ -381,6 +388,24 @@ should_apply_changes_for_rel(LogicalRepRelMapEntry *rel)
 {
 	if (am_tablesync_worker())
 		return MyLogicalRepWorker->relid == rel->localreloid;
+	else if (am_parallel_apply_worker())
+	{
+		/*
+		 * Parallel apply workers are only started when all tables are READY,
+		 * and can't handle a table that started synchronizing later since
+		 * they don't know the final LSN of the transaction.  Tables in
+		 * unknown state are not part of the subscription.
+		 */
+		if (rel->state != SUBREL_STATE_READY &&
+			rel->state != SUBREL_STATE_UNKNOWN)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("logical replication parallel apply worker for subscription \"%s\" will stop",
+							MySubscription->name),
+					 errdetail("Cannot handle streamed replication transactions using parallel apply workers until all tables have been synchronized.")));
+
+		return rel->state == SUBREL_STATE_READY;
+	}
 	else
 		return (rel->state == SUBREL_STATE_READY ||
 				(rel->state == SUBREL_STATE_SYNCDONE &&
@@ -429,9 +454,12 @@ end_replication_step(void)
  * Handle streamed transactions.
  *
  * If in streaming mode (receiving a block of streamed transaction), we
- * simply redirect it to a file for the proper toplevel transaction.
+ * simply redirect it to a file for the proper toplevel transaction, or to the
+ * parallel apply worker applying it.  In a parallel apply worker, we define
+ * a savepoint for a new subtransaction and let the caller apply the change.
  *
- * Returns true for streamed transactions, false otherwise (regular mode).
+ * Returns true for streamed transactions that the caller needn't process
+ * further, false otherwise (regular mode).
  */
 static bool
 handle_streamed_transaction(LogicalRepMsgType action, StringInfo s)
@@ -442,7 +470,6 @@ handle_streamed_transaction(LogicalRepMsgType action, StringInfo s)
 	if (!in_streamed_transaction)
 		return false;
 
-	Assert(stream_fd != NULL);
 	Assert(TransactionIdIsValid(stream_xid));
 
 	/*
@@ -456,6 +483,28 @@ handle_streamed_transaction(LogicalRepMsgType action, StringInfo s)
 				(errcode(ERRCODE_PROTOCOL_VIOLATION),
 				 errmsg_internal("invalid transaction ID in streamed replication transaction")));
 
+	if (am_parallel_apply_worker())
+	{
+		/* Define a savepoint for a subxact if needed. */
+		pa_start_subtrans(xid, stream_xid);
+		return false;
+	}
+
+	if (stream_apply_worker != NULL)
+	{
+		pa_send_data(stream_apply_worker, s->len, s->data);
+
+		/*
+		 * The publisher doesn't always send the relation and type messages
+		 * again after the streamed transaction has committed, so the leader
+		 * has to process them too.
+		 */
+		return (action != LOGICAL_REP_MSG_RELATION &&
+				action != LOGICAL_REP_MSG_TYPE);
+	}
+
+	Assert(stream_fd != NULL);
+
 	/* Add the new subxact to the array (unless already there). */
 	subxact_info_add(xid);
 
@@ -946,7 +995,7 @@ apply_handle_prepare(StringInfo s)
 	CommitTransactionCommand();
 	pgstat_report_stat(false);
 
-	store_flush_position(prepare_data.end_lsn);
+	store_flush_position(prepare_data.end_lsn, XactLastCommitEnd);
 
 	in_remote_transaction = false;
 
@@ -997,7 +1046,7 @@ apply_handle_commit_prepared(StringInfo s)
 	CommitTransactionCommand();
 	pgstat_report_stat(false);
 
-	store_flush_position(prepare_data.end_lsn);
+	store_flush_position(prepare_data.end_lsn, XactLastCommitEnd);
 	in_remote_transaction = false;
 
 	/* Process any tables that are being synchronized in parallel. */
@@ -1052,7 +1101,7 @@ apply_handle_rollback_prepared(StringInfo s)
 
 	pgstat_report_stat(false);
 
-	store_flush_position(rollback_data.rollback_end_lsn);
+	store_flush_position(rollback_data.rollback_end_lsn, XactLastCommitEnd);
 	in_remote_transaction = false;
 
 	/* Process any tables that are being synchronized in parallel. */
@@ -1100,7 +1149,7 @@ apply_handle_stream_prepare(StringInfo s)
 
 	pgstat_report_stat(false);
 
-	store_flush_position(prepare_data.end_lsn);
+	store_flush_position(prepare_data.end_lsn, XactLastCommitEnd);
 
 	in_remote_transaction = false;
 
@@ -1155,15 +1204,6 @@ apply_handle_stream_start(StringInfo s)
 				(errcode(ERRCODE_PROTOCOL_VIOLATION),
 				 errmsg_internal("duplicate STREAM START message")));
 
-	/*
-	 * Start a transaction on stream start, this transaction will be committed
-	 * on the stream stop unless it is a tablesync worker in which case it
-	 * will be committed after processing all the messages. We need the
-	 * transaction for handling the buffile, used for serializing the
-	 * streaming data and subxact info.
-	 */
-	begin_replication_step();
-
 	/* notify handle methods we're processing a remote transaction */
 	in_streamed_transaction = true;
 
@@ -1177,6 +1217,61 @@ apply_handle_stream_start(StringInfo s)
 
 	set_apply_error_context_xact(stream_xid, InvalidXLogRecPtr);
 
+	if (am_parallel_apply_worker())
+	{
+		if (first_segment)
+		{
+			/* Hold the lock until the end of the transaction. */
+			pa_lock_transaction(stream_xid, AccessExclusiveLock);
+			pa_set_xact_state(MyParallelShared, PARALLEL_TRANS_STARTED);
+
+			/* Wake up the leader, as it may be waiting for us. */
+			logicalrep_worker_wakeup(MyLogicalRepWorker->subid, InvalidOid);
+		}
+
+		pgstat_report_activity(STATE_RUNNING, NULL);
+		return;
+	}
+
+	/*
+	 * Try to hand the transaction over to a parallel apply worker, or find
+	 * the one it has been handed over to.
+	 */
+	if (first_segment)
+		stream_apply_worker = pa_allocate_worker(stream_xid);
+	else
+		stream_apply_worker = pa_find_worker(stream_xid);
+
+	if (stream_apply_worker != NULL)
+	{
+		/*
+		 * Count the block before sending it, so that the parallel apply
+		 * worker doesn't wait for the stream lock while the block is queued.
+		 */
+		pg_atomic_add_fetch_u32(&stream_apply_worker->shared->pending_stream_count, 1);
+
+		pa_send_data(stream_apply_worker, s->len, s->data);
+
+		/*
+		 * Release the stream lock taken at the last STREAM STOP, so that the
+		 * parallel apply worker can go on receiving changes.
+		 */
+		if (!first_segment)
+			pa_unlock_stream(stream_xid, AccessExclusiveLock);
+
+		pgstat_report_activity(STATE_RUNNING, NULL);
+		return;
+	}
+
+	/*
+	 * Start a transaction on stream start, this transaction will be committed
+	 * on the stream stop unless it is a tablesync worker in which case it
+	 * will be committed after processing all the messages. We need the
+	 * transaction for handling the buffile, used for serializing the
+	 * streaming data and subxact info.
+	 */
+	begin_replication_step();
+
 	/*
 	 * Initialize the worker's stream_fileset if we haven't yet. This will be
 	 * used for the entire duration of the worker so create it in a permanent
@@ -1220,6 +1315,39 @@ apply_handle_stream_stop(StringInfo s)
 				(errcode(ERRCODE_PROTOCOL_VIOLATION),
 				 errmsg_internal("STREAM STOP message without STREAM START")));
 
+	if (am_parallel_apply_worker())
+	{
+		/*
+		 * The transaction stays open until the end of the remote
+		 * transaction.  Wait for the next streaming block if the leader
+		 * hasn't sent it yet.
+		 */
+		in_streamed_transaction = false;
+		pa_decr_and_wait_stream_block();
+		pgstat_report_activity(STATE_IDLE, NULL);
+		reset_apply_error_context_info();
+		return;
+	}
+
+	if (stream_apply_worker != NULL)
+	{
+		/*
+		 * Take the stream lock before sending STREAM STOP, so that the
+		 * parallel apply worker waits for us to release it once it has
+		 * applied this block.  See the locking considerations atop
+		 * applyparallelworker.c.
+		 */
+		pa_lock_stream(stream_xid, AccessExclusiveLock);
+
+		pa_send_data(stream_apply_worker, s->len, s->data);
+
+		stream_apply_worker = NULL;
+		in_streamed_transaction = false;
+		pgstat_report_activity(STATE_IDLE, NULL);
+		reset_apply_error_context_info();
+		return;
+	}
+
 	/*
 	 * Close the file with serialized changes, and serialize information about
 	 * subxacts for the toplevel transaction.
@@ -1250,6 +1378,7 @@ apply_handle_stream_abort(StringInfo s)
 {
 	TransactionId xid;
 	TransactionId subxid;
+	ParallelApplyWorkerInfo *winfo;
 
 	if (in_streamed_transaction)
 		ereport(ERROR,
@@ -1258,6 +1387,56 @@ apply_handle_stream_abort(StringInfo s)
 
 	logicalrep_read_stream_abort(s, &xid, &subxid);
 
+	if (am_parallel_apply_worker())
+	{
+		set_apply_error_context_xact(subxid, InvalidXLogRecPtr);
+		pa_stream_abort(xid, subxid);
+
+		/*
+		 * After rolling back to a savepoint, wait for the next streaming
+		 * block like after STREAM STOP.
+		 */
+		if (xid != subxid)
+			pa_decr_and_wait_stream_block();
+
+		reset_apply_error_context_info();
+		return;
+	}
+
+	winfo = pa_find_worker(xid);
+	if (winfo != NULL)
+	{
+		set_apply_error_context_xact(subxid, InvalidXLogRecPtr);
+
+		/*
+		 * For the abort of a subtransaction, the parallel apply worker
+		 * processes the message as a streaming block of its own, so count
+		 * it, and let the worker through the stream lock we have held since
+		 * STREAM STOP while taking it again before sending.  The worker then
+		 * waits for the lock again after processing the abort, as it does
+		 * after STREAM STOP.
+		 */
+		if (xid != subxid)
+		{
+			pa_unlock_stream(xid, AccessExclusiveLock);
+			pg_atomic_add_fetch_u32(&winfo->shared->pending_stream_count, 1);
+			pa_lock_stream(xid, AccessExclusiveLock);
+		}
+
+		pa_send_data(winfo, s->len, s->data);
+
+		/*
+		 * Wait for the abort of the toplevel transaction to finish, so that
+		 * the worker is free for the next transaction.  There is no flush
+		 * position to report for an aborted transaction.
+		 */
+		if (xid == subxid)
+			pa_xact_finish(winfo, InvalidXLogRecPtr);
+
+		reset_apply_error_context_info();
+		return;
+	}
+
 	/*
 	 * If the two XIDs are the same, it's in fact abort of toplevel xact, so
 	 * just delete the files with serialized info.
@@ -1470,6 +1649,7 @@ apply_handle_stream_commit(StringInfo s)
 {
 	TransactionId xid;
 	LogicalRepCommitData commit_data;
+	ParallelApplyWorkerInfo *winfo;
 
 	if (in_streamed_transaction)
 		ereport(ERROR,
@@ -1481,12 +1661,43 @@ apply_handle_stream_commit(StringInfo s)
 
 	elog(DEBUG1, "received commit for streamed transaction %u", xid);
 
-	apply_spooled_messages(xid, commit_data.commit_lsn);
+	if (am_parallel_apply_worker())
+	{
+		apply_handle_commit_internal(&commit_data);
 
-	apply_handle_commit_internal(&commit_data);
+		MyParallelShared->last_commit_end = XactLastCommitEnd;
+
+		/*
+		 * The state must be set before releasing the lock, see
+		 * pa_xact_finish().
+		 */
+		pa_set_xact_state(MyParallelShared, PARALLEL_TRANS_FINISHED);
+		pa_unlock_transaction(xid, AccessExclusiveLock);
 
-	/* unlink the files with serialized changes and subxact info */
-	stream_cleanup_files(MyLogicalRepWorker->subid, xid);
+		pa_reset_subtrans();
+
+		pgstat_report_activity(STATE_IDLE, NULL);
+		reset_apply_error_context_info();
+		return;
+	}
+
+	winfo = pa_find_worker(xid);
+	if (winfo != NULL)
+	{
+		pa_send_data(winfo, s->len, s->data);
+
+		/* Wait for the parallel apply worker to commit the transaction. */
+		pa_xact_finish(winfo, commit_data.end_lsn);
+	}
+	else
+	{
+		apply_spooled_messages(xid, commit_data.commit_lsn);
+
+		apply_handle_commit_internal(&commit_data);
+
+		/* unlink the files with serialized changes and subxact info */
+		stream_cleanup_files(MyLogicalRepWorker->subid, xid);
+	}
 
 	/* Process any tables that are being synchronized in parallel. */
 	process_syncing_tables(commit_data.end_lsn);
@@ -1530,9 +1741,20 @@ apply_handle_commit_internal(LogicalRepCommitData *commit_data)
 		replorigin_session_origin_timestamp = commit_data->committime;
 
 		CommitTransactionCommand();
+
+		/*
+		 * A parallel apply worker applies subtransactions as savepoints in a
+		 * transaction block, which must be ended to commit.
+		 */
+		if (IsTransactionBlock())
+		{
+			EndTransactionBlock(false);
+			CommitTransactionCommand();
+		}
+
 		pgstat_report_stat(false);
 
-		store_flush_position(commit_data->end_lsn);
+		store_flush_position(commit_data->end_lsn, XactLastCommitEnd);
 	}
 	else
 	{
@@ -2467,7 +2689,7 @@ apply_handle_truncate(StringInfo s)
 /*
  * Logical replication protocol message dispatcher.
  */
-static void
+void
 apply_dispatch(StringInfo s)
 {
 	LogicalRepMsgType action = pq_getmsgbyte(s);
@@ -2631,17 +2853,24 @@ get_flush_position(XLogRecPtr *write, XLogRecPtr *flush,
 /*
  * Store current remote/local lsn pair in the tracking list.
  */
-static void
-store_flush_position(XLogRecPtr remote_lsn)
+void
+store_flush_position(XLogRecPtr remote_lsn, XLogRecPtr local_lsn)
 {
 	FlushPosition *flushpos;
 
+	/*
+	 * Skip for parallel apply workers, because the lsn_mapping is maintained
+	 * by the leader apply worker.
+	 */
+	if (am_parallel_apply_worker())
+		return;
+
 	/* Need to do this in permanent context */
 	MemoryContextSwitchTo(ApplyContext);
 
 	/* Track commit lsn  */
 	flushpos = (FlushPosition *) palloc(sizeof(FlushPosition));
-	flushpos->local_end = XactLastCommitEnd;
+	flushpos->local_end = local_lsn;
 	flushpos->remote_end = remote_lsn;
 
 	dlist_push_tail(&lsn_mapping, &flushpos->node);
@@ -3014,7 +3243,7 @@ send_feedback(XLogRecPtr recvpos, bool force, bool requestReply)
 /*
  * Reread subscription info if needed. Most changes will be exit.
  */
-static void
+void
 maybe_reread_subscription(void)
 {
 	MemoryContext oldctx;
@@ -3569,37 +3798,17 @@ start_apply(XLogRecPtr origin_startpos)
 	PG_END_TRY();
 }
 
-/* Logical Replication Apply worker entry point */
+/*
+ * Common initialization for leader apply worker, parallel apply worker and
+ * tablesync worker.
+ *
+ * Initialize the database connection, in-memory subscription and necessary
+ * config options.
+ */
 void
-ApplyWorkerMain(Datum main_arg)
+InitializeApplyWorker(void)
 {
-	int			worker_slot = DatumGetInt32(main_arg);
 	MemoryContext oldctx;
-	char		originname[NAMEDATALEN];
-	XLogRecPtr	origin_startpos = InvalidXLogRecPtr;
-	char	   *myslotname = NULL;
-	WalRcvStreamOptions options;
-	int			server_version;
-
-	/* Attach to slot */
-	logicalrep_worker_attach(worker_slot);
-
-	/* Setup signal handling */
-	pqsignal(SIGHUP, SignalHandlerForConfigReload);
-	pqsignal(SIGTERM, die);
-	BackgroundWorkerUnblockSignals();
-
-	/*
-	 * We don't currently need any ResourceOwner in a walreceiver process, but
-	 * if we did, we could call CreateAuxProcessResourceOwner here.
-	 */
-
-	/* Initialise stats to a sanish value */
-	MyLogicalRepWorker->last_send_time = MyLogicalRepWorker->last_recv_time =
-		MyLogicalRepWorker->reply_time = GetCurrentTimestamp();
-
-	/* Load the libpq-specific functions */
-	load_file("libpqwalreceiver", false);
 
 	/* Run as replica session replication role. */
 	SetConfigOption("session_replication_role", "replica",
@@ -3655,16 +3864,58 @@ ApplyWorkerMain(Datum main_arg)
 								  subscription_change_cb,
 								  (Datum) 0);
 
-	if (am_tablesync_worker())
+	if (am_table_copy_worker())
+		ereport(LOG,
+				(errmsg("logical replication table copy worker for subscription \"%s\", table \"%s\" has started",
+						MySubscription->name, get_rel_name(MyLogicalRepWorker->relid))));
+	else if (am_tablesync_worker())
 		ereport(LOG,
 				(errmsg("logical replication table synchronization worker for subscription \"%s\", table \"%s\" has started",
 						MySubscription->name, get_rel_name(MyLogicalRepWorker->relid))));
+	else if (am_parallel_apply_worker())
+		ereport(LOG,
+				(errmsg("logical replication parallel apply worker for subscription \"%s\" has started",
+						MySubscription->name)));
 	else
 		ereport(LOG,
 				(errmsg("logical replication apply worker for subscription \"%s\" has started",
 						MySubscription->name)));
 
 	CommitTransactionCommand();
+}
+
+/* Logical Replication Apply worker entry point */
+void
+ApplyWorkerMain(Datum main_arg)
+{
+	int			worker_slot = DatumGetInt32(main_arg);
+	char		originname[NAMEDATALEN];
+	XLogRecPtr	origin_startpos = InvalidXLogRecPtr;
+	char	   *myslotname = NULL;
+	WalRcvStreamOptions options;
+	int			server_version;
+
+	/* Attach to slot */
+	logicalrep_worker_attach(worker_slot);
+
+	/* Setup signal handling */
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/*
+	 * We don't currently need any ResourceOwner in a walreceiver process, but
+	 * if we did, we could call CreateAuxProcessResourceOwner here.
+	 */
+
+	/* Initialise stats to a sanish value */
+	MyLogicalRepWorker->last_send_time = MyLogicalRepWorker->last_recv_time =
+		MyLogicalRepWorker->reply_time = GetCurrentTimestamp();
+
+	/* Load the libpq-specific functions */
+	load_file("libpqwalreceiver", false);
+
+	InitializeApplyWorker();
 
 	/* Connect to the origin and start the replication. */
 	elog(DEBUG1, "connecting to publisher using connection string \"%s\"",
@@ -3682,8 +3933,7 @@ ApplyWorkerMain(Datum main_arg)
 										  MyLogicalRepWorker->relid,
 										  originname,
 										  sizeof(originname));
-		apply_error_callback_arg.origin_name = MemoryContextStrdup(ApplyContext,
-																   originname);
+		set_apply_error_context_origin(originname);
 	}
 	else
 	{
@@ -3710,7 +3960,7 @@ ApplyWorkerMain(Datum main_arg)
 		originid = replorigin_by_name(originname, true);
 		if (!OidIsValid(originid))
 			originid = replorigin_create(originname);
-		replorigin_session_setup(originid);
+		replorigin_session_setup(originid, 0);
 		replorigin_session_origin = originid;
 		origin_startpos = replorigin_session_get_progress(false);
 		CommitTransactionCommand();
@@ -3728,12 +3978,7 @@ ApplyWorkerMain(Datum main_arg)
 		 */
 		(void) walrcv_identify_system(LogRepWorkerWalRcvConn, &startpointTLI);
 
-		/*
-		 * Allocate the origin name in long-lived context for error context
-		 * message.
-		 */
-		apply_error_callback_arg.origin_name = MemoryContextStrdup(ApplyContext,
-																   originname);
+		set_apply_error_context_origin(originname);
 	}
 
 	/*
@@ -3757,7 +4002,7 @@ ApplyWorkerMain(Datum main_arg)
 
 	options.proto.logical.publication_names = MySubscription->publications;
 	options.proto.logical.binary = MySubscription->binary;
-	options.proto.logical.streaming = MySubscription->stream;
+	options.proto.logical.streaming = (MySubscription->stream != LOGICALREP_STREAM_OFF);
 	options.proto.logical.twophase = false;
 	options.proto.logical.origin = pstrdup(MySubscription->origin);
 
@@ -3988,7 +4233,7 @@ clear_subscription_skip_lsn(XLogRecPtr finish_lsn)
 }
 
 /* Error callback to give more context info about the change being applied */
-static void
+void
 apply_error_callback(void *arg)
 {
 	ApplyErrorCallbackArg *errarg = &apply_error_callback_arg;
@@ -4043,6 +4288,17 @@ set_apply_error_context_xact(TransactionId xid, XLogRecPtr lsn)
 	apply_error_callback_arg.finish_lsn = lsn;
 }
 
+/*
+ * Set the origin name for the apply error callback, allocated in a
+ * long-lived context.
+ */
+void
+set_apply_error_context_origin(char *originname)
+{
+	apply_error_callback_arg.origin_name = MemoryContextStrdup(ApplyContext,
+															   originname);
+}
+
 /* Reset all information of apply error callback */
 static inline void
 reset_apply_error_context_info(void)
@@ -905,6 +905,7 @@ logical_read_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr, int req
 {
 	XLogRecPtr	flushptr;
 	int			count;
+	Size		rbytes;
 	WALReadError errinfo;
 	XLogSegNo	segno;
 	TimeLineID	currTLI = GetWALInsertionTimeLine();
@@ -933,15 +934,24 @@ logical_read_xlog_page(XLogReaderState *state, XLogRecPtr targetPagePtr, int req
 	else
 		count = flushptr - targetPagePtr;	/* part of the page available */
 
-	/* now actually read the data, we know it's there */
-	if (!WALRead(state,
-				 cur_page,
-				 targetPagePtr,
-				 XLOG_BLCKSZ,
-				 state->seg.ws_tli, /* Pass the current TLI because only
-									 * WalSndSegmentOpen controls whether new
-									 * TLI is needed. */
-				 &errinfo))
+	/*
+	 * Now actually read the data, we know it's there.  Recent WAL is likely
+	 * still in the WAL buffers, shared with all other walsenders, so try
+	 * there first and read only what's missing from the file.  If the buffers
+	 * had everything, zero the rest of the page like read_local_xlog_page().
+	 */
+	rbytes = WALReadFromBuffers(cur_page, targetPagePtr, count,
+								state->currTLI);
+	if (rbytes == count)
+		memset(cur_page + count, 0, XLOG_BLCKSZ - count);
+	else if (!WALRead(state,
+					  cur_page + rbytes,
+					  targetPagePtr + rbytes,
+					  XLOG_BLCKSZ - rbytes,
+					  state->seg.ws_tli,	/* Pass the current TLI because
+											 * only WalSndSegmentOpen controls
+											 * whether new TLI is needed. */
+					  &errinfo))
 		WALReadRaiseError(&errinfo);
 
 	/*
@@ -2724,6 +2734,7 @@ XLogSendPhysical(void)
 	XLogRecPtr	startptr;
 	XLogRecPtr	endptr;
 	Size		nbytes;
+	Size		rbytes;
 	XLogSegNo	segno;
 	WALReadError errinfo;
 
@@ -2940,11 +2951,16 @@ XLogSendPhysical(void)
 	 */
 	enlargeStringInfo(&output_message, nbytes);
 
+	/* Take what we can from the WAL buffers, see logical_read_xlog_page() */
+	rbytes = WALReadFromBuffers(&output_message.data[output_message.len],
+								startptr, nbytes, sendTimeLine);
+
 retry:
-	if (!WALRead(xlogreader,
-				 &output_message.data[output_message.len],
-				 startptr,
-				 nbytes,
+	if (rbytes < nbytes &&
+		!WALRead(xlogreader,
+				 &output_message.data[output_message.len + rbytes],
+				 startptr + rbytes,
+				 nbytes - rbytes,
 				 xlogreader->seg.ws_tli,	/* Pass the current TLI because
 											 * only WalSndSegmentOpen controls
 											 * whether new TLI is needed. */
@@ -48,9 +48,11 @@
 #include "storage/buf_internals.h"
 #include "storage/bufmgr.h"
 #include "storage/ipc.h"
+#include "storage/lmgr.h"
 #include "storage/proc.h"
 #include "storage/smgr.h"
 #include "storage/standby.h"
+#include "utils/guc.h"
 #include "utils/memdebug.h"
 #include "utils/ps_status.h"
 #include "utils/rel.h"
@@ -810,6 +812,114 @@ ReadBufferWithoutRelcache(RelFileLocator rlocator, ForkNumber forkNum,
 }
 
 
+/*
+ * ExtendBufferedRelBy -- extend a relation by several blocks at once
+ *
+ * Adds up to extend_by zero-filled blocks to the given fork, and returns them
+ * pinned in buffers[].  The number of blocks actually added, which may be
+ * less than requested to avoid pinning too many buffers, is returned in
+ * *extended_by; the return value is the block number of the first of them.
+ *
+ * The new buffers are entered into the buffer pool before the file is
+ * extended, and the file is then extended with a single smgrzeroextend()
+ * call, so the relation extension lock is only held for a short time no
+ * matter how many blocks are added.  If EB_LOCK_FIRST is given, the first
+ * buffer is returned exclusively locked, and nobody else can have seen it
+ * yet.  The other buffers are returned unlocked; once this returns, other
+ * backends can find them (for example through the FSM), so callers must
+ * lock them and check PageIsNew() before initializing them.
+ *
+ * Pass EB_SKIP_EXTENSION_LOCK if the caller already holds the relation
+ * extension lock.  It is not needed for relations that are local to this
+ * backend.
+ */
+BlockNumber
+ExtendBufferedRelBy(Relation rel, ForkNumber forkNum,
+					BufferAccessStrategy strategy,
+					uint32 flags, uint32 extend_by,
+					Buffer *buffers, uint32 *extended_by)
+{
+	SMgrRelation smgr = RelationGetSmgr(rel);
+	bool		isLocalBuf = SmgrIsTemp(smgr);
+	bool		needLock;
+	BlockNumber firstBlock;
+
+	Assert(extend_by > 0);
+
+	/*
+	 * Don't pin more than our fair share of the buffer pool.  Temp buffers
+	 * are a much smaller pool that is exhausted easily, so be more careful
+	 * there.
+	 */
+	if (isLocalBuf)
+		extend_by = Min(extend_by, Max(num_temp_buffers / 8, 1));
+	else
+	{
+		int			maxPins;
+
+		maxPins = NBuffers / (MaxBackends + NUM_AUXILIARY_PROCS);
+		maxPins -= PrivateRefCountOverflowed + REFCOUNT_ARRAY_ENTRIES;
+		extend_by = Min(extend_by, Max(maxPins, 1));
+	}
+
+	needLock = !(flags & EB_SKIP_EXTENSION_LOCK) && !RELATION_IS_LOCAL(rel);
+	if (needLock)
+		LockRelationForExtension(rel, ExclusiveLock);
+
+	firstBlock = smgrnblocks(smgr, forkNum);
+
+	/* Fail if relation would grow beyond the maximum possible length */
+	if ((uint64) firstBlock + extend_by > (uint64) MaxBlockNumber + 1)
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("cannot extend relation %s beyond %u blocks",
+						relpath(smgr->smgr_rlocator, forkNum),
+						MaxBlockNumber + 1)));
+
+	/*
+	 * Set up zero-filled buffers for the new blocks.  They lie beyond the
+	 * current EOF, so this doesn't need any I/O, and nobody else can be
+	 * looking for them until we extend the file.  Valid buffers for such
+	 * blocks can be left over from a previous extension attempt that failed
+	 * to extend the file, or with zero_damaged_pages; as in the P_NEW path of
+	 * ReadBuffer_common, those must be all-zeroes.
+	 */
+	for (uint32 i = 0; i < extend_by; i++)
+	{
+		BlockNumber blockNum = firstBlock + i;
+		bool		hit;
+		Buffer		buf;
+
+		buf = ReadBuffer_common(smgr, rel->rd_rel->relpersistence, forkNum,
+								blockNum, RBM_ZERO_AND_LOCK, strategy, &hit);
+		buffers[i] = buf;
+
+		if (hit && !PageIsNew(BufferGetPage(buf)))
+			ereport(ERROR,
+					(errmsg("unexpected data beyond EOF in block %u of relation %s",
+							blockNum, relpath(smgr->smgr_rlocator, forkNum)),
+					 errhint("This has been seen to occur with buggy kernels; consider updating your system.")));
+
+		if (i > 0 || !(flags & EB_LOCK_FIRST))
+			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
+	}
+
+	/* Now reserve the space on disk, all in one go */
+	smgrzeroextend(smgr, forkNum, firstBlock, extend_by, false);
+
+	if (needLock)
+		UnlockRelationForExtension(rel, ExclusiveLock);
+
+	if (isLocalBuf)
+		pgBufferUsage.local_blks_written += extend_by;
+	else
+		pgBufferUsage.shared_blks_written += extend_by;
+
+	*extended_by = extend_by;
+
+	return firstBlock;
+}
+
 /*
  * ReadBuffer_common -- common logic for all ReadBuffer variants
  *
@@ -2185,6 +2185,126 @@ retry:
 	return returnCode;
 }
 
+/*
+ * FileZero - write zeroes to a region of a file
+ *
+ * Returns 0 on success, -1 otherwise, with errno set.
+ */
+int
+FileZero(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+	static PGAlignedBlock zbuffer;	/* always all zeroes */
+	struct iovec iov[PG_IOV_MAX];
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileZero: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+	/* Every element points at the same block of zeroes */
+	for (int i = 0; i < PG_IOV_MAX; i++)
+	{
+		iov[i].iov_base = zbuffer.data;
+		iov[i].iov_len = BLCKSZ;
+	}
+
+	while (amount > 0)
+	{
+		int			iovcnt = 0;
+		off_t		chunk = 0;
+		ssize_t		written;
+
+		while (iovcnt < PG_IOV_MAX && chunk < amount)
+		{
+			iov[iovcnt].iov_len = Min(BLCKSZ, amount - chunk);
+			chunk += iov[iovcnt].iov_len;
+			iovcnt++;
+		}
+
+		errno = 0;
+		pgstat_report_wait_start(wait_event_info);
+		written = pwritev(VfdCache[file].fd, iov, iovcnt, offset);
+		pgstat_report_wait_end();
+
+		if (written < 0)
+		{
+			/* OK to retry if interrupted */
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (written == 0)
+		{
+			/* if write didn't set errno, assume problem is no disk space */
+			if (errno == 0)
+				errno = ENOSPC;
+			return -1;
+		}
+
+		offset += written;
+		amount -= written;
+
+		/* restore full-sized elements for the next round */
+		for (int i = 0; i < iovcnt; i++)
+			iov[i].iov_len = BLCKSZ;
+	}
+
+	return 0;
+}
+
+/*
+ * FileFallocate - allocate zero-filled space in a file
+ *
+ * Uses posix_fallocate() where available, which is usually much cheaper than
+ * writing out zeroes; falls back to FileZero() otherwise.  Returns 0 on
+ * success, -1 otherwise, with errno set.
+ */
+int
+FileFallocate(File file, off_t offset, off_t amount, uint32 wait_event_info)
+{
+#ifdef HAVE_POSIX_FALLOCATE
+	int			returnCode;
+
+	Assert(FileIsValid(file));
+
+	DO_DB(elog(LOG, "FileFallocate: %d (%s) " INT64_FORMAT " " INT64_FORMAT,
+			   file, VfdCache[file].fileName,
+			   (int64) offset, (int64) amount));
+
+	returnCode = FileAccess(file);
+	if (returnCode < 0)
+		return returnCode;
+
+retry:
+	pgstat_report_wait_start(wait_event_info);
+	returnCode = posix_fallocate(VfdCache[file].fd, offset, amount);
+	pgstat_report_wait_end();
+
+	if (returnCode == 0)
+		return 0;
+	if (returnCode == EINTR)
+		goto retry;
+
+	/* posix_fallocate() doesn't set errno, but our callers expect it to */
+	errno = returnCode;
+
+	/*
+	 * Fall back to writing zeroes if the filesystem doesn't support it, but
+	 * report any other failure.
+	 */
+	if (returnCode != EINVAL && returnCode != EOPNOTSUPP)
+		return -1;
+#endif
+
+	return FileZero(file, offset, amount, wait_event_info);
+}
+
 int
 FileSync(File file, uint32 wait_event_info)
 {
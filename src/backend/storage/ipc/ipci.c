@@ -22,6 +22,7 @@
 #include "access/subtrans.h"
 #include "access/syncscan.h"
 #include "access/twophase.h"
+#include "access/xlogparallel.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogrecovery.h"
 #include "commands/async.h"
@@ -47,6 +48,7 @@
 #include "storage/procsignal.h"
 #include "storage/sinvaladt.h"
 #include "storage/spin.h"
+#include "storage/subxidmap.h"
 #include "utils/guc.h"
 #include "utils/snapmgr.h"
 
@@ -117,6 +119,7 @@ CalculateShmemSize(int *num_semaphores)
 	size = add_size(size, XLogPrefetchShmemSize());
 	size = add_size(size, XLOGShmemSize());
 	size = add_size(size, XLogRecoveryShmemSize());
+	size = add_size(size, ParallelRedoShmemSize());
 	size = add_size(size, CLOGShmemSize());
 	size = add_size(size, CommitTsShmemSize());
 	size = add_size(size, SUBTRANSShmemSize());
@@ -125,6 +128,7 @@ CalculateShmemSize(int *num_semaphores)
 	size = add_size(size, MultiXactShmemSize());
 	size = add_size(size, LWLockShmemSize());
 	size = add_size(size, ProcArrayShmemSize());
+	size = add_size(size, SubXidMapShmemSize());
 	size = add_size(size, BackendStatusShmemSize());
 	size = add_size(size, SInvalShmemSize());
 	size = add_size(size, PMSignalShmemSize());
@@ -241,6 +245,7 @@ CreateSharedMemoryAndSemaphores(void)
 	XLOGShmemInit();
 	XLogPrefetchShmemInit();
 	XLogRecoveryShmemInit();
+	ParallelRedoShmemInit();
 	CLOGShmemInit();
 	CommitTsShmemInit();
 	SUBTRANSShmemInit();
@@ -263,6 +268,7 @@ CreateSharedMemoryAndSemaphores(void)
 	if (!IsUnderPostmaster)
 		InitProcGlobal();
 	CreateSharedProcArray();
+	SubXidMapShmemInit();
 	CreateSharedBackendStatus();
 	TwoPhaseShmemInit();
 	BackgroundWorkerShmemInit();
@@ -61,6 +61,7 @@
 #include "storage/proc.h"
 #include "storage/procarray.h"
 #include "storage/spin.h"
+#include "storage/subxidmap.h"
 #include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/rel.h"
@@ -586,6 +587,7 @@ ProcArrayRemove(PGPROC *proc, TransactionId latestXid)
 
 		ProcGlobal->xids[myoff] = InvalidTransactionId;
 		ProcGlobal->subxidStates[myoff].overflowed = false;
+		ProcGlobal->subxidStates[myoff].mapped = false;
 		ProcGlobal->subxidStates[myoff].count = 0;
 	}
 	else
@@ -756,8 +758,10 @@ ProcArrayEndTransactionInternal(PGPROC *proc, TransactionId latestXid)
 	{
 		ProcGlobal->subxidStates[pgxactoff].count = 0;
 		ProcGlobal->subxidStates[pgxactoff].overflowed = false;
+		ProcGlobal->subxidStates[pgxactoff].mapped = false;
 		proc->subxidStatus.count = 0;
 		proc->subxidStatus.overflowed = false;
+		proc->subxidStatus.mapped = false;
 	}
 
 	/* Also advance global latestCompletedXid while holding the lock */
@@ -942,8 +946,10 @@ ProcArrayClearTransaction(PGPROC *proc)
 	{
 		ProcGlobal->subxidStates[pgxactoff].count = 0;
 		ProcGlobal->subxidStates[pgxactoff].overflowed = false;
+		ProcGlobal->subxidStates[pgxactoff].mapped = false;
 		proc->subxidStatus.count = 0;
 		proc->subxidStatus.overflowed = false;
+		proc->subxidStatus.mapped = false;
 	}
 
 	LWLockRelease(ProcArrayLock);
@@ -1564,7 +1570,7 @@ TransactionIdIsInProgress(TransactionId xid)
 	}
 
 	/*
-	 * Step 4: have to check pg_subtrans.
+	 * Step 4: have to check pg_subtrans, unless the SubXidMap knows the answer.
 	 *
 	 * At this point, we know it's either a subtransaction of one of the Xids
 	 * in xids[], or it's not running.  If it's an already-failed
@@ -1584,7 +1590,9 @@ TransactionIdIsInProgress(TransactionId xid)
 	 * is still running (or, more precisely, whether it was running when we
 	 * held ProcArrayLock).
 	 */
-	topxid = SubTransGetTopmostTransaction(xid);
+	topxid = SubXidMapLookup(xid);
+	if (!TransactionIdIsValid(topxid))
+		topxid = SubTransGetTopmostTransaction(xid);
 	Assert(TransactionIdIsValid(topxid));
 	if (!TransactionIdEquals(topxid, xid))
 	{
@@ -2186,10 +2194,10 @@ GetSnapshotDataReuse(Snapshot snapshot)
  * All running top-level XIDs are included in the snapshot, except for lazy
  * VACUUM processes.  We also try to include running subtransaction XIDs,
  * but since PGPROC has only a limited cache area for subxact XIDs, full
- * information may not be available.  If we find any overflowed subxid arrays,
- * we have to mark the snapshot's subxid data as overflowed, and extra work
- * *may* need to be done to determine what's running (see XidInMVCCSnapshot()
- * in heapam_visibility.c).
+ * information may not be available.  If we find any overflowed subxid arrays
+ * whose excess isn't recorded in the SubXidMap, we have to mark the
+ * snapshot's subxid data as overflowed, and extra work *may* need to be done
+ * to determine what's running (see XidInMVCCSnapshot() in snapmgr.c).
  *
  * We also update the following backend-global variables:
  *		TransactionXmin: the oldest xmin of any snapshot in use in the
@@ -2213,6 +2221,7 @@ GetSnapshotData(Snapshot snapshot)
 	int			count = 0;
 	int			subcount = 0;
 	bool		suboverflowed = false;
+	bool		subxidmapped = false;
 	FullTransactionId latest_completed;
 	TransactionId oldestxid;
 	int			mypgxactoff;
@@ -2369,16 +2378,24 @@ GetSnapshotData(Snapshot snapshot)
 			 * xmax.)
 			 *
 			 * Again, our own XIDs are not included in the snapshot.
+			 *
+			 * A backend whose overflowed subxids are all in the SubXidMap
+			 * doesn't force the snapshot to be suboverflowed: we still save
+			 * its cached subxids, and XidInMVCCSnapshot() will consult the
+			 * map for the rest.
 			 */
 			if (!suboverflowed)
 			{
-
-				if (subxidStates[pgxactoff].overflowed)
+				if (subxidStates[pgxactoff].overflowed &&
+					!subxidStates[pgxactoff].mapped)
 					suboverflowed = true;
 				else
 				{
 					int			nsubxids = subxidStates[pgxactoff].count;
 
+					if (subxidStates[pgxactoff].overflowed)
+						subxidmapped = true;
+
 					if (nsubxids > 0)
 					{
 						int			pgprocno = pgprocnos[pgxactoff];
@@ -2539,6 +2556,7 @@ GetSnapshotData(Snapshot snapshot)
 	snapshot->xcnt = count;
 	snapshot->subxcnt = subcount;
 	snapshot->suboverflowed = suboverflowed;
+	snapshot->subxidmapped = subxidmapped && !suboverflowed;
 	snapshot->snapXactCompletionCount = curXactCompletionCount;
 
 	snapshot->curcid = GetCurrentCommandId(false);
@@ -2942,6 +2960,53 @@ GetOldestActiveTransactionId(void)
 	return oldestRunningXid;
 }
 
+/*
+ * GetOldestXminOfAllBackends()
+ *
+ * Like GetOldestActiveTransactionId, but also takes the xmin advertised by
+ * every backend into account, including VACUUM and logical decoding
+ * processes that GetSnapshotData() and the horizon computations ignore.  No
+ * snapshot in use anywhere can consider an XID preceding the result to be
+ * running.  This is used to decide which SubXidMap entries can be removed.
+ */
+TransactionId
+GetOldestXminOfAllBackends(void)
+{
+	ProcArrayStruct *arrayP = procArray;
+	TransactionId *other_xids = ProcGlobal->xids;
+	TransactionId result;
+	int			index;
+
+	Assert(!RecoveryInProgress());
+
+	/* See GetOldestActiveTransactionId about the need for XidGenLock */
+	LWLockAcquire(XidGenLock, LW_SHARED);
+	result = XidFromFullTransactionId(ShmemVariableCache->nextXid);
+	LWLockRelease(XidGenLock);
+
+	LWLockAcquire(ProcArrayLock, LW_SHARED);
+	for (index = 0; index < arrayP->numProcs; index++)
+	{
+		PGPROC	   *proc = &allProcs[arrayP->pgprocnos[index]];
+		TransactionId xid;
+		TransactionId xmin;
+
+		/* Fetch xid and xmin just once - see GetNewTransactionId */
+		xid = UINT32_ACCESS_ONCE(other_xids[index]);
+		xmin = UINT32_ACCESS_ONCE(proc->xmin);
+
+		if (TransactionIdIsNormal(xid) &&
+			TransactionIdPrecedes(xid, result))
+			result = xid;
+		if (TransactionIdIsNormal(xmin) &&
+			TransactionIdPrecedes(xmin, result))
+			result = xmin;
+	}
+	LWLockRelease(ProcArrayLock);
+
+	return result;
+}
+
 /*
  * GetOldestSafeDecodingTransactionId -- lowest xid not affected by vacuum
  *
@@ -0,0 +1,323 @@
+/*-------------------------------------------------------------------------
+ *
+ * subxidmap.c
+ *	  Shared map from overflowed subtransaction XIDs to top-level XIDs.
+ *
+ * Each backend caches up to PGPROC_MAX_CACHED_SUBXIDS subtransaction XIDs in
+ * its PGPROC.  Once it has assigned more than that, its subxid cache is
+ * marked overflowed, and traditionally every snapshot taken while such a
+ * backend is running has to be marked suboverflowed.  XidInMVCCSnapshot()
+ * then maps every XID between xmin and xmax through pg_subtrans, so a single
+ * backend using lots of savepoints slows down visibility checks for
+ * everybody.
+ *
+ * To avoid that, GetNewTransactionId() also enters each subxid that doesn't
+ * fit in the PGPROC cache into this map, along with its top-level XID, and
+ * records in the backend's XidCacheStatus whether all of its overflowed
+ * subxids made it in ("mapped").  A snapshot that sees only mapped overflowed
+ * backends is not marked suboverflowed; instead XidInMVCCSnapshot() consults
+ * the map for XIDs not found in subxip[].  A miss in the map is
+ * authoritative: entries are only removed once their top-level XID precedes
+ * the xmin and XID of every backend, at which point no snapshot in use can
+ * consider them running.
+ *
+ * pg_subtrans is still maintained for every subxid, so backends that could
+ * not map all of their subxids (because the map was full, or because they
+ * are prepared transactions) simply make snapshots fall back to it as
+ * before.
+ *
+ * The map is a fixed-size partitioned shared hash table, sized by
+ * max_overflowed_subxids.  It is pruned when an insertion fails, and also
+ * every SUBXIDMAP_PRUNE_INTERVAL XIDs while it is in use.  Pruning only
+ * happens while overflowed subxids are being assigned, so an entry can
+ * outlive 2^31 XIDs or more if nobody overflows for a long time.  Entries
+ * therefore record their top-level XID as a FullTransactionId, which pruning
+ * compares with the horizon in 64 bits.  Lookups are by 32-bit XID, but the
+ * map is only consulted while some backend has overflowed, and every
+ * backend's first overflowed subxid triggers a pruning if one is due, which
+ * removes every entry old enough to be confused with a recycled XID.
+ *
+ *
+ * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/storage/ipc/subxidmap.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/transam.h"
+#include "port/atomics.h"
+#include "storage/lwlock.h"
+#include "storage/procarray.h"
+#include "storage/shmem.h"
+#include "storage/subxidmap.h"
+#include "utils/hsearch.h"
+
+/* Number of partitions of the map; must be a power of 2 */
+#define NUM_SUBXIDMAP_PARTITIONS	16
+
+/* Prune the map at least once every this many XIDs while it's in use */
+#define SUBXIDMAP_PRUNE_INTERVAL	((uint64) 1 << 24)
+
+typedef struct SubXidMapEnt
+{
+	TransactionId subxid;		/* hash key; must be first */
+	FullTransactionId topxid;	/* top-level XID of its transaction */
+} SubXidMapEnt;
+
+typedef struct SubXidMapSharedData
+{
+	/* set when an insertion has failed for lack of space */
+	pg_atomic_uint32 needPrune;
+	/* nextXid as of the last pruning, as a FullTransactionId */
+	pg_atomic_uint64 lastPruneXid;
+	LWLockPadded partitionLocks[NUM_SUBXIDMAP_PARTITIONS];
+} SubXidMapSharedData;
+
+int			max_overflowed_subxids = 65536;
+
+static SubXidMapSharedData *SubXidMapShared = NULL;
+static HTAB *SubXidMapHash = NULL;
+
+#define SubXidMapPartitionLock(hashcode) \
+	(&SubXidMapShared->partitionLocks[(hashcode) % NUM_SUBXIDMAP_PARTITIONS].lock)
+
+static void SubXidMapPrune(void);
+
+
+/*
+ * Report shared-memory space needed by SubXidMapShmemInit
+ */
+Size
+SubXidMapShmemSize(void)
+{
+	Size		size;
+
+	size = MAXALIGN(sizeof(SubXidMapSharedData));
+	if (max_overflowed_subxids > 0)
+		size = add_size(size, hash_estimate_size(max_overflowed_subxids,
+												 sizeof(SubXidMapEnt)));
+
+	return size;
+}
+
+/*
+ * Initialize, or attach to, the shared subxid map
+ */
+void
+SubXidMapShmemInit(void)
+{
+	HASHCTL		info;
+	bool		found;
+
+	SubXidMapShared = (SubXidMapSharedData *)
+		ShmemInitStruct("SubXidMap Data", sizeof(SubXidMapSharedData), &found);
+
+	if (!found)
+	{
+		pg_atomic_init_u32(&SubXidMapShared->needPrune, 0);
+		pg_atomic_init_u64(&SubXidMapShared->lastPruneXid,
+						   FirstNormalTransactionId);
+		for (int i = 0; i < NUM_SUBXIDMAP_PARTITIONS; i++)
+			LWLockInitialize(&SubXidMapShared->partitionLocks[i].lock,
+							 LWTRANCHE_SUBXID_MAP);
+	}
+
+	/* max_overflowed_subxids = 0 disables the map */
+	if (max_overflowed_subxids == 0)
+		return;
+
+	info.keysize = sizeof(TransactionId);
+	info.entrysize = sizeof(SubXidMapEnt);
+	info.num_partitions = NUM_SUBXIDMAP_PARTITIONS;
+
+	SubXidMapHash = ShmemInitHash("SubXidMap Hash",
+								  max_overflowed_subxids,
+								  max_overflowed_subxids,
+								  &info,
+								  HASH_ELEM | HASH_BLOBS | HASH_PARTITION |
+								  HASH_FIXED_SIZE);
+}
+
+/*
+ * SubXidMapInsert
+ *		Enter an overflowed subtransaction XID and its top-level XID.
+ *
+ * Returns false if the map is disabled or full, in which case the caller
+ * must stop advertising its subxids as mapped.  This is called while holding
+ * XidGenLock, so it must not do anything more than take a partition lock;
+ * pruning is left to SubXidMapMaintain().
+ */
+bool
+SubXidMapInsert(TransactionId subxid, FullTransactionId topxid)
+{
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	SubXidMapEnt *ent;
+	bool		found;
+
+	if (SubXidMapHash == NULL)
+		return false;
+
+	hashcode = get_hash_value(SubXidMapHash, &subxid);
+	partitionLock = SubXidMapPartitionLock(hashcode);
+
+	LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+	ent = (SubXidMapEnt *)
+		hash_search_with_hash_value(SubXidMapHash, &subxid, hashcode,
+									HASH_ENTER_NULL, &found);
+	if (ent != NULL)
+		ent->topxid = topxid;
+	LWLockRelease(partitionLock);
+
+	if (ent == NULL)
+	{
+		pg_atomic_write_u32(&SubXidMapShared->needPrune, 1);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * SubXidMapLookup
+ *		Return the top-level XID of an overflowed subxid, or
+ *		InvalidTransactionId if the map has no entry for it.
+ */
+TransactionId
+SubXidMapLookup(TransactionId xid)
+{
+	uint32		hashcode;
+	LWLock	   *partitionLock;
+	SubXidMapEnt *ent;
+	TransactionId topxid = InvalidTransactionId;
+
+	if (SubXidMapHash == NULL)
+		return InvalidTransactionId;
+
+	hashcode = get_hash_value(SubXidMapHash, &xid);
+	partitionLock = SubXidMapPartitionLock(hashcode);
+
+	LWLockAcquire(partitionLock, LW_SHARED);
+	ent = (SubXidMapEnt *)
+		hash_search_with_hash_value(SubXidMapHash, &xid, hashcode,
+									HASH_FIND, NULL);
+	if (ent != NULL)
+		topxid = XidFromFullTransactionId(ent->topxid);
+	LWLockRelease(partitionLock);
+
+	return topxid;
+}
+
+/*
+ * SubXidMapMaintain
+ *		Prune the map if an insertion has failed since the last pruning, or
+ *		if it hasn't been pruned for a long time.
+ *
+ * curxid is any recently assigned XID, used to measure the time since the
+ * last pruning.  It's a FullTransactionId, because a 32-bit distance would
+ * look small again once a full XID epoch had passed without any pruning.
+ * curxid may also be older than the last pruning, if it was assigned before
+ * another backend pruned.  GetNewTransactionId() calls this before assigning
+ * a subxid that will overflow the caller's PGPROC cache, so it must be
+ * called without holding XidGenLock or ProcArrayLock.
+ */
+void
+SubXidMapMaintain(FullTransactionId curxid)
+{
+	uint64		lastPruneXid;
+
+	if (SubXidMapHash == NULL)
+		return;
+
+	lastPruneXid = pg_atomic_read_u64(&SubXidMapShared->lastPruneXid);
+	if (pg_atomic_read_u32(&SubXidMapShared->needPrune) == 0 &&
+		U64FromFullTransactionId(curxid) <
+		lastPruneXid + SUBXIDMAP_PRUNE_INTERVAL)
+		return;
+
+	SubXidMapPrune();
+}
+
+/*
+ * Remove all entries whose top-level XID precedes every backend's xmin.
+ *
+ * The stale entries are collected while holding all partition locks in
+ * shared mode, so that lookups are never blocked, and then removed taking
+ * one partition lock at a time.  A concurrent pruning may remove some of
+ * them first, which is harmless.
+ */
+static void
+SubXidMapPrune(void)
+{
+	HASH_SEQ_STATUS status;
+	SubXidMapEnt *ent;
+	TransactionId *stale;
+	int			nstale = 0;
+	TransactionId horizon;
+	FullTransactionId nextXid;
+	FullTransactionId fullHorizon;
+	int			i;
+
+	/*
+	 * Reset the triggers first, so that an insertion failing while we work
+	 * sets needPrune again.
+	 */
+	pg_atomic_write_u32(&SubXidMapShared->needPrune, 0);
+	pg_atomic_write_u64(&SubXidMapShared->lastPruneXid,
+						U64FromFullTransactionId(ReadNextFullTransactionId()));
+
+	/*
+	 * Entries made after we compute the horizon belong to transactions that
+	 * are running, and so cannot precede it.  The horizon precedes nextXid
+	 * by less than 2^31 XIDs, so we can tell its epoch from nextXid's.
+	 */
+	horizon = GetOldestXminOfAllBackends();
+	nextXid = ReadNextFullTransactionId();
+	fullHorizon =
+		FullTransactionIdFromU64(U64FromFullTransactionId(nextXid) -
+								 (XidFromFullTransactionId(nextXid) - horizon));
+
+	stale = (TransactionId *)
+		palloc(max_overflowed_subxids * sizeof(TransactionId));
+
+	for (i = 0; i < NUM_SUBXIDMAP_PARTITIONS; i++)
+		LWLockAcquire(&SubXidMapShared->partitionLocks[i].lock, LW_SHARED);
+
+	hash_seq_init(&status, SubXidMapHash);
+	while ((ent = (SubXidMapEnt *) hash_seq_search(&status)) != NULL)
+	{
+		if (FullTransactionIdPrecedes(ent->topxid, fullHorizon))
+		{
+			Assert(nstale < max_overflowed_subxids);
+			stale[nstale++] = ent->subxid;
+		}
+	}
+
+	for (i = NUM_SUBXIDMAP_PARTITIONS; --i >= 0;)
+		LWLockRelease(&SubXidMapShared->partitionLocks[i].lock);
+
+	/*
+	 * A stale subxid cannot have been entered again meanwhile, because it
+	 * would take 2^32 XIDs to recycle it, so remove whatever entry we find.
+	 */
+	for (i = 0; i < nstale; i++)
+	{
+		uint32		hashcode;
+		LWLock	   *partitionLock;
+
+		hashcode = get_hash_value(SubXidMapHash, &stale[i]);
+		partitionLock = SubXidMapPartitionLock(hashcode);
+
+		LWLockAcquire(partitionLock, LW_EXCLUSIVE);
+		hash_search_with_hash_value(SubXidMapHash, &stale[i], hashcode,
+									HASH_REMOVE, NULL);
+		LWLockRelease(partitionLock);
+	}
+
+	pfree(stale);
+}
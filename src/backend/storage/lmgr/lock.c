@@ -54,6 +54,9 @@
 /* This configuration variable is used to set the lock table size */
 int			max_locks_per_xact; /* set by guc.c */
 
+/* Number of fast-path lock groups, see InitializeFastPathLocks() */
+int			FastPathLockGroupsPerBackend = 0;
+
 #define NLOCKENTS() \
 	mul_size(max_locks_per_xact, add_size(MaxBackends, max_prepared_xacts))
 
@@ -164,12 +167,15 @@ typedef struct TwoPhaseLockRecord
 
 
 /*
- * Count of the number of fast path lock slots we believe to be used.  This
- * might be higher than the real number if another backend has transferred
- * our locks to the primary lock table, but it can never be lower than the
- * real value, since only we can acquire locks on our own behalf.
+ * Count of the number of fast path lock slots we believe to be used in each
+ * group.  This might be higher than the real number if another backend has
+ * transferred our locks to the primary lock table, but it can never be lower
+ * than the real value, since only we can acquire locks on our own behalf.
+ *
+ * This is sized for the maximum number of groups, so that it doesn't need
+ * to be allocated; only the first FastPathLockGroupsPerBackend are used.
  */
-static int	FastPathLocalUseCount = 0;
+static int	FastPathLocalUseCounts[FP_LOCK_GROUPS_PER_BACKEND_MAX];
 
 /*
  * Flag to indicate if the relation extension lock is held by this backend.
@@ -198,23 +204,45 @@ static bool IsRelationExtensionLockHeld PG_USED_FOR_ASSERTS_ONLY = false;
  */
 static bool IsPageLockHeld PG_USED_FOR_ASSERTS_ONLY = false;
 
-/* Macros for manipulating proc->fpLockBits */
+/*
+ * Fast-path slots are numbered 0 .. FastPathLockSlotsPerBackend() - 1, and
+ * organized in groups of FP_LOCK_SLOTS_PER_GROUP.  A relation can only use
+ * the slots in the group its OID maps to, so that lookups need to scan just
+ * one group.  The number of groups is always a power of two.
+ */
+#define FAST_PATH_REL_GROUP(rel) \
+	(((uint64) (rel) * 49157) & (FastPathLockGroupsPerBackend - 1))
+#define FAST_PATH_SLOT(group, index) \
+	(AssertMacro((uint32) (group) < FastPathLockGroupsPerBackend), \
+	 AssertMacro((uint32) (index) < FP_LOCK_SLOTS_PER_GROUP), \
+	 ((group) * FP_LOCK_SLOTS_PER_GROUP + (index)))
+#define FAST_PATH_GROUP(n) \
+	(AssertMacro((uint32) (n) < FastPathLockSlotsPerBackend()), \
+	 ((n) / FP_LOCK_SLOTS_PER_GROUP))
+#define FAST_PATH_INDEX(n) \
+	(AssertMacro((uint32) (n) < FastPathLockSlotsPerBackend()), \
+	 ((n) % FP_LOCK_SLOTS_PER_GROUP))
+
+/* Macros for manipulating proc->fpLockBits; there's one word per group */
 #define FAST_PATH_BITS_PER_SLOT			3
 #define FAST_PATH_LOCKNUMBER_OFFSET		1
 #define FAST_PATH_MASK					((1 << FAST_PATH_BITS_PER_SLOT) - 1)
+#define FAST_PATH_BITS(proc, n)			(proc)->fpLockBits[FAST_PATH_GROUP(n)]
 #define FAST_PATH_GET_BITS(proc, n) \
-	(((proc)->fpLockBits >> (FAST_PATH_BITS_PER_SLOT * n)) & FAST_PATH_MASK)
+	((FAST_PATH_BITS(proc, n) >> (FAST_PATH_BITS_PER_SLOT * FAST_PATH_INDEX(n))) & FAST_PATH_MASK)
 #define FAST_PATH_BIT_POSITION(n, l) \
 	(AssertMacro((l) >= FAST_PATH_LOCKNUMBER_OFFSET), \
 	 AssertMacro((l) < FAST_PATH_BITS_PER_SLOT+FAST_PATH_LOCKNUMBER_OFFSET), \
-	 AssertMacro((n) < FP_LOCK_SLOTS_PER_BACKEND), \
-	 ((l) - FAST_PATH_LOCKNUMBER_OFFSET + FAST_PATH_BITS_PER_SLOT * (n)))
+	 ((l) - FAST_PATH_LOCKNUMBER_OFFSET + FAST_PATH_BITS_PER_SLOT * (FAST_PATH_INDEX(n))))
 #define FAST_PATH_SET_LOCKMODE(proc, n, l) \
-	 (proc)->fpLockBits |= UINT64CONST(1) << FAST_PATH_BIT_POSITION(n, l)
+	 FAST_PATH_BITS(proc, n) |= UINT64CONST(1) << FAST_PATH_BIT_POSITION(n, l)
 #define FAST_PATH_CLEAR_LOCKMODE(proc, n, l) \
-	 (proc)->fpLockBits &= ~(UINT64CONST(1) << FAST_PATH_BIT_POSITION(n, l))
+	 FAST_PATH_BITS(proc, n) &= ~(UINT64CONST(1) << FAST_PATH_BIT_POSITION(n, l))
 #define FAST_PATH_CHECK_LOCKMODE(proc, n, l) \
-	 ((proc)->fpLockBits & (UINT64CONST(1) << FAST_PATH_BIT_POSITION(n, l)))
+	 (FAST_PATH_BITS(proc, n) & (UINT64CONST(1) << FAST_PATH_BIT_POSITION(n, l)))
+
+StaticAssertDecl(FAST_PATH_BITS_PER_SLOT * FP_LOCK_SLOTS_PER_GROUP <= 64,
+				 "fast-path lock bits for a group must fit in a uint64");
 
 /*
  * The fast-path lock mechanism is concerned only with relation locks on
@@ -916,16 +944,18 @@ LockAcquireExtended(const LOCKTAG *locktag,
 
 	/*
 	 * Attempt to take lock via fast path, if eligible.  But if we remember
-	 * having filled up the fast path array, we don't attempt to make any
-	 * further use of it until we release some locks.  It's possible that some
-	 * other backend has transferred some of those locks to the shared hash
-	 * table, leaving space free, but it's not worth acquiring the LWLock just
-	 * to check.  It's also possible that we're acquiring a second or third
-	 * lock type on a relation we have already locked using the fast-path, but
-	 * for now we don't worry about that case either.
+	 * having filled up the fast path group this relation maps to, we don't
+	 * attempt to make any further use of it until we release some locks.
+	 * It's possible that some other backend has transferred some of those
+	 * locks to the shared hash table, leaving space free, but it's not worth
+	 * acquiring the LWLock just to check.  It's also possible that we're
+	 * acquiring a second or third lock type on a relation we have already
+	 * locked using the fast-path, but for now we don't worry about that case
+	 * either.
 	 */
 	if (EligibleForRelationFastPath(locktag, lockmode) &&
-		FastPathLocalUseCount < FP_LOCK_SLOTS_PER_BACKEND)
+		FastPathLocalUseCounts[FAST_PATH_REL_GROUP(locktag->locktag_field2)] <
+		FP_LOCK_SLOTS_PER_GROUP)
 	{
 		uint32		fasthashcode = FastPathStrongLockHashPartition(hashcode);
 		bool		acquired;
@@ -2077,7 +2107,7 @@ LockRelease(const LOCKTAG *locktag, LOCKMODE lockmode, bool sessionLock)
 
 	/* Attempt fast release of any lock eligible for the fast path. */
 	if (EligibleForRelationFastPath(locktag, lockmode) &&
-		FastPathLocalUseCount > 0)
+		FastPathLocalUseCounts[FAST_PATH_REL_GROUP(locktag->locktag_field2)] > 0)
 	{
 		bool		released;
 
@@ -2654,12 +2684,15 @@ LockReassignOwner(LOCALLOCK *locallock, ResourceOwner parent)
 static bool
 FastPathGrantRelationLock(Oid relid, LOCKMODE lockmode)
 {
-	uint32		f;
-	uint32		unused_slot = FP_LOCK_SLOTS_PER_BACKEND;
+	uint32		i;
+	uint32		unused_slot = FastPathLockSlotsPerBackend();
+	uint32		group = FAST_PATH_REL_GROUP(relid);
 
 	/* Scan for existing entry for this relid, remembering empty slot. */
-	for (f = 0; f < FP_LOCK_SLOTS_PER_BACKEND; f++)
+	for (i = 0; i < FP_LOCK_SLOTS_PER_GROUP; i++)
 	{
+		uint32		f = FAST_PATH_SLOT(group, i);
+
 		if (FAST_PATH_GET_BITS(MyProc, f) == 0)
 			unused_slot = f;
 		else if (MyProc->fpRelId[f] == relid)
@@ -2671,11 +2704,11 @@ FastPathGrantRelationLock(Oid relid, LOCKMODE lockmode)
 	}
 
 	/* If no existing entry, use any empty slot. */
-	if (unused_slot < FP_LOCK_SLOTS_PER_BACKEND)
+	if (unused_slot < FastPathLockSlotsPerBackend())
 	{
 		MyProc->fpRelId[unused_slot] = relid;
 		FAST_PATH_SET_LOCKMODE(MyProc, unused_slot, lockmode);
-		++FastPathLocalUseCount;
+		++FastPathLocalUseCounts[group];
 		return true;
 	}
 
@@ -2691,22 +2724,25 @@ FastPathGrantRelationLock(Oid relid, LOCKMODE lockmode)
 static bool
 FastPathUnGrantRelationLock(Oid relid, LOCKMODE lockmode)
 {
-	uint32		f;
+	uint32		i;
 	bool		result = false;
+	uint32		group = FAST_PATH_REL_GROUP(relid);
 
-	FastPathLocalUseCount = 0;
-	for (f = 0; f < FP_LOCK_SLOTS_PER_BACKEND; f++)
+	FastPathLocalUseCounts[group] = 0;
+	for (i = 0; i < FP_LOCK_SLOTS_PER_GROUP; i++)
 	{
+		uint32		f = FAST_PATH_SLOT(group, i);
+
 		if (MyProc->fpRelId[f] == relid
 			&& FAST_PATH_CHECK_LOCKMODE(MyProc, f, lockmode))
 		{
 			Assert(!result);
 			FAST_PATH_CLEAR_LOCKMODE(MyProc, f, lockmode);
 			result = true;
-			/* we continue iterating so as to update FastPathLocalUseCount */
+			/* we continue iterating so as to update FastPathLocalUseCounts */
 		}
 		if (FAST_PATH_GET_BITS(MyProc, f) != 0)
-			++FastPathLocalUseCount;
+			++FastPathLocalUseCounts[group];
 	}
 	return result;
 }
@@ -2724,6 +2760,7 @@ FastPathTransferRelationLocks(LockMethod lockMethodTable, const LOCKTAG *locktag
 {
 	LWLock	   *partitionLock = LockHashPartitionLock(hashcode);
 	Oid			relid = locktag->locktag_field2;
+	uint32		group = FAST_PATH_REL_GROUP(relid);
 	uint32		i;
 
 	/*
@@ -2735,7 +2772,7 @@ FastPathTransferRelationLocks(LockMethod lockMethodTable, const LOCKTAG *locktag
 	for (i = 0; i < ProcGlobal->allProcCount; i++)
 	{
 		PGPROC	   *proc = &ProcGlobal->allProcs[i];
-		uint32		f;
+		uint32		j;
 
 		LWLockAcquire(&proc->fpInfoLock, LW_EXCLUSIVE);
 
@@ -2760,8 +2797,10 @@ FastPathTransferRelationLocks(LockMethod lockMethodTable, const LOCKTAG *locktag
 			continue;
 		}
 
-		for (f = 0; f < FP_LOCK_SLOTS_PER_BACKEND; f++)
+		/* The relation can only be in the slots of one group */
+		for (j = 0; j < FP_LOCK_SLOTS_PER_GROUP; j++)
 		{
+			uint32		f = FAST_PATH_SLOT(group, j);
 			uint32		lockmode;
 
 			/* Look for an allocated slot matching the given relid. */
@@ -2814,12 +2853,14 @@ FastPathGetRelationLockEntry(LOCALLOCK *locallock)
 	PROCLOCK   *proclock = NULL;
 	LWLock	   *partitionLock = LockHashPartitionLock(locallock->hashcode);
 	Oid			relid = locktag->locktag_field2;
-	uint32		f;
+	uint32		group = FAST_PATH_REL_GROUP(relid);
+	uint32		i;
 
 	LWLockAcquire(&MyProc->fpInfoLock, LW_EXCLUSIVE);
 
-	for (f = 0; f < FP_LOCK_SLOTS_PER_BACKEND; f++)
+	for (i = 0; i < FP_LOCK_SLOTS_PER_GROUP; i++)
 	{
+		uint32		f = FAST_PATH_SLOT(group, i);
 		uint32		lockmode;
 
 		/* Look for an allocated slot matching the given relid. */
@@ -2963,6 +3004,7 @@ GetLockConflicts(const LOCKTAG *locktag, LOCKMODE lockmode, int *countp)
 	{
 		int			i;
 		Oid			relid = locktag->locktag_field2;
+		uint32		group = FAST_PATH_REL_GROUP(relid);
 		VirtualTransactionId vxid;
 
 		/*
@@ -2978,7 +3020,7 @@ GetLockConflicts(const LOCKTAG *locktag, LOCKMODE lockmode, int *countp)
 		for (i = 0; i < ProcGlobal->allProcCount; i++)
 		{
 			PGPROC	   *proc = &ProcGlobal->allProcs[i];
-			uint32		f;
+			uint32		j;
 
 			/* A backend never blocks itself */
 			if (proc == MyProc)
@@ -3000,8 +3042,9 @@ GetLockConflicts(const LOCKTAG *locktag, LOCKMODE lockmode, int *countp)
 				continue;
 			}
 
-			for (f = 0; f < FP_LOCK_SLOTS_PER_BACKEND; f++)
+			for (j = 0; j < FP_LOCK_SLOTS_PER_GROUP; j++)
 			{
+				uint32		f = FAST_PATH_SLOT(group, j);
 				uint32		lockmask;
 
 				/* Look for an allocated slot matching the given relid. */
@@ -3678,12 +3721,20 @@ GetLockStatusData(void)
 
 		LWLockAcquire(&proc->fpInfoLock, LW_SHARED);
 
-		for (f = 0; f < FP_LOCK_SLOTS_PER_BACKEND; ++f)
+		for (f = 0; f < FastPathLockSlotsPerBackend(); ++f)
 		{
 			LockInstanceData *instance;
-			uint32		lockbits = FAST_PATH_GET_BITS(proc, f);
+			uint32		lockbits;
+
+			/* Skip groups without any allocated slots. */
+			if (FAST_PATH_INDEX(f) == 0 && FAST_PATH_BITS(proc, f) == 0)
+			{
+				f += FP_LOCK_SLOTS_PER_GROUP - 1;
+				continue;
+			}
 
 			/* Skip unallocated slots. */
+			lockbits = FAST_PATH_GET_BITS(proc, f);
 			if (!lockbits)
 				continue;
 
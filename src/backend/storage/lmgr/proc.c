@@ -95,6 +95,18 @@ static void AuxiliaryProcKill(int code, Datum arg);
 static void CheckDeadLock(void);
 
 
+/*
+ * Space needed for the fast-path lock arrays of a single PGPROC.
+ */
+static Size
+FastPathLockShmemSize(void)
+{
+	Assert(FastPathLockGroupsPerBackend > 0);
+
+	return MAXALIGN(FastPathLockGroupsPerBackend * sizeof(uint64)) +
+		MAXALIGN(FastPathLockSlotsPerBackend() * sizeof(Oid));
+}
+
 /*
  * Report shared-memory space needed by InitProcGlobal.
  */
@@ -114,6 +126,9 @@ ProcGlobalShmemSize(void)
 	size = add_size(size, mul_size(TotalProcs, sizeof(*ProcGlobal->subxidStates)));
 	size = add_size(size, mul_size(TotalProcs, sizeof(*ProcGlobal->statusFlags)));
 
+	/* fast-path lock arrays */
+	size = add_size(size, mul_size(TotalProcs, FastPathLockShmemSize()));
+
 	return size;
 }
 
@@ -163,6 +178,7 @@ InitProcGlobal(void)
 				j;
 	bool		found;
 	uint32		TotalProcs = MaxBackends + NUM_AUXILIARY_PROCS + max_prepared_xacts;
+	char	   *fpPtr;
 
 	/* Create the ProcGlobal shared structure */
 	ProcGlobal = (PROC_HDR *)
@@ -212,6 +228,14 @@ InitProcGlobal(void)
 	ProcGlobal->statusFlags = (uint8 *) ShmemAlloc(TotalProcs * sizeof(*ProcGlobal->statusFlags));
 	MemSet(ProcGlobal->statusFlags, 0, TotalProcs * sizeof(*ProcGlobal->statusFlags));
 
+	/*
+	 * Allocate the fast-path lock arrays for all PGPROCs in one chunk.  Their
+	 * size depends on max_locks_per_transaction, so they can't be embedded in
+	 * PGPROC itself.
+	 */
+	fpPtr = (char *) ShmemAlloc(TotalProcs * FastPathLockShmemSize());
+	MemSet(fpPtr, 0, TotalProcs * FastPathLockShmemSize());
+
 	for (i = 0; i < TotalProcs; i++)
 	{
 		/* Common initialization for all PGPROCs, regardless of type. */
@@ -229,6 +253,11 @@ InitProcGlobal(void)
 		}
 		procs[i].pgprocno = i;
 
+		procs[i].fpLockBits = (uint64 *) fpPtr;
+		fpPtr += MAXALIGN(FastPathLockGroupsPerBackend * sizeof(uint64));
+		procs[i].fpRelId = (Oid *) fpPtr;
+		fpPtr += MAXALIGN(FastPathLockSlotsPerBackend() * sizeof(Oid));
+
 		/*
 		 * Newly created PGPROCs for normal backends, autovacuum and bgworkers
 		 * must be queued up on the appropriate free list.  Because there can
@@ -181,6 +181,9 @@ static int	errdetail_params(ParamListInfo params);
 static int	errdetail_abort(void);
 static int	errdetail_recovery_conflict(void);
 static void bind_param_error_callback(void *arg);
+static ParamListInfo bind_param_set(StringInfo input_message, Portal portal,
+									CachedPlanSource *psrc, int numParams,
+									int numPFormats, int16 *pformats);
 static void start_xact_command(void);
 static void finish_xact_command(void);
 static bool IsTransactionExitStmt(Node *parsetree);
@@ -1579,6 +1582,214 @@ exec_parse_message(const char *query_string,	/* string to execute */
 	debug_query_string = NULL;
 }
 
+/*
+ * bind_param_set
+ *
+ * Read one set of parameter values of a Bind message and convert them to a
+ * ParamListInfo, allocated in the current memory context.
+ */
+static ParamListInfo
+bind_param_set(StringInfo input_message, Portal portal,
+			   CachedPlanSource *psrc, int numParams,
+			   int numPFormats, int16 *pformats)
+{
+	ParamListInfo params;
+	char	  **knownTextValues = NULL; /* allocate on first use */
+	BindParamCbData one_param_data;
+	ErrorContextCallback params_errcxt;
+
+	/*
+	 * Set up an error callback so that if there's an error in this phase, we
+	 * can report the specific parameter causing the problem.
+	 */
+	one_param_data.portalName = portal->name;
+	one_param_data.paramno = -1;
+	one_param_data.paramval = NULL;
+	params_errcxt.previous = error_context_stack;
+	params_errcxt.callback = bind_param_error_callback;
+	params_errcxt.arg = (void *) &one_param_data;
+	error_context_stack = &params_errcxt;
+
+	params = makeParamList(numParams);
+
+	for (int paramno = 0; paramno < numParams; paramno++)
+	{
+		Oid			ptype = psrc->param_types[paramno];
+		int32		plength;
+		Datum		pval;
+		bool		isNull;
+		StringInfoData pbuf;
+		char		csave;
+		int16		pformat;
+
+		one_param_data.paramno = paramno;
+		one_param_data.paramval = NULL;
+
+		plength = pq_getmsgint(input_message, 4);
+		isNull = (plength == -1);
+
+		if (!isNull)
+		{
+			const char *pvalue = pq_getmsgbytes(input_message, plength);
+
+			/*
+			 * Rather than copying data around, we just set up a phony
+			 * StringInfo pointing to the correct portion of the message
+			 * buffer.  We assume we can scribble on the message buffer so
+			 * as to maintain the convention that StringInfos have a
+			 * trailing null.  This is grotty but is a big win when
+			 * dealing with very large parameter strings.
+			 */
+			pbuf.data = unconstify(char *, pvalue);
+			pbuf.maxlen = plength + 1;
+			pbuf.len = plength;
+			pbuf.cursor = 0;
+
+			csave = pbuf.data[plength];
+			pbuf.data[plength] = '\0';
+		}
+		else
+		{
+			pbuf.data = NULL;	/* keep compiler quiet */
+			csave = 0;
+		}
+
+		if (numPFormats > 1)
+			pformat = pformats[paramno];
+		else if (numPFormats > 0)
+			pformat = pformats[0];
+		else
+			pformat = 0;	/* default = text */
+
+		if (pformat == 0)	/* text mode */
+		{
+			Oid			typinput;
+			Oid			typioparam;
+			char	   *pstring;
+
+			getTypeInputInfo(ptype, &typinput, &typioparam);
+
+			/*
+			 * We have to do encoding conversion before calling the
+			 * typinput routine.
+			 */
+			if (isNull)
+				pstring = NULL;
+			else
+				pstring = pg_client_to_server(pbuf.data, plength);
+
+			/* Now we can log the input string in case of error */
+			one_param_data.paramval = pstring;
+
+			pval = OidInputFunctionCall(typinput, pstring, typioparam, -1);
+
+			one_param_data.paramval = NULL;
+
+			/*
+			 * If we might need to log parameters later, save a copy of
+			 * the converted string in MessageContext; then free the
+			 * result of encoding conversion, if any was done.
+			 */
+			if (pstring)
+			{
+				if (log_parameter_max_length_on_error != 0)
+				{
+					MemoryContext oldcxt;
+
+					oldcxt = MemoryContextSwitchTo(MessageContext);
+
+					if (knownTextValues == NULL)
+						knownTextValues = palloc0_array(char *, numParams);
+
+					if (log_parameter_max_length_on_error < 0)
+						knownTextValues[paramno] = pstrdup(pstring);
+					else
+					{
+						/*
+						 * We can trim the saved string, knowing that we
+						 * won't print all of it.  But we must copy at
+						 * least two more full characters than
+						 * BuildParamLogString wants to use; otherwise it
+						 * might fail to include the trailing ellipsis.
+						 */
+						knownTextValues[paramno] =
+							pnstrdup(pstring,
+									 log_parameter_max_length_on_error
+									 + 2 * MAX_MULTIBYTE_CHAR_LEN);
+					}
+
+					MemoryContextSwitchTo(oldcxt);
+				}
+				if (pstring != pbuf.data)
+					pfree(pstring);
+			}
+		}
+		else if (pformat == 1)	/* binary mode */
+		{
+			Oid			typreceive;
+			Oid			typioparam;
+			StringInfo	bufptr;
+
+			/*
+			 * Call the parameter type's binary input converter
+			 */
+			getTypeBinaryInputInfo(ptype, &typreceive, &typioparam);
+
+			if (isNull)
+				bufptr = NULL;
+			else
+				bufptr = &pbuf;
+
+			pval = OidReceiveFunctionCall(typreceive, bufptr, typioparam, -1);
+
+			/* Trouble if it didn't eat the whole buffer */
+			if (!isNull && pbuf.cursor != pbuf.len)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						 errmsg("incorrect binary data format in bind parameter %d",
+								paramno + 1)));
+		}
+		else
+		{
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("unsupported format code: %d",
+							pformat)));
+			pval = 0;		/* keep compiler quiet */
+		}
+
+		/* Restore message buffer contents */
+		if (!isNull)
+			pbuf.data[plength] = csave;
+
+		params->params[paramno].value = pval;
+		params->params[paramno].isnull = isNull;
+
+		/*
+		 * We mark the params as CONST.  This ensures that any custom plan
+		 * makes full use of the parameter values.
+		 */
+		params->params[paramno].pflags = PARAM_FLAG_CONST;
+		params->params[paramno].ptype = ptype;
+	}
+
+	/* Pop the per-parameter error callback */
+	error_context_stack = error_context_stack->previous;
+
+	/*
+	 * Once all parameters have been received, prepare for printing them in
+	 * future errors, if configured to do so.  (This is saved in the portal,
+	 * so that they'll appear when the query is executed later.)
+	 */
+	if (log_parameter_max_length_on_error != 0)
+		params->paramValuesStr =
+			BuildParamLogString(params,
+								knownTextValues,
+								log_parameter_max_length_on_error);
+
+	return params;
+}
+
 /*
  * exec_bind_message
  *
@@ -1600,6 +1811,8 @@ exec_bind_message(StringInfo input_message)
 	char	   *query_string;
 	char	   *saved_stmt_name;
 	ParamListInfo params;
+	int			numBatchParams = 0;
+	ParamListInfo *batchParams = NULL;
 	MemoryContext oldContext;
 	bool		save_log_statement_stats = log_statement_stats;
 	bool		snapshot_set = false;
@@ -1744,199 +1957,8 @@ exec_bind_message(StringInfo input_message)
 	 * Fetch parameters, if any, and store in the portal's memory context.
 	 */
 	if (numParams > 0)
-	{
-		char	  **knownTextValues = NULL; /* allocate on first use */
-		BindParamCbData one_param_data;
-
-		/*
-		 * Set up an error callback so that if there's an error in this phase,
-		 * we can report the specific parameter causing the problem.
-		 */
-		one_param_data.portalName = portal->name;
-		one_param_data.paramno = -1;
-		one_param_data.paramval = NULL;
-		params_errcxt.previous = error_context_stack;
-		params_errcxt.callback = bind_param_error_callback;
-		params_errcxt.arg = (void *) &one_param_data;
-		error_context_stack = &params_errcxt;
-
-		params = makeParamList(numParams);
-
-		for (int paramno = 0; paramno < numParams; paramno++)
-		{
-			Oid			ptype = psrc->param_types[paramno];
-			int32		plength;
-			Datum		pval;
-			bool		isNull;
-			StringInfoData pbuf;
-			char		csave;
-			int16		pformat;
-
-			one_param_data.paramno = paramno;
-			one_param_data.paramval = NULL;
-
-			plength = pq_getmsgint(input_message, 4);
-			isNull = (plength == -1);
-
-			if (!isNull)
-			{
-				const char *pvalue = pq_getmsgbytes(input_message, plength);
-
-				/*
-				 * Rather than copying data around, we just set up a phony
-				 * StringInfo pointing to the correct portion of the message
-				 * buffer.  We assume we can scribble on the message buffer so
-				 * as to maintain the convention that StringInfos have a
-				 * trailing null.  This is grotty but is a big win when
-				 * dealing with very large parameter strings.
-				 */
-				pbuf.data = unconstify(char *, pvalue);
-				pbuf.maxlen = plength + 1;
-				pbuf.len = plength;
-				pbuf.cursor = 0;
-
-				csave = pbuf.data[plength];
-				pbuf.data[plength] = '\0';
-			}
-			else
-			{
-				pbuf.data = NULL;	/* keep compiler quiet */
-				csave = 0;
-			}
-
-			if (numPFormats > 1)
-				pformat = pformats[paramno];
-			else if (numPFormats > 0)
-				pformat = pformats[0];
-			else
-				pformat = 0;	/* default = text */
-
-			if (pformat == 0)	/* text mode */
-			{
-				Oid			typinput;
-				Oid			typioparam;
-				char	   *pstring;
-
-				getTypeInputInfo(ptype, &typinput, &typioparam);
-
-				/*
-				 * We have to do encoding conversion before calling the
-				 * typinput routine.
-				 */
-				if (isNull)
-					pstring = NULL;
-				else
-					pstring = pg_client_to_server(pbuf.data, plength);
-
-				/* Now we can log the input string in case of error */
-				one_param_data.paramval = pstring;
-
-				pval = OidInputFunctionCall(typinput, pstring, typioparam, -1);
-
-				one_param_data.paramval = NULL;
-
-				/*
-				 * If we might need to log parameters later, save a copy of
-				 * the converted string in MessageContext; then free the
-				 * result of encoding conversion, if any was done.
-				 */
-				if (pstring)
-				{
-					if (log_parameter_max_length_on_error != 0)
-					{
-						MemoryContext oldcxt;
-
-						oldcxt = MemoryContextSwitchTo(MessageContext);
-
-						if (knownTextValues == NULL)
-							knownTextValues = palloc0_array(char *, numParams);
-
-						if (log_parameter_max_length_on_error < 0)
-							knownTextValues[paramno] = pstrdup(pstring);
-						else
-						{
-							/*
-							 * We can trim the saved string, knowing that we
-							 * won't print all of it.  But we must copy at
-							 * least two more full characters than
-							 * BuildParamLogString wants to use; otherwise it
-							 * might fail to include the trailing ellipsis.
-							 */
-							knownTextValues[paramno] =
-								pnstrdup(pstring,
-										 log_parameter_max_length_on_error
-										 + 2 * MAX_MULTIBYTE_CHAR_LEN);
-						}
-
-						MemoryContextSwitchTo(oldcxt);
-					}
-					if (pstring != pbuf.data)
-						pfree(pstring);
-				}
-			}
-			else if (pformat == 1)	/* binary mode */
-			{
-				Oid			typreceive;
-				Oid			typioparam;
-				StringInfo	bufptr;
-
-				/*
-				 * Call the parameter type's binary input converter
-				 */
-				getTypeBinaryInputInfo(ptype, &typreceive, &typioparam);
-
-				if (isNull)
-					bufptr = NULL;
-				else
-					bufptr = &pbuf;
-
-				pval = OidReceiveFunctionCall(typreceive, bufptr, typioparam, -1);
-
-				/* Trouble if it didn't eat the whole buffer */
-				if (!isNull && pbuf.cursor != pbuf.len)
-					ereport(ERROR,
-							(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
-							 errmsg("incorrect binary data format in bind parameter %d",
-									paramno + 1)));
-			}
-			else
-			{
-				ereport(ERROR,
-						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
-						 errmsg("unsupported format code: %d",
-								pformat)));
-				pval = 0;		/* keep compiler quiet */
-			}
-
-			/* Restore message buffer contents */
-			if (!isNull)
-				pbuf.data[plength] = csave;
-
-			params->params[paramno].value = pval;
-			params->params[paramno].isnull = isNull;
-
-			/*
-			 * We mark the params as CONST.  This ensures that any custom plan
-			 * makes full use of the parameter values.
-			 */
-			params->params[paramno].pflags = PARAM_FLAG_CONST;
-			params->params[paramno].ptype = ptype;
-		}
-
-		/* Pop the per-parameter error callback */
-		error_context_stack = error_context_stack->previous;
-
-		/*
-		 * Once all parameters have been received, prepare for printing them
-		 * in future errors, if configured to do so.  (This is saved in the
-		 * portal, so that they'll appear when the query is executed later.)
-		 */
-		if (log_parameter_max_length_on_error != 0)
-			params->paramValuesStr =
-				BuildParamLogString(params,
-									knownTextValues,
-									log_parameter_max_length_on_error);
-	}
+		params = bind_param_set(input_message, portal, psrc, numParams,
+								numPFormats, pformats);
 	else
 		params = NULL;
 
@@ -1963,14 +1985,64 @@ exec_bind_message(StringInfo input_message)
 			rformats[i] = pq_getmsgint(input_message, 2);
 	}
 
+	/*
+	 * If the client negotiated the _pq_.multirow_bind protocol extension,
+	 * the message may continue with a count of additional parameter sets,
+	 * each laid out like the first one (a parameter count followed by the
+	 * values, using the same format codes).  The portal then executes once
+	 * per set when the Execute message arrives.
+	 */
+	if (MyProcPort && MyProcPort->multirow_bind &&
+		input_message->cursor < input_message->len)
+	{
+		numBatchParams = pq_getmsgint(input_message, 4);
+		if (numBatchParams < 0 ||
+			numBatchParams > MaxAllocSize / sizeof(ParamListInfo))
+			ereport(ERROR,
+					(errcode(ERRCODE_PROTOCOL_VIOLATION),
+					 errmsg("invalid number of parameter sets in bind message: %d",
+							numBatchParams)));
+
+		if (numBatchParams > 0)
+		{
+			oldContext = MemoryContextSwitchTo(portal->portalContext);
+			batchParams = palloc_array(ParamListInfo, numBatchParams);
+
+			for (int i = 0; i < numBatchParams; i++)
+			{
+				int			setParams = pq_getmsgint(input_message, 2);
+
+				if (setParams != numParams)
+					ereport(ERROR,
+							(errcode(ERRCODE_PROTOCOL_VIOLATION),
+							 errmsg("bind message parameter set %d supplies %d parameters, but prepared statement \"%s\" requires %d",
+									i + 2, setParams, stmt_name, numParams)));
+
+				if (numParams > 0)
+					batchParams[i] = bind_param_set(input_message, portal,
+													psrc, numParams,
+													numPFormats, pformats);
+				else
+					batchParams[i] = NULL;
+			}
+
+			MemoryContextSwitchTo(oldContext);
+		}
+	}
+
 	pq_getmsgend(input_message);
 
 	/*
 	 * Obtain a plan from the CachedPlanSource.  Any cruft from (re)planning
 	 * will be generated in MessageContext.  The plan refcount will be
 	 * assigned to the Portal, so it will be released at portal destruction.
+	 *
+	 * With several parameter sets, don't let the first set's values drive a
+	 * custom plan: it would bake them in as constants, and we want a single
+	 * plan that can be reused for all of them.
 	 */
-	cplan = GetCachedPlan(psrc, params, NULL, NULL);
+	cplan = GetCachedPlan(psrc, numBatchParams > 0 ? NULL : params,
+						  NULL, NULL);
 
 	/*
 	 * Now we can define the portal.
@@ -1994,6 +2066,34 @@ exec_bind_message(StringInfo input_message)
 	 */
 	PortalStart(portal, params, 0, InvalidSnapshot);
 
+	/*
+	 * Repeated execution is only supported for statements that don't return
+	 * rows, and that aren't utility statements (which can't use a shared
+	 * plan anyway).
+	 */
+	if (numBatchParams > 0)
+	{
+		ListCell   *lc;
+
+		if (portal->strategy != PORTAL_MULTI_QUERY)
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("cannot bind multiple parameter sets to a statement that returns rows")));
+
+		foreach(lc, portal->stmts)
+		{
+			PlannedStmt *pstmt = lfirst_node(PlannedStmt, lc);
+
+			if (pstmt->utilityStmt != NULL)
+				ereport(ERROR,
+						(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						 errmsg("cannot bind multiple parameter sets to a utility statement")));
+		}
+
+		portal->batchParams = batchParams;
+		portal->numBatchParams = numBatchParams;
+	}
+
 	/*
 	 * Apply the result format requests to the portal.
 	 */
@@ -3986,6 +4086,7 @@ PostgresSingleUserMain(int argc, char *argv[],
 
 	/* Initialize MaxBackends */
 	InitializeMaxBackends();
+	InitializeFastPathLocks();
 
 	/*
 	 * Give preloaded libraries a chance to request additional shared memory.
@@ -49,7 +49,7 @@ static uint64 PortalRunSelect(Portal portal, bool forward, long count,
 static void PortalRunUtility(Portal portal, PlannedStmt *pstmt,
 							 bool isTopLevel, bool setHoldSnapshot,
 							 DestReceiver *dest, QueryCompletion *qc);
-static void PortalRunMulti(Portal portal,
+static void PortalRunMulti(Portal portal, ParamListInfo params,
 						   bool isTopLevel, bool setHoldSnapshot,
 						   DestReceiver *dest, DestReceiver *altdest,
 						   QueryCompletion *qc);
@@ -788,9 +788,29 @@ PortalRun(Portal portal, long count, bool isTopLevel, bool run_once,
 				break;
 
 			case PORTAL_MULTI_QUERY:
-				PortalRunMulti(portal, isTopLevel, false,
+				PortalRunMulti(portal, portal->portalParams,
+							   isTopLevel, false,
 							   dest, altdest, qc);
 
+				/*
+				 * If the portal was bound with several parameter sets, run
+				 * the same plan again for each further set, making the
+				 * previous set's effects visible first.  The row counts are
+				 * summed into a single command completion.
+				 */
+				for (int i = 0; i < portal->numBatchParams; i++)
+				{
+					QueryCompletion batchqc;
+
+					CommandCounterIncrement();
+					InitializeQueryCompletion(&batchqc);
+					PortalRunMulti(portal, portal->batchParams[i],
+								   isTopLevel, false,
+								   dest, altdest, qc ? &batchqc : NULL);
+					if (qc)
+						qc->nprocessed += batchqc.nprocessed;
+				}
+
 				/* Prevent portal's commands from being re-executed */
 				MarkPortalDone(portal);
 
@@ -1023,7 +1043,7 @@ FillPortalStore(Portal portal, bool isTopLevel)
 			 * the tuplestore.  Auxiliary query outputs are discarded. Set the
 			 * portal's holdSnapshot to the snapshot used (or a copy of it).
 			 */
-			PortalRunMulti(portal, isTopLevel, true,
+			PortalRunMulti(portal, portal->portalParams, isTopLevel, true,
 						   treceiver, None_Receiver, &qc);
 			break;
 
@@ -1184,10 +1204,10 @@ PortalRunUtility(Portal portal, PlannedStmt *pstmt,
 /*
  * PortalRunMulti
  *		Execute a portal's queries in the general case (multi queries
- *		or non-SELECT-like queries)
+ *		or non-SELECT-like queries), using the given parameter set
  */
 static void
-PortalRunMulti(Portal portal,
+PortalRunMulti(Portal portal, ParamListInfo params,
 			   bool isTopLevel, bool setHoldSnapshot,
 			   DestReceiver *dest, DestReceiver *altdest,
 			   QueryCompletion *qc)
@@ -1276,7 +1296,7 @@ PortalRunMulti(Portal portal,
 				/* statement can set tag string */
 				ProcessQuery(pstmt,
 							 portal->sourceText,
-							 portal->portalParams,
+							 params,
 							 portal->queryEnv,
 							 dest, qc);
 			}
@@ -1285,7 +1305,7 @@ PortalRunMulti(Portal portal,
 				/* stmt added by rewrite cannot set tag */
 				ProcessQuery(pstmt,
 							 portal->sourceText,
-							 portal->portalParams,
+							 params,
 							 portal->queryEnv,
 							 altdest, NULL);
 			}
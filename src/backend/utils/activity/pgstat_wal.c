@@ -101,6 +101,7 @@ pgstat_flush_wal(bool nowait)
 	WALSTAT_ACC(wal_fpi);
 	WALSTAT_ACC(wal_bytes);
 	WALSTAT_ACC(wal_buffers_full);
+	WALSTAT_ACC(wal_buffers_hit);
 	WALSTAT_ACC(wal_write);
 	WALSTAT_ACC(wal_sync);
 	WALSTAT_ACC(wal_write_time);
@@ -138,12 +139,13 @@ pgstat_init_wal(void)
  * only the number of generated WAL records but also the numbers of WAL
  * writes and syncs need to be checked. Because even transaction that
  * generates no WAL records can write or sync WAL data when flushing the
- * data pages.
+ * data pages.  Walsenders generate no WAL but read it from the WAL buffers.
  */
 bool
 pgstat_have_pending_wal(void)
 {
 	return pgWalUsage.wal_records != prevWalUsage.wal_records ||
+		PendingWalStats.wal_buffers_hit != 0 ||
 		PendingWalStats.wal_write != 0 ||
 		PendingWalStats.wal_sync != 0;
 }
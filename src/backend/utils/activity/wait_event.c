@@ -230,6 +230,9 @@ pgstat_get_wait_activity(WaitEventActivity w)
 		case WAIT_EVENT_LOGICAL_LAUNCHER_MAIN:
 			event_name = "LogicalLauncherMain";
 			break;
+		case WAIT_EVENT_LOGICAL_PARALLEL_APPLY_MAIN:
+			event_name = "LogicalParallelApplyMain";
+			break;
 		case WAIT_EVENT_RECOVERY_WAL_STREAM:
 			event_name = "RecoveryWalStream";
 			break;
@@ -388,9 +391,18 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_HASH_GROW_BUCKETS_REINSERT:
 			event_name = "HashGrowBucketsReinsert";
 			break;
+		case WAIT_EVENT_LOGICAL_APPLY_SEND_DATA:
+			event_name = "LogicalApplySendData";
+			break;
+		case WAIT_EVENT_LOGICAL_PARALLEL_APPLY_STATE_CHANGE:
+			event_name = "LogicalParallelApplyStateChange";
+			break;
 		case WAIT_EVENT_LOGICAL_SYNC_DATA:
 			event_name = "LogicalSyncData";
 			break;
+		case WAIT_EVENT_LOGICAL_SYNC_PARALLEL_COPY:
+			event_name = "LogicalSyncParallelCopy";
+			break;
 		case WAIT_EVENT_LOGICAL_SYNC_STATE_CHANGE:
 			event_name = "LogicalSyncStateChange";
 			break;
@@ -433,6 +445,18 @@ pgstat_get_wait_ipc(WaitEventIPC w)
 		case WAIT_EVENT_RECOVERY_END_COMMAND:
 			event_name = "RecoveryEndCommand";
 			break;
+		case WAIT_EVENT_RECOVERY_PARALLEL_REDO_DISPATCH:
+			event_name = "RecoveryParallelRedoDispatch";
+			break;
+		case WAIT_EVENT_RECOVERY_PARALLEL_REDO_ORDER:
+			event_name = "RecoveryParallelRedoOrder";
+			break;
+		case WAIT_EVENT_RECOVERY_PARALLEL_REDO_REPORT:
+			event_name = "RecoveryParallelRedoReport";
+			break;
+		case WAIT_EVENT_RECOVERY_PARALLEL_REDO_SYNC:
+			event_name = "RecoveryParallelRedoSync";
+			break;
 		case WAIT_EVENT_RECOVERY_PAUSE:
 			event_name = "RecoveryPause";
 			break;
@@ -0,0 +1,572 @@
+/*-------------------------------------------------------------------------
+ *
+ * approxaggs.c
+ *	  Approximate aggregate functions.
+ *
+ * These aggregates trade exactness for a bounded amount of transition state,
+ * so that, unlike their exact counterparts, they need neither sort nor
+ * remember their whole input, and can be computed in parallel.
+ *
+ * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/utils/adt/approxaggs.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <math.h>
+
+#include "fmgr.h"
+#include "lib/hyperloglog.h"
+#include "lib/tdigest.h"
+#include "libpq/pqformat.h"
+#include "utils/builtins.h"
+#include "utils/fmgrprotos.h"
+#include "utils/typcache.h"
+
+
+/*
+ * Register width of the HyperLogLog sketches built by hll_sketch and
+ * approx_count_distinct: 2^12 registers, for a standard error of about 1.6%.
+ */
+#define HLL_SKETCH_BWIDTH	12
+
+/*
+ * Transition state for approx_percentile: the requested fraction, which
+ * must be the same for all rows of a group, and a t-digest of the values.
+ */
+typedef struct ApproxPercentileState
+{
+	double		fraction;
+	TDigest    *digest;
+} ApproxPercentileState;
+
+static ApproxPercentileState *approx_percentile_create(double fraction,
+													   int compression);
+static void approx_percentile_check_fraction(ApproxPercentileState *state,
+											 double fraction);
+static hyperLogLogState *hll_create(uint8 bwidth);
+static bytea *hll_sketch_from_state(hyperLogLogState *state);
+static hyperLogLogState *hll_state_from_sketch(bytea *sketch);
+
+
+/*
+ * Create an empty approx_percentile state in the current memory context.
+ */
+static ApproxPercentileState *
+approx_percentile_create(double fraction, int compression)
+{
+	ApproxPercentileState *state;
+
+	state = palloc(sizeof(ApproxPercentileState));
+	state->fraction = fraction;
+	state->digest = tdigest_create(compression);
+
+	return state;
+}
+
+/*
+ * Complain if a fraction differs from the one the state was built with.
+ */
+static void
+approx_percentile_check_fraction(ApproxPercentileState *state,
+								 double fraction)
+{
+	if (state->fraction != fraction)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("percentile value must be the same for all rows of a group")));
+}
+
+/*
+ * approx_percentile(float8 value, float8 fraction) transition function
+ */
+Datum
+approx_percentile_transfn(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	ApproxPercentileState *state;
+	double		value;
+	double		fraction;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	state = PG_ARGISNULL(0) ? NULL : (ApproxPercentileState *) PG_GETARG_POINTER(0);
+
+	/* Like percentile_cont, ignore null values */
+	if (PG_ARGISNULL(1) || PG_ARGISNULL(2))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	value = PG_GETARG_FLOAT8(1);
+	fraction = PG_GETARG_FLOAT8(2);
+
+	if (fraction < 0 || fraction > 1 || isnan(fraction))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("percentile value %g is not between 0 and 1",
+						fraction)));
+
+	if (isnan(value) || isinf(value))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("approx_percentile does not support NaN or infinite values")));
+
+	if (state == NULL)
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(aggcontext);
+
+		state = approx_percentile_create(fraction, TDIGEST_DEFAULT_COMPRESSION);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else
+		approx_percentile_check_fraction(state, fraction);
+
+	tdigest_add(state->digest, value, 1);
+
+	PG_RETURN_POINTER(state);
+}
+
+/*
+ * approx_percentile final function
+ *
+ * Estimating the quantile compresses the digest, which does not change the
+ * distribution it summarizes, so the state may still be added to afterwards,
+ * as in a window aggregate.
+ */
+Datum
+approx_percentile_final(PG_FUNCTION_ARGS)
+{
+	ApproxPercentileState *state;
+
+	if (!AggCheckCallContext(fcinfo, NULL))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	/* If there were no regular rows, the result is NULL */
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	state = (ApproxPercentileState *) PG_GETARG_POINTER(0);
+
+	PG_RETURN_FLOAT8(tdigest_quantile(state->digest, state->fraction));
+}
+
+/*
+ * approx_percentile combine function
+ */
+Datum
+approx_percentile_combine(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	ApproxPercentileState *state1;
+	ApproxPercentileState *state2;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	state1 = PG_ARGISNULL(0) ? NULL : (ApproxPercentileState *) PG_GETARG_POINTER(0);
+	state2 = PG_ARGISNULL(1) ? NULL : (ApproxPercentileState *) PG_GETARG_POINTER(1);
+
+	if (state2 == NULL)
+	{
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	if (state1 == NULL)
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(aggcontext);
+
+		state1 = approx_percentile_create(state2->fraction,
+										  state2->digest->compression);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else
+		approx_percentile_check_fraction(state1, state2->fraction);
+
+	tdigest_merge(state1->digest, state2->digest);
+
+	PG_RETURN_POINTER(state1);
+}
+
+/*
+ * approx_percentile serialization function
+ */
+Datum
+approx_percentile_serialize(PG_FUNCTION_ARGS)
+{
+	ApproxPercentileState *state;
+	TDigest    *td;
+	StringInfoData buf;
+	int			i;
+
+	/* Ensure we disallow calling when not in aggregate context */
+	if (!AggCheckCallContext(fcinfo, NULL))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	state = (ApproxPercentileState *) PG_GETARG_POINTER(0);
+	td = state->digest;
+
+	/* Send no more centroids than necessary */
+	tdigest_compress(td);
+
+	pq_begintypsend(&buf);
+
+	pq_sendfloat8(&buf, state->fraction);
+	pq_sendint32(&buf, td->compression);
+	pq_sendfloat8(&buf, td->count);
+	pq_sendfloat8(&buf, td->min);
+	pq_sendfloat8(&buf, td->max);
+	pq_sendint32(&buf, td->ncentroids);
+	for (i = 0; i < td->ncentroids; i++)
+	{
+		pq_sendfloat8(&buf, td->centroids[i].mean);
+		pq_sendfloat8(&buf, td->centroids[i].weight);
+	}
+
+	PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+/*
+ * approx_percentile deserialization function
+ */
+Datum
+approx_percentile_deserialize(PG_FUNCTION_ARGS)
+{
+	bytea	   *sstate;
+	StringInfoData buf;
+	ApproxPercentileState *result;
+	TDigest    *td;
+	double		fraction;
+	int			compression;
+	int			ncentroids;
+	int			i;
+
+	if (!AggCheckCallContext(fcinfo, NULL))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	sstate = PG_GETARG_BYTEA_PP(0);
+
+	/*
+	 * Copy the bytea into a StringInfo so that we can "receive" it using the
+	 * standard recv-function infrastructure.
+	 */
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf,
+						   VARDATA_ANY(sstate), VARSIZE_ANY_EXHDR(sstate));
+
+	fraction = pq_getmsgfloat8(&buf);
+	compression = pq_getmsgint(&buf, 4);
+	if (compression <= 0)
+		elog(ERROR, "invalid t-digest compression %d", compression);
+
+	result = approx_percentile_create(fraction, compression);
+	td = result->digest;
+
+	td->count = pq_getmsgfloat8(&buf);
+	td->min = pq_getmsgfloat8(&buf);
+	td->max = pq_getmsgfloat8(&buf);
+	ncentroids = pq_getmsgint(&buf, 4);
+	if (ncentroids < 0 || ncentroids > td->maxcentroids)
+		elog(ERROR, "invalid number of t-digest centroids %d", ncentroids);
+	for (i = 0; i < ncentroids; i++)
+	{
+		td->centroids[i].mean = pq_getmsgfloat8(&buf);
+		td->centroids[i].weight = pq_getmsgfloat8(&buf);
+	}
+	td->ncentroids = ncentroids;
+
+	pq_getmsgend(&buf);
+	pfree(buf.data);
+
+	PG_RETURN_POINTER(result);
+}
+
+
+/*
+ * Create an empty HyperLogLog state in the current memory context.
+ */
+static hyperLogLogState *
+hll_create(uint8 bwidth)
+{
+	hyperLogLogState *state;
+
+	state = palloc(sizeof(hyperLogLogState));
+	initHyperLogLog(state, bwidth);
+
+	return state;
+}
+
+/*
+ * Build the external form of a HyperLogLog state, a bytea holding the
+ * register width followed by one byte per register.
+ */
+static bytea *
+hll_sketch_from_state(hyperLogLogState *state)
+{
+	bytea	   *result;
+
+	result = palloc(VARHDRSZ + 1 + state->nRegisters);
+	SET_VARSIZE(result, VARHDRSZ + 1 + state->nRegisters);
+	*((uint8 *) VARDATA(result)) = state->registerWidth;
+	memcpy(VARDATA(result) + 1, state->hashesArr, state->nRegisters);
+
+	return result;
+}
+
+/*
+ * Rebuild a HyperLogLog state from its external form, in the current memory
+ * context.
+ *
+ * Sketches may come from user tables, so check them thoroughly.
+ */
+static hyperLogLogState *
+hll_state_from_sketch(bytea *sketch)
+{
+	const uint8 *data = (const uint8 *) VARDATA_ANY(sketch);
+	Size		len = VARSIZE_ANY_EXHDR(sketch);
+	hyperLogLogState *state;
+	uint8		bwidth;
+	Size		i;
+
+	if (len < 1 || data[0] < 4 || data[0] > 16 ||
+		len != 1 + ((Size) 1 << data[0]))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid HyperLogLog sketch")));
+	bwidth = data[0];
+
+	state = hll_create(bwidth);
+	for (i = 0; i < state->nRegisters; i++)
+	{
+		/* No register can exceed the rank of an all-zeroes hash suffix */
+		if (data[1 + i] > 32 - bwidth + 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid HyperLogLog sketch")));
+		state->hashesArr[i] = data[1 + i];
+	}
+
+	return state;
+}
+
+/*
+ * hll_sketch(anyelement) and approx_count_distinct(anyelement) transition
+ * function
+ *
+ * Values are hashed with their type's standard hash function, so sketches
+ * of the same type (or of types whose hash functions agree, like the integer
+ * types) can be merged.
+ */
+Datum
+hll_sketch_transfn(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	hyperLogLogState *state;
+	TypeCacheEntry *typentry;
+	Oid			element_type;
+	uint32		hash;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	if (PG_ARGISNULL(0))
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(aggcontext);
+
+		state = hll_create(HLL_SKETCH_BWIDTH);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else
+		state = (hyperLogLogState *) PG_GETARG_POINTER(0);
+
+	/* Like count(DISTINCT), ignore null values */
+	if (PG_ARGISNULL(1))
+		PG_RETURN_POINTER(state);
+
+	/*
+	 * We arrange to look up the hash function only once per series of calls,
+	 * assuming the element type doesn't change underneath us.
+	 */
+	element_type = get_fn_expr_argtype(fcinfo->flinfo, 1);
+	typentry = (TypeCacheEntry *) fcinfo->flinfo->fn_extra;
+	if (typentry == NULL || typentry->type_id != element_type)
+	{
+		typentry = lookup_type_cache(element_type, TYPECACHE_HASH_PROC_FINFO);
+		if (!OidIsValid(typentry->hash_proc_finfo.fn_oid))
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_FUNCTION),
+					 errmsg("could not identify a hash function for type %s",
+							format_type_be(element_type))));
+		fcinfo->flinfo->fn_extra = (void *) typentry;
+	}
+
+	hash = DatumGetUInt32(FunctionCall1Coll(&typentry->hash_proc_finfo,
+											PG_GET_COLLATION(),
+											PG_GETARG_DATUM(1)));
+	addHyperLogLog(state, hash);
+
+	PG_RETURN_POINTER(state);
+}
+
+/*
+ * hll_union(bytea) transition function
+ */
+Datum
+hll_union_transfn(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	MemoryContext oldcontext;
+	hyperLogLogState *state;
+	hyperLogLogState *other;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	state = PG_ARGISNULL(0) ? NULL : (hyperLogLogState *) PG_GETARG_POINTER(0);
+
+	/* Ignore null sketches */
+	if (PG_ARGISNULL(1))
+	{
+		if (state == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state);
+	}
+
+	other = hll_state_from_sketch(PG_GETARG_BYTEA_PP(1));
+
+	if (state == NULL)
+	{
+		oldcontext = MemoryContextSwitchTo(aggcontext);
+		state = hll_create(other->registerWidth);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else if (state->registerWidth != other->registerWidth)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot combine HyperLogLog sketches of different precisions")));
+
+	mergeHyperLogLog(state, other);
+	freeHyperLogLog(other);
+	pfree(other);
+
+	PG_RETURN_POINTER(state);
+}
+
+/*
+ * approx_count_distinct final function
+ */
+Datum
+approx_count_distinct_final(PG_FUNCTION_ARGS)
+{
+	hyperLogLogState *state;
+
+	if (!AggCheckCallContext(fcinfo, NULL))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	/* Like count(DISTINCT), return zero if there were no input rows */
+	if (PG_ARGISNULL(0))
+		PG_RETURN_INT64(0);
+
+	state = (hyperLogLogState *) PG_GETARG_POINTER(0);
+
+	PG_RETURN_INT64((int64) rint(estimateHyperLogLog(state)));
+}
+
+/*
+ * HyperLogLog combine function, for all the above aggregates
+ */
+Datum
+hll_combine(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggcontext;
+	hyperLogLogState *state1;
+	hyperLogLogState *state2;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	state1 = PG_ARGISNULL(0) ? NULL : (hyperLogLogState *) PG_GETARG_POINTER(0);
+	state2 = PG_ARGISNULL(1) ? NULL : (hyperLogLogState *) PG_GETARG_POINTER(1);
+
+	if (state2 == NULL)
+	{
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	if (state1 == NULL)
+	{
+		MemoryContext oldcontext = MemoryContextSwitchTo(aggcontext);
+
+		state1 = hll_create(state2->registerWidth);
+		MemoryContextSwitchTo(oldcontext);
+	}
+	else if (state1->registerWidth != state2->registerWidth)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot combine HyperLogLog sketches of different precisions")));
+
+	mergeHyperLogLog(state1, state2);
+
+	PG_RETURN_POINTER(state1);
+}
+
+/*
+ * HyperLogLog serialization function
+ *
+ * This is also the final function of hll_sketch and hll_union: the
+ * serialized state is exactly the sketch those aggregates return.
+ */
+Datum
+hll_serialize(PG_FUNCTION_ARGS)
+{
+	hyperLogLogState *state;
+
+	/* Ensure we disallow calling when not in aggregate context */
+	if (!AggCheckCallContext(fcinfo, NULL))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	state = (hyperLogLogState *) PG_GETARG_POINTER(0);
+
+	PG_RETURN_BYTEA_P(hll_sketch_from_state(state));
+}
+
+/*
+ * HyperLogLog deserialization function
+ */
+Datum
+hll_deserialize(PG_FUNCTION_ARGS)
+{
+	if (!AggCheckCallContext(fcinfo, NULL))
+		elog(ERROR, "aggregate function called in non-aggregate context");
+
+	PG_RETURN_POINTER(hll_state_from_sketch(PG_GETARG_BYTEA_PP(0)));
+}
+
+/*
+ * hll_cardinality(bytea) - estimated number of distinct values in a sketch
+ */
+Datum
+hll_cardinality(PG_FUNCTION_ARGS)
+{
+	hyperLogLogState *state;
+	double		result;
+
+	state = hll_state_from_sketch(PG_GETARG_BYTEA_PP(0));
+	result = estimateHyperLogLog(state);
+	freeHyperLogLog(state);
+	pfree(state);
+
+	PG_RETURN_INT64((int64) rint(result));
+}
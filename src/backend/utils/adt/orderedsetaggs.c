@@ -23,10 +23,13 @@
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/optimizer.h"
+#include "port/pg_bitutils.h"
 #include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/datum.h"
 #include "utils/lsyscache.h"
 #include "utils/memutils.h"
+#include "utils/sortsupport.h"
 #include "utils/timestamp.h"
 #include "utils/tuplesort.h"
 
@@ -87,6 +90,8 @@ typedef struct OSAPerQueryState
 	Oid			eqOperator;
 	Oid			sortCollation;
 	bool		sortNullsFirst;
+	/* Comparator for selecting from datums held in memory: */
+	SortSupportData sortKey;
 	/* Equality operator call info, created only if needed: */
 	FmgrInfo	equalfn;
 } OSAPerQueryState;
@@ -103,9 +108,31 @@ typedef struct OSAPerGroupState
 	int64		number_of_rows;
 	/* Have we already done tuplesort_performsort? */
 	bool		sort_done;
+
+	/*
+	 * Single datums are first collected in this array, in the group context,
+	 * and only moved to a tuplesort if they outgrow work_mem or a final
+	 * function needs them in sorted order.  While the array is in use,
+	 * sortstate is NULL and number_of_rows is the number of datums in it.
+	 */
+	Datum	   *datums;
+	int64		maxdatums;		/* allocated length of the array */
+	int64		datumspace;		/* memory used by the array and datums */
+	int			tuplesortopt;	/* options for creating the tuplesort */
 } OSAPerGroupState;
 
+#define SWAP_DATUM(a, i, j) \
+	do { \
+		Datum		swap_tmp = (a)[i]; \
+		(a)[i] = (a)[j]; \
+		(a)[j] = swap_tmp; \
+	} while (0)
+
 static void ordered_set_shutdown(Datum arg);
+static void ordered_set_spill_datums(OSAPerGroupState *osastate);
+static void ordered_set_select(OSAPerGroupState *osastate, int64 lo,
+							   int64 hi, int64 k);
+static int	ordered_set_datum_cmp(const void *a, const void *b, void *arg);
 
 
 /*
@@ -270,6 +297,13 @@ ordered_set_startup(FunctionCallInfo fcinfo, bool use_tuples)
 								 &qstate->typLen,
 								 &qstate->typByVal,
 								 &qstate->typAlign);
+
+			/* Prepare the comparator used for selection */
+			qstate->sortKey.ssup_cxt = qcontext;
+			qstate->sortKey.ssup_collation = qstate->sortCollation;
+			qstate->sortKey.ssup_nulls_first = qstate->sortNullsFirst;
+			PrepareSortSupportFromOrderingOp(qstate->sortOperator,
+											 &qstate->sortKey);
 		}
 
 		fcinfo->flinfo->fn_extra = (void *) qstate;
@@ -288,11 +322,14 @@ ordered_set_startup(FunctionCallInfo fcinfo, bool use_tuples)
 
 	if (qstate->rescan_needed)
 		tuplesortopt |= TUPLESORT_RANDOMACCESS;
+	osastate->tuplesortopt = tuplesortopt;
 
 	/*
-	 * Initialize tuplesort object.
+	 * Initialize tuplesort object, or for single datums, the array we collect
+	 * them in to begin with.
 	 */
 	if (use_tuples)
+	{
 		osastate->sortstate = tuplesort_begin_heap(qstate->tupdesc,
 												   qstate->numSortCols,
 												   qstate->sortColIdx,
@@ -302,14 +339,15 @@ ordered_set_startup(FunctionCallInfo fcinfo, bool use_tuples)
 												   work_mem,
 												   NULL,
 												   tuplesortopt);
+		osastate->datums = NULL;
+	}
 	else
-		osastate->sortstate = tuplesort_begin_datum(qstate->sortColType,
-													qstate->sortOperator,
-													qstate->sortCollation,
-													qstate->sortNullsFirst,
-													work_mem,
-													NULL,
-													tuplesortopt);
+	{
+		osastate->sortstate = NULL;
+		osastate->maxdatums = 64;
+		osastate->datums = (Datum *) palloc(osastate->maxdatums * sizeof(Datum));
+		osastate->datumspace = GetMemoryChunkSpace(osastate->datums);
+	}
 
 	osastate->number_of_rows = 0;
 	osastate->sort_done = false;
@@ -367,16 +405,183 @@ ordered_set_transition(PG_FUNCTION_ARGS)
 	else
 		osastate = (OSAPerGroupState *) PG_GETARG_POINTER(0);
 
-	/* Load the datum into the tuplesort object, but only if it's not null */
+	/* Collect the datum, but only if it's not null */
 	if (!PG_ARGISNULL(1))
 	{
-		tuplesort_putdatum(osastate->sortstate, PG_GETARG_DATUM(1), false);
-		osastate->number_of_rows++;
+		if (osastate->datums != NULL)
+		{
+			MemoryContext oldcontext;
+			Datum		val;
+
+			oldcontext = MemoryContextSwitchTo(osastate->gcontext);
+
+			if (osastate->number_of_rows >= osastate->maxdatums)
+			{
+				osastate->datumspace -= GetMemoryChunkSpace(osastate->datums);
+				osastate->maxdatums *= 2;
+				osastate->datums = (Datum *)
+					repalloc_huge(osastate->datums,
+								  osastate->maxdatums * sizeof(Datum));
+				osastate->datumspace += GetMemoryChunkSpace(osastate->datums);
+			}
+
+			val = PG_GETARG_DATUM(1);
+			if (!osastate->qstate->typByVal)
+			{
+				val = datumCopy(val, false, osastate->qstate->typLen);
+				osastate->datumspace += GetMemoryChunkSpace(DatumGetPointer(val));
+			}
+			osastate->datums[osastate->number_of_rows++] = val;
+
+			MemoryContextSwitchTo(oldcontext);
+
+			/* Fall back to sorting if the datums don't fit in work_mem */
+			if (osastate->datumspace > work_mem * 1024L)
+				ordered_set_spill_datums(osastate);
+		}
+		else
+		{
+			tuplesort_putdatum(osastate->sortstate, PG_GETARG_DATUM(1), false);
+			osastate->number_of_rows++;
+		}
 	}
 
 	PG_RETURN_POINTER(osastate);
 }
 
+/*
+ * Move the datums collected in memory by ordered_set_transition into a
+ * tuplesort, for when they grow too large or must be read in sorted order.
+ */
+static void
+ordered_set_spill_datums(OSAPerGroupState *osastate)
+{
+	OSAPerQueryState *qstate = osastate->qstate;
+	MemoryContext oldcontext;
+	int64		i;
+
+	if (osastate->datums == NULL)
+		return;
+
+	oldcontext = MemoryContextSwitchTo(osastate->gcontext);
+
+	osastate->sortstate = tuplesort_begin_datum(qstate->sortColType,
+												qstate->sortOperator,
+												qstate->sortCollation,
+												qstate->sortNullsFirst,
+												work_mem,
+												NULL,
+												osastate->tuplesortopt);
+
+	for (i = 0; i < osastate->number_of_rows; i++)
+	{
+		tuplesort_putdatum(osastate->sortstate, osastate->datums[i], false);
+		if (!qstate->typByVal)
+			pfree(DatumGetPointer(osastate->datums[i]));
+	}
+	pfree(osastate->datums);
+	osastate->datums = NULL;
+	osastate->sort_done = false;
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Rearrange datums[lo .. hi - 1] of an ordered-set aggregate's in-memory
+ * input so that datums[k] holds the value it would hold if that range were
+ * sorted, with no larger values before it and no smaller values after it.
+ *
+ * This is quickselect with median-of-three pivots and three-way
+ * partitioning, so that runs of equal values don't degrade it; like
+ * introselect, it resorts to sorting the remaining range if partitioning
+ * doesn't converge, keeping the worst case at O(n log n) instead of O(n^2).
+ * The expected cost is O(n).
+ */
+static void
+ordered_set_select(OSAPerGroupState *osastate, int64 lo, int64 hi, int64 k)
+{
+	SortSupport ssup = &osastate->qstate->sortKey;
+	Datum	   *datums = osastate->datums;
+	int			depth_limit;
+
+	Assert(lo <= k && k < hi);
+
+	depth_limit = 2 * (pg_leftmost_one_pos64(hi - lo) + 1);
+
+	while (hi - lo > 16)
+	{
+		int64		mid = lo + (hi - lo) / 2;
+		Datum		pivot;
+		int64		lt,
+					gt,
+					i;
+
+		if (depth_limit-- == 0)
+			break;
+
+		/* Order datums[lo], datums[mid] and datums[hi - 1]; pivot on the middle */
+		if (ApplySortComparator(datums[mid], false, datums[lo], false, ssup) < 0)
+			SWAP_DATUM(datums, mid, lo);
+		if (ApplySortComparator(datums[hi - 1], false, datums[mid], false, ssup) < 0)
+		{
+			SWAP_DATUM(datums, hi - 1, mid);
+			if (ApplySortComparator(datums[mid], false, datums[lo], false, ssup) < 0)
+				SWAP_DATUM(datums, mid, lo);
+		}
+		pivot = datums[mid];
+
+		/*
+		 * Partition into datums[lo .. lt - 1] < pivot, datums[lt .. gt - 1]
+		 * equal to pivot and datums[gt .. hi - 1] > pivot.
+		 */
+		lt = lo;
+		gt = hi;
+		i = lo;
+		while (i < gt)
+		{
+			int			cmp = ApplySortComparator(datums[i], false,
+												  pivot, false, ssup);
+
+			if (cmp < 0)
+			{
+				SWAP_DATUM(datums, i, lt);
+				lt++;
+				i++;
+			}
+			else if (cmp > 0)
+			{
+				gt--;
+				SWAP_DATUM(datums, i, gt);
+			}
+			else
+				i++;
+		}
+
+		if (k < lt)
+			hi = lt;
+		else if (k >= gt)
+			lo = gt;
+		else
+			return;				/* datums[k] equals the pivot */
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	/* Sort what's left, which is small unless we gave up partitioning */
+	qsort_arg(datums + lo, hi - lo, sizeof(Datum), ordered_set_datum_cmp, ssup);
+}
+
+/*
+ * qsort_arg comparator for ordered_set_select
+ */
+static int
+ordered_set_datum_cmp(const void *a, const void *b, void *arg)
+{
+	return ApplySortComparator(*(const Datum *) a, false,
+							   *(const Datum *) b, false,
+							   (SortSupport) arg);
+}
+
 /*
  * Generic transition function for ordered-set aggregates
  * with (potentially) multiple aggregated input columns
@@ -458,15 +663,6 @@ percentile_disc_final(PG_FUNCTION_ARGS)
 	if (osastate->number_of_rows == 0)
 		PG_RETURN_NULL();
 
-	/* Finish the sort, or rescan if we already did */
-	if (!osastate->sort_done)
-	{
-		tuplesort_performsort(osastate->sortstate);
-		osastate->sort_done = true;
-	}
-	else
-		tuplesort_rescan(osastate->sortstate);
-
 	/*----------
 	 * We need the smallest K such that (K/N) >= percentile.
 	 * N>0, therefore K >= N*percentile, therefore K = ceil(N*percentile).
@@ -476,6 +672,24 @@ percentile_disc_final(PG_FUNCTION_ARGS)
 	rownum = (int64) ceil(percentile * osastate->number_of_rows);
 	Assert(rownum <= osastate->number_of_rows);
 
+	/* If the input is still in memory, there's no need to sort it all */
+	if (osastate->datums != NULL)
+	{
+		int64		k = Max(rownum, 1) - 1;
+
+		ordered_set_select(osastate, 0, osastate->number_of_rows, k);
+		PG_RETURN_DATUM(osastate->datums[k]);
+	}
+
+	/* Finish the sort, or rescan if we already did */
+	if (!osastate->sort_done)
+	{
+		tuplesort_performsort(osastate->sortstate);
+		osastate->sort_done = true;
+	}
+	else
+		tuplesort_rescan(osastate->sortstate);
+
 	if (rownum > 1)
 	{
 		if (!tuplesort_skiptuples(osastate->sortstate, rownum - 1, true))
@@ -564,6 +778,31 @@ percentile_cont_final_common(FunctionCallInfo fcinfo,
 
 	Assert(expect_type == osastate->qstate->sortColType);
 
+	first_row = floor(percentile * (osastate->number_of_rows - 1));
+	second_row = ceil(percentile * (osastate->number_of_rows - 1));
+
+	Assert(first_row < osastate->number_of_rows);
+
+	/*
+	 * If the input is still in memory, select the two rows.  Once the first
+	 * is in place, the second is the smallest of the rows after it.
+	 */
+	if (osastate->datums != NULL)
+	{
+		ordered_set_select(osastate, 0, osastate->number_of_rows, first_row);
+		first_val = osastate->datums[first_row];
+
+		if (first_row == second_row)
+			PG_RETURN_DATUM(first_val);
+
+		ordered_set_select(osastate, second_row, osastate->number_of_rows,
+						   second_row);
+		second_val = osastate->datums[second_row];
+
+		proportion = (percentile * (osastate->number_of_rows - 1)) - first_row;
+		PG_RETURN_DATUM(lerpfunc(first_val, second_val, proportion));
+	}
+
 	/* Finish the sort, or rescan if we already did */
 	if (!osastate->sort_done)
 	{
@@ -573,11 +812,6 @@ percentile_cont_final_common(FunctionCallInfo fcinfo,
 	else
 		tuplesort_rescan(osastate->sortstate);
 
-	first_row = floor(percentile * (osastate->number_of_rows - 1));
-	second_row = ceil(percentile * (osastate->number_of_rows - 1));
-
-	Assert(first_row < osastate->number_of_rows);
-
 	if (!tuplesort_skiptuples(osastate->sortstate, first_row, true))
 		elog(ERROR, "missing row in percentile_cont");
 
@@ -797,6 +1031,9 @@ percentile_disc_multi_final(PG_FUNCTION_ARGS)
 	 */
 	if (i < num_percentiles)
 	{
+		/* These need the input in sorted order */
+		ordered_set_spill_datums(osastate);
+
 		/* Finish the sort, or rescan if we already did */
 		if (!osastate->sort_done)
 		{
@@ -919,6 +1156,9 @@ percentile_cont_multi_final_common(FunctionCallInfo fcinfo,
 	 */
 	if (i < num_percentiles)
 	{
+		/* These need the input in sorted order */
+		ordered_set_spill_datums(osastate);
+
 		/* Finish the sort, or rescan if we already did */
 		if (!osastate->sort_done)
 		{
@@ -1063,6 +1303,9 @@ mode_final(PG_FUNCTION_ARGS)
 
 	shouldfree = !(osastate->qstate->typByVal);
 
+	/* We need the input in sorted order */
+	ordered_set_spill_datums(osastate);
+
 	/* Finish the sort, or rescan if we already did */
 	if (!osastate->sort_done)
 	{
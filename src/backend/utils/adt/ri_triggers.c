@@ -23,13 +23,17 @@
 
 #include "postgres.h"
 
+#include "access/genam.h"
 #include "access/htup_details.h"
+#include "access/stratnum.h"
 #include "access/sysattr.h"
 #include "access/table.h"
 #include "access/tableam.h"
 #include "access/xact.h"
+#include "catalog/pg_am.h"
 #include "catalog/pg_collation.h"
 #include "catalog/pg_constraint.h"
+#include "catalog/pg_index.h"
 #include "catalog/pg_operator.h"
 #include "catalog/pg_type.h"
 #include "commands/trigger.h"
@@ -124,6 +128,13 @@ typedef struct RI_ConstraintInfo
 	Oid			pf_eq_oprs[RI_MAX_NUMKEYS]; /* equality operators (PK = FK) */
 	Oid			pp_eq_oprs[RI_MAX_NUMKEYS]; /* equality operators (PK = PK) */
 	Oid			ff_eq_oprs[RI_MAX_NUMKEYS]; /* equality operators (FK = FK) */
+	Oid			conindid;		/* unique index on the referenced columns */
+	bool		idx_probe_ok;	/* can check FK rows by probing conindid? */
+	/* The rest is valid only if idx_probe_ok; all indexed by index column */
+	int			idx_keys[RI_MAX_NUMKEYS];	/* which RI key each column is */
+	RegProcedure idx_procs[RI_MAX_NUMKEYS]; /* PK = FK comparison functions */
+	Oid			idx_subtypes[RI_MAX_NUMKEYS];	/* right input types of those */
+	Oid			idx_collations[RI_MAX_NUMKEYS]; /* index column collations */
 	dlist_node	valid_link;		/* Link in list of valid entries */
 } RI_ConstraintInfo;
 
@@ -186,6 +197,9 @@ static int	ri_constraint_cache_valid_count = 0;
 static bool ri_Check_Pk_Match(Relation pk_rel, Relation fk_rel,
 							  TupleTableSlot *oldslot,
 							  const RI_ConstraintInfo *riinfo);
+static bool ri_CanProbeIndex(const RI_ConstraintInfo *riinfo, Relation pk_rel);
+static bool ri_ReferencedKeyExists(const RI_ConstraintInfo *riinfo,
+								   Relation pk_rel, TupleTableSlot *newslot);
 static Datum ri_restrict(TriggerData *trigdata, bool is_no_action);
 static Datum ri_set(TriggerData *trigdata, bool is_set_null, int tgkind);
 static void quoteOneName(char *buffer, const char *name);
@@ -217,6 +231,7 @@ static void ri_CheckTrigger(FunctionCallInfo fcinfo, const char *funcname,
 static const RI_ConstraintInfo *ri_FetchConstraintInfo(Trigger *trigger,
 													   Relation trig_rel, bool rel_is_pk);
 static const RI_ConstraintInfo *ri_LoadConstraintInfo(Oid constraintOid);
+static void ri_LoadIndexProbeInfo(RI_ConstraintInfo *riinfo);
 static Oid	get_ri_constraint_root(Oid constrOid);
 static SPIPlanPtr ri_PlanCheck(const char *querystr, int nargs, Oid *argtypes,
 							   RI_QueryKey *qkey, Relation fk_rel, Relation pk_rel);
@@ -344,6 +359,25 @@ RI_FKey_check(TriggerData *trigdata)
 			break;
 	}
 
+	/*
+	 * If we can, look up the PK row by probing the PK's unique index
+	 * ourselves, which is much cheaper than running the query below through
+	 * SPI and the executor.
+	 */
+	if (ri_CanProbeIndex(riinfo, pk_rel))
+	{
+		if (!ri_ReferencedKeyExists(riinfo, pk_rel, newslot))
+			ri_ReportViolation(riinfo,
+							   pk_rel, fk_rel,
+							   newslot,
+							   NULL,
+							   RI_PLAN_CHECK_LOOKUPPK, false);
+
+		table_close(pk_rel, RowShareLock);
+
+		return PointerGetDatum(NULL);
+	}
+
 	if (SPI_connect() != SPI_OK_CONNECT)
 		elog(ERROR, "SPI_connect failed");
 
@@ -2154,6 +2188,7 @@ ri_LoadConstraintInfo(Oid constraintOid)
 	memcpy(&riinfo->conname, &conForm->conname, sizeof(NameData));
 	riinfo->pk_relid = conForm->confrelid;
 	riinfo->fk_relid = conForm->conrelid;
+	riinfo->conindid = conForm->conindid;
 	riinfo->confupdtype = conForm->confupdtype;
 	riinfo->confdeltype = conForm->confdeltype;
 	riinfo->confmatchtype = conForm->confmatchtype;
@@ -2170,6 +2205,8 @@ ri_LoadConstraintInfo(Oid constraintOid)
 
 	ReleaseSysCache(tup);
 
+	ri_LoadIndexProbeInfo(riinfo);
+
 	/*
 	 * For efficient processing of invalidation messages below, we keep a
 	 * doubly-linked list, and a count, of all currently valid entries.
@@ -2182,6 +2219,110 @@ ri_LoadConstraintInfo(Oid constraintOid)
 	return riinfo;
 }
 
+/*
+ * ri_LoadIndexProbeInfo
+ *
+ * Work out whether RI_FKey_check() can look for the referenced row by
+ * probing the unique index on the PK side directly, and if so, how to build
+ * the scan keys.  That works when the index is a plain btree index on the
+ * referenced columns and each PK = FK operator is in the operator family of
+ * its index column, compares using the index column's collation and accepts
+ * the FK column's type without a cast.  Otherwise, we leave the check to the
+ * SPI query.
+ */
+static void
+ri_LoadIndexProbeInfo(RI_ConstraintInfo *riinfo)
+{
+	HeapTuple	reltup;
+	HeapTuple	indtup;
+	Form_pg_index indform;
+	oidvector  *indclass;
+	oidvector  *indcollation;
+	Datum		datum;
+	bool		isnull;
+	bool		ok;
+
+	riinfo->idx_probe_ok = false;
+
+	if (!OidIsValid(riinfo->conindid))
+		return;
+
+	reltup = SearchSysCache1(RELOID, ObjectIdGetDatum(riinfo->conindid));
+	if (!HeapTupleIsValid(reltup))
+		elog(ERROR, "cache lookup failed for relation %u", riinfo->conindid);
+	ok = ((Form_pg_class) GETSTRUCT(reltup))->relam == BTREE_AM_OID;
+	ReleaseSysCache(reltup);
+	if (!ok)
+		return;
+
+	indtup = SearchSysCache1(INDEXRELID, ObjectIdGetDatum(riinfo->conindid));
+	if (!HeapTupleIsValid(indtup))
+		elog(ERROR, "cache lookup failed for index %u", riinfo->conindid);
+	indform = (Form_pg_index) GETSTRUCT(indtup);
+
+	ok = (indform->indnkeyatts == riinfo->nkeys &&
+		  heap_attisnull(indtup, Anum_pg_index_indexprs, NULL) &&
+		  heap_attisnull(indtup, Anum_pg_index_indpred, NULL));
+
+	datum = SysCacheGetAttr(INDEXRELID, indtup,
+							Anum_pg_index_indclass, &isnull);
+	Assert(!isnull);
+	indclass = (oidvector *) DatumGetPointer(datum);
+	datum = SysCacheGetAttr(INDEXRELID, indtup,
+							Anum_pg_index_indcollation, &isnull);
+	Assert(!isnull);
+	indcollation = (oidvector *) DatumGetPointer(datum);
+
+	for (int i = 0; ok && i < riinfo->nkeys; i++)
+	{
+		AttrNumber	attnum = indform->indkey.values[i];
+		Oid			eq_opr;
+		Oid			lefttype;
+		Oid			righttype;
+		Oid			pk_type;
+		int32		pk_typmod;
+		Oid			pk_coll;
+		int			key;
+
+		/* Find the RI key this index column belongs to */
+		for (key = 0; key < riinfo->nkeys; key++)
+		{
+			if (riinfo->pk_attnums[key] == attnum)
+				break;
+		}
+		if (key >= riinfo->nkeys)
+		{
+			ok = false;
+			break;
+		}
+
+		eq_opr = riinfo->pf_eq_oprs[key];
+		op_input_types(eq_opr, &lefttype, &righttype);
+		get_atttypetypmodcoll(riinfo->pk_relid, attnum,
+							  &pk_type, &pk_typmod, &pk_coll);
+
+		if (get_op_opfamily_strategy(eq_opr,
+									 get_opclass_family(indclass->values[i])) != BTEqualStrategyNumber ||
+			!IsBinaryCoercible(get_atttype(riinfo->fk_relid,
+										   riinfo->fk_attnums[key]),
+							   righttype) ||
+			indcollation->values[i] != pk_coll)
+		{
+			ok = false;
+			break;
+		}
+
+		riinfo->idx_keys[i] = key;
+		riinfo->idx_procs[i] = get_opcode(eq_opr);
+		riinfo->idx_subtypes[i] = righttype;
+		riinfo->idx_collations[i] = pk_coll;
+	}
+
+	ReleaseSysCache(indtup);
+
+	riinfo->idx_probe_ok = ok;
+}
+
 /*
  * get_ri_constraint_root
  *		Returns the OID of the constraint's root parent
@@ -2439,6 +2580,188 @@ ri_PerformCheck(const RI_ConstraintInfo *riinfo,
 	return SPI_processed != 0;
 }
 
+/*
+ * ri_CanProbeIndex -
+ *
+ * Can RI_FKey_check() use ri_ReferencedKeyExists() for this constraint?
+ *
+ * Besides what ri_LoadIndexProbeInfo() checked, the PK table must not be
+ * partitioned, since we'd have to route the key to the right partition
+ * first.  Also, its owner, as whom the check is done, must have the
+ * privileges SELECT FOR KEY SHARE needs on the whole table.  If it only
+ * has column privileges, we let the executor check those.
+ */
+static bool
+ri_CanProbeIndex(const RI_ConstraintInfo *riinfo, Relation pk_rel)
+{
+	if (!riinfo->idx_probe_ok ||
+		pk_rel->rd_rel->relkind != RELKIND_RELATION)
+		return false;
+
+	return pg_class_aclmask(RelationGetRelid(pk_rel),
+							pk_rel->rd_rel->relowner,
+							ACL_SELECT | ACL_UPDATE,
+							ACLMASK_ALL) == (ACL_SELECT | ACL_UPDATE);
+}
+
+/*
+ * ri_ReferencedKeyExists -
+ *
+ * Look up the PK row referenced by the FK row in newslot and lock it in
+ * KEY SHARE mode, by probing the PK's unique index.  This does what the
+ * RI_PLAN_CHECK_LOOKUPPK query would do, with the same snapshot, user and
+ * locking behavior, but without the overhead of SPI and the executor.
+ *
+ * Returns whether the row was found.  The FK key must not contain nulls.
+ */
+static bool
+ri_ReferencedKeyExists(const RI_ConstraintInfo *riinfo,
+					   Relation pk_rel, TupleTableSlot *newslot)
+{
+	ScanKeyData skey[RI_MAX_NUMKEYS];
+	Relation	idxrel;
+	IndexScanDesc scan;
+	TupleTableSlot *pkslot;
+	Snapshot	snapshot;
+	Oid			save_userid;
+	int			save_sec_context;
+	int			lockflags;
+	bool		found = false;
+
+	/*
+	 * Use the snapshot SPI would have used for the query: a new one in READ
+	 * COMMITTED mode, the transaction snapshot otherwise, either way seeing
+	 * all our own work so far.
+	 */
+	PushActiveSnapshot(GetTransactionSnapshot());
+	CommandCounterIncrement();
+	UpdateActiveSnapshotCommandId();
+	snapshot = GetActiveSnapshot();
+
+	/* Switch to the PK table's owner, like ri_PerformCheck() */
+	GetUserIdAndSecContext(&save_userid, &save_sec_context);
+	SetUserIdAndSecContext(RelationGetForm(pk_rel)->relowner,
+						   save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+						   SECURITY_NOFORCE_RLS);
+
+	idxrel = index_open(riinfo->conindid, AccessShareLock);
+
+	for (int i = 0; i < riinfo->nkeys; i++)
+	{
+		int			key = riinfo->idx_keys[i];
+		Datum		value;
+		bool		isnull;
+
+		value = slot_getattr(newslot, riinfo->fk_attnums[key], &isnull);
+		Assert(!isnull);
+
+		ScanKeyEntryInitialize(&skey[i], 0, i + 1,
+							   BTEqualStrategyNumber,
+							   riinfo->idx_subtypes[i],
+							   riinfo->idx_collations[i],
+							   riinfo->idx_procs[i],
+							   value);
+	}
+
+	/* Lock the latest version of the row in READ COMMITTED, as LockRows */
+	lockflags = TUPLE_LOCK_FLAG_LOCK_UPDATE_IN_PROGRESS;
+	if (!IsolationUsesXactSnapshot())
+		lockflags |= TUPLE_LOCK_FLAG_FIND_LAST_VERSION;
+
+	pkslot = table_slot_create(pk_rel, NULL);
+	scan = index_beginscan(pk_rel, idxrel, snapshot, riinfo->nkeys, 0);
+	index_rescan(scan, skey, riinfo->nkeys, NULL, 0);
+
+	while (!found && index_getnext_slot(scan, ForwardScanDirection, pkslot))
+	{
+		TM_FailureData tmfd;
+		TM_Result	test;
+
+		test = table_tuple_lock(pk_rel, &pkslot->tts_tid, snapshot,
+								pkslot, GetCurrentCommandId(true),
+								LockTupleKeyShare, LockWaitBlock,
+								lockflags, &tmfd);
+
+		switch (test)
+		{
+			case TM_Ok:
+
+				/*
+				 * If we locked a newer version of the row than the one we
+				 * found, its key might have changed since.  Recheck it, like
+				 * EvalPlanQual would.
+				 */
+				found = true;
+				if (tmfd.traversed)
+				{
+					for (int i = 0; i < riinfo->nkeys; i++)
+					{
+						Datum		value;
+						bool		isnull;
+
+						value = slot_getattr(pkslot,
+											 riinfo->pk_attnums[riinfo->idx_keys[i]],
+											 &isnull);
+						if (isnull ||
+							!DatumGetBool(FunctionCall2Coll(&skey[i].sk_func,
+															skey[i].sk_collation,
+															value,
+															skey[i].sk_argument)))
+						{
+							found = false;
+							break;
+						}
+					}
+				}
+				break;
+
+			case TM_SelfModified:
+
+				/*
+				 * Updated or deleted by the current command or a later one in
+				 * this transaction; LockRows ignores such rows, and so do we.
+				 */
+				break;
+
+			case TM_Updated:
+				if (IsolationUsesXactSnapshot())
+					ereport(ERROR,
+							(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
+							 errmsg("could not serialize access due to concurrent update")));
+				elog(ERROR, "unexpected table_tuple_lock status: %u",
+					 test);
+				break;
+
+			case TM_Deleted:
+				if (IsolationUsesXactSnapshot())
+					ereport(ERROR,
+							(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
+							 errmsg("could not serialize access due to concurrent update")));
+				/* tuple was deleted, so it doesn't count */
+				break;
+
+			case TM_Invisible:
+				elog(ERROR, "attempted to lock invisible tuple");
+				break;
+
+			default:
+				elog(ERROR, "unrecognized table_tuple_lock status: %u",
+					 test);
+		}
+	}
+
+	index_endscan(scan);
+	ExecDropSingleTupleTableSlot(pkslot);
+	index_close(idxrel, NoLock);
+
+	/* Restore UID and security context */
+	SetUserIdAndSecContext(save_userid, save_sec_context);
+
+	PopActiveSnapshot();
+
+	return found;
+}
+
 /*
  * Extract fields from a tuple into Datum/nulls arrays
  */
@@ -6432,9 +6432,10 @@ genericcostestimate(PlannerInfo *root,
 
 	/*
 	 * Check for ScalarArrayOpExpr index quals, and estimate the number of
-	 * index scans that will be performed.
+	 * index scans that will be performed.  The caller may have told us about
+	 * other primitive index scans the access method does.
 	 */
-	num_sa_scans = 1;
+	num_sa_scans = Max(costs->num_sa_scans, 1);
 	foreach(l, indexQuals)
 	{
 		RestrictInfo *rinfo = (RestrictInfo *) lfirst(l);
@@ -6657,8 +6658,37 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	bool		found_saop;
 	bool		found_is_null_op;
 	double		num_sa_scans;
+	double		num_skip_scans;
+	bool		skip_scan;
 	ListCell   *lc;
 
+	/*
+	 * If there are quals on the second index column but none on the first,
+	 * nbtree does a skip scan (see _bt_preprocess_skip_key): one primitive
+	 * index scan for each distinct value of the first column, each of which
+	 * behaves as though there were an '=' qual on that column.  Finding each
+	 * value costs an extra descent of the tree, though, so this is only
+	 * cheap if the first column has few distinct values; with many, it can
+	 * cost far more than reading the whole index would.  Parallel scans
+	 * don't skip.
+	 */
+	num_skip_scans = 1;
+	skip_scan = (path->indexclauses != NIL &&
+				 linitial_node(IndexClause, path->indexclauses)->indexcol == 1 &&
+				 !path->path.parallel_aware);
+	if (skip_scan)
+	{
+		TargetEntry *tle = linitial_node(TargetEntry, index->indextlist);
+		bool		isdefault;
+
+		examine_variable(root, (Node *) tle->expr, 0, &vardata);
+		num_skip_scans = get_variable_numdistinct(&vardata, &isdefault);
+		ReleaseVariableStats(vardata);
+		memset(&vardata, 0, sizeof(vardata));
+
+		num_skip_scans = clamp_row_est(Min(num_skip_scans, index->tuples));
+	}
+
 	/*
 	 * For a btree scan, only leading '=' quals plus inequality quals for the
 	 * immediately next attribute contribute to index selectivity (these are
@@ -6674,10 +6704,11 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 *
 	 * If there's a ScalarArrayOpExpr in the quals, we'll actually perform N
 	 * index scans not one, but the ScalarArrayOpExpr's operator can be
-	 * considered to act the same as it normally does.
+	 * considered to act the same as it normally does.  Likewise, a skip scan
+	 * lets us start with the second column's quals.
 	 */
 	indexBoundQuals = NIL;
-	indexcol = 0;
+	indexcol = skip_scan ? 1 : 0;
 	eqQualHere = false;
 	found_saop = false;
 	found_is_null_op = false;
@@ -6794,13 +6825,15 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 		 * ScalarArrayOpExpr quals included in indexBoundQuals, and then round
 		 * to integer.
 		 */
-		numIndexTuples = rint(numIndexTuples / num_sa_scans);
+		numIndexTuples = rint(numIndexTuples / (num_sa_scans * num_skip_scans));
 	}
 
 	/*
-	 * Now do generic index cost estimation.
+	 * Now do generic index cost estimation.  Tell it about the primitive
+	 * index scans a skip scan will do on top of any ScalarArrayOpExpr ones.
 	 */
 	costs.numIndexTuples = numIndexTuples;
+	costs.num_sa_scans = num_skip_scans;
 
 	genericcostestimate(root, path, loop_count, &costs);
 
@@ -6813,13 +6846,19 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 *
 	 * If there are ScalarArrayOpExprs, charge this once per SA scan.  The
 	 * ones after the first one are not startup cost so far as the overall
-	 * plan is concerned, so add them only to "total" cost.
+	 * plan is concerned, so add them only to "total" cost.  A skip scan does
+	 * one more descent per value of the first column, to find it.
 	 */
 	if (index->tuples > 1)		/* avoid computing log(0) */
 	{
 		descentCost = ceil(log(index->tuples) / log(2.0)) * cpu_operator_cost;
 		costs.indexStartupCost += descentCost;
 		costs.indexTotalCost += costs.num_sa_scans * descentCost;
+		if (skip_scan)
+		{
+			costs.indexStartupCost += descentCost;
+			costs.indexTotalCost += num_skip_scans * descentCost;
+		}
 	}
 
 	/*
@@ -6830,11 +6869,17 @@ btcostestimate(PlannerInfo *root, IndexPath *path, double loop_count,
 	 * in cases where only a single leaf page is expected to be visited.  This
 	 * cost is somewhat arbitrarily set at 50x cpu_operator_cost per page
 	 * touched.  The number of such pages is btree tree height plus one (ie,
-	 * we charge for the leaf page too).  As above, charge once per SA scan.
+	 * we charge for the leaf page too).  As above, charge once per SA scan,
+	 * and once more per skip scan value.
 	 */
 	descentCost = (index->tree_height + 1) * 50.0 * cpu_operator_cost;
 	costs.indexStartupCost += descentCost;
 	costs.indexTotalCost += costs.num_sa_scans * descentCost;
+	if (skip_scan)
+	{
+		costs.indexStartupCost += descentCost;
+		costs.indexTotalCost += num_skip_scans * descentCost;
+	}
 
 	/*
 	 * If we can get an estimate of the first column's ordering correlation C
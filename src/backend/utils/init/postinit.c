@@ -563,6 +563,29 @@ InitializeMaxBackends(void)
 		elog(ERROR, "too many backends configured");
 }
 
+/*
+ * Initialize the number of fast-path lock groups from max_locks_per_xact.
+ *
+ * Each backend gets enough groups of FP_LOCK_SLOTS_PER_GROUP slots to cover
+ * max_locks_per_transaction relation locks, rounded up to a power of two so
+ * that a relation's group can be picked with a mask.  Workloads touching
+ * many relations per transaction (e.g. partitioned tables) then don't fall
+ * back to the shared lock table as soon as the 17th relation is locked.
+ *
+ * Like MaxBackends, this must be computed before the shared memory size is
+ * determined, and is passed down to EXEC_BACKEND subprocesses by postmaster.
+ */
+void
+InitializeFastPathLocks(void)
+{
+	Assert(FastPathLockGroupsPerBackend == 0);
+
+	FastPathLockGroupsPerBackend = 1;
+	while (FastPathLockGroupsPerBackend < FP_LOCK_GROUPS_PER_BACKEND_MAX &&
+		   FastPathLockGroupsPerBackend * FP_LOCK_SLOTS_PER_GROUP < max_locks_per_xact)
+		FastPathLockGroupsPerBackend *= 2;
+}
+
 /*
  * GUC check_hook for max_connections
  */
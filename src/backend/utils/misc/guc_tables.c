@@ -28,9 +28,11 @@
 
 #include "access/commit_ts.h"
 #include "access/gin.h"
+#include "access/slru.h"
 #include "access/toast_compression.h"
 #include "access/twophase.h"
 #include "access/xlog_internal.h"
+#include "access/xlogparallel.h"
 #include "access/xlogprefetcher.h"
 #include "access/xlogrecovery.h"
 #include "catalog/namespace.h"
@@ -54,11 +56,13 @@
 #include "postmaster/autovacuum.h"
 #include "postmaster/bgworker_internals.h"
 #include "postmaster/bgwriter.h"
+#include "postmaster/pgarch.h"
 #include "postmaster/postmaster.h"
 #include "postmaster/startup.h"
 #include "postmaster/syslogger.h"
 #include "postmaster/walwriter.h"
 #include "replication/logicallauncher.h"
+#include "replication/reorderbuffer.h"
 #include "replication/slot.h"
 #include "replication/syncrep.h"
 #include "storage/bufmgr.h"
@@ -66,6 +70,7 @@
 #include "storage/pg_shmem.h"
 #include "storage/predicate.h"
 #include "storage/standby.h"
+#include "storage/subxidmap.h"
 #include "tcop/tcopprot.h"
 #include "tsearch/ts_cache.h"
 #include "utils/builtins.h"
@@ -427,6 +432,25 @@ static const struct config_enum_entry default_toast_compression_options[] = {
 	{NULL, 0, false}
 };
 
+static const struct config_enum_entry spill_compression_options[] = {
+	{"pglz", SPILL_COMPRESSION_PGLZ, false},
+#ifdef USE_LZ4
+	{"lz4", SPILL_COMPRESSION_LZ4, false},
+#endif
+#ifdef USE_ZSTD
+	{"zstd", SPILL_COMPRESSION_ZSTD, false},
+#endif
+	{"on", SPILL_COMPRESSION_PGLZ, false},
+	{"off", SPILL_COMPRESSION_NONE, false},
+	{"true", SPILL_COMPRESSION_PGLZ, true},
+	{"false", SPILL_COMPRESSION_NONE, true},
+	{"yes", SPILL_COMPRESSION_PGLZ, true},
+	{"no", SPILL_COMPRESSION_NONE, true},
+	{"1", SPILL_COMPRESSION_PGLZ, true},
+	{"0", SPILL_COMPRESSION_NONE, true},
+	{NULL, 0, false}
+};
+
 static const struct config_enum_entry wal_compression_options[] = {
 	{"pglz", WAL_COMPRESSION_PGLZ, false},
 #ifdef USE_LZ4
@@ -1955,6 +1979,16 @@ struct config_int ConfigureNamesInt[] =
 		0, 0, INT_MAX / 2,
 		NULL, NULL, NULL
 	},
+	{
+		{"archive_concurrency", PGC_SIGHUP, WAL_ARCHIVING,
+			gettext_noop("Sets the maximum number of WAL files archived at the same time."),
+			gettext_noop("Values above 1 only take effect if the archive module "
+						 "supports archiving several files at once.")
+		},
+		&archive_concurrency,
+		1, 1, MAX_ARCHIVE_CONCURRENCY,
+		NULL, NULL, NULL
+	},
 	{
 		{"post_auth_delay", PGC_BACKEND, DEVELOPER_OPTIONS,
 			gettext_noop("Sets the amount of time to wait after "
@@ -2380,6 +2414,94 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_overflowed_subxids", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the maximum number of overflowed subtransaction IDs tracked in shared memory."),
+			gettext_noop("Snapshots need not consult pg_subtrans for subtransactions tracked this way. "
+						 "Zero disables the feature.")
+		},
+		&max_overflowed_subxids,
+		65536, 0, INT_MAX / 2,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"commit_timestamp_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the commit timestamp cache."),
+			gettext_noop("Specify 0 to have this value determined as a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&commit_timestamp_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_commit_ts_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_member_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact member cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_member_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_member_buffers, NULL, NULL
+	},
+
+	{
+		{"multixact_offset_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the MultiXact offset cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&multixact_offset_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_multixact_offset_buffers, NULL, NULL
+	},
+
+	{
+		{"notify_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the LISTEN/NOTIFY message cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&notify_buffers,
+		16, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_notify_buffers, NULL, NULL
+	},
+
+	{
+		{"serializable_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the serializable transaction cache."),
+			NULL,
+			GUC_UNIT_BLOCKS
+		},
+		&serializable_buffers,
+		32, 16, SLRU_MAX_ALLOWED_BUFFERS,
+		check_serial_buffers, NULL, NULL
+	},
+
+	{
+		{"subtransaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the subtransaction cache."),
+			gettext_noop("Specify 0 to have this value determined as a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&subtransaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_subtrans_buffers, NULL, NULL
+	},
+
+	{
+		{"transaction_buffers", PGC_POSTMASTER, RESOURCES_MEM,
+			gettext_noop("Sets the size of the dedicated buffer pool used for the transaction status cache."),
+			gettext_noop("Specify 0 to have this value determined as a fraction of shared_buffers."),
+			GUC_UNIT_BLOCKS
+		},
+		&transaction_buffers,
+		0, 0, SLRU_MAX_ALLOWED_BUFFERS,
+		check_transaction_buffers, NULL, NULL
+	},
+
 #ifdef LOCK_DEBUG
 	{
 		{"trace_lock_oidmin", PGC_SUSET, DEVELOPER_OPTIONS,
@@ -2599,6 +2721,16 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"recovery_parallel_workers", PGC_POSTMASTER, WAL_RECOVERY,
+			gettext_noop("Sets the number of background workers used to replay WAL in parallel during recovery."),
+			gettext_noop("Zero means that the startup process replays all WAL records itself.")
+		},
+		&recovery_parallel_workers,
+		0, 0, MAX_PARALLEL_REDO_WORKERS,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_keep_size", PGC_SIGHUP, REPLICATION_SENDING,
 			gettext_noop("Sets the size of WAL files held for standby servers."),
@@ -2973,6 +3105,32 @@ struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"min_parallel_table_sync_size",
+			PGC_SIGHUP,
+			REPLICATION_SUBSCRIBERS,
+			gettext_noop("Sets the minimum size of tables synchronized by parallel table copy."),
+			gettext_noop("The initial data of larger published tables is copied in ranges of blocks by several workers."),
+			GUC_UNIT_BLOCKS,
+		},
+		&min_parallel_table_sync_size,
+		(1024 * 1024 * 1024) / BLCKSZ, 0, INT_MAX / 3,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"table_sync_chunk_size",
+			PGC_SIGHUP,
+			DEVELOPER_OPTIONS,
+			gettext_noop("Sets the size of the chunks tables are split into by parallel table copy."),
+			NULL,
+			GUC_UNIT_BLOCKS | GUC_NOT_IN_SAMPLE,
+		},
+		&table_sync_chunk_size,
+		(128 * 1024 * 1024) / BLCKSZ, 1, INT_MAX / 3,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"log_rotation_age", PGC_SIGHUP, LOGGING_WHERE,
 			gettext_noop("Sets the amount of time to wait before forcing "
@@ -4720,6 +4878,16 @@ struct config_enum ConfigureNamesEnum[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"logical_decoding_spill_compression", PGC_USERSET, RESOURCES_MEM,
+			gettext_noop("Compresses changes spilled to disk by logical decoding with specified method."),
+			NULL
+		},
+		&logical_decoding_spill_compression,
+		SPILL_COMPRESSION_NONE, spill_compression_options,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_level", PGC_POSTMASTER, WAL_SETTINGS,
 			gettext_noop("Sets the level of information written to the WAL."),
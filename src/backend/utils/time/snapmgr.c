@@ -63,6 +63,7 @@
 #include "storage/sinval.h"
 #include "storage/sinvaladt.h"
 #include "storage/spin.h"
+#include "storage/subxidmap.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/old_snapshot.h"
@@ -188,6 +189,7 @@ typedef struct SerializedSnapshotData
 	uint32		xcnt;
 	int32		subxcnt;
 	bool		suboverflowed;
+	bool		subxidmapped;
 	bool		takenDuringRecovery;
 	CommandId	curcid;
 	TimestampTz whenTaken;
@@ -546,6 +548,7 @@ SetTransactionSnapshot(Snapshot sourcesnap, VirtualTransactionId *sourcevxid,
 		memcpy(CurrentSnapshot->subxip, sourcesnap->subxip,
 			   sourcesnap->subxcnt * sizeof(TransactionId));
 	CurrentSnapshot->suboverflowed = sourcesnap->suboverflowed;
+	CurrentSnapshot->subxidmapped = sourcesnap->subxidmapped;
 	CurrentSnapshot->takenDuringRecovery = sourcesnap->takenDuringRecovery;
 	/* NB: curcid should NOT be copied, it's a local matter */
 
@@ -1233,9 +1236,11 @@ ExportSnapshot(Snapshot snapshot)
 
 	/*
 	 * Similarly, we add our subcommitted child XIDs to the subxid data. Here,
-	 * we have to cope with possible overflow.
+	 * we have to cope with possible overflow.  A snapshot relying on the
+	 * SubXidMap is exported as overflowed, since the importer can't know
+	 * that it needs the map; pg_subtrans gives the same answers.
 	 */
-	if (snapshot->suboverflowed ||
+	if (snapshot->suboverflowed || snapshot->subxidmapped ||
 		snapshot->subxcnt + nchildren > GetMaxSnapshotSubxidCount())
 		appendStringInfoString(&buf, "sof:1\n");
 	else
@@ -1490,6 +1495,7 @@ ImportSnapshot(const char *idstr)
 		snapshot.xip[i] = parseXidFromText("xip:", &filebuf, path);
 
 	snapshot.suboverflowed = parseIntFromText("sof:", &filebuf, path);
+	snapshot.subxidmapped = false;
 
 	if (!snapshot.suboverflowed)
 	{
@@ -2155,6 +2161,7 @@ SerializeSnapshot(Snapshot snapshot, char *start_address)
 	serialized_snapshot.xcnt = snapshot->xcnt;
 	serialized_snapshot.subxcnt = snapshot->subxcnt;
 	serialized_snapshot.suboverflowed = snapshot->suboverflowed;
+	serialized_snapshot.subxidmapped = snapshot->subxidmapped;
 	serialized_snapshot.takenDuringRecovery = snapshot->takenDuringRecovery;
 	serialized_snapshot.curcid = snapshot->curcid;
 	serialized_snapshot.whenTaken = snapshot->whenTaken;
@@ -2229,6 +2236,7 @@ RestoreSnapshot(char *start_address)
 	snapshot->subxip = NULL;
 	snapshot->subxcnt = serialized_snapshot.subxcnt;
 	snapshot->suboverflowed = serialized_snapshot.suboverflowed;
+	snapshot->subxidmapped = serialized_snapshot.subxidmapped;
 	snapshot->takenDuringRecovery = serialized_snapshot.takenDuringRecovery;
 	snapshot->curcid = serialized_snapshot.curcid;
 	snapshot->whenTaken = serialized_snapshot.whenTaken;
@@ -2319,6 +2327,24 @@ XidInMVCCSnapshot(TransactionId xid, Snapshot snapshot)
 			if (pg_lfind32(xid, snapshot->subxip, snapshot->subxcnt))
 				return true;
 
+			/*
+			 * Subxids that overflowed some backend's cache are not in
+			 * subxip, but can be mapped to their top-level XID using the
+			 * SubXidMap.  If the map doesn't know the XID, it's not one of
+			 * those.
+			 */
+			if (snapshot->subxidmapped)
+			{
+				TransactionId topxid = SubXidMapLookup(xid);
+
+				if (TransactionIdIsValid(topxid))
+				{
+					xid = topxid;
+					if (TransactionIdPrecedes(xid, snapshot->xmin))
+						return false;
+				}
+			}
+
 			/* not there, fall through to search xip[] */
 		}
 		else
@@ -11,9 +11,16 @@
  * provides more flexibility, using callbacks to read/write data from the
  * underlying stream. The second API is a wrapper around fopen/gzopen and
  * friends, providing an interface similar to those, but abstracts away
- * the possible compression. Both APIs use libz for the compression, but
- * the second API uses gzip headers, so the resulting files can be easily
- * manipulated with the gzip utility.
+ * the possible compression. Both APIs support gzip, LZ4 and zstd
+ * compression.  The second API produces gzip files, LZ4 frames and zstd
+ * frames respectively, so the resulting files can be easily manipulated
+ * with the gzip, lz4 and zstd utilities.
+ *
+ * zstd can be told to use a number of worker threads (see the "workers"
+ * option of the compression specification).  In that case the data passed
+ * to the compressor is handed to the workers and compressed in the
+ * background, so compression overlaps with the reception of COPY data from
+ * the server instead of alternating with it.
  *
  * Compressor API
  * --------------
@@ -41,10 +48,10 @@
  *	libz's gzopen() APIs. It allows you to use the same functions for
  *	compressed and uncompressed streams. cfopen_read() first tries to open
  *	the file with given name, and if it fails, it tries to open the same
- *	file with the .gz suffix. cfopen_write() opens a file for writing, an
- *	extra argument specifies if the file should be compressed, and adds the
- *	.gz suffix to the filename if so. This allows you to easily handle both
- *	compressed and uncompressed files.
+ *	file with the .gz, .lz4 and .zst suffixes. cfopen_write() opens a file
+ *	for writing, an extra argument specifies if and how the file should be
+ *	compressed, and adds the matching suffix to the filename if so. This
+ *	allows you to easily handle both compressed and uncompressed files.
  *
  * IDENTIFICATION
  *	   src/bin/pg_dump/compress_io.c
@@ -53,6 +60,13 @@
  */
 #include "postgres_fe.h"
 
+#ifdef USE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
 #include "compress_io.h"
 #include "pg_backup_utils.h"
 
@@ -64,7 +78,7 @@
 /* typedef appears in compress_io.h */
 struct CompressorState
 {
-	CompressionAlgorithm comprAlg;
+	pg_compress_specification compression_spec;
 	WriteFunc	writeF;
 
 #ifdef HAVE_LIBZ
@@ -72,11 +86,19 @@ struct CompressorState
 	char	   *zlibOut;
 	size_t		zlibOutSize;
 #endif
+#ifdef USE_LZ4
+	LZ4F_cctx  *lz4ctx;
+	LZ4F_preferences_t lz4prefs;
+	bool		lz4begun;		/* have we written the frame header yet? */
+#endif
+#ifdef USE_ZSTD
+	ZSTD_CCtx  *zstdctx;
+#endif
+	/* output buffer for LZ4 and zstd */
+	char	   *outBuf;
+	size_t		outSize;
 };
 
-static void ParseCompressionOption(int compression, CompressionAlgorithm *alg,
-								   int *level);
-
 /* Routines that support zlib compressed data I/O */
 #ifdef HAVE_LIBZ
 static void InitCompressorZlib(CompressorState *cs, int level);
@@ -88,63 +110,111 @@ static void WriteDataToArchiveZlib(ArchiveHandle *AH, CompressorState *cs,
 static void EndCompressorZlib(ArchiveHandle *AH, CompressorState *cs);
 #endif
 
+/* Routines that support LZ4 compressed data I/O */
+#ifdef USE_LZ4
+static void InitCompressorLZ4(CompressorState *cs, int level);
+static void ReadDataFromArchiveLZ4(ArchiveHandle *AH, ReadFunc readF);
+static void WriteDataToArchiveLZ4(ArchiveHandle *AH, CompressorState *cs,
+								  const char *data, size_t dLen);
+static void EndCompressorLZ4(ArchiveHandle *AH, CompressorState *cs);
+#endif
+
+/* Routines that support zstd compressed data I/O */
+#ifdef USE_ZSTD
+static ZSTD_CCtx *CreateZstdCCtx(const pg_compress_specification compression_spec);
+static void InitCompressorZstd(CompressorState *cs,
+							   const pg_compress_specification compression_spec);
+static void ReadDataFromArchiveZstd(ArchiveHandle *AH, ReadFunc readF);
+static void WriteDataToArchiveZstd(ArchiveHandle *AH, CompressorState *cs,
+								   const char *data, size_t dLen);
+static void EndCompressorZstd(ArchiveHandle *AH, CompressorState *cs);
+#endif
+
 /* Routines that support uncompressed data I/O */
 static void ReadDataFromArchiveNone(ArchiveHandle *AH, ReadFunc readF);
 static void WriteDataToArchiveNone(ArchiveHandle *AH, CompressorState *cs,
 								   const char *data, size_t dLen);
 
+/* Public interface routines */
+
 /*
- * Interprets a numeric 'compression' value. The algorithm implied by the
- * value (zlib or none at the moment), is returned in *alg, and the
- * zlib compression level in *level.
+ * Check whether this installation supports the given compression algorithm.
+ *
+ * Returns NULL if it does, or an error message if not.
  */
-static void
-ParseCompressionOption(int compression, CompressionAlgorithm *alg, int *level)
+char *
+supports_compression(const pg_compress_specification compression_spec)
 {
-	if (compression == Z_DEFAULT_COMPRESSION ||
-		(compression > 0 && compression <= 9))
-		*alg = COMPR_ALG_LIBZ;
-	else if (compression == 0)
-		*alg = COMPR_ALG_NONE;
-	else
+	switch (compression_spec.algorithm)
 	{
-		pg_fatal("invalid compression code: %d", compression);
-		*alg = COMPR_ALG_NONE;	/* keep compiler quiet */
+		case PG_COMPRESSION_NONE:
+			return NULL;
+		case PG_COMPRESSION_GZIP:
+#ifdef HAVE_LIBZ
+			return NULL;
+#else
+			return psprintf("this build does not support compression with %s",
+							"gzip");
+#endif
+		case PG_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			return NULL;
+#else
+			return psprintf("this build does not support compression with %s",
+							"LZ4");
+#endif
+		case PG_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			return NULL;
+#else
+			return psprintf("this build does not support compression with %s",
+							"ZSTD");
+#endif
 	}
 
-	/* The level is just the passed-in value. */
-	if (level)
-		*level = compression;
+	return psprintf("invalid compression algorithm: %d",
+					(int) compression_spec.algorithm);
 }
 
-/* Public interface routines */
-
 /* Allocate a new compressor */
 CompressorState *
-AllocateCompressor(int compression, WriteFunc writeF)
+AllocateCompressor(const pg_compress_specification compression_spec,
+				   WriteFunc writeF)
 {
 	CompressorState *cs;
-	CompressionAlgorithm alg;
-	int			level;
+	char	   *error_detail;
 
-	ParseCompressionOption(compression, &alg, &level);
-
-#ifndef HAVE_LIBZ
-	if (alg == COMPR_ALG_LIBZ)
-		pg_fatal("not built with zlib support");
-#endif
+	error_detail = supports_compression(compression_spec);
+	if (error_detail != NULL)
+		pg_fatal("%s", error_detail);
 
 	cs = (CompressorState *) pg_malloc0(sizeof(CompressorState));
 	cs->writeF = writeF;
-	cs->comprAlg = alg;
+	cs->compression_spec = compression_spec;
 
 	/*
 	 * Perform compression algorithm specific initialization.
 	 */
+	switch (compression_spec.algorithm)
+	{
+		case PG_COMPRESSION_NONE:
+			break;
+		case PG_COMPRESSION_GZIP:
 #ifdef HAVE_LIBZ
-	if (alg == COMPR_ALG_LIBZ)
-		InitCompressorZlib(cs, level);
+			InitCompressorZlib(cs, compression_spec.level);
+#endif
+			break;
+		case PG_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			InitCompressorLZ4(cs, compression_spec.level);
 #endif
+			break;
+		case PG_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			InitCompressorZstd(cs, compression_spec);
+#endif
+			break;
+	}
 
 	return cs;
 }
@@ -154,21 +224,36 @@ AllocateCompressor(int compression, WriteFunc writeF)
  * out with ahwrite().
  */
 void
-ReadDataFromArchive(ArchiveHandle *AH, int compression, ReadFunc readF)
+ReadDataFromArchive(ArchiveHandle *AH,
+					const pg_compress_specification compression_spec,
+					ReadFunc readF)
 {
-	CompressionAlgorithm alg;
+	char	   *error_detail;
 
-	ParseCompressionOption(compression, &alg, NULL);
+	error_detail = supports_compression(compression_spec);
+	if (error_detail != NULL)
+		pg_fatal("%s", error_detail);
 
-	if (alg == COMPR_ALG_NONE)
-		ReadDataFromArchiveNone(AH, readF);
-	if (alg == COMPR_ALG_LIBZ)
+	switch (compression_spec.algorithm)
 	{
+		case PG_COMPRESSION_NONE:
+			ReadDataFromArchiveNone(AH, readF);
+			break;
+		case PG_COMPRESSION_GZIP:
 #ifdef HAVE_LIBZ
-		ReadDataFromArchiveZlib(AH, readF);
-#else
-		pg_fatal("not built with zlib support");
+			ReadDataFromArchiveZlib(AH, readF);
+#endif
+			break;
+		case PG_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			ReadDataFromArchiveLZ4(AH, readF);
+#endif
+			break;
+		case PG_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			ReadDataFromArchiveZstd(AH, readF);
 #endif
+			break;
 	}
 }
 
@@ -179,17 +264,25 @@ void
 WriteDataToArchive(ArchiveHandle *AH, CompressorState *cs,
 				   const void *data, size_t dLen)
 {
-	switch (cs->comprAlg)
+	switch (cs->compression_spec.algorithm)
 	{
-		case COMPR_ALG_LIBZ:
+		case PG_COMPRESSION_NONE:
+			WriteDataToArchiveNone(AH, cs, data, dLen);
+			break;
+		case PG_COMPRESSION_GZIP:
 #ifdef HAVE_LIBZ
 			WriteDataToArchiveZlib(AH, cs, data, dLen);
-#else
-			pg_fatal("not built with zlib support");
 #endif
 			break;
-		case COMPR_ALG_NONE:
-			WriteDataToArchiveNone(AH, cs, data, dLen);
+		case PG_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			WriteDataToArchiveLZ4(AH, cs, data, dLen);
+#endif
+			break;
+		case PG_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			WriteDataToArchiveZstd(AH, cs, data, dLen);
+#endif
 			break;
 	}
 }
@@ -200,10 +293,26 @@ WriteDataToArchive(ArchiveHandle *AH, CompressorState *cs,
 void
 EndCompressor(ArchiveHandle *AH, CompressorState *cs)
 {
+	switch (cs->compression_spec.algorithm)
+	{
+		case PG_COMPRESSION_NONE:
+			break;
+		case PG_COMPRESSION_GZIP:
 #ifdef HAVE_LIBZ
-	if (cs->comprAlg == COMPR_ALG_LIBZ)
-		EndCompressorZlib(AH, cs);
+			EndCompressorZlib(AH, cs);
+#endif
+			break;
+		case PG_COMPRESSION_LZ4:
+#ifdef USE_LZ4
+			EndCompressorLZ4(AH, cs);
+#endif
+			break;
+		case PG_COMPRESSION_ZSTD:
+#ifdef USE_ZSTD
+			EndCompressorZstd(AH, cs);
 #endif
+			break;
+	}
 	free(cs);
 }
 
@@ -376,6 +485,310 @@ ReadDataFromArchiveZlib(ArchiveHandle *AH, ReadFunc readF)
 }
 #endif							/* HAVE_LIBZ */
 
+#ifdef USE_LZ4
+/*
+ * Functions for LZ4 compressed output.
+ *
+ * We use the LZ4 frame format, so that the compressed stream is
+ * self-describing and can be handled by the lz4 utility.
+ */
+
+static void
+InitCompressorLZ4(CompressorState *cs, int level)
+{
+	LZ4F_errorCode_t status;
+
+	memset(&cs->lz4prefs, 0, sizeof(cs->lz4prefs));
+	cs->lz4prefs.compressionLevel = level;
+
+	status = LZ4F_createCompressionContext(&cs->lz4ctx, LZ4F_VERSION);
+	if (LZ4F_isError(status))
+		pg_fatal("could not initialize compression library: %s",
+				 LZ4F_getErrorName(status));
+
+	/*
+	 * The frame header is written when we first have a chance to call the
+	 * write function, which needs the ArchiveHandle.  The output buffer must
+	 * be large enough for the worst case of compressing LZ4_IN_SIZE bytes,
+	 * which is also plenty for the frame header.
+	 */
+	cs->outSize = LZ4F_compressBound(LZ4_IN_SIZE, &cs->lz4prefs);
+	cs->outBuf = pg_malloc(cs->outSize);
+	cs->lz4begun = false;
+}
+
+static void
+BeginCompressorLZ4(ArchiveHandle *AH, CompressorState *cs)
+{
+	size_t		status;
+
+	status = LZ4F_compressBegin(cs->lz4ctx, cs->outBuf, cs->outSize,
+								&cs->lz4prefs);
+	if (LZ4F_isError(status))
+		pg_fatal("could not compress data: %s", LZ4F_getErrorName(status));
+	cs->writeF(AH, cs->outBuf, status);
+	cs->lz4begun = true;
+}
+
+static void
+WriteDataToArchiveLZ4(ArchiveHandle *AH, CompressorState *cs,
+					  const char *data, size_t dLen)
+{
+	if (!cs->lz4begun)
+		BeginCompressorLZ4(AH, cs);
+
+	while (dLen > 0)
+	{
+		size_t		chunk = Min(dLen, LZ4_IN_SIZE);
+		size_t		status;
+
+		status = LZ4F_compressUpdate(cs->lz4ctx, cs->outBuf, cs->outSize,
+									 data, chunk, NULL);
+		if (LZ4F_isError(status))
+			pg_fatal("could not compress data: %s",
+					 LZ4F_getErrorName(status));
+
+		/* avoid zero-length chunks, which are EOF markers in custom format */
+		if (status > 0)
+			cs->writeF(AH, cs->outBuf, status);
+
+		data += chunk;
+		dLen -= chunk;
+	}
+}
+
+static void
+EndCompressorLZ4(ArchiveHandle *AH, CompressorState *cs)
+{
+	size_t		status;
+
+	if (!cs->lz4begun)
+		BeginCompressorLZ4(AH, cs);
+
+	status = LZ4F_compressEnd(cs->lz4ctx, cs->outBuf, cs->outSize, NULL);
+	if (LZ4F_isError(status))
+		pg_fatal("could not end compression: %s", LZ4F_getErrorName(status));
+	if (status > 0)
+		cs->writeF(AH, cs->outBuf, status);
+
+	LZ4F_freeCompressionContext(cs->lz4ctx);
+	free(cs->outBuf);
+}
+
+static void
+ReadDataFromArchiveLZ4(ArchiveHandle *AH, ReadFunc readF)
+{
+	LZ4F_decompressionContext_t ctx;
+	LZ4F_errorCode_t status;
+	char	   *out;
+	size_t		cnt;
+	char	   *buf;
+	size_t		buflen;
+
+	status = LZ4F_createDecompressionContext(&ctx, LZ4F_VERSION);
+	if (LZ4F_isError(status))
+		pg_fatal("could not initialize compression library: %s",
+				 LZ4F_getErrorName(status));
+
+	buf = pg_malloc(LZ4_IN_SIZE);
+	buflen = LZ4_IN_SIZE;
+
+	out = pg_malloc(LZ4_OUT_SIZE + 1);
+
+	while ((cnt = readF(AH, &buf, &buflen)))
+	{
+		char	   *readp = buf;
+		size_t		remaining = cnt;
+
+		/*
+		 * Keep going until all input is consumed and the decompressor has no
+		 * more output buffered, which is the case once it doesn't fill the
+		 * output buffer.
+		 */
+		for (;;)
+		{
+			size_t		outlen = LZ4_OUT_SIZE;
+			size_t		inlen = remaining;
+
+			status = LZ4F_decompress(ctx, out, &outlen, readp, &inlen, NULL);
+			if (LZ4F_isError(status))
+				pg_fatal("could not uncompress data: %s",
+						 LZ4F_getErrorName(status));
+
+			out[outlen] = '\0';
+			ahwrite(out, 1, outlen, AH);
+
+			readp += inlen;
+			remaining -= inlen;
+			if (remaining == 0 && outlen < LZ4_OUT_SIZE)
+				break;
+		}
+	}
+
+	status = LZ4F_freeDecompressionContext(ctx);
+	if (LZ4F_isError(status))
+		pg_fatal("could not close compression library: %s",
+				 LZ4F_getErrorName(status));
+
+	free(buf);
+	free(out);
+}
+#endif							/* USE_LZ4 */
+
+#ifdef USE_ZSTD
+/*
+ * Functions for zstd compressed output.
+ */
+
+/*
+ * Create a zstd compression context with the requested level and number of
+ * worker threads.
+ */
+static ZSTD_CCtx *
+CreateZstdCCtx(const pg_compress_specification compression_spec)
+{
+	ZSTD_CCtx  *cctx;
+	size_t		ret;
+
+	cctx = ZSTD_createCCtx();
+	if (cctx == NULL)
+		pg_fatal("could not initialize compression library");
+
+	ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+								 compression_spec.level);
+	if (ZSTD_isError(ret))
+		pg_fatal("could not set compression level %d: %s",
+				 compression_spec.level, ZSTD_getErrorName(ret));
+
+	if ((compression_spec.options & PG_COMPRESSION_OPTION_WORKERS) != 0)
+	{
+		/*
+		 * On older versions of libzstd, this option does not exist, and
+		 * trying to set it will fail. Similarly for newer versions if they
+		 * are compiled without threading support.
+		 */
+		ret = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers,
+									 compression_spec.workers);
+		if (ZSTD_isError(ret))
+			pg_fatal("could not set compression worker count to %d: %s",
+					 compression_spec.workers, ZSTD_getErrorName(ret));
+	}
+
+	return cctx;
+}
+
+static void
+InitCompressorZstd(CompressorState *cs,
+				   const pg_compress_specification compression_spec)
+{
+	cs->zstdctx = CreateZstdCCtx(compression_spec);
+	cs->outSize = ZSTD_CStreamOutSize();
+	cs->outBuf = pg_malloc(cs->outSize);
+}
+
+static void
+WriteDataToArchiveZstd(ArchiveHandle *AH, CompressorState *cs,
+					   const char *data, size_t dLen)
+{
+	ZSTD_inBuffer input = {data, dLen, 0};
+
+	/*
+	 * With worker threads, ZSTD_compressStream2() mostly just hands the input
+	 * to the workers and returns whatever compressed output they have
+	 * produced so far, so this doesn't wait for the compression itself.
+	 */
+	while (input.pos < input.size)
+	{
+		ZSTD_outBuffer output = {cs->outBuf, cs->outSize, 0};
+		size_t		ret;
+
+		ret = ZSTD_compressStream2(cs->zstdctx, &output, &input,
+								   ZSTD_e_continue);
+		if (ZSTD_isError(ret))
+			pg_fatal("could not compress data: %s", ZSTD_getErrorName(ret));
+
+		/* avoid zero-length chunks, which are EOF markers in custom format */
+		if (output.pos > 0)
+			cs->writeF(AH, cs->outBuf, output.pos);
+	}
+}
+
+static void
+EndCompressorZstd(ArchiveHandle *AH, CompressorState *cs)
+{
+	ZSTD_inBuffer input = {NULL, 0, 0};
+	size_t		ret;
+
+	/* Flush all remaining data, waiting for the workers if there are any */
+	do
+	{
+		ZSTD_outBuffer output = {cs->outBuf, cs->outSize, 0};
+
+		ret = ZSTD_compressStream2(cs->zstdctx, &output, &input, ZSTD_e_end);
+		if (ZSTD_isError(ret))
+			pg_fatal("could not compress data: %s", ZSTD_getErrorName(ret));
+
+		if (output.pos > 0)
+			cs->writeF(AH, cs->outBuf, output.pos);
+	} while (ret != 0);
+
+	ZSTD_freeCCtx(cs->zstdctx);
+	free(cs->outBuf);
+}
+
+static void
+ReadDataFromArchiveZstd(ArchiveHandle *AH, ReadFunc readF)
+{
+	ZSTD_DCtx  *dctx;
+	char	   *out;
+	size_t		outSize;
+	size_t		cnt;
+	char	   *buf;
+	size_t		buflen;
+
+	dctx = ZSTD_createDCtx();
+	if (dctx == NULL)
+		pg_fatal("could not initialize compression library");
+
+	buflen = ZSTD_DStreamInSize();
+	buf = pg_malloc(buflen);
+
+	outSize = ZSTD_DStreamOutSize();
+	out = pg_malloc(outSize + 1);
+
+	while ((cnt = readF(AH, &buf, &buflen)))
+	{
+		ZSTD_inBuffer input = {buf, cnt, 0};
+
+		/*
+		 * Keep going until all input is consumed and the decompressor has no
+		 * more output buffered, which is the case once it doesn't fill the
+		 * output buffer.
+		 */
+		for (;;)
+		{
+			ZSTD_outBuffer output = {out, outSize, 0};
+			size_t		ret;
+
+			ret = ZSTD_decompressStream(dctx, &output, &input);
+			if (ZSTD_isError(ret))
+				pg_fatal("could not uncompress data: %s",
+						 ZSTD_getErrorName(ret));
+
+			out[output.pos] = '\0';
+			ahwrite(out, 1, output.pos, AH);
+
+			if (input.pos >= input.size && output.pos < output.size)
+				break;
+		}
+	}
+
+	ZSTD_freeDCtx(dctx);
+	free(buf);
+	free(out);
+}
+#endif							/* USE_ZSTD */
+
 
 /*
  * Functions for uncompressed output.
@@ -415,18 +828,56 @@ WriteDataToArchiveNone(ArchiveHandle *AH, CompressorState *cs,
 /*
  * cfp represents an open stream, wrapping the underlying FILE or gzFile
  * pointer. This is opaque to the callers.
+ *
+ * For LZ4 and zstd, we do the (de)compression ourselves, and read and write
+ * the underlying file through uncompressedfp.
  */
 struct cfp
 {
+	pg_compress_algorithm algorithm;
 	FILE	   *uncompressedfp;
 #ifdef HAVE_LIBZ
 	gzFile		compressedfp;
 #endif
+#ifdef USE_LZ4
+	LZ4F_cctx  *lz4cctx;
+	LZ4F_dctx  *lz4dctx;
+#endif
+#ifdef USE_ZSTD
+	ZSTD_CCtx  *zstdcctx;
+	ZSTD_DCtx  *zstddctx;
+#endif
+
+	/*
+	 * Buffers for LZ4 and zstd.  When writing, outBuf holds compressed data
+	 * to be written to the file.  When reading, inBuf holds compressed data
+	 * read from the file, and outBuf holds decompressed data not yet returned
+	 * to the caller.
+	 */
+	char	   *inBuf;
+	size_t		inSize;
+	size_t		inPos;
+	size_t		inLen;
+	char	   *outBuf;
+	size_t		outSize;
+	size_t		outPos;
+	size_t		outLen;
+	bool		eof;			/* no more decompressed data */
 };
 
-#ifdef HAVE_LIBZ
+/* Does this stream do its own LZ4 or zstd (de)compression? */
+#define CFP_IS_FRAMED(fp) \
+	((fp)->algorithm == PG_COMPRESSION_LZ4 || \
+	 (fp)->algorithm == PG_COMPRESSION_ZSTD)
+
 static int	hasSuffix(const char *filename, const char *suffix);
-#endif
+static const char *compressionSuffix(pg_compress_algorithm algorithm);
+static bool cfopen_framed(cfp *fp, const char *mode,
+						  const pg_compress_specification compression_spec);
+static bool cffill_framed(cfp *fp);
+static size_t cfread_framed(void *ptr, size_t size, cfp *fp);
+static size_t cfwrite_framed(const void *ptr, size_t size, cfp *fp);
+static bool cfflush_framed(cfp *fp);
 
 /* free() without changing errno; useful in several places below */
 static void
@@ -442,35 +893,49 @@ free_keep_errno(void *p)
  * Open a file for reading. 'path' is the file to open, and 'mode' should
  * be either "r" or "rb".
  *
- * If the file at 'path' does not exist, we append the ".gz" suffix (if 'path'
- * doesn't already have it) and try again. So if you pass "foo" as 'path',
- * this will open either "foo" or "foo.gz".
+ * If 'path' has one of the suffixes of the supported compression algorithms,
+ * the file is decompressed with that algorithm.  Otherwise, if the file at
+ * 'path' does not exist, we append the ".gz", ".lz4" and ".zst" suffixes in
+ * turn and try again, skipping algorithms not supported by this build.  So
+ * if you pass "foo" as 'path', this will open "foo", "foo.gz", "foo.lz4" or
+ * "foo.zst".
  *
  * On failure, return NULL with an error code in errno.
  */
 cfp *
 cfopen_read(const char *path, const char *mode)
 {
+	static const pg_compress_algorithm algorithms[] = {
+		PG_COMPRESSION_GZIP, PG_COMPRESSION_LZ4, PG_COMPRESSION_ZSTD
+	};
+	pg_compress_specification compression_spec = {0};
 	cfp		   *fp;
+	int			i;
 
-#ifdef HAVE_LIBZ
-	if (hasSuffix(path, ".gz"))
-		fp = cfopen(path, mode, 1);
-	else
-#endif
+	for (i = 0; i < lengthof(algorithms); i++)
 	{
-		fp = cfopen(path, mode, 0);
-#ifdef HAVE_LIBZ
-		if (fp == NULL)
+		if (hasSuffix(path, compressionSuffix(algorithms[i])))
 		{
-			char	   *fname;
-
-			fname = psprintf("%s.gz", path);
-			fp = cfopen(fname, mode, 1);
-			free_keep_errno(fname);
+			compression_spec.algorithm = algorithms[i];
+			return cfopen(path, mode, compression_spec);
 		}
-#endif
 	}
+
+	fp = cfopen(path, mode, compression_spec);
+
+	for (i = 0; i < lengthof(algorithms) && fp == NULL; i++)
+	{
+		char	   *fname;
+
+		compression_spec.algorithm = algorithms[i];
+		if (supports_compression(compression_spec) != NULL)
+			continue;
+
+		fname = psprintf("%s%s", path, compressionSuffix(algorithms[i]));
+		fp = cfopen(fname, mode, compression_spec);
+		free_keep_errno(fname);
+	}
+
 	return fp;
 }
 
@@ -479,56 +944,63 @@ cfopen_read(const char *path, const char *mode)
  * be a filemode as accepted by fopen() and gzopen() that indicates writing
  * ("w", "wb", "a", or "ab").
  *
- * If 'compression' is non-zero, a gzip compressed stream is opened, and
- * 'compression' indicates the compression level used. The ".gz" suffix
- * is automatically added to 'path' in that case.
+ * If 'compression_spec' specifies compression, a compressed stream is opened
+ * with the given algorithm and level, and the matching suffix (".gz", ".lz4"
+ * or ".zst") is automatically added to 'path'.
  *
  * On failure, return NULL with an error code in errno.
  */
 cfp *
-cfopen_write(const char *path, const char *mode, int compression)
+cfopen_write(const char *path, const char *mode,
+			 const pg_compress_specification compression_spec)
 {
 	cfp		   *fp;
 
-	if (compression == 0)
-		fp = cfopen(path, mode, 0);
+	if (compression_spec.algorithm == PG_COMPRESSION_NONE)
+		fp = cfopen(path, mode, compression_spec);
 	else
 	{
-#ifdef HAVE_LIBZ
 		char	   *fname;
 
-		fname = psprintf("%s.gz", path);
-		fp = cfopen(fname, mode, compression);
+		fname = psprintf("%s%s", path,
+						 compressionSuffix(compression_spec.algorithm));
+		fp = cfopen(fname, mode, compression_spec);
 		free_keep_errno(fname);
-#else
-		pg_fatal("not built with zlib support");
-		fp = NULL;				/* keep compiler quiet */
-#endif
 	}
 	return fp;
 }
 
 /*
- * Opens file 'path' in 'mode'. If 'compression' is non-zero, the file
- * is opened with libz gzopen(), otherwise with plain fopen().
+ * Opens file 'path' in 'mode'. If 'compression_spec' specifies gzip, the file
+ * is opened with libz gzopen(); otherwise it is opened with plain fopen(),
+ * and LZ4 or zstd (de)compression is done here if requested.
  *
  * On failure, return NULL with an error code in errno.
  */
 cfp *
-cfopen(const char *path, const char *mode, int compression)
+cfopen(const char *path, const char *mode,
+	   const pg_compress_specification compression_spec)
 {
-	cfp		   *fp = pg_malloc(sizeof(cfp));
+	cfp		   *fp;
+	char	   *error_detail;
+
+	error_detail = supports_compression(compression_spec);
+	if (error_detail != NULL)
+		pg_fatal("%s", error_detail);
 
-	if (compression != 0)
+	fp = pg_malloc0(sizeof(cfp));
+	fp->algorithm = compression_spec.algorithm;
+
+	if (compression_spec.algorithm == PG_COMPRESSION_GZIP)
 	{
 #ifdef HAVE_LIBZ
-		if (compression != Z_DEFAULT_COMPRESSION)
+		if (compression_spec.level != Z_DEFAULT_COMPRESSION)
 		{
 			/* user has specified a compression level, so tell zlib to use it */
 			char		mode_compression[32];
 
 			snprintf(mode_compression, sizeof(mode_compression), "%s%d",
-					 mode, compression);
+					 mode, compression_spec.level);
 			fp->compressedfp = gzopen(path, mode_compression);
 		}
 		else
@@ -537,27 +1009,31 @@ cfopen(const char *path, const char *mode, int compression)
 			fp->compressedfp = gzopen(path, mode);
 		}
 
-		fp->uncompressedfp = NULL;
 		if (fp->compressedfp == NULL)
 		{
 			free_keep_errno(fp);
 			fp = NULL;
 		}
-#else
-		pg_fatal("not built with zlib support");
 #endif
 	}
 	else
 	{
-#ifdef HAVE_LIBZ
-		fp->compressedfp = NULL;
-#endif
 		fp->uncompressedfp = fopen(path, mode);
 		if (fp->uncompressedfp == NULL)
 		{
 			free_keep_errno(fp);
 			fp = NULL;
 		}
+		else if (CFP_IS_FRAMED(fp) &&
+				 !cfopen_framed(fp, mode, compression_spec))
+		{
+			int			save_errno = errno;
+
+			fclose(fp->uncompressedfp);
+			free(fp);
+			errno = save_errno;
+			fp = NULL;
+		}
 	}
 
 	return fp;
@@ -587,6 +1063,9 @@ cfread(void *ptr, int size, cfp *fp)
 	}
 	else
 #endif
+	if (CFP_IS_FRAMED(fp))
+		ret = cfread_framed(ptr, size, fp);
+	else
 	{
 		ret = fread(ptr, 1, size, fp->uncompressedfp);
 		if (ret != size && !feof(fp->uncompressedfp))
@@ -603,6 +1082,9 @@ cfwrite(const void *ptr, int size, cfp *fp)
 		return gzwrite(fp->compressedfp, ptr, size);
 	else
 #endif
+	if (CFP_IS_FRAMED(fp))
+		return cfwrite_framed(ptr, size, fp);
+	else
 		return fwrite(ptr, 1, size, fp->uncompressedfp);
 }
 
@@ -625,6 +1107,15 @@ cfgetc(cfp *fp)
 	}
 	else
 #endif
+	if (CFP_IS_FRAMED(fp))
+	{
+		unsigned char c;
+
+		if (cfread_framed(&c, 1, fp) != 1)
+			pg_fatal("could not read from input file: end of file");
+		ret = c;
+	}
+	else
 	{
 		ret = fgetc(fp->uncompressedfp);
 		if (ret == EOF)
@@ -642,6 +1133,27 @@ cfgets(cfp *fp, char *buf, int len)
 		return gzgets(fp->compressedfp, buf, len);
 	else
 #endif
+	if (CFP_IS_FRAMED(fp))
+	{
+		int			i = 0;
+
+		/* like fgets(), stop after a newline or when the buffer is full */
+		while (i < len - 1)
+		{
+			unsigned char c;
+
+			if (cfread_framed(&c, 1, fp) != 1)
+				break;
+			buf[i++] = c;
+			if (c == '\n')
+				break;
+		}
+		if (i == 0)
+			return NULL;
+		buf[i] = '\0';
+		return buf;
+	}
+	else
 		return fgets(buf, len, fp->uncompressedfp);
 }
 
@@ -663,6 +1175,22 @@ cfclose(cfp *fp)
 	}
 	else
 #endif
+	if (CFP_IS_FRAMED(fp))
+	{
+		bool		flushed = cfflush_framed(fp);
+		int			save_errno = errno;
+
+		result = fclose(fp->uncompressedfp);
+		fp->uncompressedfp = NULL;
+		if (!flushed)
+		{
+			errno = save_errno;
+			result = EOF;
+		}
+		free_keep_errno(fp->inBuf);
+		free_keep_errno(fp->outBuf);
+	}
+	else
 	{
 		result = fclose(fp->uncompressedfp);
 		fp->uncompressedfp = NULL;
@@ -680,6 +1208,9 @@ cfeof(cfp *fp)
 		return gzeof(fp->compressedfp);
 	else
 #endif
+	if (CFP_IS_FRAMED(fp))
+		return fp->eof;
+	else
 		return feof(fp->uncompressedfp);
 }
 
@@ -699,7 +1230,6 @@ get_cfp_error(cfp *fp)
 	return strerror(errno);
 }
 
-#ifdef HAVE_LIBZ
 static int
 hasSuffix(const char *filename, const char *suffix)
 {
@@ -714,4 +1244,306 @@ hasSuffix(const char *filename, const char *suffix)
 				  suffixlen) == 0;
 }
 
+/*
+ * File name suffix used for files compressed with the given algorithm.
+ */
+static const char *
+compressionSuffix(pg_compress_algorithm algorithm)
+{
+	switch (algorithm)
+	{
+		case PG_COMPRESSION_NONE:
+			return "";
+		case PG_COMPRESSION_GZIP:
+			return ".gz";
+		case PG_COMPRESSION_LZ4:
+			return ".lz4";
+		case PG_COMPRESSION_ZSTD:
+			return ".zst";
+	}
+	return "";					/* keep compiler quiet */
+}
+
+/*
+ * Set up LZ4 or zstd (de)compression on a newly opened stream.  When writing
+ * with LZ4, the frame header is written immediately.
+ *
+ * Returns false with an error code in errno if writing the header failed.
+ */
+static bool
+cfopen_framed(cfp *fp, const char *mode,
+			  const pg_compress_specification compression_spec)
+{
+	bool		reading = (mode[0] == 'r');
+
+#ifdef USE_LZ4
+	if (fp->algorithm == PG_COMPRESSION_LZ4)
+	{
+		LZ4F_errorCode_t status;
+
+		if (reading)
+		{
+			status = LZ4F_createDecompressionContext(&fp->lz4dctx,
+													 LZ4F_VERSION);
+			if (LZ4F_isError(status))
+				pg_fatal("could not initialize compression library: %s",
+						 LZ4F_getErrorName(status));
+			fp->inSize = LZ4_IN_SIZE;
+			fp->outSize = LZ4_OUT_SIZE;
+		}
+		else
+		{
+			LZ4F_preferences_t prefs;
+			size_t		len;
+
+			memset(&prefs, 0, sizeof(prefs));
+			prefs.compressionLevel = compression_spec.level;
+
+			status = LZ4F_createCompressionContext(&fp->lz4cctx,
+												   LZ4F_VERSION);
+			if (LZ4F_isError(status))
+				pg_fatal("could not initialize compression library: %s",
+						 LZ4F_getErrorName(status));
+			fp->outSize = LZ4F_compressBound(LZ4_IN_SIZE, &prefs);
+			fp->outBuf = pg_malloc(fp->outSize);
+
+			len = LZ4F_compressBegin(fp->lz4cctx, fp->outBuf, fp->outSize,
+									 &prefs);
+			if (LZ4F_isError(len))
+				pg_fatal("could not compress data: %s",
+						 LZ4F_getErrorName(len));
+			if (fwrite(fp->outBuf, 1, len, fp->uncompressedfp) != len)
+			{
+				LZ4F_freeCompressionContext(fp->lz4cctx);
+				free_keep_errno(fp->outBuf);
+				return false;
+			}
+		}
+	}
+#endif
+#ifdef USE_ZSTD
+	if (fp->algorithm == PG_COMPRESSION_ZSTD)
+	{
+		if (reading)
+		{
+			fp->zstddctx = ZSTD_createDCtx();
+			if (fp->zstddctx == NULL)
+				pg_fatal("could not initialize compression library");
+			fp->inSize = ZSTD_DStreamInSize();
+			fp->outSize = ZSTD_DStreamOutSize();
+		}
+		else
+		{
+			fp->zstdcctx = CreateZstdCCtx(compression_spec);
+			fp->outSize = ZSTD_CStreamOutSize();
+			fp->outBuf = pg_malloc(fp->outSize);
+		}
+	}
+#endif
+
+	if (reading)
+	{
+		fp->inBuf = pg_malloc(fp->inSize);
+		fp->outBuf = pg_malloc(fp->outSize);
+	}
+
+	return true;
+}
+
+/*
+ * Decompress more data into outBuf, reading more input from the file as
+ * needed.  Returns false at the end of the decompressed stream.
+ */
+static bool
+cffill_framed(cfp *fp)
+{
+	for (;;)
+	{
+		size_t		produced = 0;
+
+		/* Refill the input buffer once it's been consumed */
+		if (fp->inPos == fp->inLen)
+		{
+			fp->inLen = fread(fp->inBuf, 1, fp->inSize, fp->uncompressedfp);
+			fp->inPos = 0;
+			if (fp->inLen == 0 && ferror(fp->uncompressedfp))
+				READ_ERROR_EXIT(fp->uncompressedfp);
+		}
+
+#ifdef USE_LZ4
+		if (fp->algorithm == PG_COMPRESSION_LZ4)
+		{
+			size_t		outlen = fp->outSize;
+			size_t		inlen = fp->inLen - fp->inPos;
+			size_t		status;
+
+			status = LZ4F_decompress(fp->lz4dctx, fp->outBuf, &outlen,
+									 fp->inBuf + fp->inPos, &inlen, NULL);
+			if (LZ4F_isError(status))
+				pg_fatal("could not uncompress data: %s",
+						 LZ4F_getErrorName(status));
+			fp->inPos += inlen;
+			produced = outlen;
+		}
+#endif
+#ifdef USE_ZSTD
+		if (fp->algorithm == PG_COMPRESSION_ZSTD)
+		{
+			ZSTD_inBuffer input = {fp->inBuf, fp->inLen, fp->inPos};
+			ZSTD_outBuffer output = {fp->outBuf, fp->outSize, 0};
+			size_t		ret;
+
+			ret = ZSTD_decompressStream(fp->zstddctx, &output, &input);
+			if (ZSTD_isError(ret))
+				pg_fatal("could not uncompress data: %s",
+						 ZSTD_getErrorName(ret));
+			fp->inPos = input.pos;
+			produced = output.pos;
+		}
+#endif
+
+		fp->outPos = 0;
+		fp->outLen = produced;
+		if (produced > 0)
+			return true;
+
+		/* No output, and the file has no more input: we're done */
+		if (fp->inLen == 0)
+		{
+			fp->eof = true;
+			return false;
+		}
+	}
+}
+
+static size_t
+cfread_framed(void *ptr, size_t size, cfp *fp)
+{
+	size_t		done = 0;
+
+	while (done < size)
+	{
+		size_t		n;
+
+		if (fp->outPos == fp->outLen && !cffill_framed(fp))
+			break;
+
+		n = Min(size - done, fp->outLen - fp->outPos);
+		memcpy((char *) ptr + done, fp->outBuf + fp->outPos, n);
+		fp->outPos += n;
+		done += n;
+	}
+
+	return done;
+}
+
+/*
+ * Compress data and write it to the file.  Returns the number of input bytes
+ * consumed, which is less than 'size' only if writing to the file failed.
+ */
+static size_t
+cfwrite_framed(const void *ptr, size_t size, cfp *fp)
+{
+#ifdef USE_LZ4
+	if (fp->algorithm == PG_COMPRESSION_LZ4)
+	{
+		size_t		done = 0;
+
+		while (done < size)
+		{
+			size_t		chunk = Min(size - done, LZ4_IN_SIZE);
+			size_t		len;
+
+			len = LZ4F_compressUpdate(fp->lz4cctx, fp->outBuf, fp->outSize,
+									  (const char *) ptr + done, chunk, NULL);
+			if (LZ4F_isError(len))
+				pg_fatal("could not compress data: %s",
+						 LZ4F_getErrorName(len));
+			if (fwrite(fp->outBuf, 1, len, fp->uncompressedfp) != len)
+				return done;
+			done += chunk;
+		}
+	}
 #endif
+#ifdef USE_ZSTD
+	if (fp->algorithm == PG_COMPRESSION_ZSTD)
+	{
+		ZSTD_inBuffer input = {ptr, size, 0};
+
+		while (input.pos < input.size)
+		{
+			ZSTD_outBuffer output = {fp->outBuf, fp->outSize, 0};
+			size_t		done = input.pos;
+			size_t		ret;
+
+			ret = ZSTD_compressStream2(fp->zstdcctx, &output, &input,
+									   ZSTD_e_continue);
+			if (ZSTD_isError(ret))
+				pg_fatal("could not compress data: %s",
+						 ZSTD_getErrorName(ret));
+			if (fwrite(fp->outBuf, 1, output.pos, fp->uncompressedfp) !=
+				output.pos)
+				return done;
+		}
+	}
+#endif
+
+	return size;
+}
+
+/*
+ * Finish the compressed stream, if writing, and release the (de)compression
+ * contexts.  Returns false with an error code in errno if writing the end of
+ * the stream failed.
+ */
+static bool
+cfflush_framed(cfp *fp)
+{
+	bool		ok = true;
+
+#ifdef USE_LZ4
+	if (fp->lz4cctx != NULL)
+	{
+		size_t		len;
+
+		len = LZ4F_compressEnd(fp->lz4cctx, fp->outBuf, fp->outSize, NULL);
+		if (LZ4F_isError(len))
+			pg_fatal("could not end compression: %s",
+					 LZ4F_getErrorName(len));
+		if (fwrite(fp->outBuf, 1, len, fp->uncompressedfp) != len)
+			ok = false;
+		LZ4F_freeCompressionContext(fp->lz4cctx);
+	}
+	if (fp->lz4dctx != NULL)
+		LZ4F_freeDecompressionContext(fp->lz4dctx);
+#endif
+#ifdef USE_ZSTD
+	if (fp->zstdcctx != NULL)
+	{
+		ZSTD_inBuffer input = {NULL, 0, 0};
+		size_t		ret;
+
+		do
+		{
+			ZSTD_outBuffer output = {fp->outBuf, fp->outSize, 0};
+
+			ret = ZSTD_compressStream2(fp->zstdcctx, &output, &input,
+									   ZSTD_e_end);
+			if (ZSTD_isError(ret))
+				pg_fatal("could not compress data: %s",
+						 ZSTD_getErrorName(ret));
+			if (fwrite(fp->outBuf, 1, output.pos, fp->uncompressedfp) !=
+				output.pos)
+			{
+				ok = false;
+				break;
+			}
+		} while (ret != 0);
+		ZSTD_freeCCtx(fp->zstdcctx);
+	}
+	if (fp->zstddctx != NULL)
+		ZSTD_freeDCtx(fp->zstddctx);
+#endif
+
+	return ok;
+}
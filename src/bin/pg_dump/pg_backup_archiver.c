@@ -31,6 +31,7 @@
 #endif
 
 #include "common/string.h"
+#include "compress_io.h"
 #include "dumputils.h"
 #include "fe_utils/string_utils.h"
 #include "lib/stringinfo.h"
@@ -70,7 +71,8 @@ typedef struct _parallelReadyList
 
 
 static ArchiveHandle *_allocAH(const char *FileSpec, const ArchiveFormat fmt,
-							   const int compression, bool dosync, ArchiveMode mode,
+							   const pg_compress_specification compression_spec,
+							   bool dosync, ArchiveMode mode,
 							   SetupWorkerPtrType setupWorkerPtr);
 static void _getObjectDescription(PQExpBuffer buf, TocEntry *te);
 static void _printTocEntry(ArchiveHandle *AH, TocEntry *te, bool isData);
@@ -239,11 +241,12 @@ setupRestoreWorker(Archive *AHX)
 /* Public */
 Archive *
 CreateArchive(const char *FileSpec, const ArchiveFormat fmt,
-			  const int compression, bool dosync, ArchiveMode mode,
+			  const pg_compress_specification compression_spec,
+			  bool dosync, ArchiveMode mode,
 			  SetupWorkerPtrType setupDumpWorker)
 
 {
-	ArchiveHandle *AH = _allocAH(FileSpec, fmt, compression, dosync,
+	ArchiveHandle *AH = _allocAH(FileSpec, fmt, compression_spec, dosync,
 								 mode, setupDumpWorker);
 
 	return (Archive *) AH;
@@ -254,7 +257,9 @@ CreateArchive(const char *FileSpec, const ArchiveFormat fmt,
 Archive *
 OpenArchive(const char *FileSpec, const ArchiveFormat fmt)
 {
-	ArchiveHandle *AH = _allocAH(FileSpec, fmt, 0, true, archModeRead, setupRestoreWorker);
+	pg_compress_specification compression_spec = {0};
+	ArchiveHandle *AH = _allocAH(FileSpec, fmt, compression_spec, true,
+								 archModeRead, setupRestoreWorker);
 
 	return (Archive *) AH;
 }
@@ -383,16 +388,20 @@ RestoreArchive(Archive *AHX)
 	/*
 	 * Make sure we won't need (de)compression we haven't got
 	 */
-#ifndef HAVE_LIBZ
-	if (AH->compression != 0 && AH->PrintTocDataPtr != NULL)
+	if (AH->PrintTocDataPtr != NULL)
 	{
-		for (te = AH->toc->next; te != AH->toc; te = te->next)
+		char	   *errmsg = supports_compression(AH->compression_spec);
+
+		if (errmsg != NULL)
 		{
-			if (te->hadDumper && (te->reqs & REQ_DATA) != 0)
-				pg_fatal("cannot restore from compressed archive (compression not supported in this installation)");
+			for (te = AH->toc->next; te != AH->toc; te = te->next)
+			{
+				if (te->hadDumper && (te->reqs & REQ_DATA) != 0)
+					pg_fatal("cannot restore from compressed archive (%s)",
+							 errmsg);
+			}
 		}
 	}
-#endif
 
 	/*
 	 * Prepare index arrays, so we can assume we have them throughout restore.
@@ -1129,9 +1138,10 @@ PrintTOCSummary(Archive *AHX)
 		strcpy(stamp_str, "[unknown]");
 
 	ahprintf(AH, ";\n; Archive created at %s\n", stamp_str);
-	ahprintf(AH, ";     dbname: %s\n;     TOC Entries: %d\n;     Compression: %d\n",
+	ahprintf(AH, ";     dbname: %s\n;     TOC Entries: %d\n;     Compression: %s\n",
 			 sanitize_line(AH->archdbname, false),
-			 AH->tocCount, AH->compression);
+			 AH->tocCount,
+			 get_compress_algorithm_name(AH->compression_spec.algorithm));
 
 	switch (AH->format)
 	{
@@ -1512,8 +1522,14 @@ SetOutput(ArchiveHandle *AH, const char *filename, int compression)
 	{
 		char		fmode[14];
 
-		/* Don't use PG_BINARY_x since this is zlib */
-		sprintf(fmode, "wb%d", compression);
+		/*
+		 * Don't use PG_BINARY_x since this is zlib.  Only specify a level if
+		 * the user did; "wb-1" would be read as level 1.
+		 */
+		if (compression != Z_DEFAULT_COMPRESSION)
+			sprintf(fmode, "wb%d", compression);
+		else
+			strcpy(fmode, "wb");
 		if (fn >= 0)
 			AH->OF = gzdopen(dup(fn), fmode);
 		else
@@ -1819,8 +1835,12 @@ buildTocEntryArrays(ArchiveHandle *AH)
 	DumpId		maxDumpId = AH->maxDumpId;
 	TocEntry   *te;
 
+	DumpId	   *lastChunk;
+	DumpId		id;
+
 	AH->tocsByDumpId = (TocEntry **) pg_malloc0((maxDumpId + 1) * sizeof(TocEntry *));
 	AH->tableDataId = (DumpId *) pg_malloc0((maxDumpId + 1) * sizeof(DumpId));
+	AH->tableDataNextChunk = (DumpId *) pg_malloc0((maxDumpId + 1) * sizeof(DumpId));
 
 	for (te = AH->toc->next; te != AH->toc; te = te->next)
 	{
@@ -1830,14 +1850,28 @@ buildTocEntryArrays(ArchiveHandle *AH)
 
 		/* tocsByDumpId indexes all TOCs by their dump ID */
 		AH->tocsByDumpId[te->dumpId] = te;
+	}
 
-		/*
-		 * tableDataId provides the TABLE DATA item's dump ID for each TABLE
-		 * TOC entry that has a DATA item.  We compute this by reversing the
-		 * TABLE DATA item's dependency, knowing that a TABLE DATA item has
-		 * just one dependency and it is the TABLE item.
-		 */
-		if (strcmp(te->desc, "TABLE DATA") == 0 && te->nDeps > 0)
+	/*
+	 * tableDataId provides the TABLE DATA item's dump ID for each TABLE TOC
+	 * entry that has a DATA item.  We compute this by reversing the TABLE
+	 * DATA item's dependency, knowing that the first dependency of a TABLE
+	 * DATA item is the TABLE item.
+	 *
+	 * pg_dump may have split a large table's data into several TABLE DATA
+	 * items.  The first of them has the lowest dump ID, and the others also
+	 * depend on it.  We make tableDataId point to the first chunk and chain
+	 * the others from it through tableDataNextChunk; scanning in dump ID
+	 * order (rather than TOC order, which the user may have rearranged)
+	 * makes that easy.
+	 */
+	lastChunk = (DumpId *) pg_malloc0((maxDumpId + 1) * sizeof(DumpId));
+
+	for (id = 1; id <= maxDumpId; id++)
+	{
+		te = AH->tocsByDumpId[id];
+
+		if (te != NULL && strcmp(te->desc, "TABLE DATA") == 0 && te->nDeps > 0)
 		{
 			DumpId		tableId = te->dependencies[0];
 
@@ -1849,9 +1883,15 @@ buildTocEntryArrays(ArchiveHandle *AH)
 			if (tableId <= 0 || tableId > maxDumpId)
 				pg_fatal("bad table dumpId for TABLE DATA item");
 
-			AH->tableDataId[tableId] = te->dumpId;
+			if (AH->tableDataId[tableId] == 0)
+				AH->tableDataId[tableId] = te->dumpId;
+			else
+				AH->tableDataNextChunk[lastChunk[tableId]] = te->dumpId;
+			lastChunk[tableId] = te->dumpId;
 		}
 	}
+
+	free(lastChunk);
 }
 
 TocEntry *
@@ -2198,7 +2238,8 @@ _discoverArchiveFormat(ArchiveHandle *AH)
  */
 static ArchiveHandle *
 _allocAH(const char *FileSpec, const ArchiveFormat fmt,
-		 const int compression, bool dosync, ArchiveMode mode,
+		 const pg_compress_specification compression_spec,
+		 bool dosync, ArchiveMode mode,
 		 SetupWorkerPtrType setupWorkerPtr)
 {
 	ArchiveHandle *AH;
@@ -2249,7 +2290,7 @@ _allocAH(const char *FileSpec, const ArchiveFormat fmt,
 	AH->toc->prev = AH->toc;
 
 	AH->mode = mode;
-	AH->compression = compression;
+	AH->compression_spec = compression_spec;
 	AH->dosync = dosync;
 
 	memset(&(AH->sqlparse), 0, sizeof(AH->sqlparse));
@@ -2264,7 +2305,8 @@ _allocAH(const char *FileSpec, const ArchiveFormat fmt,
 	 * Force stdin/stdout into binary mode if that is what we are using.
 	 */
 #ifdef WIN32
-	if ((fmt != archNull || compression != 0) &&
+	if ((fmt != archNull ||
+		 compression_spec.algorithm != PG_COMPRESSION_NONE) &&
 		(AH->fSpec == NULL || strcmp(AH->fSpec, "") == 0))
 	{
 		if (mode == archModeWrite)
@@ -3705,7 +3747,8 @@ WriteHead(ArchiveHandle *AH)
 	AH->WriteBytePtr(AH, AH->intSize);
 	AH->WriteBytePtr(AH, AH->offSize);
 	AH->WriteBytePtr(AH, AH->format);
-	WriteInt(AH, AH->compression);
+	WriteInt(AH, AH->compression_spec.level);
+	AH->WriteBytePtr(AH, AH->compression_spec.algorithm);
 	crtm = *localtime(&AH->createDate);
 	WriteInt(AH, crtm.tm_sec);
 	WriteInt(AH, crtm.tm_min);
@@ -3726,6 +3769,7 @@ ReadHead(ArchiveHandle *AH)
 				vmin,
 				vrev;
 	int			fmt;
+	char	   *errmsg;
 
 	/*
 	 * If we haven't already read the header, do so.
@@ -3779,17 +3823,27 @@ ReadHead(ArchiveHandle *AH)
 	if (AH->version >= K_VERS_1_2)
 	{
 		if (AH->version < K_VERS_1_4)
-			AH->compression = AH->ReadBytePtr(AH);
+			AH->compression_spec.level = AH->ReadBytePtr(AH);
 		else
-			AH->compression = ReadInt(AH);
+			AH->compression_spec.level = ReadInt(AH);
+
+		if (AH->version >= K_VERS_1_16)
+			AH->compression_spec.algorithm = AH->ReadBytePtr(AH);
+		else if (AH->compression_spec.level != 0)
+			AH->compression_spec.algorithm = PG_COMPRESSION_GZIP;
+		else
+			AH->compression_spec.algorithm = PG_COMPRESSION_NONE;
 	}
 	else
-		AH->compression = Z_DEFAULT_COMPRESSION;
+	{
+		AH->compression_spec.algorithm = PG_COMPRESSION_GZIP;
+		AH->compression_spec.level = Z_DEFAULT_COMPRESSION;
+	}
 
-#ifndef HAVE_LIBZ
-	if (AH->compression != 0)
-		pg_log_warning("archive is compressed, but this installation does not support compression -- no data will be available");
-#endif
+	errmsg = supports_compression(AH->compression_spec);
+	if (errmsg != NULL)
+		pg_log_warning("archive is compressed, but this installation does not support compression (%s) -- no data will be available",
+					   errmsg);
 
 	if (AH->version >= K_VERS_1_4)
 	{
@@ -4609,11 +4663,30 @@ repoint_table_dependencies(ArchiveHandle *AH)
 			{
 				DumpId		tabledataid = AH->tableDataId[olddep];
 				TocEntry   *tabledatate = AH->tocsByDumpId[tabledataid];
+				DumpId		chunkid;
 
 				te->dependencies[i] = tabledataid;
 				te->dataLength = Max(te->dataLength, tabledatate->dataLength);
 				pg_log_debug("transferring dependency %d -> %d to %d",
 							 te->dumpId, olddep, tabledataid);
+
+				/*
+				 * If the table's data was split into chunks, the item must
+				 * wait for all of them.  The added dependencies are appended
+				 * to the array, where this loop will skip over them since
+				 * they are not TABLE items.
+				 */
+				for (chunkid = AH->tableDataNextChunk[tabledataid];
+					 chunkid != 0;
+					 chunkid = AH->tableDataNextChunk[chunkid])
+				{
+					te->dependencies = pg_realloc_array(te->dependencies,
+														DumpId, te->nDeps + 1);
+					te->dependencies[te->nDeps++] = chunkid;
+					te->depCount++;
+					pg_log_debug("adding dependency %d -> %d",
+								 te->dumpId, chunkid);
+				}
 			}
 		}
 	}
@@ -4727,6 +4800,10 @@ reduce_dependencies(ArchiveHandle *AH, TocEntry *te,
 /*
  * Set the created flag on the DATA member corresponding to the given
  * TABLE member
+ *
+ * If the table's data was split into several chunks, only the first one is
+ * marked; the TRUNCATE issued along with it must not be repeated, and the
+ * other chunks wait for the first one anyway.
  */
 static void
 mark_create_done(ArchiveHandle *AH, TocEntry *te)
@@ -4749,9 +4826,11 @@ inhibit_data_for_failed_table(ArchiveHandle *AH, TocEntry *te)
 	pg_log_info("table \"%s\" could not be created, will not restore its data",
 				te->tag);
 
-	if (AH->tableDataId[te->dumpId] != 0)
+	for (DumpId chunkid = AH->tableDataId[te->dumpId];
+		 chunkid != 0;
+		 chunkid = AH->tableDataNextChunk[chunkid])
 	{
-		TocEntry   *ted = AH->tocsByDumpId[AH->tableDataId[te->dumpId]];
+		TocEntry   *ted = AH->tocsByDumpId[chunkid];
 
 		ted->reqs = 0;
 	}
@@ -55,6 +55,7 @@
 #include "catalog/pg_trigger_d.h"
 #include "catalog/pg_type_d.h"
 #include "common/connect.h"
+#include "compress_io.h"
 #include "dumputils.h"
 #include "fe_utils/option_utils.h"
 #include "fe_utils/string_utils.h"
@@ -129,6 +130,9 @@ static SimpleOidList extension_include_oids = {NULL, NULL};
 
 static const CatalogId nilCatalogId = {0, 0};
 
+/* --table-chunk-size, converted to pages of the server's block size */
+static BlockNumber table_chunk_pages = 0;
+
 /* override for standard extra_float_digits setting */
 static bool have_extra_float_digits = false;
 static int	extra_float_digits;
@@ -158,11 +162,19 @@ static int	nseclabels = 0;
 	fmtQualifiedId((obj)->dobj.namespace->dobj.name, \
 				   (obj)->dobj.name)
 
+/*
+ * Is this TableDataInfo one of several chunks of a table's data?
+ */
+#define IsTableDataChunk(tdinfo) \
+	((tdinfo)->chunkstart > 0 || (tdinfo)->chunkend > 0)
+
 static void help(const char *progname);
 static void setup_connection(Archive *AH,
 							 const char *dumpencoding, const char *dumpsnapshot,
 							 char *use_role);
 static ArchiveFormat parseArchiveFormat(const char *format, ArchiveMode *mode);
+static void parse_compress_option(const char *option,
+								  pg_compress_specification *compression_spec);
 static void expand_schema_name_patterns(Archive *fout,
 										SimpleStringList *patterns,
 										SimpleOidList *oids,
@@ -183,6 +195,9 @@ static void prohibit_crossdb_refs(PGconn *conn, const char *dbname,
 
 static NamespaceInfo *findNamespace(Oid nsoid);
 static void dumpTableData(Archive *fout, const TableDataInfo *tdinfo);
+static void dumpTableDataChunks(Archive *fout, const TableDataInfo *tdinfo,
+								const char *copyStmt, DataDumperPtr dumpFn);
+static void appendTableChunkQual(PQExpBuffer buf, const TableDataInfo *tdinfo);
 static void refreshMatViewData(Archive *fout, const TableDataInfo *tdinfo);
 static const char *getRoleName(const char *roleoid_str);
 static void collectRoleNames(Archive *fout);
@@ -339,7 +354,9 @@ main(int argc, char **argv)
 	const char *dumpsnapshot = NULL;
 	char	   *use_role = NULL;
 	int			numWorkers = 1;
-	int			compressLevel = -1;
+	pg_compress_specification compression_spec = {0};
+	bool		user_compression_defined = false;
+	char	   *error_detail;
 	int			plainText = 0;
 	ArchiveFormat archiveFormat = archUnknown;
 	ArchiveMode archiveMode;
@@ -412,6 +429,7 @@ main(int argc, char **argv)
 		{"on-conflict-do-nothing", no_argument, &dopt.do_nothing, 1},
 		{"rows-per-insert", required_argument, NULL, 10},
 		{"include-foreign-data", required_argument, NULL, 11},
+		{"table-chunk-size", required_argument, NULL, 12},
 
 		{NULL, 0, NULL, 0}
 	};
@@ -560,10 +578,9 @@ main(int argc, char **argv)
 				dopt.aclsSkip = true;
 				break;
 
-			case 'Z':			/* Compression Level */
-				if (!option_parse_int(optarg, "-Z/--compress", 0, 9,
-									  &compressLevel))
-					exit_nicely(1);
+			case 'Z':			/* Compression */
+				parse_compress_option(optarg, &compression_spec);
+				user_compression_defined = true;
 				break;
 
 			case 0:
@@ -622,6 +639,12 @@ main(int argc, char **argv)
 										  optarg);
 				break;
 
+			case 12:			/* table chunk size */
+				if (!option_parse_int(optarg, "--table-chunk-size", 1, INT_MAX,
+									  &dopt.table_chunk_size))
+					exit_nicely(1);
+				break;
+
 			default:
 				/* getopt_long already emitted a complaint */
 				pg_log_error_hint("Try \"%s --help\" for more information.", progname);
@@ -666,6 +689,9 @@ main(int argc, char **argv)
 	if (numWorkers > 1 && foreign_servers_include_patterns.head != NULL)
 		pg_fatal("option --include-foreign-data is not supported with parallel backup");
 
+	if (dopt.schemaOnly && dopt.table_chunk_size > 0)
+		pg_fatal("options -s/--schema-only and --table-chunk-size cannot be used together");
+
 	if (dopt.dataOnly && dopt.outputClean)
 		pg_fatal("options -c/--clean and -a/--data-only cannot be used together");
 
@@ -687,22 +713,37 @@ main(int argc, char **argv)
 		plainText = 1;
 
 	/* Custom and directory formats are compressed by default, others not */
-	if (compressLevel == -1)
+	if (!user_compression_defined)
 	{
 #ifdef HAVE_LIBZ
 		if (archiveFormat == archCustom || archiveFormat == archDirectory)
-			compressLevel = Z_DEFAULT_COMPRESSION;
-		else
+		{
+			compression_spec.algorithm = PG_COMPRESSION_GZIP;
+			compression_spec.level = Z_DEFAULT_COMPRESSION;
+		}
 #endif
-			compressLevel = 0;
 	}
 
 #ifndef HAVE_LIBZ
-	if (compressLevel != 0)
+	if (compression_spec.algorithm == PG_COMPRESSION_GZIP)
+	{
 		pg_log_warning("requested compression not available in this installation -- archive will be uncompressed");
-	compressLevel = 0;
+		compression_spec.algorithm = PG_COMPRESSION_NONE;
+		compression_spec.level = 0;
+	}
 #endif
 
+	error_detail = supports_compression(compression_spec);
+	if (error_detail != NULL)
+		pg_fatal("%s", error_detail);
+
+	/* Plain-text output can only be compressed with gzip */
+	if (archiveFormat == archNull &&
+		compression_spec.algorithm != PG_COMPRESSION_NONE &&
+		compression_spec.algorithm != PG_COMPRESSION_GZIP)
+		pg_fatal("compression with %s is not supported by plain-text format",
+				 get_compress_algorithm_name(compression_spec.algorithm));
+
 	/*
 	 * If emitting an archive format, we always want to emit a DATABASE item,
 	 * in case --create is specified at pg_restore time.
@@ -715,7 +756,7 @@ main(int argc, char **argv)
 		pg_fatal("parallel backup only supported by the directory format");
 
 	/* Open the output file */
-	fout = CreateArchive(filename, archiveFormat, compressLevel, dosync,
+	fout = CreateArchive(filename, archiveFormat, compression_spec, dosync,
 						 archiveMode, setupDumpWorker);
 
 	/* Make dump options accessible right away */
@@ -751,6 +792,28 @@ main(int argc, char **argv)
 	if (fout->isStandby)
 		dopt.no_unlogged_table_data = true;
 
+	/*
+	 * Table data chunks are read with ctid range quals, which need TID range
+	 * scans (added in v14) to avoid scanning the whole table for each chunk.
+	 */
+	if (dopt.table_chunk_size > 0)
+	{
+		PGresult   *res;
+		int			blcksz;
+
+		if (fout->remoteVersion < 140000)
+			pg_fatal("option --table-chunk-size is not supported by this server version");
+
+		res = ExecuteSqlQueryForSingleRow(fout,
+										  "SELECT pg_catalog.current_setting('block_size')");
+		blcksz = atoi(PQgetvalue(res, 0, 0));
+		PQclear(res);
+
+		table_chunk_pages = (BlockNumber)
+			Min((uint64) dopt.table_chunk_size * 1024 * 1024 / blcksz,
+				MaxBlockNumber);
+	}
+
 	/*
 	 * Find the last built-in OID, if needed (prior to 8.1)
 	 *
@@ -947,10 +1010,10 @@ main(int argc, char **argv)
 	ropt->sequence_data = dopt.sequence_data;
 	ropt->binary_upgrade = dopt.binary_upgrade;
 
-	if (compressLevel == -1)
-		ropt->compression = 0;
+	if (compression_spec.algorithm == PG_COMPRESSION_GZIP)
+		ropt->compression = compression_spec.level;
 	else
-		ropt->compression = compressLevel;
+		ropt->compression = 0;
 
 	ropt->suppressDumpWarnings = true;	/* We've already shown them */
 
@@ -997,7 +1060,8 @@ help(const char *progname)
 	printf(_("  -j, --jobs=NUM               use this many parallel jobs to dump\n"));
 	printf(_("  -v, --verbose                verbose mode\n"));
 	printf(_("  -V, --version                output version information, then exit\n"));
-	printf(_("  -Z, --compress=0-9           compression level for compressed formats\n"));
+	printf(_("  -Z, --compress=METHOD[:DETAIL]\n"
+			 "                               compress as specified\n"));
 	printf(_("  --lock-wait-timeout=TIMEOUT  fail after waiting TIMEOUT for a table lock\n"));
 	printf(_("  --no-sync                    do not wait for changes to be written safely to disk\n"));
 	printf(_("  -?, --help                   show this help, then exit\n"));
@@ -1049,6 +1113,8 @@ help(const char *progname)
 	printf(_("  --snapshot=SNAPSHOT          use given snapshot for the dump\n"));
 	printf(_("  --strict-names               require table and/or schema include patterns to\n"
 			 "                               match at least one entity each\n"));
+	printf(_("  --table-chunk-size=SIZE      dump data of tables larger than SIZE megabytes\n"
+			 "                               in separate chunks of that size\n"));
 	printf(_("  --use-set-session-authorization\n"
 			 "                               use SET SESSION AUTHORIZATION commands instead of\n"
 			 "                               ALTER OWNER commands to set ownership\n"));
@@ -1291,6 +1357,64 @@ parseArchiveFormat(const char *format, ArchiveMode *mode)
 	return archiveFormat;
 }
 
+/*
+ * Parse the argument of -Z/--compress.
+ *
+ * A bare integer is a gzip compression level, as in older releases, with 0
+ * meaning no compression.  Otherwise the argument is METHOD[:DETAIL], where
+ * DETAIL is either a level or a comma-separated list of options such as
+ * "level=3,workers=4", as accepted by parse_compress_specification().
+ */
+static void
+parse_compress_option(const char *option,
+					  pg_compress_specification *compression_spec)
+{
+	pg_compress_algorithm algorithm;
+	char	   *algorithm_str;
+	char	   *detail = NULL;
+	const char *sep;
+	char	   *error_detail;
+
+	if (option[0] == '-' || isdigit((unsigned char) option[0]))
+	{
+		int			level;
+
+		if (!option_parse_int(option, "-Z/--compress", 0, 9, &level))
+			exit_nicely(1);
+		if (level == 0)
+		{
+			compression_spec->algorithm = PG_COMPRESSION_NONE;
+			compression_spec->level = 0;
+		}
+		else
+		{
+			compression_spec->algorithm = PG_COMPRESSION_GZIP;
+			compression_spec->level = level;
+		}
+		return;
+	}
+
+	sep = strchr(option, ':');
+	if (sep == NULL)
+		algorithm_str = pg_strdup(option);
+	else
+	{
+		algorithm_str = pnstrdup(option, sep - option);
+		detail = pg_strdup(sep + 1);
+	}
+
+	if (!parse_compress_algorithm(algorithm_str, &algorithm))
+		pg_fatal("unrecognized compression algorithm: \"%s\"", algorithm_str);
+
+	parse_compress_specification(algorithm, detail, compression_spec);
+	error_detail = validate_compress_specification(compression_spec);
+	if (error_detail != NULL)
+		pg_fatal("invalid compression specification: %s", error_detail);
+
+	free(algorithm_str);
+	free(detail);
+}
+
 /*
  * Find the OIDs of all schemas matching the given list of patterns,
  * and append them to the given OID list.
@@ -1989,11 +2113,12 @@ dumpTableData_copy(Archive *fout, const void *dcontext)
 	column_list = fmtCopyColumnList(tbinfo, clistBuf);
 
 	/*
-	 * Use COPY (SELECT ...) TO when dumping a foreign table's data, and when
-	 * a filter condition was specified.  For other cases a simple COPY
-	 * suffices.
+	 * Use COPY (SELECT ...) TO when dumping a foreign table's data, when a
+	 * filter condition was specified, and when dumping one chunk of a table.
+	 * For other cases a simple COPY suffices.
 	 */
-	if (tdinfo->filtercond || tbinfo->relkind == RELKIND_FOREIGN_TABLE)
+	if (tdinfo->filtercond || tbinfo->relkind == RELKIND_FOREIGN_TABLE ||
+		IsTableDataChunk(tdinfo))
 	{
 		appendPQExpBufferStr(q, "COPY (SELECT ");
 		/* klugery to get rid of parens in column list */
@@ -2005,9 +2130,17 @@ dumpTableData_copy(Archive *fout, const void *dcontext)
 		else
 			appendPQExpBufferStr(q, "* ");
 
-		appendPQExpBuffer(q, "FROM %s %s) TO stdout;",
-						  fmtQualifiedDumpable(tbinfo),
-						  tdinfo->filtercond ? tdinfo->filtercond : "");
+		if (IsTableDataChunk(tdinfo))
+		{
+			appendPQExpBuffer(q, "FROM ONLY %s",
+							  fmtQualifiedDumpable(tbinfo));
+			appendTableChunkQual(q, tdinfo);
+			appendPQExpBufferStr(q, ") TO stdout;");
+		}
+		else
+			appendPQExpBuffer(q, "FROM %s %s) TO stdout;",
+							  fmtQualifiedDumpable(tbinfo),
+							  tdinfo->filtercond ? tdinfo->filtercond : "");
 	}
 	else
 	{
@@ -2164,6 +2297,8 @@ dumpTableData_insert(Archive *fout, const void *dcontext)
 					  fmtQualifiedDumpable(tbinfo));
 	if (tdinfo->filtercond)
 		appendPQExpBuffer(q, " %s", tdinfo->filtercond);
+	if (IsTableDataChunk(tdinfo))
+		appendTableChunkQual(q, tdinfo);
 
 	ExecuteSqlStatement(fout, q->data);
 
@@ -2452,8 +2587,19 @@ dumpTableData(Archive *fout, const TableDataInfo *tdinfo)
 	 * Note: although the TableDataInfo is a full DumpableObject, we treat its
 	 * dependency on its table as "special" and pass it to ArchiveEntry now.
 	 * See comments for BuildArchiveDependencies.
+	 *
+	 * Plain tables bigger than --table-chunk-size are dumped as several
+	 * TABLE DATA items, which are built by dumpTableDataChunks.
 	 */
-	if (tdinfo->dobj.dump & DUMP_COMPONENT_DATA)
+	if ((tdinfo->dobj.dump & DUMP_COMPONENT_DATA) &&
+		table_chunk_pages > 0 &&
+		tbinfo->relkind == RELKIND_RELATION &&
+		tdinfo->filtercond == NULL &&
+		(BlockNumber) tbinfo->relpages > table_chunk_pages)
+	{
+		dumpTableDataChunks(fout, tdinfo, copyStmt, dumpFn);
+	}
+	else if (tdinfo->dobj.dump & DUMP_COMPONENT_DATA)
 	{
 		TocEntry   *te;
 
@@ -2498,6 +2644,90 @@ dumpTableData(Archive *fout, const TableDataInfo *tdinfo)
 	destroyPQExpBuffer(clistBuf);
 }
 
+/*
+ * dumpTableDataChunks -
+ *	  make ArchiveEntries for the contents of a table split into page ranges
+ *
+ * Each chunk becomes a separate TABLE DATA item, so that parallel dump and
+ * parallel restore can process the chunks of one table concurrently.  Since
+ * parallel dump workers share a synchronized snapshot, the chunks together
+ * still form a consistent copy of the table.
+ *
+ * The first chunk reuses the TableDataInfo's dump ID, so that anything that
+ * depends on the table data still finds it.  The other chunks get fresh dump
+ * IDs and depend on the first chunk as well as on the table: if pg_restore
+ * created the table in the same run, it precedes the first chunk with a
+ * TRUNCATE, which must not wipe out rows already loaded by other chunks.
+ * The last chunk has no upper bound, so that pages added to the table since
+ * relpages was last updated are not missed.
+ */
+static void
+dumpTableDataChunks(Archive *fout, const TableDataInfo *tdinfo,
+					const char *copyStmt, DataDumperPtr dumpFn)
+{
+	TableInfo  *tbinfo = tdinfo->tdtable;
+	BlockNumber relpages = (BlockNumber) tbinfo->relpages;
+	BlockNumber toastpages = (BlockNumber) tbinfo->toastpages;
+	BlockNumber nchunks;
+	DumpId		deps[2];
+
+	nchunks = relpages / table_chunk_pages;
+	if (relpages % table_chunk_pages != 0)
+		nchunks++;
+
+	deps[0] = tbinfo->dobj.dumpId;
+	deps[1] = tdinfo->dobj.dumpId;
+
+	for (BlockNumber chunkno = 0; chunkno < nchunks; chunkno++)
+	{
+		TableDataInfo *chunk;
+		TocEntry   *te;
+
+		chunk = (TableDataInfo *) pg_malloc(sizeof(TableDataInfo));
+		memcpy(chunk, tdinfo, sizeof(TableDataInfo));
+		if (chunkno > 0)
+			chunk->dobj.dumpId = createDumpId();
+		chunk->chunkstart = chunkno * table_chunk_pages;
+		if (chunkno < nchunks - 1)
+			chunk->chunkend = chunk->chunkstart + table_chunk_pages;
+		else
+			chunk->chunkend = 0;
+
+		te = ArchiveEntry(fout, chunk->dobj.catId, chunk->dobj.dumpId,
+						  ARCHIVE_OPTS(.tag = tbinfo->dobj.name,
+									   .namespace = tbinfo->dobj.namespace->dobj.name,
+									   .owner = tbinfo->rolname,
+									   .description = "TABLE DATA",
+									   .section = SECTION_DATA,
+									   .copyStmt = copyStmt,
+									   .deps = deps,
+									   .nDeps = (chunkno == 0) ? 1 : 2,
+									   .dumpFn = dumpFn,
+									   .dumpArg = chunk));
+
+		/*
+		 * As in dumpTableData, dataLength is measured in pages.  We don't
+		 * know how the TOAST pages are distributed, so spread them evenly.
+		 */
+		te->dataLength = (chunk->chunkend > 0) ?
+			table_chunk_pages : relpages - chunk->chunkstart;
+		te->dataLength += toastpages / nchunks;
+	}
+}
+
+/*
+ * Append the WHERE clause selecting the pages of one chunk of a table's data.
+ */
+static void
+appendTableChunkQual(PQExpBuffer buf, const TableDataInfo *tdinfo)
+{
+	appendPQExpBuffer(buf, " WHERE ctid >= '(%u,0)'::pg_catalog.tid",
+					  tdinfo->chunkstart);
+	if (tdinfo->chunkend > 0)
+		appendPQExpBuffer(buf, " AND ctid < '(%u,0)'::pg_catalog.tid",
+						  tdinfo->chunkend);
+}
+
 /*
  * refreshMatViewData -
  *	  load or refresh the contents of a single materialized view
@@ -2615,6 +2845,8 @@ makeTableDataInfo(DumpOptions *dopt, TableInfo *tbinfo)
 	tdinfo->dobj.namespace = tbinfo->dobj.namespace;
 	tdinfo->tdtable = tbinfo;
 	tdinfo->filtercond = NULL;	/* might get set later */
+	tdinfo->chunkstart = 0;
+	tdinfo->chunkend = 0;
 	addObjectDependency(&tdinfo->dobj, tbinfo->dobj.dumpId);
 
 	/* A TableDataInfo contains data, of course */
@@ -4617,8 +4849,10 @@ dumpSubscription(Archive *fout, const SubscriptionInfo *subinfo)
 	if (strcmp(subinfo->subbinary, "t") == 0)
 		appendPQExpBufferStr(query, ", binary = true");
 
-	if (strcmp(subinfo->substream, "f") != 0)
+	if (strcmp(subinfo->substream, "t") == 0)
 		appendPQExpBufferStr(query, ", streaming = on");
+	else if (strcmp(subinfo->substream, "p") == 0)
+		appendPQExpBufferStr(query, ", streaming = parallel");
 
 	if (strcmp(subinfo->subtwophasestate, two_phase_disabled) != 0)
 		appendPQExpBufferStr(query, ", two_phase = on");
@@ -6344,8 +6578,28 @@ getTables(Archive *fout, int *numTables)
 						 CppAsString2(RELKIND_COMPOSITE_TYPE) ", "
 						 CppAsString2(RELKIND_MATVIEW) ", "
 						 CppAsString2(RELKIND_FOREIGN_TABLE) ", "
-						 CppAsString2(RELKIND_PARTITIONED_TABLE) ")\n"
-						 "ORDER BY c.oid");
+						 CppAsString2(RELKIND_PARTITIONED_TABLE) ")\n");
+
+	/*
+	 * Skip the change logs of incrementally maintained materialized views,
+	 * which are named pg_ivmlog_* and internally dependent on their view;
+	 * they are recreated along with the view.  Other tables with internal
+	 * dependencies are dumped as usual.
+	 */
+	if (fout->remoteVersion >= 160000)
+		appendPQExpBufferStr(query,
+							 "AND NOT (c.relkind = " CppAsString2(RELKIND_RELATION)
+							 " AND EXISTS (SELECT 1 FROM pg_depend ld"
+							 " WHERE ld.classid = 'pg_class'::regclass"
+							 " AND ld.objid = c.oid AND ld.objsubid = 0"
+							 " AND ld.refclassid = 'pg_class'::regclass"
+							 " AND ld.refobjsubid = 0 AND ld.deptype = 'i'"
+							 " AND c.relname LIKE 'pg\\_ivmlog\\_%'"
+							 " AND EXISTS (SELECT 1 FROM pg_class lv"
+							 " WHERE lv.oid = ld.refobjid AND lv.relkind = "
+							 CppAsString2(RELKIND_MATVIEW) ")))\n");
+
+	appendPQExpBufferStr(query, "ORDER BY c.oid");
 
 	res = ExecuteSqlQuery(fout, query->data, PGRES_TUPLES_OK);
 
@@ -381,6 +381,8 @@ typedef struct _tableDataInfo
 	DumpableObject dobj;
 	TableInfo  *tdtable;		/* link to table to dump */
 	char	   *filtercond;		/* WHERE condition to limit rows dumped */
+	uint32		chunkstart;		/* first page of a chunk of the table */
+	uint32		chunkend;		/* page after the chunk, or 0 for no limit */
 } TableDataInfo;
 
 typedef struct _indxInfo
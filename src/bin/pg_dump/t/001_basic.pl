@@ -62,6 +62,17 @@ command_fails_like(
 	'pg_dump: option --include-foreign-data is not supported with parallel backup'
 );
 
+command_fails_like(
+	[ 'pg_dump', '-s', '--table-chunk-size=1024' ],
+	qr/\Qpg_dump: error: options -s\/--schema-only and --table-chunk-size cannot be used together\E/,
+	'pg_dump: options -s/--schema-only and --table-chunk-size cannot be used together'
+);
+
+command_fails_like(
+	[ 'pg_dump', '--table-chunk-size=0' ],
+	qr/\Qpg_dump: error: --table-chunk-size must be in range\E/,
+	'pg_dump: --table-chunk-size must be in range');
+
 command_fails_like(
 	['pg_restore'],
 	qr{\Qpg_restore: error: one of -d/--dbname and -f/--file must be specified\E},
@@ -125,6 +136,16 @@ command_fails_like(
 	qr/\Qpg_dump: error: -Z\/--compress must be in range 0..9\E/,
 	'pg_dump: -Z/--compress must be in range');
 
+command_fails_like(
+	[ 'pg_dump', '--compress', 'garbage' ],
+	qr/\Qpg_dump: error: unrecognized compression algorithm: "garbage"\E/,
+	'pg_dump: unrecognized compression algorithm');
+
+command_fails_like(
+	[ 'pg_dump', '--compress', 'gzip:workers=2' ],
+	qr/\Qpg_dump: error: invalid compression specification: compression algorithm "gzip" does not accept a worker count\E/,
+	'pg_dump: invalid compression specification');
+
 if (check_pg_config("#define HAVE_LIBZ 1"))
 {
 	command_fails_like(
@@ -103,6 +103,69 @@ my %pgdump_runs = (
 		],
 	},
 
+	compression_lz4_custom => {
+		test_key       => 'compression',
+		compile_option => 'lz4',
+		dump_cmd       => [
+			'pg_dump',        '--format=custom',
+			'--compress=lz4', "--file=$tempdir/compression_lz4_custom.dump",
+			'postgres',
+		],
+		restore_cmd => [
+			'pg_restore',
+			"--file=$tempdir/compression_lz4_custom.sql",
+			"$tempdir/compression_lz4_custom.dump",
+		],
+	},
+
+	compression_lz4_dir => {
+		test_key       => 'compression',
+		compile_option => 'lz4',
+		dump_cmd       => [
+			'pg_dump',                             '--jobs=2',
+			'--format=directory',                  '--compress=lz4:1',
+			"--file=$tempdir/compression_lz4_dir", 'postgres',
+		],
+		restore_cmd => [
+			'pg_restore', '--jobs=2',
+			"--file=$tempdir/compression_lz4_dir.sql",
+			"$tempdir/compression_lz4_dir",
+		],
+	},
+
+	# zstd worker threads compress while the data is being received.
+	compression_zstd_custom => {
+		test_key       => 'compression',
+		compile_option => 'zstd',
+		dump_cmd       => [
+			'pg_dump', '--format=custom',
+			'--compress=zstd:workers=2',
+			"--file=$tempdir/compression_zstd_custom.dump",
+			'postgres',
+		],
+		restore_cmd => [
+			'pg_restore',
+			"--file=$tempdir/compression_zstd_custom.sql",
+			"$tempdir/compression_zstd_custom.dump",
+		],
+	},
+
+	compression_zstd_dir => {
+		test_key       => 'compression',
+		compile_option => 'zstd',
+		dump_cmd       => [
+			'pg_dump', '--jobs=2',
+			'--format=directory',
+			'--compress=zstd:level=3,workers=2',
+			"--file=$tempdir/compression_zstd_dir", 'postgres',
+		],
+		restore_cmd => [
+			'pg_restore', '--jobs=2',
+			"--file=$tempdir/compression_zstd_dir.sql",
+			"$tempdir/compression_zstd_dir",
+		],
+	},
+
 	compression_gzip_plain => {
 		test_key       => 'compression',
 		compile_option => 'gzip',
@@ -116,6 +179,23 @@ my %pgdump_runs = (
 			args    => [ '-d', "$tempdir/compression_gzip_plain.sql.gz", ],
 		},
 	},
+
+	# Without a level, zlib's default level is used.
+	compression_gzip_plain_default => {
+		test_key       => 'compression',
+		compile_option => 'gzip',
+		dump_cmd       => [
+			'pg_dump', '--format=plain', '--compress=gzip',
+			"--file=$tempdir/compression_gzip_plain_default.sql.gz",
+			'postgres',
+		],
+		# Decompress the generated file to run through the tests.
+		compress_cmd => {
+			program => $ENV{'GZIP_PROGRAM'},
+			args    =>
+			  [ '-d', "$tempdir/compression_gzip_plain_default.sql.gz", ],
+		},
+	},
 	clean => {
 		dump_cmd => [
 			'pg_dump',
@@ -2304,6 +2384,29 @@ my %tests = (
 		  { exclude_dump_test_schema => 1, no_toast_compression => 1, },
 	},
 
+	'CREATE MATERIALIZED VIEW matview_incremental' => {
+		create_order => 20,
+		create_sql   => 'CREATE MATERIALIZED VIEW
+						   dump_test.matview_incremental WITH (incremental) AS
+						   SELECT col1 FROM dump_test.test_table;',
+		regexp => qr/^
+			\QCREATE MATERIALIZED VIEW dump_test.matview_incremental\E
+			\n\QWITH (incremental='true') AS\E
+			\n\s+\QSELECT test_table.col1\E
+			\n\s+\QFROM dump_test.test_table\E
+			\n\s+\QWITH NO DATA;\E
+			/xm,
+		like =>
+		  { %full_runs, %dump_test_schema_runs, section_pre_data => 1, },
+		unlike => { exclude_dump_test_schema => 1, },
+	},
+
+	# The change logs of matview_incremental are recreated along with it
+	'change logs of matview_incremental' => {
+		regexp => qr/pg_ivmlog_/,
+		like   => {},
+	},
+
 	'CREATE POLICY p1 ON test_table' => {
 		create_order => 22,
 		create_sql   => 'CREATE POLICY p1 ON dump_test.test_table
@@ -3902,6 +4005,7 @@ if ($collation_check_stderr !~ /ERROR: /)
 my $supports_icu  = ($ENV{with_icu} eq 'yes');
 my $supports_lz4  = check_pg_config("#define USE_LZ4 1");
 my $supports_gzip = check_pg_config("#define HAVE_LIBZ 1");
+my $supports_zstd = check_pg_config("#define USE_ZSTD 1");
 
 # ICU doesn't work with some encodings
 my $encoding = $node->safe_psql('postgres', 'show server_encoding');
@@ -4102,13 +4206,18 @@ foreach my $run (sort keys %pgdump_runs)
 	my $test_key = $run;
 	my $run_db   = 'postgres';
 
-	# Skip command-level tests for gzip if there is no support for it.
-	if (   defined($pgdump_runs{$run}->{compile_option})
-		&& $pgdump_runs{$run}->{compile_option} eq 'gzip'
-		&& !$supports_gzip)
+	# Skip command-level tests for compression methods without support.
+	if (defined($pgdump_runs{$run}->{compile_option}))
 	{
-		note "$run: skipped due to no gzip support";
-		next;
+		my $compile_option = $pgdump_runs{$run}->{compile_option};
+
+		if (   ($compile_option eq 'gzip' && !$supports_gzip)
+			|| ($compile_option eq 'lz4'  && !$supports_lz4)
+			|| ($compile_option eq 'zstd' && !$supports_zstd))
+		{
+			note "$run: skipped due to no $compile_option support";
+			next;
+		}
 	}
 
 	$node->command_ok(\@{ $pgdump_runs{$run}->{dump_cmd} },
@@ -37,4 +37,37 @@ command_ok(
 	[ "pg_dump", '-p', $port, '-a', '--include-foreign-data=s2', 'postgres' ],
 	"dump foreign server with no tables");
 
+#########################################
+# Verify that a table dumped in several chunks is restored completely,
+# including with a parallel restore that truncates the new table
+
+$node->safe_psql('postgres', "CREATE DATABASE chunked_restore");
+$node->safe_psql('postgres',
+	"CREATE TABLE chunked (a int PRIMARY KEY, b text); "
+	  . "INSERT INTO chunked SELECT g, repeat('x', 100) FROM generate_series(1, 50000) g");
+$node->safe_psql('postgres', "VACUUM chunked");
+
+my $chunkdir = "$tempdir/chunked";
+command_ok(
+	[
+		"pg_dump", '-p', $port, '-Fd', '-j2', '-t', 'chunked',
+		'--table-chunk-size=1', '-f', $chunkdir, 'postgres'
+	],
+	"parallel dump with table chunks");
+
+($stdout, $stderr) = run_command([ "pg_restore", '-l', $chunkdir ]);
+my $nchunks = () = $stdout =~ /TABLE DATA public chunked/g;
+cmp_ok($nchunks, '>', 1, "table data was split into chunks");
+
+command_ok(
+	[
+		"pg_restore", '-p', $port, '-j2', '-d', 'chunked_restore',
+		$chunkdir
+	],
+	"parallel restore of table chunks");
+
+$result = $node->safe_psql('chunked_restore',
+	"SELECT count(*), count(DISTINCT a), sum(a) FROM chunked");
+is($result, '50000|50000|1250025000', "all chunks were restored");
+
 done_testing();
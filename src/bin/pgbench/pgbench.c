@@ -169,7 +169,7 @@ typedef struct socket_set
  * some configurable parameters */
 
 #define DEFAULT_INIT_STEPS "dtgvp"	/* default -I setting */
-#define ALL_INIT_STEPS "dtgGvpf"	/* all possible steps */
+#define ALL_INIT_STEPS "dtgGvpfw"	/* all possible steps */
 
 #define LOG_STEP_SECONDS	5	/* seconds between log messages */
 #define DEFAULT_NXACTS	10		/* default nxacts */
@@ -254,6 +254,10 @@ int64		random_seed = -1;
 #define ntellers	10
 #define naccounts	100000
 
+/* sizes of the tables of the contention workloads, see init step "w" */
+#define nhotrows	10			/* rows of pgbench_hot */
+#define neventparts	16			/* partitions of pgbench_events */
+
 /*
  * The scale factor at/beyond which 32bit integers are incapable of storing
  * 64bit values.
@@ -276,6 +280,10 @@ bool		is_connect;			/* establish connection for each transaction */
 bool		report_per_command = false; /* report per-command latencies,
 										 * retries after errors and failures
 										 * (errors without retrying) */
+bool		latency_percentiles = false;	/* collect latency histograms and
+											 * report percentiles */
+char	   *histogram_file_name = NULL; /* write histograms to this file */
+FILE	   *histogram_file = NULL;
 int			main_pid;			/* main process id used in log filename */
 
 /*
@@ -371,6 +379,33 @@ typedef struct SimpleStats
 	double		sum2;			/* sum of squared values */
 } SimpleStats;
 
+/*
+ * Latency histogram, in the style of HdrHistogram.  Values are recorded in
+ * microseconds, into buckets whose width grows with the magnitude of the
+ * value: values below HIST_SUB_BUCKETS have a bucket each, and every further
+ * power of two is split into HIST_SUB_BUCKETS / 2 buckets.  So any recorded
+ * value is known within 1/64 of its magnitude, which is plenty to compute
+ * high percentiles, while a histogram only needs a few kilobytes.  Values
+ * above HIST_MAX_VALUE (about 19 hours) are counted in the last bucket.
+ */
+#define HIST_SUB_BUCKET_BITS	7
+#define HIST_SUB_BUCKETS		(1 << HIST_SUB_BUCKET_BITS)
+#define HIST_MAX_MAGNITUDE		36
+#define HIST_MAX_VALUE			((INT64CONST(1) << HIST_MAX_MAGNITUDE) - 1)
+#define HIST_BUCKETS \
+	(HIST_SUB_BUCKETS + \
+	 (HIST_MAX_MAGNITUDE - HIST_SUB_BUCKET_BITS) * (HIST_SUB_BUCKETS / 2))
+
+typedef struct LatencyHistogram
+{
+	int64		count;			/* how many values were recorded */
+	int64		max;			/* the maximum seen */
+	int64		buckets[HIST_BUCKETS];
+} LatencyHistogram;
+
+/* percentiles shown in reports */
+static const double report_percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+
 /*
  * The instr_time type is expensive when dealing with time arithmetic.  Define
  * a type to hold microseconds instead.  Type int64 is good enough for about
@@ -449,6 +484,7 @@ typedef struct StatsData
 									 * error */
 	SimpleStats latency;
 	SimpleStats lag;
+	LatencyHistogram *histogram;	/* latencies, or NULL if not collected */
 } StatsData;
 
 /*
@@ -738,6 +774,7 @@ static const char *QUERYMODE[] = {"simple", "extended", "prepared"};
  * aset			do gset on all possible queries of a combined query (\;).
  * expr			Parsed expression, if needed.
  * stats		Time spent in this command.
+ * histogram	Histogram of the time spent in this command, if collected.
  * retries		Number of retries after a serialization or deadlock error in the
  *				current command.
  * failures		Number of errors in the current command that were not retried.
@@ -753,6 +790,7 @@ typedef struct Command
 	char	   *varprefix;
 	PgBenchExpr *expr;
 	SimpleStats stats;
+	LatencyHistogram *histogram;
 	int64		retries;
 	int64		failures;
 } Command;
@@ -770,6 +808,8 @@ static int	num_scripts;		/* number of scripts in sql_script[] */
 static int64 total_weight = 0;
 
 static bool verbose_errors = false; /* print verbose messages of all errors */
+static bool workload_tables_used = false;	/* a builtin script needs the
+											 * tables of init step "w" */
 
 /* Builtin test scripts */
 typedef struct BuiltinScript
@@ -777,6 +817,7 @@ typedef struct BuiltinScript
 	const char *name;			/* very short name for -b ... */
 	const char *desc;			/* short description */
 	const char *script;			/* actual pgbench script */
+	bool		workload_tables;	/* needs tables created by init step "w" */
 } BuiltinScript;
 
 static const BuiltinScript builtin_script[] =
@@ -814,6 +855,56 @@ static const BuiltinScript builtin_script[] =
 		"<builtin: select only>",
 		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
 		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+	},
+
+	/*
+	 * The following scripts each concentrate on one contention point, so that
+	 * scalability regressions there are easy to measure.  Most of them need
+	 * the tables created by initialization step "w".
+	 */
+	{
+		/* row locks and tuple updates on a handful of rows */
+		"hot-update",
+		"<builtin: hot row update>",
+		"\\set hid random(1, " CppAsString2(nhotrows) ")\n"
+		"UPDATE pgbench_hot SET counter = counter + 1 WHERE hid = :hid;\n",
+		true
+	},
+	{
+		/* WAL insertion, with wide rows spread over many partitions */
+		"partition-insert",
+		"<builtin: partitioned insert>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set tid random(1, " CppAsString2(ntellers) " * :scale)\n"
+		"\\set delta random(-5000, 5000)\n"
+		"INSERT INTO pgbench_events (aid, tid, delta, mtime, payload) VALUES (:aid, :tid, :delta, CURRENT_TIMESTAMP, repeat(md5(:aid::text), 16));\n",
+		true
+	},
+	{
+		/* relation extension, by many clients loading the same table */
+		"bulk-insert",
+		"<builtin: bulk insert>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"INSERT INTO pgbench_ingest (aid, payload) SELECT :aid + i, repeat('x', 100) FROM generate_series(1, 1000) AS i;\n",
+		true
+	},
+	{
+		/* snapshot acquisition, with many short read-only transactions */
+		"snapshot-read",
+		"<builtin: read-only snapshots>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set bid random(1, " CppAsString2(nbranches) " * :scale)\n"
+		"BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY;\n"
+		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+		"SELECT bbalance FROM pgbench_branches WHERE bid = :bid;\n"
+		"END;\n"
+	},
+	{
+		/* sorting a range of accounts fetched by key, larger than work_mem */
+		"large-sort",
+		"<builtin: large sort>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * (:scale - 1) + 1)\n"
+		"SELECT count(*) FROM (SELECT aid FROM pgbench_accounts WHERE aid BETWEEN :aid AND :aid + " CppAsString2(naccounts) " - 1 ORDER BY abalance DESC, aid DESC) AS s;\n"
 	}
 };
 
@@ -830,6 +921,8 @@ static void doLog(TState *thread, CState *st,
 				  StatsData *agg, bool skipped, double latency, double lag);
 static void processXactStats(TState *thread, CState *st, pg_time_usec_t *now,
 							 bool skipped, StatsData *agg);
+static void writeHistogram(FILE *file, const char *kind, int64 time,
+						   int script, int command, LatencyHistogram *h);
 static void addScript(const ParsedScript *script);
 static THREAD_FUNC_RETURN_TYPE THREAD_FUNC_CC threadRun(void *arg);
 static void finishCon(CState *st);
@@ -916,9 +1009,12 @@ usage(void)
 		   "  -v, --vacuum-all         vacuum all four standard tables before tests\n"
 		   "  --aggregate-interval=NUM aggregate data over NUM seconds\n"
 		   "  --failures-detailed      report the failures grouped by basic types\n"
+		   "  --histogram-file=FILENAME\n"
+		   "                           write latency histograms to FILENAME\n"
 		   "  --log-prefix=PREFIX      prefix for transaction time log file\n"
 		   "                           (default: \"pgbench_log\")\n"
 		   "  --max-tries=NUM          max number of tries to run transaction (default: 1)\n"
+		   "  --percentiles            report latency percentiles\n"
 		   "  --progress-timestamp     use Unix epoch timestamps for progress\n"
 		   "  --random-seed=SEED       set random seed (\"time\", \"rand\", integer)\n"
 		   "  --sampling-rate=NUM      fraction of transactions to log (e.g., 0.01 for 1%%)\n"
@@ -1435,9 +1531,200 @@ mergeSimpleStats(SimpleStats *acc, SimpleStats *ss)
 	acc->sum2 += ss->sum2;
 }
 
+/*
+ * Allocate a new, empty LatencyHistogram
+ */
+static LatencyHistogram *
+newHistogram(void)
+{
+	return (LatencyHistogram *) pg_malloc0(sizeof(LatencyHistogram));
+}
+
+/*
+ * Reset a LatencyHistogram to all zeroes
+ */
+static void
+resetHistogram(LatencyHistogram *h)
+{
+	memset(h, 0, sizeof(LatencyHistogram));
+}
+
+/*
+ * Return the bucket of a LatencyHistogram that counts the given value.
+ */
+static int
+histogramBucket(int64 value)
+{
+	int			shift;
+
+	if (value < HIST_SUB_BUCKETS)
+		return value < 0 ? 0 : (int) value;
+	if (value > HIST_MAX_VALUE)
+		value = HIST_MAX_VALUE;
+
+	/* keep the HIST_SUB_BUCKET_BITS most significant bits of the value */
+	shift = pg_leftmost_one_pos64(value) - HIST_SUB_BUCKET_BITS + 1;
+	return HIST_SUB_BUCKETS + (shift - 1) * (HIST_SUB_BUCKETS / 2) +
+		(int) (value >> shift) - HIST_SUB_BUCKETS / 2;
+}
+
+/*
+ * Return the lowest value counted in the given bucket.
+ */
+static int64
+histogramBucketLow(int bucket)
+{
+	int			shift;
+	int64		sub;
+
+	if (bucket < HIST_SUB_BUCKETS)
+		return bucket;
+
+	shift = (bucket - HIST_SUB_BUCKETS) / (HIST_SUB_BUCKETS / 2) + 1;
+	sub = (bucket - HIST_SUB_BUCKETS) % (HIST_SUB_BUCKETS / 2) +
+		HIST_SUB_BUCKETS / 2;
+	return sub << shift;
+}
+
+/*
+ * Return the highest value counted in the given bucket.
+ */
+static int64
+histogramBucketHigh(int bucket)
+{
+	if (bucket >= HIST_BUCKETS - 1)
+		return HIST_MAX_VALUE;
+	return histogramBucketLow(bucket + 1) - 1;
+}
+
+/*
+ * Record 'count' occurrences of a value, in microseconds.
+ */
+static void
+addToHistogram(LatencyHistogram *h, int64 value, int64 count)
+{
+	h->buckets[histogramBucket(value)] += count;
+	h->count += count;
+	if (value > h->max)
+		h->max = value;
+}
+
+/*
+ * Merge two LatencyHistogram objects
+ */
+static void
+mergeHistogram(LatencyHistogram *acc, const LatencyHistogram *h)
+{
+	for (int i = 0; i < HIST_BUCKETS; i++)
+		acc->buckets[i] += h->buckets[i];
+	acc->count += h->count;
+	if (h->max > acc->max)
+		acc->max = h->max;
+}
+
+/*
+ * Compute the histogram of the values recorded in 'cur' but not yet in
+ * 'prev', an earlier copy of the same histogram.
+ *
+ * The maximum of the difference is not known exactly; we use the upper bound
+ * of the highest non-empty bucket, capped by the overall maximum.
+ */
+static void
+diffHistogram(LatencyHistogram *res, const LatencyHistogram *cur,
+			  const LatencyHistogram *prev)
+{
+	resetHistogram(res);
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		res->buckets[i] = cur->buckets[i] - prev->buckets[i];
+		if (res->buckets[i] > 0)
+			res->max = Min(histogramBucketHigh(i), cur->max);
+	}
+	res->count = cur->count - prev->count;
+}
+
+/*
+ * Return the value below which the given percentage of the recorded values
+ * fall, in microseconds.  As HdrHistogram does, we report the highest value
+ * of the bucket holding that rank, so percentiles are never underestimated.
+ */
+static double
+histogramPercentile(const LatencyHistogram *h, double percent)
+{
+	int64		rank;
+	int64		seen = 0;
+
+	if (h->count == 0)
+		return 0.0;
+
+	rank = (int64) ceil(percent / 100.0 * h->count);
+	if (rank < 1)
+		rank = 1;
+
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		seen += h->buckets[i];
+		if (seen >= rank)
+			return (double) Min(histogramBucketHigh(i), h->max);
+	}
+	return (double) h->max;
+}
+
+/*
+ * Correct a histogram for coordinated omission.
+ *
+ * In a closed-loop benchmark, a client stuck in a slow transaction does not
+ * issue the transactions it would otherwise have issued meanwhile, so stalls
+ * are under-represented.  As HdrHistogram's copyCorrectedForCoordinatedOmission
+ * does, for each recorded value v larger than the expected interval between
+ * transactions, we add the values v - interval, v - 2 * interval, ... down to
+ * the interval, which the missing transactions would have experienced.
+ *
+ * Rather than adding these one by one, for each pair of source and target
+ * buckets we count how many of them fall into the target bucket.
+ */
+static void
+correctHistogram(LatencyHistogram *res, const LatencyHistogram *h,
+				 int64 interval)
+{
+	*res = *h;
+
+	if (interval <= 0)
+		return;
+
+	for (int i = histogramBucket(interval); i < HIST_BUCKETS; i++)
+	{
+		int64		value = Min(histogramBucketHigh(i), h->max);
+
+		if (h->buckets[i] == 0 || value <= interval)
+			continue;
+
+		for (int j = histogramBucket(interval); j <= i; j++)
+		{
+			int64		low = Max(histogramBucketLow(j), interval);
+			int64		high = Min(histogramBucketHigh(j), value - interval);
+			int64		kmin,
+						kmax;
+
+			if (low > high)
+				continue;
+
+			/* value - k * interval is in [low, high] for k in [kmin, kmax] */
+			kmin = (value - high + interval - 1) / interval;
+			kmax = (value - low) / interval;
+			if (kmax >= kmin)
+			{
+				res->buckets[j] += h->buckets[i] * (kmax - kmin + 1);
+				res->count += h->buckets[i] * (kmax - kmin + 1);
+			}
+		}
+	}
+}
+
 /*
  * Initialize a StatsData struct to mostly zeroes, with its start time set to
- * the given value.
+ * the given value.  No histogram is attached; callers that want one must set
+ * it up afterwards.
  */
 static void
 initStats(StatsData *sd, pg_time_usec_t start)
@@ -1451,6 +1738,7 @@ initStats(StatsData *sd, pg_time_usec_t start)
 	sd->deadlock_failures = 0;
 	initSimpleStats(&sd->latency);
 	initSimpleStats(&sd->lag);
+	sd->histogram = NULL;
 }
 
 /*
@@ -1463,8 +1751,15 @@ accumStats(StatsData *stats, bool skipped, double lat, double lag,
 	/* Record the skipped transaction */
 	if (skipped)
 	{
-		/* no latency to record on skipped transactions */
+		/*
+		 * Skipped transactions have no latency, but leaving them out of the
+		 * histogram would hide exactly the slowdowns that caused them to be
+		 * skipped.  Record how late they were when skipped instead, which is
+		 * a lower bound of their latency had they been executed.
+		 */
 		stats->skipped++;
+		if (stats->histogram)
+			addToHistogram(stats->histogram, (int64) lat, 1);
 		return;
 	}
 
@@ -1485,6 +1780,8 @@ accumStats(StatsData *stats, bool skipped, double lat, double lag,
 			stats->cnt++;
 
 			addToSimpleStats(&stats->latency, lat);
+			if (stats->histogram)
+				addToHistogram(stats->histogram, (int64) lat, 1);
 
 			/* and possibly the same for schedule lag */
 			if (throttle_delay)
@@ -3963,6 +4260,9 @@ advanceConnectionState(TState *thread, CState *st, StatsData *agg)
 					/* XXX could use a mutex here, but we choose not to */
 					addToSimpleStats(&command->stats,
 									 PG_TIME_GET_DOUBLE(now - st->stmt_begin));
+					if (command->histogram)
+						addToHistogram(command->histogram,
+									   now - st->stmt_begin, 1);
 				}
 
 				/* Go ahead with next command, to be executed or skipped */
@@ -4586,7 +4886,7 @@ processXactStats(TState *thread, CState *st, pg_time_usec_t *now,
 	double		latency = 0.0,
 				lag = 0.0;
 	bool		detailed = progress || throttle_delay || latency_limit ||
-	use_log || per_script_stats;
+	use_log || per_script_stats || latency_percentiles;
 
 	if (detailed && !skipped && st->estatus == ESTATUS_NO_ERROR)
 	{
@@ -4596,12 +4896,18 @@ processXactStats(TState *thread, CState *st, pg_time_usec_t *now,
 		latency = (*now) - st->txn_scheduled;
 		lag = st->txn_begin - st->txn_scheduled;
 	}
+	else if (skipped && latency_percentiles)
+	{
+		/* how late the transaction was when skipped, for the histograms */
+		pg_time_now_lazy(now);
+		latency = (*now) - st->txn_scheduled;
+	}
 
 	/* keep detailed thread stats */
 	accumStats(&thread->stats, skipped, latency, lag, st->estatus, st->tries);
 
 	/* count transactions over the latency limit, if needed */
-	if (latency_limit && latency > latency_limit)
+	if (latency_limit && !skipped && latency > latency_limit)
 		thread->latency_late++;
 
 	/* client stat is just counting */
@@ -4642,7 +4948,10 @@ initDropTables(PGconn *con)
 	executeStatement(con, "drop table if exists "
 					 "pgbench_accounts, "
 					 "pgbench_branches, "
+					 "pgbench_events, "
 					 "pgbench_history, "
+					 "pgbench_hot, "
+					 "pgbench_ingest, "
 					 "pgbench_tellers");
 }
 
@@ -5080,6 +5389,90 @@ initCreateFKeys(PGconn *con)
 	}
 }
 
+/*
+ * Create and fill the tables of the contention workloads: pgbench_hot, a
+ * handful of rows updated by all clients; pgbench_events, partitioned into
+ * many parts; and pgbench_ingest, an append-only table.
+ */
+static void
+initCreateWorkloadTables(PGconn *con)
+{
+	PQExpBufferData query;
+	char	   *escape_tablespace = NULL;
+	char	   *escape_index_tablespace = NULL;
+
+	fprintf(stderr, "creating workload tables...\n");
+
+	if (tablespace != NULL)
+		escape_tablespace = PQescapeIdentifier(con, tablespace,
+											   strlen(tablespace));
+	if (index_tablespace != NULL)
+		escape_index_tablespace = PQescapeIdentifier(con, index_tablespace,
+													 strlen(index_tablespace));
+
+	executeStatement(con, "drop table if exists "
+					 "pgbench_events, "
+					 "pgbench_hot, "
+					 "pgbench_ingest");
+
+	initPQExpBuffer(&query);
+
+	/* a few hot rows, with room for HOT updates as set by -F */
+	printfPQExpBuffer(&query,
+					  "create%s table pgbench_hot(hid int not null,counter bigint)"
+					  " with (fillfactor=%d)",
+					  unlogged_tables ? " unlogged" : "", fillfactor);
+	if (escape_tablespace)
+		appendPQExpBuffer(&query, " tablespace %s", escape_tablespace);
+	executeStatement(con, query.data);
+
+	printfPQExpBuffer(&query,
+					  "insert into pgbench_hot(hid,counter) "
+					  "select hid, 0 from generate_series(1, %d) as hid",
+					  nhotrows);
+	executeStatement(con, query.data);
+
+	printfPQExpBuffer(&query, "alter table pgbench_hot add primary key (hid)");
+	if (escape_index_tablespace)
+		appendPQExpBuffer(&query, " using index tablespace %s",
+						  escape_index_tablespace);
+	executeStatement(con, query.data);
+
+	/* wide rows, hash-partitioned */
+	printfPQExpBuffer(&query,
+					  "create%s table pgbench_events(aid bigint,tid int,delta int,mtime timestamp,payload text)"
+					  " partition by hash (aid)",
+					  unlogged_tables ? " unlogged" : "");
+	executeStatement(con, query.data);
+
+	for (int p = 0; p < neventparts; p++)
+	{
+		printfPQExpBuffer(&query,
+						  "create%s table pgbench_events_%d\n"
+						  "  partition of pgbench_events\n"
+						  "  for values with (modulus %d, remainder %d)",
+						  unlogged_tables ? " unlogged" : "", p + 1,
+						  neventparts, p);
+		if (escape_tablespace)
+			appendPQExpBuffer(&query, " tablespace %s", escape_tablespace);
+		executeStatement(con, query.data);
+	}
+
+	/* append-only target of bulk loads */
+	printfPQExpBuffer(&query,
+					  "create%s table pgbench_ingest(aid bigint,payload text)",
+					  unlogged_tables ? " unlogged" : "");
+	if (escape_tablespace)
+		appendPQExpBuffer(&query, " tablespace %s", escape_tablespace);
+	executeStatement(con, query.data);
+
+	termPQExpBuffer(&query);
+	if (escape_tablespace)
+		PQfreemem(escape_tablespace);
+	if (escape_index_tablespace)
+		PQfreemem(escape_index_tablespace);
+}
+
 /*
  * Validate an initialization-steps string
  *
@@ -5159,6 +5552,10 @@ runInitSteps(const char *initialize_steps)
 				op = "foreign keys";
 				initCreateFKeys(con);
 				break;
+			case 'w':
+				op = "workload tables";
+				initCreateWorkloadTables(con);
+				break;
 			case ' ':
 				break;			/* ignore */
 			default:
@@ -5188,6 +5585,31 @@ runInitSteps(const char *initialize_steps)
 	termPQExpBuffer(&stats);
 }
 
+/*
+ * Check that the tables created by initialization step "w" exist, as they
+ * are needed by some of the builtin scripts.
+ */
+static void
+CheckWorkloadTables(PGconn *con)
+{
+	PGresult   *res;
+
+	res = PQexec(con, "select count(*) from pgbench_hot");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+	{
+		char	   *sqlState = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+
+		pg_log_error("could not find the workload tables: %s", PQerrorMessage(con));
+
+		if (sqlState && strcmp(sqlState, ERRCODE_UNDEFINED_TABLE) == 0)
+			pg_log_error_hint("Perhaps you need to do initialization with step \"w\" (\"pgbench -i -I %sw\") in database \"%s\".",
+							  DEFAULT_INIT_STEPS, PQdb(con));
+
+		exit(1);
+	}
+	PQclear(res);
+}
+
 /*
  * Extract pgbench table information into global variables scale,
  * partition_method and partitions.
@@ -5456,6 +5878,7 @@ create_sql_command(PQExpBuffer buf, const char *source)
 	my_command->varprefix = NULL;	/* allocated later, if needed */
 	my_command->expr = NULL;
 	initSimpleStats(&my_command->stats);
+	my_command->histogram = NULL;	/* allocated later, if needed */
 
 	return my_command;
 }
@@ -5984,6 +6407,8 @@ static void
 process_builtin(const BuiltinScript *bi, int weight)
 {
 	ParseScript(bi->script, bi->desc, weight);
+	if (bi->workload_tables)
+		workload_tables_used = true;
 }
 
 /* show available builtin scripts */
@@ -5994,7 +6419,7 @@ listAvailableScripts(void)
 
 	fprintf(stderr, "Available builtin scripts:\n");
 	for (i = 0; i < lengthof(builtin_script); i++)
-		fprintf(stderr, "  %13s: %s\n", builtin_script[i].name, builtin_script[i].desc);
+		fprintf(stderr, "  %16s: %s\n", builtin_script[i].name, builtin_script[i].desc);
 	fprintf(stderr, "\n");
 }
 
@@ -6110,6 +6535,8 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 				stdev;
 	char		tbuf[315];
 	StatsData	cur;
+	static LatencyHistogram *hist_bufs[2];
+	static LatencyHistogram *interval_hist;
 
 	/*
 	 * Add up the statistics of all threads.
@@ -6122,8 +6549,26 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 	 * "torn" read and completely bogus latencies though!)
 	 */
 	initStats(&cur, 0);
+	if (latency_percentiles)
+	{
+		/*
+		 * The previous report's histogram is kept in *last, so alternate
+		 * between two buffers for the current one.
+		 */
+		if (hist_bufs[0] == NULL)
+		{
+			hist_bufs[0] = newHistogram();
+			hist_bufs[1] = newHistogram();
+			interval_hist = newHistogram();
+		}
+		cur.histogram = (last->histogram == hist_bufs[0]) ?
+			hist_bufs[1] : hist_bufs[0];
+		resetHistogram(cur.histogram);
+	}
 	for (int i = 0; i < nthreads; i++)
 	{
+		if (cur.histogram)
+			mergeHistogram(cur.histogram, threads[i].stats.histogram);
 		mergeSimpleStats(&cur.latency, &threads[i].stats.latency);
 		mergeSimpleStats(&cur.lag, &threads[i].stats.lag);
 		cur.cnt += threads[i].stats.cnt;
@@ -6168,6 +6613,25 @@ printProgressReport(TState *threads, int64 test_start, pg_time_usec_t now,
 			"progress: %s, %.1f tps, lat %.3f ms stddev %.3f, " INT64_FORMAT " failed",
 			tbuf, tps, latency, stdev, failures);
 
+	if (cur.histogram)
+	{
+		/* percentiles of this interval only */
+		if (last->histogram)
+			diffHistogram(interval_hist, cur.histogram, last->histogram);
+		else
+			*interval_hist = *cur.histogram;
+
+		fprintf(stderr, ", p50/p99/p99.9 %.3f/%.3f/%.3f ms",
+				0.001 * histogramPercentile(interval_hist, 50.0),
+				0.001 * histogramPercentile(interval_hist, 99.0),
+				0.001 * histogramPercentile(interval_hist, 99.9));
+
+		if (histogram_file)
+			writeHistogram(histogram_file, "interval",
+						   (*last_report + epoch_shift) / 1000000,
+						   -1, -1, interval_hist);
+	}
+
 	if (throttle_delay)
 	{
 		fprintf(stderr, ", lag %.3f ms", lag);
@@ -6200,6 +6664,71 @@ printSimpleStats(const char *prefix, SimpleStats *ss)
 	}
 }
 
+/*
+ * Print the report_percentiles of a histogram, in milliseconds.
+ */
+static void
+printHistogramPercentiles(const char *prefix, LatencyHistogram *h)
+{
+	if (h->count > 0)
+	{
+		printf("%s:", prefix);
+		for (int i = 0; i < lengthof(report_percentiles); i++)
+			printf("%s p%g = %.3f", i > 0 ? "," : "", report_percentiles[i],
+				   0.001 * histogramPercentile(h, report_percentiles[i]));
+		printf(", max = %.3f ms\n", 0.001 * h->max);
+	}
+}
+
+/*
+ * Write the non-empty buckets of a histogram to the --histogram-file, one
+ * line per bucket.  'script' and 'command' are -1 for histograms covering
+ * all scripts or whole transactions.
+ */
+static void
+writeHistogram(FILE *file, const char *kind, int64 time,
+			   int script, int command, LatencyHistogram *h)
+{
+	for (int i = 0; i < HIST_BUCKETS; i++)
+	{
+		if (h->buckets[i] == 0)
+			continue;
+		fprintf(file, "%s " INT64_FORMAT " %d %d " INT64_FORMAT " " INT64_FORMAT
+				" " INT64_FORMAT "\n",
+				kind, time, script, command,
+				histogramBucketLow(i), histogramBucketHigh(i),
+				h->buckets[i]);
+	}
+}
+
+/*
+ * Write the final histograms to the --histogram-file: all transactions, then
+ * each script and each command of the script, if they were collected.
+ */
+static void
+writeHistograms(StatsData *total, pg_time_usec_t bench_start)
+{
+	int64		time = (bench_start + epoch_shift) / 1000000;
+
+	writeHistogram(histogram_file, "total", time, -1, -1, total->histogram);
+
+	for (int i = 0; i < num_scripts; i++)
+	{
+		Command   **commands = sql_script[i].commands;
+
+		if (sql_script[i].stats.histogram)
+			writeHistogram(histogram_file, "total", time, i, -1,
+						   sql_script[i].stats.histogram);
+
+		for (int j = 0; commands[j] != NULL; j++)
+		{
+			if (commands[j]->histogram)
+				writeHistogram(histogram_file, "total", time, i, j,
+							   commands[j]->histogram);
+		}
+	}
+}
+
 /* print version banner */
 static void
 printVersion(PGconn *con)
@@ -6317,6 +6846,30 @@ printResults(StatsData *total,
 			   failures > 0 ? " (including failures)" : "");
 	}
 
+	if (total->histogram)
+	{
+		printHistogramPercentiles("latency percentiles in ms", total->histogram);
+
+		/*
+		 * Under --rate, latencies are measured from the scheduled start of
+		 * each transaction, so they already include the time transactions
+		 * spent waiting behind slow ones.  Otherwise, correct for the
+		 * transactions the clients did not issue while waiting, taking the
+		 * median latency as the expected interval between transactions.
+		 */
+		if (!throttle_delay && total->histogram->count > 0)
+		{
+			LatencyHistogram *corrected = newHistogram();
+			int64		interval;
+
+			interval = (int64) histogramPercentile(total->histogram, 50.0);
+			correctHistogram(corrected, total->histogram, Max(interval, 1));
+			printHistogramPercentiles("latency percentiles in ms, corrected for coordinated omission",
+									  corrected);
+			pg_free(corrected);
+		}
+	}
+
 	if (throttle_delay)
 	{
 		/*
@@ -6405,6 +6958,9 @@ printResults(StatsData *total,
 						   100.0 * sstats->skipped / script_total_cnt);
 
 				printSimpleStats(" - latency", &sstats->latency);
+				if (sstats->histogram)
+					printHistogramPercentiles(" - latency percentiles in ms",
+											  sstats->histogram);
 			}
 
 			/*
@@ -6441,6 +6997,26 @@ printResults(StatsData *total,
 							   (*commands)->retries,
 							   (*commands)->first_line);
 				}
+
+				if (latency_percentiles)
+				{
+					printf("%sstatement latency percentiles in milliseconds (p50, p99, p99.9, max):\n",
+						   per_script_stats ? " - " : "");
+
+					for (commands = sql_script[i].commands;
+						 *commands != NULL;
+						 commands++)
+					{
+						LatencyHistogram *chist = (*commands)->histogram;
+
+						printf("   %11.3f %11.3f %11.3f %11.3f  %s\n",
+							   0.001 * histogramPercentile(chist, 50.0),
+							   0.001 * histogramPercentile(chist, 99.0),
+							   0.001 * histogramPercentile(chist, 99.9),
+							   0.001 * chist->max,
+							   (*commands)->first_line);
+					}
+				}
 			}
 		}
 	}
@@ -6544,6 +7120,8 @@ main(int argc, char **argv)
 		{"failures-detailed", no_argument, NULL, 13},
 		{"max-tries", required_argument, NULL, 14},
 		{"verbose-errors", no_argument, NULL, 15},
+		{"percentiles", no_argument, NULL, 16},
+		{"histogram-file", required_argument, NULL, 17},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -6881,6 +7459,15 @@ main(int argc, char **argv)
 				benchmarking_option_set = true;
 				verbose_errors = true;
 				break;
+			case 16:			/* percentiles */
+				benchmarking_option_set = true;
+				latency_percentiles = true;
+				break;
+			case 17:			/* histogram-file */
+				benchmarking_option_set = true;
+				latency_percentiles = true;
+				histogram_file_name = pg_strdup(optarg);
+				break;
 			default:
 				/* getopt_long already emitted a complaint */
 				pg_log_error_hint("Try \"%s --help\" for more information.", progname);
@@ -6916,6 +7503,22 @@ main(int argc, char **argv)
 	if (num_scripts > 1)
 		per_script_stats = true;
 
+	/* set up the histograms of scripts and commands, if needed */
+	if (latency_percentiles)
+	{
+		for (i = 0; i < num_scripts; i++)
+		{
+			Command   **commands = sql_script[i].commands;
+
+			if (per_script_stats)
+				sql_script[i].stats.histogram = newHistogram();
+
+			if (report_per_command)
+				for (int j = 0; commands[j] != NULL; j++)
+					commands[j]->histogram = newHistogram();
+		}
+	}
+
 	/*
 	 * Don't need more threads than there are clients.  (This is not merely an
 	 * optimization; throttle_delay is calculated incorrectly below if some
@@ -7092,6 +7695,9 @@ main(int argc, char **argv)
 	if (internal_script_used)
 		GetTableInfo(con, scale_given);
 
+	if (workload_tables_used)
+		CheckWorkloadTables(con);
+
 	/*
 	 * :scale variables normally get -s or database scale, but don't override
 	 * an explicit -D switch
@@ -7153,6 +7759,14 @@ main(int argc, char **argv)
 	}
 	PQfinish(con);
 
+	if (histogram_file_name)
+	{
+		histogram_file = fopen(histogram_file_name, "w");
+		if (histogram_file == NULL)
+			pg_fatal("could not open histogram file \"%s\": %m",
+					 histogram_file_name);
+	}
+
 	/* set up thread data structures */
 	threads = (TState *) pg_malloc(sizeof(TState) * nthreads);
 	nclients_dealt = 0;
@@ -7171,6 +7785,8 @@ main(int argc, char **argv)
 		thread->logfile = NULL; /* filled in later */
 		thread->latency_late = 0;
 		initStats(&thread->stats, 0);
+		if (latency_percentiles)
+			thread->stats.histogram = newHistogram();
 
 		nclients_dealt += thread->nstate;
 	}
@@ -7215,6 +7831,8 @@ main(int argc, char **argv)
 
 	/* wait for other threads and accumulate results */
 	initStats(&stats, 0);
+	if (latency_percentiles)
+		stats.histogram = newHistogram();
 	conn_total_duration = 0;
 
 	for (i = 0; i < nthreads; i++)
@@ -7231,6 +7849,8 @@ main(int argc, char **argv)
 				exit_code = 2;
 
 		/* aggregate thread level stats */
+		if (stats.histogram)
+			mergeHistogram(stats.histogram, thread->stats.histogram);
 		mergeSimpleStats(&stats.latency, &thread->stats.latency);
 		mergeSimpleStats(&stats.lag, &thread->stats.lag);
 		stats.cnt += thread->stats.cnt;
@@ -7264,6 +7884,14 @@ main(int argc, char **argv)
 	printResults(&stats, pg_time_now() - bench_start, conn_total_duration,
 				 bench_start - start_time, latency_late);
 
+	if (histogram_file)
+	{
+		writeHistograms(&stats, bench_start);
+		if (fclose(histogram_file) != 0)
+			pg_log_error("could not write histogram file \"%s\": %m",
+						 histogram_file_name);
+	}
+
 	THREAD_BARRIER_DESTROY(&barrier);
 
 	if (exit_code != 0)
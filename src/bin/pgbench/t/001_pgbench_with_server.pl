@@ -145,6 +145,36 @@ $node->pgbench(
 	],
 	'pgbench select only');
 
+# contention workloads, which need their own tables
+$node->pgbench(
+	'-n -t 5 -b hot-update',
+	1,
+	[qr{^$}],
+	[qr{Perhaps you need to do initialization with step "w"}],
+	'contention workload without its tables');
+
+$node->pgbench(
+	'--initialize --init-steps=w',
+	0,
+	[qr{^$}],
+	[ qr{creating workload tables}, qr{done in \d+\.\d\d s } ],
+	'pgbench workload tables initialization');
+
+$node->pgbench(
+	'-n -t 5 -c 2 -b hot-update -b partition-insert -b bulk-insert'
+	  . ' -b snapshot-read -b large-sort',
+	0,
+	[
+		qr{processed: 10/10},
+		qr{builtin: hot row update},
+		qr{builtin: partitioned insert},
+		qr{builtin: bulk insert},
+		qr{builtin: read-only snapshots},
+		qr{builtin: large sort}
+	],
+	[qr{^$}],
+	'pgbench contention workloads');
+
 # check if threads are supported
 my $nthreads = 2;
 
@@ -1200,6 +1230,29 @@ $node->pgbench(
 check_pgbench_logs($bdir, '001_pgbench_log_3', 1, 10, 10,
 	qr{^0 \d{1,2} \d+ \d \d+ \d+$});
 
+# Latency histograms and percentiles, per script and per statement
+$node->pgbench(
+	"-n -b select-only -b simple-update -t 20 -c 2 -r",
+	0,
+	[
+		qr{processed: 40/40},
+		qr{latency percentiles in ms: p50 = \d+\.\d+, p90 = },
+		qr{corrected for coordinated omission},
+		qr{ - latency percentiles in ms: p50 = },
+		qr{statement latency percentiles in milliseconds}
+	],
+	[qr{^$}],
+	'pgbench latency percentiles', undef,
+	"--histogram-file=$bdir/001_pgbench_histogram");
+
+my @hist = split(/\n/, slurp_file("$bdir/001_pgbench_histogram"));
+ok(@hist > 0, "histogram file is not empty");
+ok(grep(!/^total \d+ -?\d+ -?\d+ \d+ \d+ \d+$/, @hist) == 0,
+	"histogram file format");
+my $hist_total = 0;
+$hist_total += (split / /)[6] for grep(/^total \d+ -1 -1 /, @hist);
+is($hist_total, 40, "histogram counts all transactions");
+
 # abortion of the client if the script contains an incomplete transaction block
 $node->pgbench(
 	'--no-vacuum',
@@ -257,7 +257,8 @@ pgbench(
 	[qr{^$}],
 	[
 		qr{Available builtin scripts:}, qr{tpcb-like},
-		qr{simple-update},              qr{select-only}
+		qr{simple-update},              qr{select-only},
+		qr{hot-update},                 qr{large-sort}
 	],
 	'pgbench builtin list');
 
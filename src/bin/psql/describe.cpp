@@ -5411,8 +5411,20 @@ bool describeSubscriptions(const char *pattern, bool verbose) {
                     gettext_noop("Name"), gettext_noop("Owner"), gettext_noop("Enabled"), gettext_noop("Publication"));
 
   if (verbose) {
-    /* Binary mode and streaming are only supported in v14 and higher */
-    if (pset.sversion >= 140000)
+    /*
+     * Binary mode and streaming are only supported in v14 and higher;
+     * parallel streaming in v16 and higher, where substream is a char
+     */
+    if (pset.sversion >= 160000)
+      appendPQExpBuffer(&buf,
+                        ", subbinary AS \"%s\"\n"
+                        ", (CASE substream\n"
+                        "    WHEN 'f' THEN 'off'\n"
+                        "    WHEN 't' THEN 'on'\n"
+                        "    WHEN 'p' THEN 'parallel'\n"
+                        "   END) AS \"%s\"\n",
+                        gettext_noop("Binary"), gettext_noop("Streaming"));
+    else if (pset.sversion >= 140000)
       appendPQExpBuffer(&buf,
                         ", subbinary AS \"%s\"\n"
                         ", substream AS \"%s\"\n",
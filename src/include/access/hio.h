@@ -24,12 +24,19 @@
  * If current_buf isn't InvalidBuffer, then we are holding an extra pin
  * on that buffer.
  *
+ * next_free..last_free are blocks we added to the relation in an earlier
+ * bulk extension and haven't used yet.  They aren't reserved for us, so
+ * other backends may have used them in the meantime.
+ *
  * "typedef struct BulkInsertStateData *BulkInsertState" is in heapam.h
  */
 typedef struct BulkInsertStateData
 {
 	BufferAccessStrategy strategy;	/* our BULKWRITE strategy object */
 	Buffer		current_buf;	/* current insertion target page */
+	BlockNumber next_free;		/* next unused block from last extension */
+	BlockNumber last_free;		/* last unused block from last extension */
+	uint32		already_extended_by;	/* blocks added using this state */
 } BulkInsertStateData;
 
 
@@ -38,6 +45,7 @@ extern void RelationPutHeapTuple(Relation relation, Buffer buffer,
 extern Buffer RelationGetBufferForTuple(Relation relation, Size len,
 										Buffer otherBuffer, int options,
 										BulkInsertStateData *bistate,
-										Buffer *vmbuffer, Buffer *vmbuffer_other);
+										Buffer *vmbuffer, Buffer *vmbuffer_other,
+										int num_pages);
 
 #endif							/* HIO_H */
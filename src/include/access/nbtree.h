@@ -1044,6 +1044,24 @@ typedef struct BTScanOpaqueData
 	BTArrayKeyInfo *arrayKeys;	/* info about each equality-type array key */
 	MemoryContext arrayContext; /* scan-lifespan context for array data */
 
+	/*
+	 * workspace for skip scans (see _bt_preprocess_skip_key()).  When
+	 * skipScan is set, arrayKeys[0] is the skip array on the first index
+	 * column; its cur_elem and mark_elem count the values visited so far.
+	 * Once skipFallback is set, the scan has stopped skipping and is reading
+	 * the rest of the index without the skip array's key.
+	 */
+	bool		skipScan;		/* is there a skip array? */
+	bool		skipIsNull;		/* current leading value is NULL? */
+	bool		skipMarkIsNull; /* marked leading value is NULL? */
+	bool		skipFallback;	/* gave up skipping? */
+	bool		skipMarkFallback;	/* gave up skipping when mark was set? */
+	int			skipWasted;		/* consecutive skips that saved nothing */
+	BlockNumber skipLastPage;	/* last leaf page read by the scan */
+	Datum		skipValue;		/* current leading value */
+	Datum		skipMarkValue;	/* leading value when mark was set */
+	ScanKeyData skipKey;		/* template for the skip array's "=" key */
+
 	/* info about killed items if any (killedItems is NULL if never used) */
 	int		   *killedItems;	/* currPos.items indexes of killed items */
 	int			numKilled;		/* number of currently stored items */
@@ -1232,6 +1250,8 @@ extern bool _bt_first(IndexScanDesc scan, ScanDirection dir);
 extern bool _bt_next(IndexScanDesc scan, ScanDirection dir);
 extern Buffer _bt_get_endpoint(Relation rel, uint32 level, bool rightmost,
 							   Snapshot snapshot);
+extern bool _bt_skip_search(IndexScanDesc scan, ScanDirection dir, bool first,
+							Datum *value, bool *isnull, bool *nearby);
 
 /*
  * prototypes for functions in nbtutils.c
@@ -1239,7 +1259,8 @@ extern Buffer _bt_get_endpoint(Relation rel, uint32 level, bool rightmost,
 extern BTScanInsert _bt_mkscankey(Relation rel, IndexTuple itup);
 extern void _bt_freestack(BTStack stack);
 extern void _bt_preprocess_array_keys(IndexScanDesc scan);
-extern void _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir);
+extern void _bt_preprocess_skip_key(IndexScanDesc scan);
+extern bool _bt_start_array_keys(IndexScanDesc scan, ScanDirection dir);
 extern bool _bt_advance_array_keys(IndexScanDesc scan, ScanDirection dir);
 extern void _bt_mark_array_keys(IndexScanDesc scan);
 extern void _bt_restore_array_keys(IndexScanDesc scan);
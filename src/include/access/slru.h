@@ -33,6 +33,20 @@
  */
 #define SLRU_PAGES_PER_SEGMENT	32
 
+/*
+ * The buffer slots of an SLRU are divided into banks of SLRU_BANK_SIZE slots.
+ * A page can only be cached in the bank selected by its page number, and
+ * each bank is protected by its own LWLock, so looking up a page or choosing
+ * a victim slot only needs to scan one bank, and processes working on pages
+ * in different banks don't contend with each other.  The number of buffers
+ * of an SLRU must therefore be a multiple of SLRU_BANK_SIZE.
+ */
+#define SLRU_BANK_BITSHIFT		4
+#define SLRU_BANK_SIZE			(1 << SLRU_BANK_BITSHIFT)
+
+/* Maximum number of buffers for a single SLRU, i.e. 1GB worth of pages */
+#define SLRU_MAX_ALLOWED_BUFFERS ((1024 * 1024 * 1024) / BLCKSZ)
+
 /*
  * Page status codes.  Note that these do not include the "dirty" bit.
  * page_dirty can be true only in the VALID or WRITE_IN_PROGRESS states;
@@ -52,8 +66,6 @@ typedef enum
  */
 typedef struct SlruSharedData
 {
-	LWLock	   *ControlLock;
-
 	/* Number of buffers managed by this SLRU structure */
 	int			num_slots;
 
@@ -66,8 +78,16 @@ typedef struct SlruSharedData
 	bool	   *page_dirty;
 	int		   *page_number;
 	int		   *page_lru_count;
+
+	/* Per-slot locks synchronizing I/O on each buffer */
 	LWLockPadded *buffer_locks;
 
+	/*
+	 * Per-bank locks protecting the shared state of the slots in each bank
+	 * (see SimpleLruGetBankLock()).
+	 */
+	LWLockPadded *bank_locks;
+
 	/*
 	 * Optional array of WAL flush LSNs associated with entries in the SLRU
 	 * pages.  If not zero/NULL, we must flush WAL before writing pages (true
@@ -80,22 +100,25 @@ typedef struct SlruSharedData
 	int			lsn_groups_per_page;
 
 	/*----------
-	 * We mark a page "most recently used" by setting
-	 *		page_lru_count[slotno] = ++cur_lru_count;
-	 * The oldest page is therefore the one with the highest value of
-	 *		cur_lru_count - page_lru_count[slotno]
+	 * Each bank has its own LRU clock.  We mark a page "most recently used"
+	 * by setting
+	 *		page_lru_count[slotno] = ++bank_cur_lru_count[bankno];
+	 * The oldest page in a bank is therefore the one with the highest value
+	 * of
+	 *		bank_cur_lru_count[bankno] - page_lru_count[slotno]
 	 * The counts will eventually wrap around, but this calculation still
 	 * works as long as no page's age exceeds INT_MAX counts.
 	 *----------
 	 */
-	int			cur_lru_count;
+	int		   *bank_cur_lru_count;
 
 	/*
 	 * latest_page_number is the page number of the current end of the log;
 	 * this is not critical data, since we use it only to avoid swapping out
-	 * the latest page.
+	 * the latest page.  It's read and written without holding any particular
+	 * bank lock, hence the atomic.
 	 */
-	int			latest_page_number;
+	pg_atomic_uint32 latest_page_number;
 
 	/* SLRU's index for statistics purposes (might not be unique) */
 	int			slru_stats_idx;
@@ -111,6 +134,9 @@ typedef struct SlruCtlData
 {
 	SlruShared	shared;
 
+	/* Number of banks in this SLRU, i.e. num_slots / SLRU_BANK_SIZE */
+	int			nbanks;
+
 	/*
 	 * Which sync handler function to use when handing sync requests over to
 	 * the checkpointer.  SYNC_HANDLER_NONE to disable fsync (eg pg_notify).
@@ -139,10 +165,23 @@ typedef struct SlruCtlData
 typedef SlruCtlData *SlruCtl;
 
 
+/*
+ * Get the bank lock protecting the buffer slots that can hold the given page.
+ * This lock must be held to look up, read in, zero or modify the page.
+ */
+static inline LWLock *
+SimpleLruGetBankLock(SlruCtl ctl, int pageno)
+{
+	int			bankno = (uint32) pageno % ctl->nbanks;
+
+	return &(ctl->shared->bank_locks[bankno].lock);
+}
+
 extern Size SimpleLruShmemSize(int nslots, int nlsns);
+extern int	SimpleLruAutotuneBuffers(int divisor, int max);
 extern void SimpleLruInit(SlruCtl ctl, const char *name, int nslots, int nlsns,
-						  LWLock *ctllock, const char *subdir, int tranche_id,
-						  SyncRequestHandler sync_handler);
+						  const char *subdir, int buffer_tranche_id,
+						  int bank_tranche_id, SyncRequestHandler sync_handler);
 extern int	SimpleLruZeroPage(SlruCtl ctl, int pageno);
 extern int	SimpleLruReadPage(SlruCtl ctl, int pageno, bool write_ok,
 							  TransactionId xid);
@@ -165,6 +204,8 @@ extern void SlruDeleteSegment(SlruCtl ctl, int segno);
 
 extern int	SlruSyncFileTag(SlruCtl ctl, const FileTag *ftag, char *path);
 
+extern bool check_slru_buffers(const char *name, int *newval);
+
 /* SlruScanDirectory public callbacks */
 extern bool SlruScanDirCbReportPresence(SlruCtl ctl, char *filename,
 										int segpage, void *data);
@@ -17,6 +17,7 @@
 #include "access/xact.h"
 #include "access/xlogdefs.h"
 #include "datatype/timestamp.h"
+#include "nodes/pg_list.h"
 #include "storage/lock.h"
 
 /*
@@ -62,4 +63,5 @@ extern void PrepareRedoRemove(TransactionId xid, bool giveWarning);
 extern void restoreTwoPhaseData(void);
 extern bool LookupGXact(const char *gid, XLogRecPtr prepare_at_lsn,
 						TimestampTz origin_prepare_timestamp);
+extern List *GetPreparedTransactionGids(const char *prefix);
 #endif							/* TWOPHASE_H */
@@ -0,0 +1,42 @@
+/*-------------------------------------------------------------------------
+ *
+ * xlogparallel.h
+ *		Declarations for parallel WAL redo.
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *		src/include/access/xlogparallel.h
+ *-------------------------------------------------------------------------
+ */
+#ifndef XLOGPARALLEL_H
+#define XLOGPARALLEL_H
+
+#include "access/xlogreader.h"
+#include "storage/block.h"
+#include "storage/relfilelocator.h"
+
+/* Upper limit for recovery_parallel_workers */
+#define MAX_PARALLEL_REDO_WORKERS	64
+
+/* GUCs */
+extern PGDLLIMPORT int recovery_parallel_workers;
+
+extern Size ParallelRedoShmemSize(void);
+extern void ParallelRedoShmemInit(void);
+
+/* Functions called by the startup process */
+extern void ParallelRedoStartWorkers(void);
+extern bool ParallelRedoDispatch(XLogReaderState *record);
+extern bool ParallelRedoWaitForWorkers(void);
+extern void ParallelRedoBarrierApplied(XLogReaderState *record);
+extern void ParallelRedoStopWorkers(void);
+
+/* Functions called by parallel redo workers */
+extern bool ParallelRedoReportInvalidPage(RelFileLocator locator,
+										  ForkNumber forkno,
+										  BlockNumber blkno, bool present);
+extern void ParallelRedoWorkerMain(Datum main_arg);
+
+#endif							/* XLOGPARALLEL_H */
@@ -59,6 +59,8 @@ extern PGDLLIMPORT HotStandbyState standbyState;
 
 extern bool XLogHaveInvalidPages(void);
 extern void XLogCheckInvalidPages(void);
+extern void XLogRememberInvalidPage(RelFileLocator locator, ForkNumber forkno,
+									BlockNumber blkno, bool present);
 
 extern void XLogDropRelation(RelFileLocator rlocator, ForkNumber forknum);
 extern void XLogDropDatabase(Oid dbid);
@@ -43,6 +43,15 @@
  */
 #define LOGICALREP_ORIGIN_ANY "any"
 
+/*
+ * substream values.  With "parallel", in-progress transactions are streamed
+ * and applied by a parallel apply worker as they arrive; see comments atop
+ * applyparallelworker.c.
+ */
+#define LOGICALREP_STREAM_OFF 'f'
+#define LOGICALREP_STREAM_ON 't'
+#define LOGICALREP_STREAM_PARALLEL 'p'
+
 /* ----------------
  *		pg_subscription definition. cpp turns this into
  *		typedef struct FormData_pg_subscription
@@ -80,7 +89,8 @@ CATALOG(pg_subscription,6100,SubscriptionRelationId) BKI_SHARED_RELATION BKI_ROW
 	bool		subbinary;		/* True if the subscription wants the
 								 * publisher to send data in binary */
 
-	bool		substream;		/* Stream in-progress transactions. */
+	char		substream;		/* Stream in-progress transactions. See
+								 * LOGICALREP_STREAM_xxx constants. */
 
 	char		subtwophasestate;	/* Stream two-phase transactions */
 
@@ -124,7 +134,8 @@ typedef struct Subscription
 	bool		enabled;		/* Indicates if the subscription is enabled */
 	bool		binary;			/* Indicates if the subscription wants data in
 								 * binary format */
-	bool		stream;			/* Allow streaming in-progress transactions. */
+	char		stream;			/* Allow streaming in-progress transactions.
+								 * See LOGICALREP_STREAM_xxx constants. */
 	char		twophasestate;	/* Allow streaming two-phase transactions */
 	bool		disableonerr;	/* Indicates if the subscription should be
 								 * automatically disabled if a worker error
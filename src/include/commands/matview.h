@@ -30,4 +30,7 @@ extern DestReceiver *CreateTransientRelDestReceiver(Oid oid);
 
 extern bool MatViewIncrementalMaintenanceIsEnabled(void);
 
+extern void CreateMatViewChangeLogs(Oid matviewOid, Query *query);
+extern List *GetMatViewChangeLogs(Oid matviewOid);
+
 #endif							/* MATVIEW_H */
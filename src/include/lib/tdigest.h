@@ -0,0 +1,58 @@
+/*
+ * tdigest.h
+ *
+ * A t-digest for estimating quantiles in bounded memory
+ *
+ * Portions Copyright (c) 2022, PostgreSQL Global Development Group
+ *
+ * src/include/lib/tdigest.h
+ */
+#ifndef TDIGEST_H
+#define TDIGEST_H
+
+/*
+ * A t-digest summarizes a set of values as a list of centroids, each being
+ * the mean and number of a run of adjacent values.  Centroids near the
+ * extremes are kept small and those in the middle are allowed to grow, so
+ * that the estimated quantiles are most accurate near 0 and 1.  The number
+ * of centroids is bounded by the compression parameter, and two digests can
+ * be merged, which makes them suitable for parallel aggregation.  See Ted
+ * Dunning's paper "The t-digest: Efficient estimates of distributions" for
+ * more.
+ *
+ * TDigest
+ *
+ *		compression		accuracy parameter ("delta"); more is more accurate
+ *		ncentroids		number of centroids
+ *		maxcentroids	allocated length of centroids
+ *		count			total weight of all values added
+ *		min, max		smallest and largest value added
+ *		centroids		centroids, in no particular order
+ */
+typedef struct TDigestCentroid
+{
+	double		mean;
+	double		weight;
+} TDigestCentroid;
+
+typedef struct TDigest
+{
+	int			compression;
+	int			ncentroids;
+	int			maxcentroids;
+	double		count;
+	double		min;
+	double		max;
+	TDigestCentroid *centroids;
+} TDigest;
+
+#define TDIGEST_DEFAULT_COMPRESSION 100
+
+extern TDigest *tdigest_create(int compression);
+extern void tdigest_add(TDigest *td, double value, double weight);
+extern void tdigest_merge(TDigest *td, const TDigest *other);
+extern void tdigest_compress(TDigest *td);
+extern double tdigest_quantile(TDigest *td, double q);
+extern void tdigest_free(TDigest *td);
+
+#endif							/* TDIGEST_H */
@@ -174,6 +174,12 @@ typedef struct Port
 	 */
 	char	   *application_name;
 
+	/*
+	 * Protocol extensions requested by the client via "_pq_." startup
+	 * options and accepted by us.
+	 */
+	bool		multirow_bind;	/* _pq_.multirow_bind */
+
 	/*
 	 * Information that needs to be held during the authentication cycle.
 	 */
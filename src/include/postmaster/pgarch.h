@@ -26,28 +26,40 @@
 #define MAX_XFN_CHARS	40
 #define VALID_XFN_CHARS "0123456789ABCDEF.history.backup.partial"
 
+/* Upper limit for archive_concurrency */
+#define MAX_ARCHIVE_CONCURRENCY	64
+
 extern Size PgArchShmemSize(void);
 extern void PgArchShmemInit(void);
 extern bool PgArchCanRestart(void);
 extern void PgArchiverMain(void) pg_attribute_noreturn();
 extern void PgArchWakeup(void);
 extern void PgArchForceDirScan(void);
+extern void PgArchNotifyReady(const char *xlog);
 
 /*
  * The value of the archive_library GUC.
  */
 extern PGDLLIMPORT char *XLogArchiveLibrary;
 
+/*
+ * The value of the archive_concurrency GUC.
+ */
+extern PGDLLIMPORT int archive_concurrency;
+
 /*
  * Archive module callbacks
  *
  * These callback functions should be defined by archive libraries and returned
  * via _PG_archive_module_init().  ArchiveFileCB is the only required callback.
- * For more information about the purpose of each callback, refer to the
- * archive modules documentation.
+ * ArchiveFilesCB is optional; if provided, it is used to archive up to
+ * archive_concurrency files at a time.  For more information about the
+ * purpose of each callback, refer to the archive modules documentation.
  */
 typedef bool (*ArchiveCheckConfiguredCB) (void);
 typedef bool (*ArchiveFileCB) (const char *file, const char *path);
+typedef void (*ArchiveFilesCB) (int nfiles, const char *const *files,
+								const char *const *paths, bool *succeeded);
 typedef void (*ArchiveShutdownCB) (void);
 
 typedef struct ArchiveModuleCallbacks
@@ -55,6 +67,7 @@ typedef struct ArchiveModuleCallbacks
 	ArchiveCheckConfiguredCB check_configured_cb;
 	ArchiveFileCB archive_file_cb;
 	ArchiveShutdownCB shutdown_cb;
+	ArchiveFilesCB archive_files_cb;
 } ArchiveModuleCallbacks;
 
 /*
@@ -18,6 +18,16 @@
 #include "utils/timestamp.h"
 
 extern PGDLLIMPORT int logical_decoding_work_mem;
+extern PGDLLIMPORT int logical_decoding_spill_compression;
+
+/* possible values for logical_decoding_spill_compression */
+typedef enum LogicalDecodingSpillCompression
+{
+	SPILL_COMPRESSION_NONE = 0,
+	SPILL_COMPRESSION_PGLZ,
+	SPILL_COMPRESSION_LZ4,
+	SPILL_COMPRESSION_ZSTD
+} LogicalDecodingSpillCompression;
 
 /* an individual tuple, stored in one chunk of memory */
 typedef struct ReorderBufferTupleBuf
@@ -601,6 +611,25 @@ struct ReorderBuffer
 	char	   *outbuf;
 	Size		outbufsize;
 
+	/*
+	 * Block of serialized changes being assembled before it is (possibly
+	 * compressed and) written to a spill file, and a buffer to compress it
+	 * into.
+	 */
+	char	   *spillbuf;
+	Size		spillbufsize;
+	Size		spillbuflen;
+	char	   *spillzbuf;
+	Size		spillzbufsize;
+
+	/*
+	 * Decompressed block of a spill file whose changes are being restored.
+	 * A block's changes are always restored together, so all spill files
+	 * being read share this buffer.
+	 */
+	char	   *restorebuf;
+	Size		restorebufsize;
+
 	/* memory accounting */
 	Size		size;
 
@@ -614,6 +643,7 @@ struct ReorderBuffer
 	int64		spillTxns;		/* number of transactions spilled to disk */
 	int64		spillCount;		/* spill-to-disk invocation counter */
 	int64		spillBytes;		/* amount of data spilled to disk */
+	int64		spillDiskBytes; /* amount of data written to spill files */
 
 	/* Statistics about transactions streamed to the decoding output plugin */
 	int64		streamTxns;		/* number of transactions streamed */
@@ -17,8 +17,13 @@
 #include "access/xlogdefs.h"
 #include "catalog/pg_subscription.h"
 #include "datatype/timestamp.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "storage/dsm.h"
 #include "storage/fileset.h"
 #include "storage/lock.h"
+#include "storage/shm_mq.h"
 #include "storage/spin.h"
 
 
@@ -51,6 +56,13 @@ typedef struct LogicalRepWorker
 	XLogRecPtr	relstate_lsn;
 	slock_t		relmutex;
 
+	/*
+	 * PID of the leader if this slot is used for a parallel apply worker (the
+	 * leader being an apply worker) or a table copy worker (the leader being
+	 * the tablesync worker of relid), InvalidPid otherwise.
+	 */
+	pid_t		leader_pid;
+
 	/*
 	 * Used to create the changes and subxact files for the streaming
 	 * transactions.  Upon the arrival of the first streaming transaction, the
@@ -68,9 +80,79 @@ typedef struct LogicalRepWorker
 	TimestampTz reply_time;
 } LogicalRepWorker;
 
+/*
+ * State of the transaction in parallel apply worker.
+ *
+ * The enum values must have the same order as the transaction state
+ * transitions.
+ */
+typedef enum ParallelTransState
+{
+	PARALLEL_TRANS_UNKNOWN,
+	PARALLEL_TRANS_STARTED,
+	PARALLEL_TRANS_FINISHED
+} ParallelTransState;
+
+/*
+ * Struct for sharing information between leader apply worker and parallel
+ * apply workers.
+ */
+typedef struct ParallelApplyWorkerShared
+{
+	slock_t		mutex;
+
+	/* Remote transaction being applied by the parallel apply worker. */
+	TransactionId xid;
+
+	/*
+	 * State used to ensure commit ordering.
+	 *
+	 * The parallel apply worker will set it to PARALLEL_TRANS_FINISHED after
+	 * handling the transaction finish commands while the apply leader will
+	 * wait for it to become PARALLEL_TRANS_FINISHED before proceeding in
+	 * transaction finish commands (e.g. STREAM_COMMIT).
+	 */
+	ParallelTransState xact_state;
+
+	/*
+	 * Number of streaming blocks sent by the leader that the parallel apply
+	 * worker has not processed yet.  See the locking considerations atop
+	 * applyparallelworker.c.
+	 */
+	pg_atomic_uint32 pending_stream_count;
+
+	/*
+	 * The local end LSN of the commit of the transaction, which the leader
+	 * uses to report the flush position to the publisher.
+	 */
+	XLogRecPtr	last_commit_end;
+
+	/* Set by the parallel apply worker when it exits. */
+	bool		exited;
+} ParallelApplyWorkerShared;
+
+/*
+ * Information which is used to manage the parallel apply worker.
+ */
+typedef struct ParallelApplyWorkerInfo
+{
+	/* Queue used to send data from the leader to the parallel apply worker. */
+	shm_mq_handle *mq_handle;
+
+	dsm_segment *dsm_seg;
+
+	/* Is the worker assigned to a transaction? */
+	bool		in_use;
+
+	ParallelApplyWorkerShared *shared;
+} ParallelApplyWorkerInfo;
+
 /* Main memory context for apply worker. Permanent during worker lifetime. */
 extern PGDLLIMPORT MemoryContext ApplyContext;
 
+/* Memory context reset after each replication protocol message. */
+extern PGDLLIMPORT MemoryContext ApplyMessageContext;
+
 /* libpqreceiver connection */
 extern PGDLLIMPORT struct WalReceiverConn *LogRepWorkerWalRcvConn;
 
@@ -80,12 +162,15 @@ extern PGDLLIMPORT LogicalRepWorker *MyLogicalRepWorker;
 
 extern PGDLLIMPORT bool in_remote_transaction;
 
+extern PGDLLIMPORT ParallelApplyWorkerShared *MyParallelShared;
+
 extern void logicalrep_worker_attach(int slot);
 extern LogicalRepWorker *logicalrep_worker_find(Oid subid, Oid relid,
 												bool only_running);
 extern List *logicalrep_workers_find(Oid subid, bool only_running);
-extern void logicalrep_worker_launch(Oid dbid, Oid subid, const char *subname,
-									 Oid userid, Oid relid);
+extern bool logicalrep_worker_launch(Oid dbid, Oid subid, const char *subname,
+									 Oid userid, Oid relid,
+									 dsm_handle subworker_dsm);
 extern void logicalrep_worker_stop(Oid subid, Oid relid);
 extern void logicalrep_worker_wakeup(Oid subid, Oid relid);
 extern void logicalrep_worker_wakeup_ptr(LogicalRepWorker *worker);
@@ -95,6 +180,8 @@ extern int	logicalrep_sync_worker_count(Oid subid);
 extern void ReplicationOriginNameForTablesync(Oid suboid, Oid relid,
 											  char *originname, int szorgname);
 extern char *LogicalRepSyncTableStart(XLogRecPtr *origin_startpos);
+extern void FinishTableCopyTransactions(Oid subid, Oid relid, bool isCommit);
+extern bool TableCopyTransactionsExist(Oid subid);
 
 extern bool AllTablesyncsReady(void);
 extern void UpdateTwoPhaseState(Oid suboid, char new_state);
@@ -103,10 +190,60 @@ extern void process_syncing_tables(XLogRecPtr current_lsn);
 extern void invalidate_syncing_table_states(Datum arg, int cacheid,
 											uint32 hashvalue);
 
+extern void InitializeApplyWorker(void);
+extern void apply_dispatch(StringInfo s);
+extern void apply_error_callback(void *arg);
+extern void set_apply_error_context_origin(char *originname);
+extern void maybe_reread_subscription(void);
+extern void store_flush_position(XLogRecPtr remote_lsn, XLogRecPtr local_lsn);
+
+/* Functions for parallel apply workers */
+extern ParallelApplyWorkerInfo *pa_allocate_worker(TransactionId xid);
+extern ParallelApplyWorkerInfo *pa_find_worker(TransactionId xid);
+extern void pa_send_data(ParallelApplyWorkerInfo *winfo, Size nbytes,
+						 const void *data);
+extern void pa_xact_finish(ParallelApplyWorkerInfo *winfo,
+						   XLogRecPtr remote_lsn);
+extern void pa_set_xact_state(ParallelApplyWorkerShared *wshared,
+							  ParallelTransState xact_state);
+extern void pa_start_subtrans(TransactionId current_xid,
+							  TransactionId top_xid);
+extern void pa_stream_abort(TransactionId xid, TransactionId subxid);
+extern void pa_reset_subtrans(void);
+extern void pa_decr_and_wait_stream_block(void);
+
+extern void pa_lock_stream(TransactionId xid, LOCKMODE lockmode);
+extern void pa_unlock_stream(TransactionId xid, LOCKMODE lockmode);
+extern void pa_lock_transaction(TransactionId xid, LOCKMODE lockmode);
+extern void pa_unlock_transaction(TransactionId xid, LOCKMODE lockmode);
+
+#define isParallelApplyWorker(worker) ((worker)->leader_pid != InvalidPid && \
+									   !OidIsValid((worker)->relid))
+#define isTableCopyWorker(worker) ((worker)->leader_pid != InvalidPid && \
+								   OidIsValid((worker)->relid))
+
 static inline bool
 am_tablesync_worker(void)
 {
 	return OidIsValid(MyLogicalRepWorker->relid);
 }
 
+static inline bool
+am_parallel_apply_worker(void)
+{
+	return isParallelApplyWorker(MyLogicalRepWorker);
+}
+
+static inline bool
+am_table_copy_worker(void)
+{
+	return isTableCopyWorker(MyLogicalRepWorker);
+}
+
+static inline bool
+am_leader_apply_worker(void)
+{
+	return (!am_tablesync_worker() && !am_parallel_apply_worker());
+}
+
 #endif							/* WORKER_INTERNAL_H */
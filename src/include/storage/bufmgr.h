@@ -46,6 +46,10 @@ typedef enum
 								 * replay; otherwise same as RBM_NORMAL */
 } ReadBufferMode;
 
+/* Flags for ExtendBufferedRelBy() */
+#define EB_SKIP_EXTENSION_LOCK	(1 << 0)	/* caller holds extension lock */
+#define EB_LOCK_FIRST			(1 << 1)	/* exclusive-lock first new buffer */
+
 /*
  * Type returned by PrefetchBuffer().
  */
@@ -116,6 +120,10 @@ extern Buffer ReadBufferWithoutRelcache(RelFileLocator rlocator,
 										ForkNumber forkNum, BlockNumber blockNum,
 										ReadBufferMode mode, BufferAccessStrategy strategy,
 										bool permanent);
+extern BlockNumber ExtendBufferedRelBy(Relation rel, ForkNumber forkNum,
+									   BufferAccessStrategy strategy,
+									   uint32 flags, uint32 extend_by,
+									   Buffer *buffers, uint32 *extended_by);
 extern void ReleaseBuffer(Buffer buffer);
 extern void UnlockReleaseBuffer(Buffer buffer);
 extern void MarkBufferDirty(Buffer buffer);
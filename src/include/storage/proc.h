@@ -43,6 +43,8 @@ typedef struct XidCacheStatus
 	uint8		count;
 	/* has PGPROC->subxids overflowed */
 	bool		overflowed;
+	/* if overflowed, are all the uncached subxids in the SubXidMap? */
+	bool		mapped;
 } XidCacheStatus;
 
 struct XidCache
@@ -77,12 +79,22 @@ struct XidCache
 #define		PROC_XMIN_FLAGS (PROC_IN_VACUUM | PROC_IN_SAFE_IC)
 
 /*
- * We allow a small number of "weak" relation locks (AccessShareLock,
- * RowShareLock, RowExclusiveLock) to be recorded in the PGPROC structure
- * rather than the main lock table.  This eases contention on the lock
- * manager LWLocks.  See storage/lmgr/README for additional details.
+ * We allow a limited number of "weak" relation locks (AccessShareLock,
+ * RowShareLock, RowExclusiveLock) to be recorded in per-backend fast-path
+ * arrays referenced from the PGPROC structure, rather than the main lock
+ * table.  This eases contention on the lock manager LWLocks.  See
+ * storage/lmgr/README for additional details.
+ *
+ * The slots are divided into groups of FP_LOCK_SLOTS_PER_GROUP, and each
+ * relation maps to one group.  The number of groups is derived from
+ * max_locks_per_transaction at startup, see InitializeFastPathLocks().
  */
-#define		FP_LOCK_SLOTS_PER_BACKEND 16
+extern PGDLLIMPORT int FastPathLockGroupsPerBackend;
+
+#define		FP_LOCK_GROUPS_PER_BACKEND_MAX	1024
+#define		FP_LOCK_SLOTS_PER_GROUP		16	/* don't change, see lock.c */
+#define		FastPathLockSlotsPerBackend() \
+	(FP_LOCK_SLOTS_PER_GROUP * FastPathLockGroupsPerBackend)
 
 /*
  * An invalid pgprocno.  Must be larger than the maximum number of PGPROC
@@ -284,8 +296,9 @@ struct PGPROC
 
 	/* Lock manager data, recording fast-path locks taken by this backend. */
 	LWLock		fpInfoLock;		/* protects per-backend fast-path state */
-	uint64		fpLockBits;		/* lock modes held for each fast-path slot */
-	Oid			fpRelId[FP_LOCK_SLOTS_PER_BACKEND]; /* slots for rel oids */
+	uint64	   *fpLockBits;		/* lock modes held for each fast-path slot,
+								 * one word per group */
+	Oid		   *fpRelId;		/* slots for rel oids */
 	bool		fpVXIDLock;		/* are we holding a fast-path VXID lock? */
 	LocalTransactionId fpLocalTransactionId;	/* lxid for fast-path VXID
 												 * lock */
@@ -0,0 +1,29 @@
+/*-------------------------------------------------------------------------
+ *
+ * subxidmap.h
+ *	  Shared map from overflowed subtransaction XIDs to top-level XIDs.
+ *
+ *
+ * Portions Copyright (c) 1996-2022, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * src/include/storage/subxidmap.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SUBXIDMAP_H
+#define SUBXIDMAP_H
+
+#include "access/transam.h"
+
+/* GUC variable */
+extern PGDLLIMPORT int max_overflowed_subxids;
+
+extern Size SubXidMapShmemSize(void);
+extern void SubXidMapShmemInit(void);
+
+extern bool SubXidMapInsert(TransactionId subxid, FullTransactionId topxid);
+extern TransactionId SubXidMapLookup(TransactionId xid);
+extern void SubXidMapMaintain(FullTransactionId curxid);
+
+#endif							/* SUBXIDMAP_H */
@@ -140,6 +140,8 @@ typedef struct PortalData
 	CachedPlan *cplan;			/* CachedPlan, if stmts are from one */
 
 	ParamListInfo portalParams; /* params to pass to query */
+	ParamListInfo *batchParams; /* further parameter sets, run in turn */
+	int			numBatchParams; /* number of entries in batchParams */
 	QueryEnvironment *queryEnv; /* environment for query */
 
 	/* Features/options */
@@ -339,6 +339,7 @@ typedef struct StdRdOptions
 	int			parallel_workers;	/* max number of parallel workers */
 	StdRdOptIndexCleanup vacuum_index_cleanup;	/* controls index vacuuming */
 	bool		vacuum_truncate;	/* enables vacuum to truncate a relation */
+	bool		incremental;	/* matview is maintained incrementally */
 } StdRdOptions;
 
 #define HEAP_MIN_FILLFACTOR			10
@@ -385,6 +386,17 @@ typedef struct StdRdOptions
 	  (relation)->rd_rel->relkind == RELKIND_MATVIEW) ? \
 	 ((StdRdOptions *) (relation)->rd_options)->user_catalog_table : false)
 
+/*
+ * RelationIsIncrementallyMaintained
+ *		Returns whether the relation is a materialized view whose REFRESH
+ *		applies logged changes rather than recomputing it.
+ *		Note multiple eval of argument!
+ */
+#define RelationIsIncrementallyMaintained(relation) \
+	((relation)->rd_options && \
+	 (relation)->rd_rel->relkind == RELKIND_MATVIEW ? \
+	 ((StdRdOptions *) (relation)->rd_options)->incremental : false)
+
 /*
  * RelationGetParallelWorkers
  *		Returns the relation's parallel_workers reloption setting.
@@ -116,7 +116,9 @@ typedef struct VariableStatData
  *
  * Callers should initialize all fields of GenericCosts to zero.  In addition,
  * they can set numIndexTuples to some positive value if they have a better
- * than default way of estimating the number of leaf index tuples visited.
+ * than default way of estimating the number of leaf index tuples visited,
+ * and num_sa_scans to the number of primitive index scans the index AM will
+ * do for reasons other than ScalarArrayOpExprs (such as btree skip scans).
  */
 typedef struct
 {
@@ -130,7 +132,8 @@ typedef struct
 	double		numIndexPages;	/* number of leaf pages visited */
 	double		numIndexTuples; /* number of leaf tuples visited */
 	double		spc_random_page_cost;	/* relevant random_page_cost value */
-	double		num_sa_scans;	/* # indexscans from ScalarArrayOpExprs */
+	double		num_sa_scans;	/* # indexscans from ScalarArrayOpExprs (and
+								 * any the caller told us about) */
 } GenericCosts;
 
 /* Hooks for plugins to get control when we ask for stats */
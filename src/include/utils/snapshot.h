@@ -180,6 +180,8 @@ typedef struct SnapshotData
 	TransactionId *subxip;
 	int32		subxcnt;		/* # of xact ids in subxip[] */
 	bool		suboverflowed;	/* has the subxip array overflowed? */
+	bool		subxidmapped;	/* must XIDs not in subxip[] be looked up in
+								 * the SubXidMap? */
 
 	bool		takenDuringRecovery;	/* recovery-shaped snapshot? */
 	bool		copied;			/* false if it's a static snapshot */
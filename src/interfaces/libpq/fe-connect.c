@@ -341,6 +341,10 @@ static const internalPQconninfoOption PQconninfoOptions[] = {
 		"Target-Session-Attrs", "", 15, /* sizeof("prefer-standby") = 15 */
 	offsetof(struct pg_conn, target_session_attrs)},
 
+	{"multirow_bind", NULL, "0", NULL,
+		"Multirow-Bind", "", 1,
+	offsetof(struct pg_conn, multirow_bind)},
+
 	/* Terminating entry --- MUST BE LAST */
 	{NULL, NULL, NULL, NULL,
 	NULL, NULL, 0}
@@ -2936,8 +2940,11 @@ keep_going:						/* We will come back to here until there is
 #endif							/* USE_SSL */
 
 				/*
-				 * Build the startup packet.
+				 * Build the startup packet.  Multi-row Bind is requested
+				 * there, and stays enabled unless the server turns it down.
 				 */
+				conn->multirow_bind_enabled =
+					(conn->multirow_bind && conn->multirow_bind[0] == '1');
 				startpacket = pqBuildStartupPacket3(conn, &packetlen,
 													EnvironmentOptions);
 				if (!startpacket)
@@ -3246,10 +3253,11 @@ keep_going:						/* We will come back to here until there is
 
 				/*
 				 * Validate message type: we expect only an authentication
-				 * request or an error here.  Anything else probably means
-				 * it's not Postgres on the other end at all.
+				 * request, a protocol negotiation or an error here.
+				 * Anything else probably means it's not Postgres on the
+				 * other end at all.
 				 */
-				if (!(beresp == 'R' || beresp == 'E'))
+				if (!(beresp == 'R' || beresp == 'v' || beresp == 'E'))
 				{
 					appendPQExpBuffer(&conn->errorMessage,
 									  libpq_gettext("expected authentication request from server, but received %c\n"),
@@ -3274,7 +3282,8 @@ keep_going:						/* We will come back to here until there is
 				 * server also used the old protocol for errors that happened
 				 * before processing the startup packet.)
 				 */
-				if (beresp == 'R' && (msgLength < 8 || msgLength > 2000))
+				if ((beresp == 'R' || beresp == 'v') &&
+					(msgLength < 8 || msgLength > 2000))
 				{
 					appendPQExpBuffer(&conn->errorMessage,
 									  libpq_gettext("expected authentication request from server, but received %c\n"),
@@ -3406,6 +3415,20 @@ keep_going:						/* We will come back to here until there is
 					goto error_return;
 				}
 
+				/*
+				 * The server doesn't know some of the protocol options we
+				 * asked for.  Authentication follows, unless we can't do
+				 * without them.
+				 */
+				if (beresp == 'v')
+				{
+					if (pqGetNegotiateProtocolVersion3(conn))
+						goto error_return;
+					/* OK, we read the message; mark data consumed */
+					conn->inStart = conn->inCursor;
+					goto keep_going;
+				}
+
 				/* It is an authentication request. */
 				conn->auth_req_received = true;
 
@@ -4086,6 +4109,7 @@ freePGconn(PGconn *conn)
 	free(conn->outBuffer);
 	free(conn->rowBuf);
 	free(conn->target_session_attrs);
+	free(conn->multirow_bind);
 	termPQExpBuffer(&conn->errorMessage);
 	termPQExpBuffer(&conn->workBuffer);
 
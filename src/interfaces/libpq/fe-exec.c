@@ -68,11 +68,17 @@ static int	PQsendQueryGuts(PGconn *conn,
 							const char *command,
 							const char *stmtName,
 							int nParams,
+							int nRows,
 							const Oid *paramTypes,
 							const char *const *paramValues,
 							const int *paramLengths,
 							const int *paramFormats,
 							int resultFormat);
+static int	pqPutParamValues(PGconn *conn,
+							 int nParams,
+							 const char *const *paramValues,
+							 const int *paramLengths,
+							 const int *paramFormats);
 static void parseInput(PGconn *conn);
 static PGresult *getCopyResult(PGconn *conn, ExecStatusType copytype);
 static bool PQexecStart(PGconn *conn);
@@ -1583,6 +1589,7 @@ PQsendQueryParams(PGconn *conn,
 						   command,
 						   "",	/* use unnamed statement */
 						   nParams,
+						   1,	/* one row of parameters */
 						   paramTypes,
 						   paramValues,
 						   paramLengths,
@@ -1728,6 +1735,7 @@ PQsendQueryPrepared(PGconn *conn,
 						   NULL,	/* no command to parse */
 						   stmtName,
 						   nParams,
+						   1,	/* one row of parameters */
 						   NULL,	/* no param types */
 						   paramValues,
 						   paramLengths,
@@ -1735,6 +1743,68 @@ PQsendQueryPrepared(PGconn *conn,
 						   resultFormat);
 }
 
+/*
+ * PQsendPreparedBatch
+ *		Like PQsendQueryPrepared, but execute the statement once for each of
+ *		nRows rows of parameters, which are all sent in one Bind message
+ *
+ * paramValues and paramLengths hold nParams entries for each row, one row
+ * after the other, while paramFormats applies to all rows.  Several rows
+ * need a connection made with multirow_bind=1 to a server that supports it,
+ * and a statement that returns no rows.  The result reports the total
+ * number of rows affected.
+ */
+int
+PQsendPreparedBatch(PGconn *conn,
+					const char *stmtName,
+					int nParams,
+					int nRows,
+					const char *const *paramValues,
+					const int *paramLengths,
+					const int *paramFormats)
+{
+	if (!PQsendQueryStart(conn, true))
+		return 0;
+
+	/* check the arguments */
+	if (!stmtName)
+	{
+		appendPQExpBufferStr(&conn->errorMessage,
+							 libpq_gettext("statement name is a null pointer\n"));
+		return 0;
+	}
+	if (nParams < 0 || nParams > PQ_QUERY_PARAM_MAX_LIMIT)
+	{
+		appendPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("number of parameters must be between 0 and %d\n"),
+						  PQ_QUERY_PARAM_MAX_LIMIT);
+		return 0;
+	}
+	if (nRows < 1)
+	{
+		appendPQExpBufferStr(&conn->errorMessage,
+							 libpq_gettext("number of rows must be at least 1\n"));
+		return 0;
+	}
+	if (nRows > 1 && !conn->multirow_bind_enabled)
+	{
+		appendPQExpBufferStr(&conn->errorMessage,
+							 libpq_gettext("multi-row Bind is not enabled on this connection\n"));
+		return 0;
+	}
+
+	return PQsendQueryGuts(conn,
+						   NULL,	/* no command to parse */
+						   stmtName,
+						   nParams,
+						   nRows,
+						   NULL,	/* no param types */
+						   paramValues,
+						   paramLengths,
+						   paramFormats,
+						   0);	/* no rows are returned */
+}
+
 /*
  * PQsendQueryStart
  *	Common startup code for PQsendQuery and sibling routines
@@ -1823,12 +1893,16 @@ PQsendQueryStart(PGconn *conn, bool newQuery)
  *		PQsendQueryStart should be done already
  *
  * command may be NULL to indicate we use an already-prepared statement
+ *
+ * paramValues and paramLengths hold nParams entries for each of nRows rows;
+ * rows after the first one are sent as a multi-row Bind
  */
 static int
 PQsendQueryGuts(PGconn *conn,
 				const char *command,
 				const char *stmtName,
 				int nParams,
+				int nRows,
 				const Oid *paramTypes,
 				const char *const *paramValues,
 				const int *paramLengths,
@@ -1897,47 +1971,32 @@ PQsendQueryGuts(PGconn *conn,
 			goto sendFailed;
 	}
 
-	if (pqPutInt(nParams, 2, conn) < 0)
+	/* Send parameters */
+	if (pqPutInt(nParams, 2, conn) < 0 ||
+		pqPutParamValues(conn, nParams, paramValues, paramLengths,
+						 paramFormats) < 0)
+		goto sendFailed;
+	if (pqPutInt(1, 2, conn) < 0 ||
+		pqPutInt(resultFormat, 2, conn))
 		goto sendFailed;
 
-	/* Send parameters */
-	for (i = 0; i < nParams; i++)
+	/* Send the count of the other rows, and their parameters */
+	if (nRows > 1)
 	{
-		if (paramValues && paramValues[i])
+		if (pqPutInt(nRows - 1, 4, conn) < 0)
+			goto sendFailed;
+		for (i = 1; i < nRows; i++)
 		{
-			int			nbytes;
+			size_t		offset = (size_t) i * nParams;
 
-			if (paramFormats && paramFormats[i] != 0)
-			{
-				/* binary parameter */
-				if (paramLengths)
-					nbytes = paramLengths[i];
-				else
-				{
-					appendPQExpBufferStr(&conn->errorMessage,
-										 libpq_gettext("length must be given for binary parameter\n"));
-					goto sendFailed;
-				}
-			}
-			else
-			{
-				/* text parameter, do not use paramLengths */
-				nbytes = strlen(paramValues[i]);
-			}
-			if (pqPutInt(nbytes, 4, conn) < 0 ||
-				pqPutnchar(paramValues[i], nbytes, conn) < 0)
-				goto sendFailed;
-		}
-		else
-		{
-			/* take the param as NULL */
-			if (pqPutInt(-1, 4, conn) < 0)
+			if (pqPutInt(nParams, 2, conn) < 0 ||
+				pqPutParamValues(conn, nParams,
+								 paramValues ? paramValues + offset : NULL,
+								 paramLengths ? paramLengths + offset : NULL,
+								 paramFormats) < 0)
 				goto sendFailed;
 		}
 	}
-	if (pqPutInt(1, 2, conn) < 0 ||
-		pqPutInt(resultFormat, 2, conn))
-		goto sendFailed;
 	if (pqPutMsgEnd(conn) < 0)
 		goto sendFailed;
 
@@ -1990,6 +2049,59 @@ sendFailed:
 	return 0;
 }
 
+/*
+ * pqPutParamValues
+ *		Put one row of parameter values of a Bind message
+ *
+ * Returns 0 on success, EOF on failure
+ */
+static int
+pqPutParamValues(PGconn *conn,
+				 int nParams,
+				 const char *const *paramValues,
+				 const int *paramLengths,
+				 const int *paramFormats)
+{
+	int			i;
+
+	for (i = 0; i < nParams; i++)
+	{
+		if (paramValues && paramValues[i])
+		{
+			int			nbytes;
+
+			if (paramFormats && paramFormats[i] != 0)
+			{
+				/* binary parameter */
+				if (paramLengths)
+					nbytes = paramLengths[i];
+				else
+				{
+					appendPQExpBufferStr(&conn->errorMessage,
+										 libpq_gettext("length must be given for binary parameter\n"));
+					return EOF;
+				}
+			}
+			else
+			{
+				/* text parameter, do not use paramLengths */
+				nbytes = strlen(paramValues[i]);
+			}
+			if (pqPutInt(nbytes, 4, conn) < 0 ||
+				pqPutnchar(paramValues[i], nbytes, conn) < 0)
+				return EOF;
+		}
+		else
+		{
+			/* take the param as NULL */
+			if (pqPutInt(-1, 4, conn) < 0)
+				return EOF;
+		}
+	}
+
+	return 0;
+}
+
 /*
  * Select row-by-row processing mode
  */
@@ -2390,6 +2502,29 @@ PQexecPrepared(PGconn *conn,
 	return PQexecFinish(conn);
 }
 
+/*
+ * PQexecPreparedBatch
+ *		Like PQexecPrepared, but execute the statement for several rows of
+ *		parameters, see PQsendPreparedBatch
+ */
+PGresult *
+PQexecPreparedBatch(PGconn *conn,
+					const char *stmtName,
+					int nParams,
+					int nRows,
+					const char *const *paramValues,
+					const int *paramLengths,
+					const int *paramFormats)
+{
+	if (!PQexecStart(conn))
+		return NULL;
+	if (!PQsendPreparedBatch(conn, stmtName,
+							 nParams, nRows, paramValues, paramLengths,
+							 paramFormats))
+		return NULL;
+	return PQexecFinish(conn);
+}
+
 /*
  * Common code for PQexec and sibling routines: prepare to send command
  */
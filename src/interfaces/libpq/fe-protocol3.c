@@ -2190,6 +2190,62 @@ pqFunctionCall3(PGconn *conn, Oid fnid,
 }
 
 
+/*
+ * Attempt to read a NegotiateProtocolVersion message, which the server sends
+ * instead of rejecting protocol options or a protocol minor version that it
+ * doesn't support.  Entire message has already been read.
+ *
+ * Returns 0 if the connection can proceed, or EOF after adding an error
+ * message.
+ */
+int
+pqGetNegotiateProtocolVersion3(PGconn *conn)
+{
+	int			their_version;
+	int			num;
+	int			i;
+
+	if (pqGetInt(&their_version, 4, conn) != 0 ||
+		pqGetInt(&num, 4, conn) != 0)
+		goto invalid;
+
+	if ((ProtocolVersion) their_version < conn->pversion)
+	{
+		appendPQExpBuffer(&conn->errorMessage,
+						  libpq_gettext("protocol version not supported by server: client uses %u.%u, server supports up to %u.%u\n"),
+						  PG_PROTOCOL_MAJOR(conn->pversion),
+						  PG_PROTOCOL_MINOR(conn->pversion),
+						  PG_PROTOCOL_MAJOR(their_version),
+						  PG_PROTOCOL_MINOR(their_version));
+		return EOF;
+	}
+
+	for (i = 0; i < num; i++)
+	{
+		if (pqGets(&conn->workBuffer, conn))
+			goto invalid;
+
+		/* We can do without multi-row Bind */
+		if (strcmp(conn->workBuffer.data, "_pq_.multirow_bind") == 0)
+			conn->multirow_bind_enabled = false;
+		else
+		{
+			appendPQExpBuffer(&conn->errorMessage,
+							  libpq_gettext("protocol extension not supported by server: %s\n"),
+							  conn->workBuffer.data);
+			return EOF;
+		}
+	}
+
+	return 0;
+
+invalid:
+	appendPQExpBuffer(&conn->errorMessage,
+					  libpq_gettext("invalid %s message\n"),
+					  "NegotiateProtocolVersion");
+	return EOF;
+}
+
 /*
  * Construct startup packet
  *
@@ -2266,6 +2322,10 @@ build_startup_packet(const PGconn *conn, char *packet,
 	if (conn->client_encoding_initial && conn->client_encoding_initial[0])
 		ADD_STARTUP_OPTION("client_encoding", conn->client_encoding_initial);
 
+	/* Protocol extensions */
+	if (conn->multirow_bind_enabled)
+		ADD_STARTUP_OPTION("_pq_.multirow_bind", "true");
+
 	/* Add any environment-driven GUC settings needed */
 	for (next_eo = options; next_eo->envName; next_eo++)
 	{
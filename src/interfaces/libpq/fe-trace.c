@@ -227,9 +227,10 @@ pqTraceOutputA(FILE *f, const char *message, int *cursor, bool regress)
 
 /* Bind */
 static void
-pqTraceOutputB(FILE *f, const char *message, int *cursor)
+pqTraceOutputB(FILE *f, const char *message, int *cursor, int length)
 {
 	int			nparams;
+	int			nrows;
 
 	fprintf(f, "Bind\t");
 	pqTraceOutputString(f, message, cursor, false);
@@ -254,6 +255,24 @@ pqTraceOutputB(FILE *f, const char *message, int *cursor)
 	nparams = pqTraceOutputInt16(f, message, cursor);
 	for (int i = 0; i < nparams; i++)
 		pqTraceOutputInt16(f, message, cursor);
+
+	/* Further rows of parameters of a multi-row Bind */
+	if (*cursor - 1 >= length)
+		return;
+	nrows = pqTraceOutputInt32(f, message, cursor, false);
+	for (int row = 0; row < nrows; row++)
+	{
+		nparams = pqTraceOutputInt16(f, message, cursor);
+		for (int i = 0; i < nparams; i++)
+		{
+			int			nbytes;
+
+			nbytes = pqTraceOutputInt32(f, message, cursor, false);
+			if (nbytes == -1)
+				continue;
+			pqTraceOutputNchar(f, nbytes, message, cursor);
+		}
+	}
 }
 
 /* Close(F) or CommandComplete(B) */
@@ -578,7 +597,7 @@ pqTraceOutputMessage(PGconn *conn, const char *message, bool toServer)
 			pqTraceOutputA(conn->Pfdebug, message, &logCursor, regress);
 			break;
 		case 'B':				/* Bind */
-			pqTraceOutputB(conn->Pfdebug, message, &logCursor);
+			pqTraceOutputB(conn->Pfdebug, message, &logCursor, length);
 			break;
 		case 'c':
 			fprintf(conn->Pfdebug, "CopyDone");
@@ -438,6 +438,13 @@ extern PGresult *PQexecPrepared(PGconn *conn,
 								const int *paramLengths,
 								const int *paramFormats,
 								int resultFormat);
+extern PGresult *PQexecPreparedBatch(PGconn *conn,
+									 const char *stmtName,
+									 int nParams,
+									 int nRows,
+									 const char *const *paramValues,
+									 const int *paramLengths,
+									 const int *paramFormats);
 
 /* Interface for multiple-result or asynchronous queries */
 #define PQ_QUERY_PARAM_MAX_LIMIT 65535
@@ -461,6 +468,13 @@ extern int	PQsendQueryPrepared(PGconn *conn,
 								const int *paramLengths,
 								const int *paramFormats,
 								int resultFormat);
+extern int	PQsendPreparedBatch(PGconn *conn,
+								const char *stmtName,
+								int nParams,
+								int nRows,
+								const char *const *paramValues,
+								const int *paramLengths,
+								const int *paramFormats);
 extern int	PQsetSingleRowMode(PGconn *conn);
 extern PGresult *PQgetResult(PGconn *conn);
 
@@ -0,0 +1,62 @@
+# Shared subxid map
+#
+# Subtransaction XIDs that don't fit in a backend's PGPROC cache are entered
+# in the shared subxid map, which other sessions consult to check whether a
+# row's inserting XID belongs to a running transaction.  Make sure rows
+# written in such subtransactions stay invisible until their top-level
+# transaction commits, and that rows from aborted subtransactions never
+# become visible.
+
+setup
+{
+CREATE TABLE subxmap (subx integer, owner text);
+
+CREATE FUNCTION subxmap_fill (who text, n integer)
+ RETURNS VOID
+ LANGUAGE plpgsql
+AS $$
+BEGIN
+  FOR i IN 1..n LOOP
+    BEGIN /* generates a subxid */
+      INSERT INTO subxmap VALUES (i, who);
+      IF i % 10 = 0 THEN
+        RAISE EXCEPTION 'abort this one';
+      END IF;
+    EXCEPTION
+      WHEN raise_exception THEN NULL;
+    END;
+  END LOOP;
+END;
+$$;
+}
+
+teardown
+{
+ DROP TABLE subxmap;
+ DROP FUNCTION subxmap_fill(text, integer);
+}
+
+session s1
+# 100 subxids, overflowing the PGPROC cache
+step s1b	{ BEGIN; SELECT subxmap_fill('s1', 100); }
+step s1sel	{ SELECT count(*), max(subx) FROM subxmap WHERE owner = 's1'; }
+step s1c	{ COMMIT; }
+step s1a	{ ROLLBACK; }
+
+session s2
+# a second overflowed transaction sharing the map
+step s2b	{ BEGIN; SELECT subxmap_fill('s2', 80); }
+step s2c	{ COMMIT; }
+
+session s3
+step s3brr	{ BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step s3brc	{ BEGIN ISOLATION LEVEL READ COMMITTED; }
+step s3sel	{ SELECT owner, count(*), max(subx) FROM subxmap GROUP BY owner ORDER BY owner; }
+step s3c	{ COMMIT; }
+
+# invisible while running, and to snapshots taken while running
+permutation s1b s2b s3brr s3sel s1sel s1c s3sel s2c s3sel s3c s3sel
+# visible to new snapshots once committed
+permutation s1b s2b s3brc s3sel s1c s3sel s2c s3sel s3c
+# never visible if the top-level transaction aborts
+permutation s1b s3brc s3sel s1a s3sel s3c
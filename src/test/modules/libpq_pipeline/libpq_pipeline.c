@@ -230,6 +230,165 @@ test_multi_pipelines(PGconn *conn)
 	fprintf(stderr, "ok\n");
 }
 
+/*
+ * Test multi-row Bind.  It has to be requested when connecting; then a batch
+ * of rows is inserted by a single Bind and Execute, and a failing batch
+ * inserts none of its rows.
+ */
+static void
+test_multirow_bind(PGconn *conn, const char *conninfo, int n_rows)
+{
+	const char *const keywords[] = {"dbname", "multirow_bind", NULL};
+	const char *const values[] = {conninfo, "1", NULL};
+	PGconn	   *mconn;
+	PGresult   *res;
+	const char **paramValues;
+	char		cmdtag[32];
+	int			nnulls = 0;
+
+	fprintf(stderr, "multirow bind... ");
+
+	res = PQexec(conn, "DROP TABLE IF EXISTS pq_multirow_bind;"
+				 "CREATE TABLE pq_multirow_bind (id int PRIMARY KEY, val text)");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pg_fatal("failed to create table: %s", PQerrorMessage(conn));
+	PQclear(res);
+
+	res = PQprepare(conn, "ins", "INSERT INTO pq_multirow_bind VALUES ($1, $2)",
+					2, NULL);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pg_fatal("failed to prepare query: %s", PQerrorMessage(conn));
+	PQclear(res);
+
+	/* Parameters for ids 1 to n_rows + 1, with some null values */
+	paramValues = pg_malloc(sizeof(char *) * 2 * (n_rows + 1));
+	for (int i = 0; i <= n_rows; i++)
+	{
+		paramValues[2 * i] = psprintf("%d", i + 1);
+		if (i % 10 == 5)
+		{
+			paramValues[2 * i + 1] = NULL;
+			nnulls++;
+		}
+		else
+			paramValues[2 * i + 1] = psprintf("value %d", i + 1);
+	}
+
+	/* Without multirow_bind, only one row can be sent */
+	res = PQexecPreparedBatch(conn, "ins", 2, 2, paramValues, NULL, NULL);
+	if (res != NULL)
+		pg_fatal("multi-row batch succeeded without multirow_bind");
+	if (strstr(PQerrorMessage(conn), "multi-row Bind is not enabled") == NULL)
+		pg_fatal("unexpected error: %s", PQerrorMessage(conn));
+	res = PQexecPreparedBatch(conn, "ins", 2, 1, paramValues, NULL, NULL);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pg_fatal("single-row batch failed: %s", PQerrorMessage(conn));
+	if (strcmp(PQcmdStatus(res), "INSERT 0 1") != 0)
+		pg_fatal("unexpected command status: %s", PQcmdStatus(res));
+	PQclear(res);
+
+	mconn = PQconnectdbParams(keywords, values, 1);
+	if (PQstatus(mconn) != CONNECTION_OK)
+		pg_fatal("connection with multirow_bind failed: %s",
+				 PQerrorMessage(mconn));
+
+	res = PQprepare(mconn, "ins", "INSERT INTO pq_multirow_bind VALUES ($1, $2)",
+					2, NULL);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pg_fatal("failed to prepare query: %s", PQerrorMessage(mconn));
+	PQclear(res);
+
+	/* All the other rows in one batch */
+	res = PQexecPreparedBatch(mconn, "ins", 2, n_rows, paramValues + 2,
+							  NULL, NULL);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pg_fatal("batch failed: %s", PQerrorMessage(mconn));
+	snprintf(cmdtag, sizeof(cmdtag), "INSERT 0 %d", n_rows);
+	if (strcmp(PQcmdStatus(res), cmdtag) != 0)
+		pg_fatal("unexpected command status: %s", PQcmdStatus(res));
+	PQclear(res);
+
+	res = PQexec(mconn, "SELECT count(*), count(val), max(id) FROM pq_multirow_bind");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pg_fatal("failed to count rows: %s", PQerrorMessage(mconn));
+	if (atoi(PQgetvalue(res, 0, 0)) != n_rows + 1 ||
+		atoi(PQgetvalue(res, 0, 1)) != n_rows + 1 - nnulls ||
+		atoi(PQgetvalue(res, 0, 2)) != n_rows + 1)
+		pg_fatal("unexpected table contents: %s, %s, %s",
+				 PQgetvalue(res, 0, 0), PQgetvalue(res, 0, 1),
+				 PQgetvalue(res, 0, 2));
+	PQclear(res);
+
+	/*
+	 * In a pipeline, a batch whose second row violates the primary key is
+	 * rolled back entirely, and the batch in the next transaction goes in.
+	 */
+	if (n_rows < 6)
+		pg_fatal("need at least 6 rows");
+	res = PQexec(mconn, "DELETE FROM pq_multirow_bind WHERE id > 2 AND id <> 4");
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pg_fatal("failed to delete rows: %s", PQerrorMessage(mconn));
+	PQclear(res);
+
+	if (PQenterPipelineMode(mconn) != 1)
+		pg_fatal("failed to enter pipeline mode: %s", PQerrorMessage(mconn));
+	if (PQsendPreparedBatch(mconn, "ins", 2, 3, paramValues + 4,
+							NULL, NULL) != 1)
+		pg_fatal("failed to send batch: %s", PQerrorMessage(mconn));
+	if (PQpipelineSync(mconn) != 1)
+		pg_fatal("pipeline sync failed: %s", PQerrorMessage(mconn));
+	if (PQsendPreparedBatch(mconn, "ins", 2, 3, paramValues + 8,
+							NULL, NULL) != 1)
+		pg_fatal("failed to send batch: %s", PQerrorMessage(mconn));
+	if (PQpipelineSync(mconn) != 1)
+		pg_fatal("pipeline sync failed: %s", PQerrorMessage(mconn));
+
+	res = PQgetResult(mconn);
+	if (PQresultStatus(res) != PGRES_FATAL_ERROR)
+		pg_fatal("expected FATAL_ERROR, got %s",
+				 PQresStatus(PQresultStatus(res)));
+	if (strcmp(PQresultErrorField(res, PG_DIAG_SQLSTATE), "23505") != 0)
+		pg_fatal("unexpected error: %s", PQresultErrorMessage(res));
+	PQclear(res);
+	res = PQgetResult(mconn);
+	if (res != NULL)
+		pg_fatal("expected NULL result");
+	res = PQgetResult(mconn);
+	if (PQresultStatus(res) != PGRES_PIPELINE_SYNC)
+		pg_fatal("expected PGRES_PIPELINE_SYNC, got %s",
+				 PQresStatus(PQresultStatus(res)));
+	PQclear(res);
+
+	res = PQgetResult(mconn);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pg_fatal("expected COMMAND_OK, got %s: %s",
+				 PQresStatus(PQresultStatus(res)), PQerrorMessage(mconn));
+	if (strcmp(PQcmdStatus(res), "INSERT 0 3") != 0)
+		pg_fatal("unexpected command status: %s", PQcmdStatus(res));
+	PQclear(res);
+	res = PQgetResult(mconn);
+	if (res != NULL)
+		pg_fatal("expected NULL result");
+	res = PQgetResult(mconn);
+	if (PQresultStatus(res) != PGRES_PIPELINE_SYNC)
+		pg_fatal("expected PGRES_PIPELINE_SYNC, got %s",
+				 PQresStatus(PQresultStatus(res)));
+	PQclear(res);
+
+	if (PQexitPipelineMode(mconn) != 1)
+		pg_fatal("could not exit pipeline mode: %s", PQerrorMessage(mconn));
+
+	res = PQexec(mconn, "SELECT string_agg(id::text, ',' ORDER BY id) FROM pq_multirow_bind");
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pg_fatal("failed to read rows: %s", PQerrorMessage(mconn));
+	if (strcmp(PQgetvalue(res, 0, 0), "1,2,4,5,6,7") != 0)
+		pg_fatal("unexpected rows: %s", PQgetvalue(res, 0, 0));
+	PQclear(res);
+
+	PQfinish(mconn);
+	fprintf(stderr, "ok\n");
+}
+
 /*
  * Test behavior when a pipeline dispatches a number of commands that are
  * not flushed by a sync point.
@@ -1748,6 +1907,7 @@ print_test_list(void)
 {
 	printf("disallowed_in_pipeline\n");
 	printf("multi_pipelines\n");
+	printf("multirow_bind\n");
 	printf("nosync\n");
 	printf("pipeline_abort\n");
 	printf("pipeline_idle\n");
@@ -1851,6 +2011,8 @@ main(int argc, char **argv)
 		test_disallowed_in_pipeline(conn);
 	else if (strcmp(testname, "multi_pipelines") == 0)
 		test_multi_pipelines(conn);
+	else if (strcmp(testname, "multirow_bind") == 0)
+		test_multirow_bind(conn, conninfo, numrows);
 	else if (strcmp(testname, "nosync") == 0)
 		test_nosync(conn);
 	else if (strcmp(testname, "pipeline_abort") == 0)
@@ -0,0 +1,107 @@
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test parallel redo on a hot standby.  Index entries must not become
+# visible before the heap tuples they point to, or index-only scans could
+# return rows inserted by transactions that haven't committed, from pages
+# whose all-visible bit hasn't been cleared yet.
+
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node_primary = PostgreSQL::Test::Cluster->new('primary');
+$node_primary->init(allows_streaming => 1);
+$node_primary->append_conf('postgresql.conf', 'max_prepared_transactions = 10');
+$node_primary->start;
+
+my $backup_name = 'my_backup';
+$node_primary->backup($backup_name);
+
+my $node_standby = PostgreSQL::Test::Cluster->new('standby');
+$node_standby->init_from_backup($node_primary, $backup_name,
+	has_streaming => 1);
+$node_standby->append_conf(
+	'postgresql.conf', qq[
+recovery_parallel_workers = 4
+max_worker_processes = 12
+]);
+$node_standby->start;
+
+$node_standby->wait_for_log(qr/using 4 parallel redo workers/);
+pass('parallel redo workers started');
+
+# Leave some free space on all-visible pages, so that the inserts below
+# clear all-visible bits.
+$node_primary->safe_psql(
+	'postgres', q[
+CREATE TABLE pr_tab (a int, b text);
+CREATE INDEX pr_tab_a ON pr_tab (a);
+INSERT INTO pr_tab SELECT i, md5(i::text) FROM generate_series(1, 10000) i;
+DELETE FROM pr_tab WHERE a % 10 = 0;
+VACUUM pr_tab;
+]);
+$node_primary->wait_for_catchup($node_standby);
+
+my $ios = q[
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SET enable_indexscan = off;
+];
+my $indexscan = q[
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SET enable_indexonlyscan = off;
+];
+
+like(
+	$node_standby->safe_psql(
+		'postgres',
+		$ios . 'EXPLAIN (COSTS OFF) SELECT count(*) FROM pr_tab WHERE a > 5000;'),
+	qr/Index Only Scan/,
+	'standby uses an index-only scan');
+is( $node_standby->safe_psql(
+		'postgres', $ios . 'SELECT count(*) FROM pr_tab WHERE a > 5000;'),
+	'4500',
+	'index-only scan sees the initial rows');
+
+# Insert rows into the free space, in several transactions that stay
+# uncommitted.  Each round gives the standby another chance to replay an
+# index insertion ahead of its heap insertion.
+for my $round (1 .. 5)
+{
+	my $lo = 10000 + $round * 1000;
+	my $hi = $lo + 199;
+
+	$node_primary->safe_psql(
+		'postgres', qq[
+BEGIN;
+INSERT INTO pr_tab SELECT i, md5(i::text) FROM generate_series($lo, $hi) i;
+PREPARE TRANSACTION 'pr_$round';
+]);
+}
+$node_primary->wait_for_catchup($node_standby);
+
+is( $node_standby->safe_psql(
+		'postgres', $ios . 'SELECT count(*) FROM pr_tab WHERE a > 10000;'),
+	'0',
+	'index-only scan does not see uncommitted rows');
+is( $node_standby->safe_psql(
+		'postgres', $indexscan . 'SELECT count(*) FROM pr_tab WHERE a > 10000;'),
+	'0',
+	'index scan does not see uncommitted rows');
+
+$node_primary->safe_psql('postgres', "COMMIT PREPARED 'pr_$_'") for (1 .. 5);
+$node_primary->wait_for_catchup($node_standby);
+
+is( $node_standby->safe_psql(
+		'postgres', $ios . 'SELECT count(*) FROM pr_tab WHERE a > 10000;'),
+	'1000',
+	'index-only scan sees committed rows');
+is( $node_standby->safe_psql(
+		'postgres', 'SELECT count(*) FROM pr_tab WHERE a > 10000;'),
+	'1000',
+	'sequential scan agrees');
+
+done_testing();
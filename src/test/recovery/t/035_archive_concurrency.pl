@@ -0,0 +1,110 @@
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test archiving with archive_concurrency > 1, where the archive command
+# fails for one file in the middle of a batch.
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+if ($PostgreSQL::Test::Utils::windows_os)
+{
+	plan skip_all => 'archive command uses a POSIX shell';
+}
+
+my $primary = PostgreSQL::Test::Cluster->new('primary');
+$primary->init(has_archiving => 1);
+$primary->append_conf(
+	'postgresql.conf', q{
+autovacuum = off
+archive_concurrency = 4
+});
+$primary->start;
+my $primary_data = $primary->data_dir;
+my $archive_dir  = $primary->archive_dir;
+
+# The command fails for any file for which a marker file exists.
+my $marker_dir = $primary->basedir;
+my $archive_command =
+  qq{test ! -f "$marker_dir/fail_%f" && cp "%p" "$archive_dir/%f"};
+
+# Stop archiving while we queue up a batch of segments.
+$primary->safe_psql(
+	'postgres', q{
+	ALTER SYSTEM SET archive_command TO '';
+	SELECT pg_reload_conf();
+});
+
+my @segments;
+$primary->safe_psql('postgres', 'CREATE TABLE mine (x int)');
+for my $i (1 .. 4)
+{
+	push @segments,
+	  $primary->safe_psql('postgres',
+		q{SELECT pg_walfile_name(pg_current_wal_lsn())});
+	$primary->safe_psql(
+		'postgres', qq{
+		INSERT INTO mine VALUES ($i);
+		SELECT pg_switch_wal();
+	});
+}
+
+my $failing = $segments[1];
+open my $fh, '>', "$marker_dir/fail_$failing"
+  or die "could not create marker file: $!";
+close $fh;
+
+$primary->safe_psql(
+	'postgres', qq{
+	ALTER SYSTEM SET archive_command TO '$archive_command';
+	SELECT pg_reload_conf();
+});
+
+# Wait until the other files of the batch are archived and the failing one
+# has failed at least once.
+$primary->poll_query_until(
+	'postgres', qq{
+	SELECT failed_count > 0 AND last_failed_wal = '$failing'
+	FROM pg_stat_archiver})
+  or die "Timed out while waiting for archiving to fail";
+for my $segment (@segments)
+{
+	next if $segment eq $failing;
+	$primary->poll_query_until('postgres',
+		qq{SELECT count(*) = 1 FROM pg_ls_archive_statusdir()
+		   WHERE name = '$segment.done'})
+	  or die "Timed out while waiting for $segment to be archived";
+}
+ok(-f "$archive_dir/$segments[0]" && -f "$archive_dir/$segments[3]",
+	'files around the failing one were archived');
+ok( -f "$primary_data/pg_wal/archive_status/$failing.ready",
+	".ready file remains for the failing segment $failing");
+ok(!-f "$archive_dir/$failing", "failing segment $failing was not archived");
+
+# Unconfigure archiving while the failed file is being retried, then fix
+# the problem and restore the command.  The archiver must find the file
+# again without waiting for its periodic directory scan.
+my $log_offset = -s $primary->logfile;
+$primary->safe_psql(
+	'postgres', q{
+	ALTER SYSTEM SET archive_command TO '';
+	SELECT pg_reload_conf();
+});
+$primary->wait_for_log(qr/archiving is not configured/, $log_offset);
+
+unlink "$marker_dir/fail_$failing"
+  or die "could not remove marker file: $!";
+$primary->safe_psql(
+	'postgres', qq{
+	ALTER SYSTEM SET archive_command TO '$archive_command';
+	SELECT pg_reload_conf();
+});
+
+$primary->poll_query_until('postgres',
+	qq{SELECT count(*) = 1 FROM pg_ls_archive_statusdir()
+	   WHERE name = '$failing.done'})
+  or die "Timed out while waiting for $failing to be archived";
+ok(-f "$archive_dir/$failing", "segment $failing archived after retry");
+
+done_testing();
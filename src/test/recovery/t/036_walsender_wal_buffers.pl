@@ -0,0 +1,73 @@
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test that walsenders read recent WAL from the WAL buffers rather than from
+# the WAL segment files, for both physical and logical replication.  Reads
+# from the WAL buffers are counted in pg_stat_wal.wal_buffers_hit, which a
+# walsender reports when it exits.
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+my $node_primary = PostgreSQL::Test::Cluster->new('primary');
+$node_primary->init(allows_streaming => 'logical');
+$node_primary->append_conf('postgresql.conf', 'wal_buffers = 4MB');
+$node_primary->start;
+
+my $backup_name = 'my_backup';
+$node_primary->backup($backup_name);
+
+my $node_standby = PostgreSQL::Test::Cluster->new('standby');
+$node_standby->init_from_backup($node_primary, $backup_name,
+	has_streaming => 1);
+$node_standby->start;
+
+$node_primary->safe_psql('postgres',
+	"SELECT pg_create_logical_replication_slot('test_slot', 'test_decoding')");
+
+# A small amount of WAL, which stays in the WAL buffers.
+$node_primary->safe_psql(
+	'postgres', q{
+CREATE TABLE tab_int (a int);
+INSERT INTO tab_int SELECT generate_series(1, 10);
+});
+$node_primary->wait_for_catchup($node_standby);
+
+is($node_standby->safe_psql('postgres', 'SELECT count(*) FROM tab_int'),
+	'10', 'standby has replicated the rows');
+
+# Stopping the standby makes its walsender exit and report its statistics.
+$node_standby->stop;
+$node_primary->poll_query_until('postgres',
+	"SELECT wal_buffers_hit > 0 FROM pg_stat_wal")
+  or die "Timed out while waiting for the physical walsender's statistics";
+pass('physical walsender read WAL from WAL buffers');
+
+my $endpos = $node_primary->safe_psql('postgres',
+	"SELECT lsn FROM pg_logical_slot_peek_changes('test_slot', NULL, NULL) ORDER BY lsn DESC LIMIT 1"
+);
+
+$node_primary->safe_psql('postgres', "SELECT pg_stat_reset_shared('wal')");
+is($node_primary->safe_psql('postgres', 'SELECT wal_buffers_hit FROM pg_stat_wal'),
+	'0', 'WAL statistics were reset');
+
+my $stdout_recv = $node_primary->pg_recvlogical_upto(
+	'postgres', 'test_slot', $endpos,
+	$PostgreSQL::Test::Utils::timeout_default,
+	'include-xids'     => '0',
+	'skip-empty-xacts' => '1');
+like(
+	$stdout_recv,
+	qr/table public.tab_int: INSERT: a\[integer\]:10/,
+	'logical walsender decoded the changes');
+
+# The walsender exits once pg_recvlogical has reached the end position.
+$node_primary->poll_query_until('postgres',
+	"SELECT wal_buffers_hit > 0 FROM pg_stat_wal")
+  or die "Timed out while waiting for the logical walsender's statistics";
+pass('logical walsender read WAL from WAL buffers');
+
+$node_primary->stop;
+
+done_testing();
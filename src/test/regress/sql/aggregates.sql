@@ -804,6 +804,41 @@ from unnest('{fred,jim,fred,jack,jill,fred,jill,jim,jim,sheila,jim,sheila}'::tex
 select pg_collation_for(percentile_disc(1) within group (order by x collate "POSIX"))
   from (values ('fred'),('jim')) v(x);
 
+-- approx_percentile is exact for small inputs
+select p, approx_percentile(x, p), percentile_cont(p) within group (order by x)
+from generate_series(1,5) x,
+     (values (0::float8),(0.1),(0.25),(0.4),(0.5),(0.6),(0.75),(0.9),(1)) v(p)
+group by p order by p;
+select p, abs(approx_percentile(thousand, p) -
+              percentile_cont(p) within group (order by thousand)) < 10
+from tenk1, (values (0.01::float8),(0.1),(0.5),(0.9),(0.99)) v(p)
+group by p order by p;
+select approx_percentile(x, null) from generate_series(1,5) x;
+select approx_percentile(x, 0.5) from generate_series(1,0) x;
+select approx_percentile(x, 1.5) from generate_series(1,5) x;  -- error
+select approx_percentile(x, x / 10.0) from generate_series(1,5) x;  -- error
+select approx_percentile(x, 0.5)
+from (values (1::float8),('infinity')) v(x);  -- error
+
+-- approx_count_distinct and HyperLogLog sketches
+select approx_count_distinct(ten), approx_count_distinct(ten::int8),
+       count(distinct ten)
+from tenk1;
+select abs(approx_count_distinct(unique1) - 10000) < 1000,
+       abs(approx_count_distinct(stringu1) - 10000) < 1000
+from tenk1;
+select approx_count_distinct(x), hll_sketch(x) is null
+from generate_series(1,0) x;
+select approx_count_distinct(null::int) from generate_series(1,3);
+create temp table hll_rollup as
+  select ten, hll_sketch(unique1) as s from tenk1 group by ten;
+select (select hll_union(s) from hll_rollup) =
+       (select hll_sketch(unique1) from tenk1);
+select abs(hll_cardinality(hll_union(s)) - 10000) < 1000 from hll_rollup;
+drop table hll_rollup;
+select hll_cardinality('\x00'::bytea);  -- error
+select approx_count_distinct(point(1,1));  -- error
+
 -- ordered-set aggs created with CREATE AGGREGATE
 select test_rank(3) within group (order by x)
 from (values (1),(1),(2),(2),(3),(3),(4)) v(x);
@@ -242,3 +242,97 @@ CREATE TABLE btree_part (id int4) PARTITION BY RANGE (id);
 CREATE INDEX btree_part_idx ON btree_part(id);
 ALTER INDEX btree_part_idx ALTER COLUMN id SET (n_distinct=100);
 DROP TABLE btree_part;
+
+-- Searches comparing an integer-like leading key column inline: negative
+-- values, DESC columns, NULLs, ties on the leading column, and OIDs beyond
+-- the signed 32-bit range
+CREATE TABLE btree_fastcmp (i2 int2, i8 int8, o oid);
+INSERT INTO btree_fastcmp
+  SELECT (i % 200) - 100, i - 2000, i FROM generate_series(1, 4000) i;
+INSERT INTO btree_fastcmp VALUES (NULL, NULL, NULL), (NULL, NULL, 4000000000);
+CREATE INDEX btree_fastcmp_i2 ON btree_fastcmp (i2, i8);
+CREATE INDEX btree_fastcmp_i8 ON btree_fastcmp (i8 DESC);
+CREATE INDEX btree_fastcmp_o ON btree_fastcmp (o);
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM btree_fastcmp WHERE i2 = -100::int2;
+SELECT i2, i8 FROM btree_fastcmp WHERE i2 = -3::int2 AND i8 > 1000::int8 ORDER BY i2, i8;
+SELECT i8 FROM btree_fastcmp WHERE i8 BETWEEN -5::int8 AND 5::int8 ORDER BY i8 DESC;
+SELECT o FROM btree_fastcmp WHERE o >= 3998 ORDER BY o;
+SELECT count(*) FROM btree_fastcmp WHERE i2 IS NULL;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE btree_fastcmp;
+
+-- High keys of text indexes under the "C" collation may be truncated within
+-- the value; check that searches still find everything
+CREATE TABLE btree_prefix (t text COLLATE "C");
+CREATE INDEX btree_prefix_idx ON btree_prefix (t);
+INSERT INTO btree_prefix
+  SELECT 'https://www.example.com/a/rather/long/shared/path/' || i
+  FROM generate_series(1, 10000) i;
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT count(*) FROM btree_prefix
+  WHERE t >= 'https://www.example.com/a/rather/long/shared/path/5';
+SELECT t FROM btree_prefix
+  WHERE t = 'https://www.example.com/a/rather/long/shared/path/7777';
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE btree_prefix;
+
+-- Skip scans: quals on the second index column only
+CREATE TABLE btree_skip (a int, b int);
+INSERT INTO btree_skip SELECT i % 5, i FROM generate_series(1, 10000) i;
+INSERT INTO btree_skip VALUES (NULL, 42), (NULL, 43);
+CREATE INDEX btree_skip_a_b ON btree_skip (a, b);
+VACUUM ANALYZE btree_skip;
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM btree_skip WHERE b = 42 ORDER BY a, b;
+SELECT a, b FROM btree_skip WHERE b = 42 ORDER BY a, b;
+EXPLAIN (COSTS OFF)
+SELECT a, b FROM btree_skip WHERE b BETWEEN 40 AND 44 ORDER BY a DESC, b DESC;
+SELECT a, b FROM btree_skip WHERE b BETWEEN 40 AND 44 ORDER BY a DESC, b DESC;
+SELECT a, b FROM btree_skip WHERE b IN (7, 9, 100) ORDER BY a, b;
+SELECT count(*) FROM btree_skip WHERE b > 9990;
+-- Skip scans must cope with mark/restore and with rescans
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SET enable_hashjoin = off;
+SET enable_nestloop = off;
+SET enable_material = off;
+EXPLAIN (COSTS OFF)
+SELECT t1.b, t2.b FROM btree_skip t1 JOIN btree_skip t2 ON t1.a = t2.a
+  WHERE t1.b < 8 AND t2.b < 13 ORDER BY t1.b, t2.b;
+SELECT t1.b, t2.b FROM btree_skip t1 JOIN btree_skip t2 ON t1.a = t2.a
+  WHERE t1.b < 8 AND t2.b < 13 ORDER BY t1.b, t2.b;
+RESET enable_nestloop;
+SET enable_mergejoin = off;
+EXPLAIN (COSTS OFF)
+SELECT v.x, s.a FROM (VALUES (42), (7), (100)) v(x) JOIN btree_skip s ON s.b = v.x;
+SELECT v.x, s.a FROM (VALUES (42), (7), (100)) v(x) JOIN btree_skip s ON s.b = v.x;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+RESET enable_material;
+RESET enable_bitmapscan;
+SET enable_seqscan = off;
+SET enable_indexscan = off;
+SET enable_indexonlyscan = off;
+SELECT count(*) FROM btree_skip WHERE b > 3 AND b < 10;
+RESET enable_seqscan;
+RESET enable_indexscan;
+RESET enable_indexonlyscan;
+DROP TABLE btree_skip;
+-- Skip scans stop skipping when the leading column is nearly unique
+CREATE TABLE btree_skip_many (a int, b int);
+INSERT INTO btree_skip_many SELECT i / 2, i % 7 FROM generate_series(1, 2000) i;
+CREATE INDEX btree_skip_many_a_b ON btree_skip_many (a, b);
+VACUUM ANALYZE btree_skip_many;
+SET enable_seqscan = off;
+SET enable_bitmapscan = off;
+SELECT a, b FROM btree_skip_many WHERE b = 3 ORDER BY a, b OFFSET 200 LIMIT 3;
+SELECT a, b FROM btree_skip_many WHERE b = 3 ORDER BY a DESC, b DESC OFFSET 200 LIMIT 3;
+SELECT count(*), sum(a) FROM btree_skip_many WHERE b = 3;
+RESET enable_seqscan;
+RESET enable_bitmapscan;
+DROP TABLE btree_skip_many;
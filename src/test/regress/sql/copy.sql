@@ -135,6 +135,41 @@ select * from parted_copytest where b = 2;
 
 drop table parted_copytest;
 
+-- Load a range-partitioned table in key order, with stray rows that belong
+-- to other partitions interleaved, as in a time-series load with late rows.
+-- There are more partitions than COPY keeps multi-insert buffers for, so the
+-- buffers are trimmed after each flush.  The stray rows must be routed
+-- correctly without disturbing the partitions currently being loaded.
+create table parted_copytest2 (a int, b int) partition by range (a);
+create table parted_copytest2_def partition of parted_copytest2 default;
+do $$
+begin
+  for i in 0..39 loop
+    execute format('create table parted_copytest2_p%s partition of parted_copytest2 for values from (%s) to (%s)',
+                   i, i * 1000, (i + 1) * 1000);
+  end loop;
+end;
+$$;
+
+\set filename :abs_builddir '/results/parted_copytest2.csv'
+copy (select case when x % 500 = 250 then -x
+                  when x % 100 = 99 then (x * 37) % 40000
+                  else x end, x
+      from generate_series(0, 39999) x) to :'filename';
+
+copy parted_copytest2 from :'filename';
+
+select count(*), sum(a) from parted_copytest2;
+select count(*) filter (where a <> b) as stray,
+       count(*) filter (where tableoid = 'parted_copytest2_def'::regclass) as default_rows
+from parted_copytest2;
+-- Every row must be in the partition its key belongs to.
+select count(*) from parted_copytest2
+where tableoid <> (case when a < 0 then 'parted_copytest2_def'
+                        else 'parted_copytest2_p' || a / 1000 end)::regclass;
+
+drop table parted_copytest2;
+
 --
 -- Progress reporting for COPY
 --
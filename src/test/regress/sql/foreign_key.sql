@@ -2013,3 +2013,44 @@ UPDATE fkpart11.pk SET a = 3 WHERE a = 4;
 UPDATE fkpart11.pk SET a = 1 WHERE a = 2;
 
 DROP SCHEMA fkpart11 CASCADE;
+
+-- FK checks probing the referenced table's unique index directly, with the
+-- referenced columns in another order than in the index, and cross-type or
+-- binary-coercible comparisons
+CREATE TABLE fkprobe_pk (a int, b text, UNIQUE (b, a));
+CREATE TABLE fkprobe_fk (x int8, y varchar,
+  FOREIGN KEY (x, y) REFERENCES fkprobe_pk (a, b));
+INSERT INTO fkprobe_pk VALUES (1, 'one'), (2, 'two');
+INSERT INTO fkprobe_fk VALUES (1, 'one'), (2, 'two'), (2, NULL);
+INSERT INTO fkprobe_fk VALUES (1, 'two');  -- fail
+UPDATE fkprobe_fk SET x = 1 WHERE y = 'two';  -- fail
+-- the referenced row must be visible to the check even if inserted by the
+-- same statement, and must not be if deleted earlier
+WITH p AS (INSERT INTO fkprobe_pk VALUES (3, 'three'))
+INSERT INTO fkprobe_fk VALUES (3, 'three');
+BEGIN;
+DELETE FROM fkprobe_fk WHERE x = 3;
+DELETE FROM fkprobe_pk WHERE a = 3;
+INSERT INTO fkprobe_fk VALUES (3, 'three');  -- fail
+ROLLBACK;
+SELECT * FROM fkprobe_fk ORDER BY x, y;
+DROP TABLE fkprobe_fk, fkprobe_pk;
+
+-- FK check events beyond work_mem are spilled to a temporary file and read
+-- back at the end of the statement
+CREATE TABLE fkspill_pk (a int PRIMARY KEY);
+CREATE TABLE fkspill_fk (a int REFERENCES fkspill_pk ON DELETE CASCADE);
+INSERT INTO fkspill_pk SELECT generate_series(1, 40000);
+SET work_mem = '64kB';
+INSERT INTO fkspill_fk SELECT generate_series(1, 40001);  -- fail
+INSERT INTO fkspill_fk SELECT generate_series(1, 40000);
+UPDATE fkspill_fk SET a = a + 1 WHERE a < 40000;
+BEGIN;
+SAVEPOINT s;
+UPDATE fkspill_fk SET a = a + 1;  -- fail
+ROLLBACK TO s;
+DELETE FROM fkspill_pk WHERE a % 2 = 0;
+COMMIT;
+RESET work_mem;
+SELECT count(*), min(a), max(a) FROM fkspill_fk;
+DROP TABLE fkspill_fk, fkspill_pk;
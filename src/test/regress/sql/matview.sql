@@ -295,3 +295,80 @@ EXPLAIN (ANALYZE, COSTS OFF, SUMMARY OFF, TIMING OFF)
   CREATE MATERIALIZED VIEW IF NOT EXISTS matview_ine_tab AS
     SELECT 1 / 0 WITH NO DATA; -- ok
 DROP MATERIALIZED VIEW matview_ine_tab;
+
+-- incrementally maintained materialized views
+CREATE TABLE mvi_a (id int PRIMARY KEY, grp int, val int);
+CREATE TABLE mvi_b (grp int, name text);
+INSERT INTO mvi_a VALUES (1, 1, 10), (2, 1, 20), (3, 2, 30);
+INSERT INTO mvi_b VALUES (1, 'one'), (2, 'two');
+CREATE MATERIALIZED VIEW mvi_join WITH (incremental) AS
+  SELECT a.id, b.name, a.val FROM mvi_a a JOIN mvi_b b ON a.grp = b.grp;
+CREATE MATERIALIZED VIEW mvi_agg WITH (incremental) AS
+  SELECT grp, count(*) AS cnt, sum(val) AS total FROM mvi_a GROUP BY grp;
+INSERT INTO mvi_a VALUES (4, 2, 40);
+UPDATE mvi_a SET val = val + 1 WHERE id = 1;
+DELETE FROM mvi_a WHERE id = 2;
+INSERT INTO mvi_b VALUES (2, 'deux');
+REFRESH MATERIALIZED VIEW mvi_join;
+REFRESH MATERIALIZED VIEW mvi_agg;
+SELECT * FROM mvi_join ORDER BY id, name;
+SELECT * FROM mvi_agg ORDER BY grp;
+-- a truncated table makes the refresh recompute the view
+TRUNCATE mvi_b;
+-- which needs a snapshot taken after the view is locked
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+REFRESH MATERIALIZED VIEW mvi_join; -- error
+ROLLBACK;
+REFRESH MATERIALIZED VIEW mvi_join;
+SELECT count(*) FROM mvi_join;
+ALTER MATERIALIZED VIEW mvi_agg SET (incremental = false); -- error
+CREATE MATERIALIZED VIEW mvi_bad WITH (incremental) AS
+  SELECT DISTINCT grp FROM mvi_a; -- error
+CREATE MATERIALIZED VIEW mvi_bad WITH (incremental) AS
+  SELECT a.id FROM mvi_a a LEFT JOIN mvi_b b ON a.grp = b.grp; -- error
+DROP MATERIALIZED VIEW mvi_join, mvi_agg;
+DROP TABLE mvi_a, mvi_b;
+
+-- aggregates maintained in place, a self-join and a view over two changed
+-- tables; groups are emptied by DELETE and by UPDATE
+CREATE TABLE mvi_c (grp int, val int NOT NULL, opt int);
+CREATE TABLE mvi_d (grp int PRIMARY KEY, name text);
+INSERT INTO mvi_c VALUES (1, 1, NULL), (1, 2, 5), (2, 3, 7), (4, 10, 20);
+INSERT INTO mvi_d VALUES (1, 'one'), (2, 'two'), (4, 'four');
+CREATE MATERIALIZED VIEW mvi_sums WITH (incremental) AS
+  SELECT grp, count(*) AS cnt, sum(val) AS sv, avg(val) AS av,
+         count(opt) AS co, sum(opt) AS so
+  FROM mvi_c GROUP BY grp;
+CREATE MATERIALIZED VIEW mvi_total WITH (incremental) AS
+  SELECT count(*) AS cnt, sum(val) AS sv, avg(val) AS av FROM mvi_c;
+CREATE MATERIALIZED VIEW mvi_self WITH (incremental) AS
+  SELECT x.val AS v1, y.val AS v2
+  FROM mvi_c x JOIN mvi_c y ON x.grp = y.grp AND x.val < y.val;
+CREATE MATERIALIZED VIEW mvi_named WITH (incremental) AS
+  SELECT d.name, count(*) AS cnt, sum(c.val) AS sv
+  FROM mvi_c c JOIN mvi_d d ON c.grp = d.grp GROUP BY d.name;
+INSERT INTO mvi_c VALUES (3, 4, NULL);
+UPDATE mvi_c SET grp = 3 WHERE grp = 2;
+DELETE FROM mvi_c WHERE grp = 4;
+UPDATE mvi_c SET opt = NULL WHERE grp = 1;
+INSERT INTO mvi_d VALUES (3, 'three');
+UPDATE mvi_d SET name = 'uno' WHERE grp = 1;
+REFRESH MATERIALIZED VIEW mvi_sums;
+REFRESH MATERIALIZED VIEW mvi_total;
+REFRESH MATERIALIZED VIEW mvi_self;
+REFRESH MATERIALIZED VIEW mvi_named;
+SELECT * FROM mvi_sums ORDER BY grp;
+SELECT * FROM mvi_total;
+SELECT * FROM mvi_self ORDER BY v1, v2;
+SELECT * FROM mvi_named ORDER BY name;
+-- emptying the table leaves the sums null
+DELETE FROM mvi_c;
+REFRESH MATERIALIZED VIEW mvi_total;
+SELECT * FROM mvi_total;
+INSERT INTO mvi_c VALUES (1, 1, NULL), (3, 3, 7);
+REFRESH MATERIALIZED VIEW mvi_total;
+REFRESH MATERIALIZED VIEW mvi_named;
+SELECT * FROM mvi_total;
+SELECT * FROM mvi_named ORDER BY name;
+DROP MATERIALIZED VIEW mvi_sums, mvi_total, mvi_self;
+-- leave mvi_named and its tables around, for pg_dump and pg_upgrade testing
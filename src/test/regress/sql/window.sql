@@ -1621,3 +1621,30 @@ $$ LANGUAGE SQL STABLE;
 
 EXPLAIN (costs off) SELECT * FROM pg_temp.f(2);
 SELECT * FROM pg_temp.f(2);
+
+-- aggregates without inverse transition functions over long moving frames
+-- are evaluated from a segment tree; compare with direct computation
+CREATE TEMP TABLE segtree_t AS
+  SELECT i, CASE WHEN i % 7 = 0 THEN NULL ELSE (i * 7919) % 1000 END AS v
+  FROM generate_series(1, 1000) i;
+
+SELECT count(*) AS mismatches
+FROM (SELECT i, max(v) OVER w AS mx, min(v) OVER w AS mn,
+             bit_or(v) OVER w AS bo
+      FROM segtree_t
+      WINDOW w AS (ORDER BY i ROWS BETWEEN 40 PRECEDING AND 60 FOLLOWING)) s
+WHERE mx IS DISTINCT FROM
+        (SELECT max(v) FROM segtree_t t WHERE t.i BETWEEN s.i - 40 AND s.i + 60)
+   OR mn IS DISTINCT FROM
+        (SELECT min(v) FROM segtree_t t WHERE t.i BETWEEN s.i - 40 AND s.i + 60)
+   OR bo IS DISTINCT FROM
+        (SELECT bit_or(v) FROM segtree_t t WHERE t.i BETWEEN s.i - 40 AND s.i + 60);
+
+SELECT count(*) AS mismatches
+FROM (SELECT i, max(v) OVER w AS mx
+      FROM segtree_t
+      WINDOW w AS (ORDER BY i / 50 GROUPS BETWEEN CURRENT ROW AND CURRENT ROW)) s
+WHERE mx IS DISTINCT FROM
+      (SELECT max(v) FROM segtree_t t WHERE t.i / 50 = s.i / 50);
+
+DROP TABLE segtree_t;
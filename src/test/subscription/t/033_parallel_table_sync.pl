@@ -0,0 +1,207 @@
+
+# Copyright (c) 2022, PostgreSQL Global Development Group
+
+# Test initial table synchronization with table copy workers, including
+# restarts of the tablesync worker in DATASYNC and FINISHEDCOPY states and
+# duplicate keys in the copied data
+use strict;
+use warnings;
+use PostgreSQL::Test::Cluster;
+use PostgreSQL::Test::Utils;
+use Test::More;
+
+# Create publisher node
+my $node_publisher = PostgreSQL::Test::Cluster->new('publisher');
+$node_publisher->init(allows_streaming => 'logical');
+$node_publisher->start;
+
+# Create subscriber node, splitting tables into many small chunks
+my $node_subscriber = PostgreSQL::Test::Cluster->new('subscriber');
+$node_subscriber->init(allows_streaming => 'logical');
+$node_subscriber->append_conf(
+	'postgresql.conf', qq(
+max_prepared_transactions = 10
+max_worker_processes = 12
+max_logical_replication_workers = 10
+max_sync_workers_per_subscription = 4
+min_parallel_table_sync_size = 64kB
+table_sync_chunk_size = 64kB
+wal_retrieve_retry_interval = 1s
+log_min_messages = debug1
+));
+$node_subscriber->start;
+
+for my $tab ('tab1', 'tab2')
+{
+	$node_publisher->safe_psql('postgres',
+		"CREATE TABLE $tab (a int primary key, b text)");
+	$node_publisher->safe_psql('postgres',
+		"INSERT INTO $tab SELECT i, md5(i::text) FROM generate_series(1, 20000) i"
+	);
+}
+$node_publisher->safe_psql('postgres',
+	"CREATE TABLE tab3 (a int, b text)");
+$node_publisher->safe_psql('postgres',
+	"ALTER TABLE tab3 REPLICA IDENTITY FULL");
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab3 SELECT i, md5(i::text) FROM generate_series(1, 20000) i"
+);
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab3 VALUES (1, 'dup')");
+
+# The copy of the first row of tab1 and tab2 is held back as long as the
+# hold flag is set.  This leaves the copy unfinished while the other table
+# copy workers prepare their share.
+$node_subscriber->safe_psql(
+	'postgres', q{
+CREATE TABLE sync_ctl (hold bool);
+INSERT INTO sync_ctl VALUES (true);
+CREATE FUNCTION hold_first_row() RETURNS trigger LANGUAGE plpgsql AS $$
+BEGIN
+  IF NEW.a = 1 THEN
+    WHILE (SELECT hold FROM public.sync_ctl) LOOP
+      PERFORM pg_sleep(0.1);
+    END LOOP;
+  END IF;
+  RETURN NEW;
+END $$;
+CREATE TABLE tab1 (a int primary key, b text);
+CREATE TABLE tab2 (a int primary key, b text);
+CREATE TABLE tab3 (a int primary key, b text);
+CREATE TRIGGER hold_first_row BEFORE INSERT ON tab1
+  FOR EACH ROW EXECUTE FUNCTION hold_first_row();
+ALTER TABLE tab1 ENABLE ALWAYS TRIGGER hold_first_row;
+CREATE TRIGGER hold_first_row BEFORE INSERT ON tab2
+  FOR EACH ROW EXECUTE FUNCTION hold_first_row();
+ALTER TABLE tab2 ENABLE ALWAYS TRIGGER hold_first_row;
+});
+
+my $publisher_connstr = $node_publisher->connstr . ' dbname=postgres';
+$node_publisher->safe_psql('postgres',
+	"CREATE PUBLICATION tap_pub FOR TABLE tab1");
+
+my $offset = -s $node_subscriber->logfile;
+$node_subscriber->safe_psql('postgres',
+	"CREATE SUBSCRIPTION tap_sub CONNECTION '$publisher_connstr' PUBLICATION tap_pub"
+);
+
+$node_subscriber->wait_for_log(
+	qr/copying table "public.tab1" in \d+ chunks with [1-9]\d* table copy workers/,
+	$offset);
+pass('tab1 is copied by table copy workers');
+
+# Crash the subscriber once some table copy workers have prepared their
+# share, while the copy is still unfinished.
+$node_subscriber->poll_query_until('postgres',
+	"SELECT count(*) > 0 FROM pg_prepared_xacts WHERE gid LIKE 'pg_sync_%'")
+  or die "Timed out while waiting for table copy workers to prepare";
+
+my $result = $node_subscriber->safe_psql('postgres',
+	"SELECT srsubstate FROM pg_subscription_rel WHERE srrelid = 'tab1'::regclass"
+);
+is($result, 'd', 'tab1 is in DATASYNC state');
+
+$node_subscriber->safe_psql('postgres', "UPDATE sync_ctl SET hold = false");
+$node_subscriber->stop('immediate');
+$node_subscriber->start;
+
+# The copy starts over, without the share prepared before the crash.
+$node_subscriber->wait_for_subscription_sync($node_publisher, 'tap_sub');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*), count(DISTINCT a), max(a) FROM tab1");
+is($result, qq(20000|20000|20000),
+	'tab1 was copied after restart in DATASYNC state');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*) FROM pg_prepared_xacts");
+is($result, qq(0), 'no prepared transactions left after copying tab1');
+
+# Make the catchup phase of tab2 fail on a row inserted on the publisher
+# after the copy has started, which restarts the tablesync worker in
+# FINISHEDCOPY state.
+$node_subscriber->safe_psql(
+	'postgres', q{
+UPDATE sync_ctl SET hold = true;
+INSERT INTO tab2 VALUES (30000, 'local');
+});
+
+$offset = -s $node_subscriber->logfile;
+$node_publisher->safe_psql('postgres',
+	"ALTER PUBLICATION tap_pub ADD TABLE tab2");
+$node_subscriber->safe_psql('postgres',
+	"ALTER SUBSCRIPTION tap_sub REFRESH PUBLICATION");
+
+$node_subscriber->poll_query_until('postgres',
+	"SELECT count(*) > 0 FROM pg_prepared_xacts WHERE gid LIKE 'pg_sync_%'")
+  or die "Timed out while waiting for table copy workers to prepare";
+
+$node_publisher->safe_psql('postgres',
+	"INSERT INTO tab2 VALUES (30000, 'remote')");
+$node_subscriber->safe_psql('postgres', "UPDATE sync_ctl SET hold = false");
+
+$node_subscriber->wait_for_log(
+	qr/duplicate key value violates unique constraint "tab2_pkey"/, $offset);
+
+$offset = -s $node_subscriber->logfile;
+$node_subscriber->wait_for_log(
+	qr/duplicate key value violates unique constraint "tab2_pkey"/, $offset);
+pass('tablesync worker for tab2 was restarted in FINISHEDCOPY state');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT srsubstate FROM pg_subscription_rel WHERE srrelid = 'tab2'::regclass"
+);
+is($result, 'f', 'tab2 is in FINISHEDCOPY state');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*), count(DISTINCT a) FROM tab2");
+is($result, qq(20001|20001),
+	'share of the table copy workers was committed with the copy');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*) FROM pg_prepared_xacts");
+is($result, qq(0), 'no prepared transactions left after copying tab2');
+
+# Resolve the conflict and let the synchronization finish.
+$node_subscriber->safe_psql('postgres', "DELETE FROM tab2 WHERE a = 30000");
+$node_subscriber->wait_for_subscription_sync($node_publisher, 'tap_sub');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*), count(DISTINCT a), max(b) FILTER (WHERE a = 30000) FROM tab2"
+);
+is($result, qq(20001|20001|remote), 'tab2 was synchronized');
+
+# A duplicate key in the copied data makes a table copy worker time out
+# waiting for another one.  The tablesync worker then copies the table by
+# itself, which fails like a non-parallel copy would.
+$offset = -s $node_subscriber->logfile;
+$node_publisher->safe_psql('postgres',
+	"ALTER PUBLICATION tap_pub ADD TABLE tab3");
+$node_subscriber->safe_psql('postgres',
+	"ALTER SUBSCRIPTION tap_sub REFRESH PUBLICATION");
+
+$node_subscriber->wait_for_log(
+	qr/table copy worker for subscription "tap_sub", table "tab3" exited before finishing its copy/,
+	$offset);
+pass('table copy worker for tab3 failed on duplicate key');
+
+$node_subscriber->wait_for_log(
+	qr/duplicate key value violates unique constraint "tab3_pkey"/, $offset);
+pass('copy of tab3 without table copy workers failed on duplicate key');
+
+$node_publisher->safe_psql('postgres', "DELETE FROM tab3 WHERE b = 'dup'");
+$node_subscriber->wait_for_subscription_sync($node_publisher, 'tap_sub');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*), count(DISTINCT a), max(a) FROM tab3");
+is($result, qq(20000|20000|20000),
+	'tab3 was copied once the duplicate key was removed');
+
+$result = $node_subscriber->safe_psql('postgres',
+	"SELECT count(*) FROM pg_prepared_xacts");
+is($result, qq(0), 'no prepared transactions left after copying tab3');
+
+$node_subscriber->stop;
+$node_publisher->stop;
+
+done_testing();